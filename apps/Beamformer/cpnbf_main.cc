@@ -196,12 +196,13 @@ public:
 };
 CPN_DECLARE_NODE_FACTORY(CPNBFInputNode, CPNBFInputNode);
 
-static const char* const VALID_OPTS = "h:i:o:er:R:na:s:c:f:F:S:q:p:PCv:V:j:J:lk:D:O:H:M:";
+static const char* const VALID_OPTS = "h:i:o:er:R:na:s:c:d:f:F:S:q:p:PCv:V:j:J:lk:D:O:H:M:";
 
 static const char* const HELP_OPTS = "Usage: %s [options]\n"
 "\t-a n\t Use algorithm n for vertical\n"
 "\t-C\t Print config and exit\n"
 "\t-c y|n\t Load internal config. (default: yes)\n"
+"\t-d y|n\t Turn the D4R deadlock detection on or off (default: yes).\n"
 "\t-D num\t A number to divide the number of threads for omp when specifying -p\n"
 "\t-e\t Estimate FFT algorithm rather than measure.\n"
 "\t-f y|n\t Use the 'fan' vertical beamformer (default: yes).\n"
@@ -278,6 +279,9 @@ int cpnbf_main(int argc, char **argv) {
         case 'c':
             load_internal_config = ParseBool(optarg);
             break;
+        case 'd':
+            loader.UseD4R(ParseBool(optarg));
+            break;
         case 'D':
             thread_divisor = atoi(optarg);
             break;
@@ -0,0 +1,18 @@
+unsigned char ThresholdSieveDefaults_json[] = {
+  0x0a, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x22, 0x6d, 0x61, 0x78, 0x70,
+  0x72, 0x69, 0x6d, 0x65, 0x22, 0x3a, 0x20, 0x31, 0x30, 0x30, 0x2c, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x22, 0x71, 0x75, 0x65, 0x75, 0x65, 0x73, 0x69,
+  0x7a, 0x65, 0x22, 0x3a, 0x20, 0x31, 0x30, 0x30, 0x2c, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x22, 0x74, 0x68, 0x72, 0x65, 0x73, 0x68, 0x6f, 0x6c, 0x64,
+  0x22, 0x3a, 0x20, 0x32, 0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x22, 0x70,
+  0x70, 0x66, 0x22, 0x3a, 0x20, 0x5b, 0x31, 0x5d, 0x2c, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x22, 0x70, 0x72, 0x69, 0x6d, 0x65, 0x77, 0x68, 0x65, 0x65,
+  0x6c, 0x22, 0x3a, 0x20, 0x30, 0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x22,
+  0x71, 0x75, 0x65, 0x75, 0x65, 0x68, 0x69, 0x6e, 0x74, 0x22, 0x3a, 0x20,
+  0x22, 0x74, 0x68, 0x72, 0x65, 0x73, 0x68, 0x6f, 0x6c, 0x64, 0x22, 0x2c,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x22, 0x72, 0x65, 0x70, 0x6f, 0x72, 0x74,
+  0x22, 0x3a, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x22, 0x7a, 0x65, 0x72, 0x6f, 0x63, 0x6f, 0x70, 0x79, 0x22,
+  0x3a, 0x20, 0x30, 0x0a, 0x7d, 0x0a, 0x0a
+};
+unsigned int ThresholdSieveDefaults_json_len = 175;
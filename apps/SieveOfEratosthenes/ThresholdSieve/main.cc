@@ -84,6 +84,8 @@ static void PrintHelp(const std::string &progname) {
         "\t-C\tPrint config\n"
         "\t-P file\tLoad file as JSON and merge with params to controller\n"
         "\t-d num\tDivisor for calculation of which kernel to choose when creating filters.\n"
+        "\t-F\tRun the nodes as fibers on one worker thread per processor.\n"
+        "\t-D y|n\tTurn the D4R deadlock detection on or off (default n)\n"
         "\n"
         "Note that when the number of primes in the prime wheel is not zero the maximum\n"
         "number to consider for primes is not exact.\n"
@@ -144,7 +146,7 @@ int main(int argc, char **argv) {
     bool internal_config = true;;
     std::string outfile = "";
     while (true) {
-        int c = getopt(argc, argv, "m:q:t:hf:i:p:vVw:rz:j:J:c:CP:d:l:");
+        int c = getopt(argc, argv, "m:q:t:hf:i:p:vVw:rz:j:J:c:CP:d:l:FD:");
         if (c == -1) break;
         switch (c) {
         case 'd':
@@ -244,6 +246,12 @@ int main(int argc, char **argv) {
         case 'r':
             param["report"] = true;
             break;
+        case 'F':
+            loader.UseFibers(true);
+            break;
+        case 'D':
+            loader.UseD4R(ParseBool(optarg));
+            break;
         case 'z':
             param["zerocopy"] = atoi(optarg);
             break;
@@ -306,6 +314,7 @@ int main(int argc, char **argv) {
             result["primewheel"] = param["primewheel"];
             result["ppf"] = param["ppf"];
             result["zerocopy"] = param["zerocopy"];
+            result["d4r"] = loader.GetConfig()["d4r"];
             output.Append(result);
         }
         if (!outfile.empty()) {
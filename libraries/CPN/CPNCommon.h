@@ -84,6 +84,7 @@ namespace CPN {
     class QueueWriter;
     class QueueAttr;
     class SimpleQueueAttr;
+    class GrowPolicy;
 
     class NodeAttr;
     class NodeBase;
@@ -95,6 +96,9 @@ namespace CPN {
     class RemoteQueue;
     class ConnectionServer;
 
+    class Fiber;
+    class FiberScheduler;
+
     // Global enums
     /**
      * Hints that can be given about what kind of queue
@@ -102,12 +106,29 @@ namespace CPN {
      */
     enum QueueHint_t { QUEUEHINT_DEFAULT, QUEUEHINT_THRESHOLD };
 
+    /**
+     * Values for QueueAttr::SetMemoryNode other than a NUMA node
+     * number.
+     */
+    enum QueueMemoryNode_t {
+        QUEUEMEMORY_ANY = -1, ///< No preference
+        QUEUEMEMORY_READER = -2, ///< The NUMA node of the reader
+        QUEUEMEMORY_WRITER = -3 ///< The NUMA node of the writer
+    };
+
     // Types
     /**
      * Key_t is used for all the keys for each of the objects.
      */
     typedef uint64_t Key_t;
 
+    /**
+     * QueueSize_t is used for all queue lengths, thresholds and byte
+     * counts so that a queue or a single threshold may be larger than
+     * 4 GiB. Code written against unsigned converts implicitly.
+     */
+    typedef uint64_t QueueSize_t;
+
 }
 
 #endif
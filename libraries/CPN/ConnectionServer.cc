@@ -43,54 +43,74 @@ namespace CPN {
         std::deque<FileHandle*> files;
         files.push_back(&server);
         files.push_back(&wakeup);
+        {
+            AutoPLock al(lock);
+            for (unsigned i = 0; i < extraservers.size(); ++i) {
+                files.push_back(extraservers[i].get());
+            }
+        }
         FileHandle::Poll(files.begin(), files.end(), -1);
         wakeup.Read();
         if (server.Readable()) {
             server.Readable(false);
-            try {
-                SocketHandle sock(server.Accept());
-                Packet packet;
-                unsigned num = sock.Read(&packet.header, sizeof(packet.header));
-                if (num != sizeof(packet.header)) {
-                    return;
-                }
-                if (!packet.Valid()) {
-                    return;
-                }
-                if ((packet.Type() == PACKET_ID_READER)
-                        || (packet.Type() == PACKET_ID_WRITER)) {
-                    AutoPLock al(lock);
-                    Key_t key = packet.DestinationKey();
-                    shared_ptr<PendingConnection> conn;
-                    std::pair<PendingMap::iterator, PendingMap::iterator> range;
-                    range = pendingconnections.equal_range(key);
-                    PendingMap::iterator entry = range.first;
-                    PendingMap::iterator end = range.second;
-                    while (entry != end) {
-                        if (!entry->second->Done()) {
-                            conn = entry->second;
-                            break;
-                        }
-                        ++entry;
-                    }
-                    if (!conn) {
-                        conn = shared_ptr<PendingConnection>(new PendingConnection(key, this));
-                        pendingconnections.insert(std::make_pair(key, conn));
+            Accept(server);
+        }
+        for (unsigned i = 2; i < files.size(); ++i) {
+            ServerSocketHandle *serv = static_cast<ServerSocketHandle*>(files[i]);
+            if (serv->Readable()) {
+                serv->Readable(false);
+                Accept(*serv);
+            }
+        }
+    }
+
+    void ConnectionServer::Accept(ServerSocketHandle &serv) {
+        try {
+            SocketHandle sock(serv.Accept());
+            Packet packet;
+            unsigned num = sock.Read(&packet.header, sizeof(packet.header));
+            if (num != sizeof(packet.header)) {
+                return;
+            }
+            if (!packet.Valid()) {
+                return;
+            }
+            if ((packet.Type() == PACKET_ID_READER)
+                    || (packet.Type() == PACKET_ID_WRITER)) {
+                AutoPLock al(lock);
+                Key_t key = packet.DestinationKey();
+                shared_ptr<PendingConnection> conn;
+                std::pair<PendingMap::iterator, PendingMap::iterator> range;
+                range = pendingconnections.equal_range(key);
+                PendingMap::iterator entry = range.first;
+                PendingMap::iterator end = range.second;
+                while (entry != end) {
+                    if (!entry->second->Done() && entry->second->GetStripe() == packet.Stripe()) {
+                        conn = entry->second;
+                        break;
                     }
-                    conn->Set(sock.FD());
-                    sock.Reset();
+                    ++entry;
                 }
-            } catch (const ErrnoException &e) {
-                // Ignore, if we had an error we closed the socket when we
-                // left the scope, will try again later
-                logger.Error("Exception in ConnectionServer main loop (e: %d): %s", e.Error(), e.what());
+                if (!conn) {
+                    conn = shared_ptr<PendingConnection>(new PendingConnection(key, packet.Stripe(), this));
+                    pendingconnections.insert(std::make_pair(key, conn));
+                }
+                conn->Set(sock.FD(), packet.Version());
+                sock.Reset();
             }
+        } catch (const ErrnoException &e) {
+            // Ignore, if we had an error we closed the socket when we
+            // left the scope, will try again later
+            logger.Error("Exception in ConnectionServer main loop (e: %d): %s", e.Error(), e.what());
         }
     }
 
     void ConnectionServer::Close() {
         AutoPLock al(lock);
         server.Close();
+        for (unsigned i = 0; i < extraservers.size(); ++i) {
+            extraservers[i]->Close();
+        }
         for (PendingMap::iterator itr = pendingconnections.begin();
                 itr != pendingconnections.end(); ++itr)
         {
@@ -98,24 +118,35 @@ namespace CPN {
         }
     }
 
-    shared_ptr<Sync::Future<int> > ConnectionServer::ConnectWriter(Key_t writerkey) {
+    shared_ptr<ConnectionServer::PendingConnection> ConnectionServer::ConnectWriter(Key_t writerkey, unsigned stripe,
+            const std::vector<std::string> &localaddrs, const std::vector<std::string> &readeraddrs) {
         if (server.Closed()) {
-            return shared_ptr<Sync::Future<int> >();
+            return shared_ptr<PendingConnection>();
         }
         AutoPLock al(lock);
         shared_ptr<PendingConnection> conn;
         if (enabled) {
             al.Unlock();
-            conn = shared_ptr<PendingConnection>(new PendingConnection(writerkey, this));
+            conn = shared_ptr<PendingConnection>(new PendingConnection(writerkey, stripe, this));
             Key_t readerkey = context->GetWritersReader(writerkey);
             Key_t kernelkey = context->GetReaderKernel(readerkey);
             std::string hostname;
             std::string servname;
             context->GetKernelConnectionInfo(kernelkey, hostname, servname);
+            if (!readeraddrs.empty()) {
+                hostname = readeraddrs[stripe % readeraddrs.size()];
+            }
             SocketHandle sock;
-            sock.Connect(SocketAddress::CreateIP(hostname, servname));
+            if (localaddrs.empty()) {
+                sock.Connect(SocketAddress::CreateIP(hostname, servname));
+            } else {
+                const std::string &localhost = localaddrs[stripe % localaddrs.size()];
+                sock.Connect(SocketAddress::CreateIP(hostname, servname),
+                        SocketAddress::CreateIPFromHost(localhost));
+            }
             Packet packet(PACKET_ID_WRITER);
-            packet.SourceKey(writerkey).DestinationKey(readerkey);
+            packet.SourceKey(writerkey).DestinationKey(readerkey).Version(PACKET_VERSION);
+            packet.Stripe(stripe);
             unsigned num = sock.Write(&packet.header, sizeof(packet.header));
             if (num != sizeof(packet.header)) {
                 conn->Cancel();
@@ -124,24 +155,29 @@ namespace CPN {
                 sock.Reset();
             }
         } else {
-            conn = shared_ptr<PendingConnection>(new PendingConnection(writerkey, this));
+            conn = shared_ptr<PendingConnection>(new PendingConnection(writerkey, stripe, this));
             pendingconnections.insert(std::make_pair(writerkey, conn));
         }
         return conn;
     }
 
-    shared_ptr<Sync::Future<int> > ConnectionServer::ConnectReader(Key_t readerkey) {
+    shared_ptr<ConnectionServer::PendingConnection> ConnectionServer::ConnectReader(Key_t readerkey, unsigned stripe) {
         if (server.Closed()) {
-            return shared_ptr<Sync::Future<int> >();
+            return shared_ptr<PendingConnection>();
         }
         AutoPLock al(lock);
         shared_ptr<PendingConnection> conn;
-        PendingMap::iterator entry = pendingconnections.find(readerkey);
-        if (entry == pendingconnections.end()) {
-            conn = shared_ptr<PendingConnection>(new PendingConnection(readerkey, this));
+        std::pair<PendingMap::iterator, PendingMap::iterator> range;
+        range = pendingconnections.equal_range(readerkey);
+        for (PendingMap::iterator entry = range.first; entry != range.second; ++entry) {
+            if (entry->second->GetStripe() == stripe) {
+                conn = entry->second;
+                break;
+            }
+        }
+        if (!conn) {
+            conn = shared_ptr<PendingConnection>(new PendingConnection(readerkey, stripe, this));
             pendingconnections.insert(std::make_pair(readerkey, conn));
-        } else {
-            conn = entry->second;
         }
         return conn;
     }
@@ -152,6 +188,14 @@ namespace CPN {
         return addr;
     }
 
+    void ConnectionServer::Listen(const SockAddrList &addrs) {
+        shared_ptr<ServerSocketHandle> serv(new ServerSocketHandle);
+        serv->Listen(addrs);
+        AutoPLock al(lock);
+        extraservers.push_back(serv);
+        wakeup.SendWakeup();
+    }
+
     void ConnectionServer::Disable() {
         AutoPLock al(lock);
         enabled = false;
@@ -192,8 +236,8 @@ namespace CPN {
         }
     }
 
-    ConnectionServer::PendingConnection::PendingConnection(Key_t k, ConnectionServer *serv)
-        : key(k), server(serv)
+    ConnectionServer::PendingConnection::PendingConnection(Key_t k, unsigned s, ConnectionServer *serv)
+        : key(k), stripe(s), server(serv), peerversion(PACKET_VERSION_LEGACY)
     {}
 
     ConnectionServer::PendingConnection::~PendingConnection() {
@@ -212,9 +256,10 @@ namespace CPN {
         return filed;
     }
 
-    void ConnectionServer::PendingConnection::Set(int filed) {
+    void ConnectionServer::PendingConnection::Set(int filed, unsigned version) {
         AutoPLock alf(file_lock);
         fd = filed;
+        peerversion = version;
         alf.Unlock();
         AutoPLock al(future_lock);
         ASSERT(!done);
@@ -28,9 +28,11 @@
 #include "SocketHandle.h"
 #include "WakeupHandle.h"
 #include "Logger.h"
+#include "PacketHeader.h"
 #include "Future.h"
 #include "PthreadMutex.h"
 #include <map>
+#include <vector>
 namespace CPN {
     /**
      * The connnection server takes ownership of the listening socket and accepts
@@ -40,6 +42,33 @@ namespace CPN {
      */
     class CPN_LOCAL ConnectionServer {
     public:
+        /**
+         * A connection being made, Get returns the file descriptor when
+         * it is done.
+         */
+        class PendingConnection : public Sync::Future<int>, public SocketHandle {
+        public:
+            PendingConnection(Key_t k, unsigned s, ConnectionServer *serv);
+            ~PendingConnection();
+            int Get();
+            void Set(int filed, unsigned version = PACKET_VERSION_LEGACY);
+            Key_t GetKey() const { return key; }
+            unsigned GetStripe() const { return stripe; }
+            /**
+             * \return the protocol version the other end announced in
+             * the ID packet it connected with. Only the accepting (reader)
+             * end learns it this way, the connecting (writer) end sees
+             * PACKET_VERSION_LEGACY and learns the version of the reader
+             * from the ID packet the reader sends in band.
+             */
+            unsigned PeerVersion() const { return peerversion; }
+        private:
+            const Key_t key;
+            const unsigned stripe;
+            ConnectionServer *server;
+            unsigned peerversion;
+        };
+
         /**
          * \param addrs list of socket addresses to use to listen on
          * \param ctx the context which contains all the data connection data.
@@ -62,21 +91,38 @@ namespace CPN {
          * Request the connectino server to connect the RemoteQueue which has
          * key writekey to its other endpoint.
          * \param writerkey the writekey of the endpoint.
-         * \return A Sync::Future which will contain the file descriptor
+         * \param stripe which of the queue's connections this is
+         * \param localaddrs local hosts to bind to, stripe i uses
+         * entry i modulo the size, empty to let the system choose
+         * \param readeraddrs hosts of the reader kernel to connect to,
+         * stripe i uses entry i modulo the size, empty for the host the
+         * reader kernel registered
+         * \return A future which will contain the file descriptor
          * when finished
          */
-        shared_ptr<Sync::Future<int> > ConnectWriter(Key_t writerkey);
+        shared_ptr<PendingConnection> ConnectWriter(Key_t writerkey, unsigned stripe = 0,
+                const std::vector<std::string> &localaddrs = std::vector<std::string>(),
+                const std::vector<std::string> &readeraddrs = std::vector<std::string>());
         /**
          * Request the connection server connect the RemoteQueue which has
          * key readerkey to its other endpoint.
          * \param readerkey the key for the reader of this queue
-         * \return A Sync::Future which will have the file descriptor.
+         * \param stripe which of the queue's connections this is
+         * \return A future which will have the file descriptor and
+         * the protocol version of the writer.
          */
-        shared_ptr<Sync::Future<int> > ConnectReader(Key_t readerkey);
+        shared_ptr<PendingConnection> ConnectReader(Key_t readerkey, unsigned stripe = 0);
         /**
          * \return the address this connection server is listening on
          */
         SocketAddress GetAddress();
+        /**
+         * Also accept connections on another address, on top of the one
+         * given at construction, so the connections of a striped queue
+         * can arrive on different interfaces.
+         * \param addrs the addresses to try, the first that works is used
+         */
+        void Listen(const SockAddrList &addrs);
 
         /**
          * These functions are for testing and debugging.
@@ -89,25 +135,16 @@ namespace CPN {
         void LogState();
         /** @} */
     private:
-        class PendingConnection : public Sync::Future<int>, public SocketHandle {
-        public:
-            PendingConnection(Key_t k, ConnectionServer *serv);
-            ~PendingConnection();
-            int Get();
-            void Set(int filed);
-            Key_t GetKey() const { return key; }
-        private:
-            const Key_t key;
-            ConnectionServer *server;
-        };
 
         void PendingDone(Key_t key, PendingConnection *conn);
+        void Accept(ServerSocketHandle &serv);
 
         typedef std::multimap<Key_t, shared_ptr<PendingConnection> > PendingMap;
         PthreadMutex lock;
         shared_ptr<Context> context;
         Logger logger;
         ServerSocketHandle server;
+        std::vector<shared_ptr<ServerSocketHandle> > extraservers;
         WakeupHandle wakeup;
         PendingMap pendingconnections;
         bool enabled;
@@ -24,12 +24,17 @@
 #include "Context.h"
 #include "LocalContext.h"
 #include "Exceptions.h"
+#include <stdexcept>
 
 namespace CPN {
     shared_ptr<Context> Context::Local() {
         return shared_ptr<Context>(new LocalContext);
     }
 
+    shared_ptr<Context> Context::Local(shared_ptr<LoggerOutput> out) {
+        return shared_ptr<Context>(new LocalContext(out));
+    }
+
     Context::Context()
     {
     }
@@ -41,6 +46,30 @@ namespace CPN {
         return false;
     }
 
+    std::vector<Key_t> Context::CreateNodeKeys(const std::vector<std::pair<Key_t, std::string> > &nodes) {
+        // Check all the names first so a taken one allocates nothing
+        for (unsigned i = 0; i < nodes.size(); ++i) {
+            bool taken = true;
+            try {
+                GetNodeKey(nodes[i].second);
+            } catch (const std::invalid_argument &e) {
+                taken = false;
+            }
+            if (taken) {
+                throw std::invalid_argument("Node " + nodes[i].second + " already exists.");
+            }
+        }
+        std::vector<Key_t> keys;
+        for (unsigned i = 0; i < nodes.size(); ++i) {
+            keys.push_back(CreateNodeKey(nodes[i].first, nodes[i].second));
+        }
+        return keys;
+    }
+
+    void Context::PrefetchEndpoints(const std::vector<std::pair<std::string, std::string> > &readers,
+            const std::vector<std::pair<std::string, std::string> > &writers) {
+    }
+
     void Context::CheckTerminated() {
         if (IsTerminated()) {
             throw ShutdownException();
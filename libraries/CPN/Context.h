@@ -27,6 +27,8 @@
 #include "CPNCommon.h"
 #include "Logger.h"
 #include <string>
+#include <vector>
+#include <utility>
 
 
 
@@ -55,6 +57,13 @@ namespace CPN {
          */
         static shared_ptr<Context> Local();
 
+        /** \brief Create a local context which logs to out,
+         * for example a LoggerAsyncOutput.
+         * \param out where the log messages go
+         * \return a new local context.
+         */
+        static shared_ptr<Context> Local(shared_ptr<LoggerOutput> out);
+
         virtual ~Context();
 
         /** \brief Called by the Kernel when it has successfully set it self up.
@@ -146,6 +155,16 @@ namespace CPN {
          * \throw std::invalid_argument
          */
         virtual Key_t CreateNodeKey(Key_t kernelkey, const std::string &nodename) = 0;
+        /** \brief Allocate the keys for many nodes at once, for a context
+         * that would otherwise need a round trip for each.
+         * The default calls CreateNodeKey for each.
+         * \param nodes the kernel key and name of each node
+         * \return the node keys in the same order
+         * \throw ShutdownException
+         * \throw std::invalid_argument naming the first node that already
+         * exists, the names are checked before any key is allocated
+         */
+        virtual std::vector<Key_t> CreateNodeKeys(const std::vector<std::pair<Key_t, std::string> > &nodes);
         /** \return the unique key associated with the given node name.
          * \throw ShutdownException
          * \throw std::invalid_argument
@@ -192,6 +211,22 @@ namespace CPN {
          */
         virtual void WaitForAllNodeEnd() = 0;
 
+        /** \brief Record that a name stands for a group of replicas of a
+         * node (see NodeAttr::SetReplicas), so that every kernel routes
+         * the queues of that name through the group.
+         * \param attr the attributes of the group, named after it, with
+         * the number of replicas and the scatter and gather blocks
+         * \return false if a group of that name already exists
+         * \throw ShutdownException
+         */
+        virtual bool SetReplicas(const NodeAttr &attr) = 0;
+        /** \param nodename the name to look up
+         * \param attr set to the attributes of the group if nodename is one
+         * \return true if nodename stands for a group of replicas
+         * \throw ShutdownException
+         */
+        virtual bool GetReplicas(const std::string &nodename, NodeAttr &attr) = 0;
+
 
         /** \brief Get the key associated with the given endpoint for the given node.
          * Creates the information if it does not exist
@@ -220,6 +255,17 @@ namespace CPN {
          */
         virtual std::string GetReaderName(Key_t portkey) = 0;
 
+        /** \brief Tell the context that the given endpoints are about to be
+         * looked up with WaitForNodeStart and GetCreateReaderKey or
+         * GetCreateWriterKey, so that it may look them all up at once.
+         * The default does nothing.
+         * \param readers the node name and port name of each reader
+         * \param writers the node name and port name of each writer
+         * \throw ShutdownException
+         */
+        virtual void PrefetchEndpoints(const std::vector<std::pair<std::string, std::string> > &readers,
+                const std::vector<std::pair<std::string, std::string> > &writers);
+
         /** \see GetCreateReaderKey */
         virtual Key_t GetCreateWriterKey(Key_t nodekey, const std::string &portname) = 0;
         /** \see GetReaderNode */
@@ -275,7 +321,7 @@ namespace CPN {
         /** \brief Calculate the new queue size when a queue needs to grow.
          * \return the new queue size
          */
-        virtual unsigned CalculateGrowSize(unsigned currentsize, unsigned request) { return currentsize + request; }
+        virtual QueueSize_t CalculateGrowSize(QueueSize_t currentsize, QueueSize_t request) { return currentsize + request; }
 
     protected:
         Context();
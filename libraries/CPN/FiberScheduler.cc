@@ -0,0 +1,452 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+#include "FiberScheduler.h"
+#include "PthreadFunctional.h"
+#include "PthreadKey.h"
+#include "ErrnoException.h"
+#include "ThrowingAssert.h"
+#include "AutoLock.h"
+#include "NumProcs.h"
+#include "Clock.h"
+#include "Atomic.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+namespace CPN {
+
+    /// The fiber each worker thread is running
+    static PthreadKey<Fiber*> currentfiber;
+    /// Set by the first scheduler and never cleared
+    static Sync::Atomic<bool> started(false);
+
+    Fiber::Fiber(FiberScheduler &s)
+        : scheduler(s),
+        workercontext(0),
+        stack(0),
+        stacksize(s.StackSize()),
+        unlockfunc(0),
+        unlockarg(0),
+        parked(false),
+        wakeup(false),
+        finished(false),
+        done(false),
+        cputime(0)
+    {
+    }
+
+    Fiber::~Fiber() {
+        FreeStack();
+    }
+
+    void Fiber::Start() {
+        ASSERT(!stack, "Fiber started twice");
+        const unsigned pagesize = sysconf(_SC_PAGESIZE);
+        stacksize = (stacksize + pagesize - 1)/pagesize*pagesize;
+        // One extra page below the stack as a guard against overflow
+        void *mem = mmap(0, stacksize + pagesize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            throw ErrnoException("Unable to allocate a fiber stack", errno);
+        }
+        if (mprotect(mem, pagesize, PROT_NONE) != 0) {
+            int err = errno;
+            munmap(mem, stacksize + pagesize);
+            throw ErrnoException("Unable to protect a fiber stack", err);
+        }
+        stack = mem;
+        ENSURE(!getcontext(&context));
+        context.uc_stack.ss_sp = static_cast<char*>(mem) + pagesize;
+        context.uc_stack.ss_size = stacksize;
+        context.uc_link = 0;
+        // makecontext only passes int arguments
+        const uint64_t self = reinterpret_cast<uintptr_t>(this);
+        makecontext(&context, (void(*)())&Fiber::Trampoline, 2,
+                unsigned(self >> 32), unsigned(self & 0xFFFFFFFF));
+        scheduler.Ready(this);
+    }
+
+    void Fiber::Join() {
+        AutoLock<PthreadMutex> al(statelock);
+        while (!done) {
+            donecond.Wait(statelock);
+        }
+    }
+
+    bool Fiber::Done() {
+        AutoLock<PthreadMutex> al(statelock);
+        return done;
+    }
+
+    double Fiber::CPUTime() {
+        AutoLock<PthreadMutex> al(statelock);
+        return cputime;
+    }
+
+    Fiber *Fiber::Current() {
+        if (!started.Load()) { return 0; }
+        return currentfiber.Get();
+    }
+
+    void Fiber::Suspend(void (*unlock)(void*), void *arg) {
+        ASSERT(Current() == this);
+        unlockfunc = unlock;
+        unlockarg = arg;
+        ENSURE(!swapcontext(&context, workercontext));
+    }
+
+    void Fiber::Resume() {
+        bool runnable = false;
+        {
+            AutoLock<PthreadMutex> al(statelock);
+            if (parked) {
+                parked = false;
+                runnable = true;
+            } else {
+                // Still switching out, SwitchedOut will see this
+                wakeup = true;
+            }
+        }
+        if (runnable) {
+            scheduler.Ready(this);
+        }
+    }
+
+    void Fiber::Yield() {
+        {
+            AutoLock<PthreadMutex> al(statelock);
+            // SwitchedOut makes us ready again
+            wakeup = true;
+        }
+        Suspend(0, 0);
+    }
+
+    void Fiber::HandOff() {
+        Fiber *fiber = Current();
+        if (fiber && fiber->scheduler.HandsOff()) {
+            fiber->Yield();
+        }
+    }
+
+    void Fiber::Trampoline(unsigned hi, unsigned lo) {
+        Fiber *fiber = reinterpret_cast<Fiber*>((uintptr_t(hi) << 32) | uintptr_t(lo));
+        fiber->EntryPoint();
+        fiber->finished = true;
+        setcontext(fiber->workercontext);
+    }
+
+    /**
+     * Called by the worker thread once this fiber is no longer running
+     * on it.
+     */
+    void Fiber::SwitchedOut() {
+        if (finished) {
+            FreeStack();
+            AutoLock<PthreadMutex> al(statelock);
+            done = true;
+            donecond.Broadcast();
+            return;
+        }
+        void (*unlock)(void*) = unlockfunc;
+        unlockfunc = 0;
+        if (unlock) {
+            unlock(unlockarg);
+        }
+        bool runnable = false;
+        {
+            AutoLock<PthreadMutex> al(statelock);
+            if (wakeup) {
+                wakeup = false;
+                runnable = true;
+            } else {
+                parked = true;
+            }
+        }
+        if (runnable) {
+            scheduler.Ready(this);
+        }
+    }
+
+    void Fiber::FreeStack() {
+        if (stack) {
+            munmap(stack, stacksize + sysconf(_SC_PAGESIZE));
+            stack = 0;
+        }
+    }
+
+    FiberScheduler::FiberScheduler(unsigned numworkers_, unsigned stacksize_, bool handoff_)
+        : numworkers(numworkers_),
+        stacksize(stacksize_),
+        handoff(handoff_),
+        running(0),
+        blocked(0),
+        shutdown(false)
+    {
+        if (numworkers == 0) {
+            numworkers = GetNumProcs();
+            if (numworkers == 0) { numworkers = 1; }
+        }
+        // Before any worker can run a fiber
+        started.Set(true);
+        AutoLock<PthreadMutex> al(lock);
+        for (unsigned i = 0; i < numworkers; ++i) {
+            AddWorker();
+        }
+    }
+
+    FiberScheduler::~FiberScheduler() {
+        {
+            AutoLock<PthreadMutex> al(lock);
+            shutdown = true;
+            cond.Broadcast();
+        }
+        for (std::vector<Pthread*>::iterator itr = workers.begin(); itr != workers.end(); ++itr) {
+            (*itr)->Join();
+            delete *itr;
+        }
+    }
+
+    bool FiberScheduler::Started() {
+        return started.Load();
+    }
+
+    unsigned FiberScheduler::NumReady() {
+        AutoLock<PthreadMutex> al(lock);
+        return ready.size();
+    }
+
+    unsigned FiberScheduler::NumThreads() {
+        AutoLock<PthreadMutex> al(lock);
+        return workers.size();
+    }
+
+    void FiberScheduler::EnterBlocking() {
+        AutoLock<PthreadMutex> al(lock);
+        ++blocked;
+        // Every worker is busy, one of them with us, so get another
+        // for the fibers which become ready while we block.
+        if (running == workers.size()) {
+            AddWorker();
+        }
+        cond.Broadcast();
+    }
+
+    void FiberScheduler::LeaveBlocking() {
+        AutoLock<PthreadMutex> al(lock);
+        --blocked;
+    }
+
+    void FiberScheduler::AddWorker() {
+        Pthread *worker = CreatePthreadFunctional(this, &FiberScheduler::WorkerEntryPoint);
+        workers.push_back(worker);
+        worker->Start();
+    }
+
+    void FiberScheduler::Ready(Fiber *fiber) {
+        AutoLock<PthreadMutex> al(lock);
+        ready.push_back(fiber);
+        cond.Signal();
+    }
+
+    void *FiberScheduler::WorkerEntryPoint() {
+        ucontext_t workercontext;
+        while (true) {
+            Fiber *fiber = 0;
+            {
+                AutoLock<PthreadMutex> al(lock);
+                while ((ready.empty() || running - blocked >= numworkers) && !shutdown) {
+                    cond.Wait(lock);
+                }
+                if (ready.empty()) { break; }
+                fiber = ready.front();
+                ready.pop_front();
+                ++running;
+            }
+            fiber->workercontext = &workercontext;
+            currentfiber.Set(fiber);
+            const double start = ThreadCPUTime();
+            ENSURE(!swapcontext(&workercontext, &fiber->context));
+            const double end = ThreadCPUTime();
+            currentfiber.Set(0);
+            {
+                AutoLock<PthreadMutex> al(fiber->statelock);
+                fiber->cputime = (start < 0 ? -1 : fiber->cputime + end - start);
+            }
+            fiber->SwitchedOut();
+            {
+                AutoLock<PthreadMutex> al(lock);
+                --running;
+            }
+        }
+        return 0;
+    }
+
+    bool FiberWaitList::Suspend(void (*unlock)(void*), void *arg) {
+        Fiber *fiber = Fiber::Current();
+        if (!fiber) { return false; }
+        {
+            AutoLock<PthreadMutex> al(lock);
+            waiters.push_back(fiber);
+        }
+        fiber->Suspend(unlock, arg);
+        return true;
+    }
+
+    bool FiberWaitList::WakeOne() {
+        // No fiber can have waited
+        if (!started.Load()) { return false; }
+        Fiber *fiber = 0;
+        {
+            AutoLock<PthreadMutex> al(lock);
+            if (waiters.empty()) { return false; }
+            fiber = waiters.front();
+            waiters.pop_front();
+        }
+        fiber->Resume();
+        return true;
+    }
+
+    bool FiberWaitList::WakeAll() {
+        if (!started.Load()) { return false; }
+        std::deque<Fiber*> woken;
+        {
+            AutoLock<PthreadMutex> al(lock);
+            if (waiters.empty()) { return false; }
+            woken.swap(waiters);
+        }
+        for (std::deque<Fiber*>::iterator itr = woken.begin(); itr != woken.end(); ++itr) {
+            (*itr)->Resume();
+        }
+        return true;
+    }
+
+    FiberMutex::FiberMutex(bool recursive_)
+        : ownerfiber(0),
+        depth(0),
+        numwaiting(0),
+        recursive(recursive_),
+        plain(false)
+    {
+    }
+
+    void FiberMutex::Lock() const {
+        if (!recursive && !started.Load()) {
+            guard.Lock();
+            if (depth == 0) {
+                plain = true;
+                return;
+            }
+            // A fiber got it since the check
+            Acquire(1);
+            guard.Unlock();
+            return;
+        }
+        AutoLock<PthreadMutex> al(guard);
+        if (depth > 0 && Owned()) {
+            ASSERT(recursive, "FiberMutex locked twice by its owner");
+            ++depth;
+            return;
+        }
+        Acquire(1);
+    }
+
+    void FiberMutex::Unlock() const {
+        if (plain) {
+            plain = false;
+            guard.Unlock();
+            return;
+        }
+        AutoLock<PthreadMutex> al(guard);
+        ASSERT(depth > 0, "FiberMutex unlocked when not locked");
+        if (--depth == 0) {
+            ownerfiber = 0;
+            if (numwaiting > 0) {
+                threadcond.Signal();
+                waiters.WakeOne();
+            }
+        }
+    }
+
+    bool FiberMutex::Owned() const {
+        Fiber *self = Fiber::Current();
+        if (self) {
+            return ownerfiber == self;
+        }
+        return ownerfiber == 0 && pthread_equal(ownerthread, pthread_self());
+    }
+
+    unsigned FiberMutex::Release() const {
+        ASSERT(depth > 0, "FiberMutex released when not locked");
+        const unsigned count = depth;
+        depth = 0;
+        ownerfiber = 0;
+        if (numwaiting > 0) {
+            threadcond.Signal();
+            waiters.WakeOne();
+        }
+        return count;
+    }
+
+    void FiberMutex::Reclaim() const {
+        if (depth == 0) {
+            plain = true;
+            return;
+        }
+        plain = false;
+        Acquire(1);
+        guard.Unlock();
+    }
+
+    void FiberMutex::Acquire(unsigned count) const {
+        while (depth > 0) {
+            ++numwaiting;
+            if (!waiters.Wait(guard)) {
+                threadcond.Wait(guard);
+            }
+            --numwaiting;
+        }
+        depth = count;
+        ownerfiber = Fiber::Current();
+        ownerthread = pthread_self();
+    }
+
+    FiberBlockingCall::FiberBlockingCall()
+        : scheduler(0)
+    {
+        Fiber *fiber = Fiber::Current();
+        if (fiber) {
+            scheduler = &fiber->scheduler;
+            scheduler->EnterBlocking();
+        }
+    }
+
+    FiberBlockingCall::~FiberBlockingCall() {
+        if (scheduler) {
+            scheduler->LeaveBlocking();
+        }
+    }
+}
@@ -0,0 +1,363 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief A scheduler that runs fibers (user space threads with their
+ * own stack) on a fixed pool of worker threads.
+ */
+#ifndef CPN_FIBERSCHEDULER_H
+#define CPN_FIBERSCHEDULER_H
+#pragma once
+
+#include "CPNCommon.h"
+#include "PthreadMutex.h"
+#include "PthreadCondition.h"
+#include "AutoLock.h"
+#include <ucontext.h>
+#include <deque>
+#include <vector>
+
+class Pthread;
+
+namespace CPN {
+
+    class FiberScheduler;
+    class Fiber;
+
+    /**
+     * \brief The fibers waiting on some condition.
+     */
+    class CPN_LOCAL FiberWaitList {
+    public:
+        /**
+         * \brief If the caller is a fiber suspend it until woken,
+         * releasing lock while suspended.
+         * \return false without waiting if the caller is not a fiber
+         */
+        template<class Lock>
+        bool Wait(Lock &lock) {
+            if (!Suspend(&Unlock<Lock>, &lock)) { return false; }
+            lock.Lock();
+            return true;
+        }
+        /** \return true if a fiber was woken */
+        bool WakeOne();
+        /** \return true if any fiber was woken */
+        bool WakeAll();
+    private:
+        template<class Lock>
+        static void Unlock(void *lock) { static_cast<Lock*>(lock)->Unlock(); }
+        bool Suspend(void (*unlock)(void*), void *arg);
+
+        PthreadMutex lock;
+        std::deque<Fiber*> waiters;
+    };
+
+    /**
+     * \brief A mutex owned by the fiber which locked it rather than by
+     * the worker thread the fiber happens to run on.
+     *
+     * A fiber which finds it locked is suspended instead of blocking its
+     * worker. So a fiber may hold it across a suspension, for instance
+     * while it waits on a FiberCondition, without another fiber on the
+     * same worker getting in or the worker deadlocking on itself. Threads
+     * which are not fibers may use it as well.
+     *
+     * Until the process creates its first FiberScheduler no thread can be
+     * a fiber, and a mutex that is not recursive is simply its guard held
+     * for as long as it is locked.
+     */
+    class CPN_API FiberMutex {
+    public:
+        /** \param recursive_ true to let the owner lock it again */
+        FiberMutex(bool recursive_ = false);
+        void Lock() const;
+        void Unlock() const;
+    private:
+        FiberMutex(const FiberMutex&);
+        FiberMutex &operator=(const FiberMutex&);
+
+        template<class Condition> friend class FiberCondition;
+        /** \return true if the caller owns it, guard must be held */
+        bool Owned() const;
+        /**
+         * \brief Give it up no matter how many times the owner locked
+         * it, guard must be held.
+         * \return the lock count to give back to Acquire
+         */
+        unsigned Release() const;
+        /** \brief Wait until it is free and take it, guard must be held */
+        void Acquire(unsigned count) const;
+        /**
+         * \brief Called with guard held again after a plain wait, takes
+         * it back properly if a fiber got it meanwhile.
+         */
+        void Reclaim() const;
+
+        mutable PthreadMutex guard;
+        mutable PthreadCondition threadcond;
+        mutable FiberWaitList waiters;
+        mutable Fiber *ownerfiber;
+        mutable pthread_t ownerthread;
+        mutable unsigned depth;
+        /// Threads and fibers waiting in Acquire
+        mutable unsigned numwaiting;
+        const bool recursive;
+        /// Locked by holding guard, only the holder looks at it
+        mutable bool plain;
+    };
+
+    typedef AutoLock<const FiberMutex> AutoFiberLock;
+
+    /**
+     * \brief A condition which suspends a waiting fiber instead of
+     * blocking its worker thread, and otherwise behaves exactly like
+     * the Condition it wraps.
+     *
+     * Waiting with a FiberMutex releases it completely, whatever the
+     * lock count, and takes it back at the same count. Any other Lock
+     * must not be held across the wait by anything but the caller
+     * itself, as it stays locked by the worker thread.
+     */
+    template<class Condition>
+    class CPN_LOCAL FiberCondition {
+    public:
+        /** \return true if a waiting fiber was woken */
+        bool Signal() { cond.Signal(); return waiters.WakeOne(); }
+        /** \return true if any waiting fiber was woken */
+        bool Broadcast() { cond.Broadcast(); return waiters.WakeAll(); }
+        template<class Lock>
+        void Wait(Lock &lock) {
+            if (!waiters.Wait(lock)) {
+                cond.Wait(lock);
+            }
+        }
+        void Wait(FiberMutex &lock) { WaitFiberMutex(lock); }
+        void Wait(const FiberMutex &lock) { WaitFiberMutex(lock); }
+    private:
+        void WaitFiberMutex(const FiberMutex &lock) {
+            if (lock.plain) {
+                // Others may lock it meanwhile, fibers too
+                lock.plain = false;
+                cond.Wait(lock.guard);
+                lock.Reclaim();
+                return;
+            }
+            AutoLock<PthreadMutex> al(lock.guard);
+            const unsigned count = lock.Release();
+            // Nobody can take lock and signal before the guard is
+            // released, which happens only once we are waiting.
+            if (!waiters.Wait(lock.guard)) {
+                cond.Wait(lock.guard);
+            }
+            lock.Acquire(count);
+        }
+
+        Condition cond;
+        FiberWaitList waiters;
+    };
+
+    /**
+     * \brief Marks a call which blocks in the operating system (I/O, a
+     * plain mutex or condition, a Sync::Future, ...) for the lifetime
+     * of the object.
+     *
+     * If the caller is a fiber its scheduler has another worker run the
+     * ready fibers meanwhile, starting a new worker if none is idle. So
+     * a fiber blocked on something only another fiber can provide does
+     * not deadlock the pool. Does nothing for threads which are not
+     * fibers. The caller must not wait on a FiberCondition or contended
+     * FiberMutex while it is marked as blocking.
+     */
+    class CPN_API FiberBlockingCall {
+    public:
+        FiberBlockingCall();
+        ~FiberBlockingCall();
+    private:
+        FiberBlockingCall(const FiberBlockingCall&);
+        FiberBlockingCall &operator=(const FiberBlockingCall&);
+        FiberScheduler *scheduler;
+    };
+
+    /**
+     * \brief A fiber is a thread of execution which the FiberScheduler
+     * multiplexes onto its worker threads.
+     *
+     * A fiber only gives up its worker when it waits in a FiberWaitList
+     * (see FiberCondition and FiberMutex). Any other blocking call blocks
+     * the worker thread along with the fiber and should be marked with a
+     * FiberBlockingCall. A fiber may resume on a different worker than
+     * the one it suspended on.
+     */
+    class CPN_LOCAL Fiber {
+    public:
+        Fiber(FiberScheduler &s);
+        virtual ~Fiber();
+
+        /** \brief Make the fiber runnable. */
+        void Start();
+        /** \brief Wait for the fiber to return from EntryPoint. */
+        void Join();
+        bool Done();
+        /**
+         * \return the CPU seconds the fiber has used up to the last
+         * time it was switched out, negative if unknown
+         */
+        double CPUTime();
+
+        /**
+         * \return the fiber running on the calling thread or 0
+         * if the calling thread is not running a fiber.
+         */
+        static Fiber *Current();
+
+        /**
+         * \brief Suspend the current fiber until Resume is called.
+         * unlock is called with arg once the fiber has been switched
+         * out so that a Resume cannot run it before then.
+         */
+        void Suspend(void (*unlock)(void*), void *arg);
+        /** \brief Make a suspended fiber runnable again. */
+        void Resume();
+        /**
+         * \brief Put the current fiber at the back of the ready
+         * fibers and let the ones ahead of it run.
+         */
+        void Yield();
+        /**
+         * \brief If the caller is a fiber on a scheduler which hands
+         * off (see FiberScheduler) yield so that the fibers the
+         * caller just woke run before it continues.
+         * Must not be called with any lock held.
+         */
+        static void HandOff();
+    protected:
+        virtual void *EntryPoint() = 0;
+    private:
+        Fiber(const Fiber&);
+        Fiber &operator=(const Fiber&);
+
+        static void Trampoline(unsigned hi, unsigned lo);
+        void SwitchedOut();
+        void FreeStack();
+
+        friend class FiberScheduler;
+        friend class FiberBlockingCall;
+        FiberScheduler &scheduler;
+        ucontext_t context;
+        ucontext_t *workercontext;
+        void *stack;
+        unsigned stacksize;
+        void (*unlockfunc)(void*);
+        void *unlockarg;
+
+        PthreadMutex statelock;
+        FiberCondition<PthreadCondition> donecond;
+        bool parked;
+        bool wakeup;
+        bool finished;
+        bool done;
+        double cputime;
+    };
+
+    template<class T>
+    class CPN_LOCAL FiberFunctional : public Fiber {
+    public:
+        FiberFunctional(FiberScheduler &s, T *obj_, void *(T::*method_)())
+            : Fiber(s), obj(obj_), method(method_) {}
+    protected:
+        void *EntryPoint() { return (obj->*method)(); }
+    private:
+        T *obj;
+        void *(T::*method)();
+    };
+
+    template<class T>
+    inline Fiber *CreateFiberFunctional(FiberScheduler &s, T *obj, void *(T::*method)()) {
+        return new FiberFunctional<T>(s, obj, method);
+    }
+
+    /**
+     * \brief A fixed pool of worker threads which run the fibers
+     * that are ready in the order they became ready.
+     *
+     * A scheduler which hands off makes a fiber yield when it wakes
+     * another one with Fiber::HandOff. With a single worker this runs
+     * a consumer as soon as its producer gives it data, so that the
+     * data is still in the cache.
+     *
+     * At most NumWorkers fibers run at once, not counting those marked
+     * with a FiberBlockingCall. Workers are added when fibers block and
+     * none is idle, and are kept until the scheduler is destroyed.
+     */
+    class CPN_LOCAL FiberScheduler {
+    public:
+        /**
+         * \param numworkers the number of worker threads, 0 for one
+         * per processor
+         * \param stacksize the size of each fiber stack in bytes
+         * \param handoff true to hand off (see Fiber::HandOff)
+         */
+        FiberScheduler(unsigned numworkers, unsigned stacksize, bool handoff = false);
+        /**
+         * Stops the worker threads. All fibers must be done.
+         */
+        ~FiberScheduler();
+
+        unsigned NumWorkers() const { return numworkers; }
+        /// For debugging ONLY!
+        unsigned NumThreads();
+        unsigned StackSize() const { return stacksize; }
+        bool HandsOff() const { return handoff; }
+        /**
+         * \return true once any scheduler was created in this process,
+         * before that no thread is a fiber
+         */
+        static bool Started();
+
+        /// For debugging ONLY!
+        unsigned NumReady();
+    private:
+        FiberScheduler(const FiberScheduler&);
+        FiberScheduler &operator=(const FiberScheduler&);
+
+        friend class Fiber;
+        friend class FiberBlockingCall;
+        void Ready(Fiber *fiber);
+        void EnterBlocking();
+        void LeaveBlocking();
+        /** \brief Start another worker, lock must be held */
+        void AddWorker();
+        void *WorkerEntryPoint();
+
+        unsigned numworkers;
+        const unsigned stacksize;
+        const bool handoff;
+        std::vector<Pthread*> workers;
+        PthreadMutex lock;
+        PthreadCondition cond;
+        std::deque<Fiber*> ready;
+        /// The workers running a fiber
+        unsigned running;
+        /// The running fibers inside a FiberBlockingCall
+        unsigned blocked;
+        bool shutdown;
+    };
+}
+#endif
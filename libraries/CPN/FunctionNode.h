@@ -61,7 +61,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode0");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode0<Function>(*this, attr, func));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -88,7 +88,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode1");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode1<Function, Argument1>(*this, attr, func, arg1));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -116,7 +116,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode2");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode2<Function, Argument1, Argument2>(*this, attr, func, arg1, arg2));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -145,7 +145,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode3");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode3<Function, Argument1, Argument2, Argument3>(*this, attr, func, arg1, arg2, arg3));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -175,7 +175,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode4");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode4<Function, Argument1, Argument2, Argument3, Argument4>(*this, attr, func, arg1, arg2, arg3, arg4));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -206,7 +206,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode5");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode5<Function, Argument1, Argument2, Argument3, Argument4, Argument5>(*this, attr, func, arg1, arg2, arg3, arg4, arg5));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -238,7 +238,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode6");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode6<Function, Argument1, Argument2, Argument3, Argument4, Argument5, Argument6>(*this, attr, func, arg1, arg2, arg3, arg4, arg5, arg6));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -271,7 +271,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode7");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode7<Function, Argument1, Argument2, Argument3, Argument4, Argument5, Argument6, Argument7>(*this, attr, func, arg1, arg2, arg3, arg4, arg5, arg6, arg7));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -305,7 +305,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode8");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode8<Function, Argument1, Argument2, Argument3, Argument4, Argument5, Argument6, Argument7, Argument8>(*this, attr, func, arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -340,7 +340,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, nodename);
         NodeAttr attr(nodename, "FunctionNode9");
         attr.SetKey(nodekey).SetKernelKey(kernelkey);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         shared_ptr<NodeBase> node;
         node.reset(new FunctionNode9<Function, Argument1, Argument2, Argument3, Argument4, Argument5, Argument6, Argument7, Argument8, Argument9>(*this, attr, func, arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8, arg9));
         nodemap.insert(std::make_pair(nodekey, node));
@@ -0,0 +1,162 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+#include "GrowPolicy.h"
+#include "Variant.h"
+#include "JSONToVariant.h"
+#include "VariantToJSON.h"
+#include "AutoLock.h"
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace CPN {
+
+    GrowPolicy::~GrowPolicy() {}
+
+    QueueSize_t GrowPolicy::InitialLength(const std::string &name, QueueSize_t length) {
+        return length;
+    }
+
+    void GrowPolicy::Flush() {}
+
+    GeometricGrowPolicy::GeometricGrowPolicy(double factor_, QueueSize_t cap_)
+        : factor(std::max(factor_, 1.0)), cap(cap_)
+    {}
+
+    QueueSize_t GeometricGrowPolicy::GrowSize(const GrowRequest &req) {
+        QueueSize_t size = QueueSize_t(req.length*factor);
+        if (cap > 0) { size = std::min(size, cap); }
+        return std::max(size, req.count + req.request);
+    }
+
+    BudgetGrowPolicy::BudgetGrowPolicy(QueueSize_t budget_, shared_ptr<GrowPolicy> policy_)
+        : budget(budget_), policy(policy_), used(0)
+    {
+        if (!policy) { policy.reset(new GeometricGrowPolicy); }
+    }
+
+    QueueSize_t BudgetGrowPolicy::GrowSize(const GrowRequest &req) {
+        const QueueSize_t needed = req.count + req.request;
+        QueueSize_t size = std::max(policy->GrowSize(req), needed);
+        const QueueSize_t chans = std::max(req.numchannels, 1u);
+        AutoLock<PthreadMutex> al(lock);
+        if (size > req.length && used + (size - req.length)*chans > budget) {
+            size = needed;
+        }
+        if (size > req.length) { used += (size - req.length)*chans; }
+        return size;
+    }
+
+    QueueSize_t BudgetGrowPolicy::InitialLength(const std::string &name, QueueSize_t length) {
+        return policy->InitialLength(name, length);
+    }
+
+    QueueSize_t BudgetGrowPolicy::Used() const {
+        AutoLock<PthreadMutex> al(lock);
+        return used;
+    }
+
+    HistoryGrowPolicy::HistoryGrowPolicy(const std::string &filename_, shared_ptr<GrowPolicy> policy_)
+        : filename(filename_), policy(policy_), changed(false)
+    {
+        if (!policy) { policy.reset(new GeometricGrowPolicy); }
+        Load();
+    }
+
+    HistoryGrowPolicy::~HistoryGrowPolicy() {
+        Save();
+    }
+
+    QueueSize_t HistoryGrowPolicy::GrowSize(const GrowRequest &req) {
+        const QueueSize_t size = policy->GrowSize(req);
+        if (req.name.empty()) { return size; }
+        // Called with the queue lock held, only record it
+        AutoLock<PthreadMutex> al(lock);
+        QueueSize_t &remembered = lengths[req.name];
+        if (size > remembered) {
+            remembered = size;
+            changed = true;
+        }
+        return size;
+    }
+
+    QueueSize_t HistoryGrowPolicy::InitialLength(const std::string &name, QueueSize_t length) {
+        length = policy->InitialLength(name, length);
+        AutoLock<PthreadMutex> al(lock);
+        LengthMap::iterator entry = lengths.find(name);
+        if (entry != lengths.end()) {
+            length = std::max(length, entry->second);
+        }
+        return length;
+    }
+
+    void HistoryGrowPolicy::Flush() {
+        Save();
+    }
+
+    bool HistoryGrowPolicy::Save() {
+        AutoLock<PthreadMutex> sl(savelock);
+        Variant queues(Variant::ObjectType);
+        {
+            AutoLock<PthreadMutex> al(lock);
+            if (!changed) { return true; }
+            for (LengthMap::iterator itr = lengths.begin(); itr != lengths.end(); ++itr) {
+                queues[itr->first] = itr->second;
+            }
+            changed = false;
+        }
+        Variant doc(Variant::ObjectType);
+        doc["queues"] = queues;
+        const std::string json = VariantToJSON(doc, true);
+        const std::string tmpname = filename + ".tmp";
+        bool ok = false;
+        FILE *f = fopen(tmpname.c_str(), "w");
+        if (f) {
+            ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+            ok = (fputc('\n', f) != EOF) && ok;
+            ok = (fclose(f) == 0) && ok;
+            ok = ok && rename(tmpname.c_str(), filename.c_str()) == 0;
+            if (!ok) { unlink(tmpname.c_str()); }
+        }
+        if (!ok) {
+            AutoLock<PthreadMutex> al(lock);
+            changed = true;
+        }
+        return ok;
+    }
+
+    void HistoryGrowPolicy::Load() {
+        std::ifstream f(filename.c_str());
+        if (!f.good()) { return; }
+        JSONToVariant parser;
+        f >> parser;
+        if (!parser.Done()) { return; }
+        Variant queues = parser.Get()["queues"];
+        if (!queues.IsObject()) { return; }
+        for (Variant::MapIterator itr = queues.MapBegin(); itr != queues.MapEnd(); ++itr) {
+            if (itr->second.IsNumber()) {
+                lengths[itr->first] = itr->second.AsNumber<QueueSize_t>();
+            }
+        }
+    }
+}
@@ -0,0 +1,166 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Policies for how much a queue grows when the D4R finds it
+ * in an artificial deadlock.
+ */
+#ifndef CPN_GROWPOLICY_H
+#define CPN_GROWPOLICY_H
+#pragma once
+
+#include "CPNCommon.h"
+#include "PthreadMutex.h"
+#include <string>
+#include <map>
+
+namespace CPN {
+
+    /** \brief The queue the D4R wants to grow. */
+    struct GrowRequest {
+        /// The name of the queue, see SimpleQueueAttr::GetName
+        std::string name;
+        /// What is in the queue
+        QueueSize_t count;
+        /// The current length of the queue
+        QueueSize_t length;
+        /// What the blocked writer asked for
+        QueueSize_t request;
+        unsigned numchannels;
+    };
+
+    /**
+     * \brief Decides the new length of a queue in an artificial deadlock.
+     *
+     * Set one for all the queues of a kernel with
+     * KernelAttr::SetGrowPolicy or for a single queue with
+     * QueueAttr::SetGrowPolicy. Without one the kernel asks
+     * Context::CalculateGrowSize. A policy is called with the lock of the
+     * queue held and may be shared by several queues and kernels.
+     */
+    class CPN_API GrowPolicy {
+    public:
+        virtual ~GrowPolicy();
+
+        /**
+         * \return the new length of the queue, anything less than count
+         * plus request is raised to that
+         */
+        virtual QueueSize_t GrowSize(const GrowRequest &req) = 0;
+
+        /**
+         * Called when a queue is created.
+         * \return the length to create the queue with
+         */
+        virtual QueueSize_t InitialLength(const std::string &name, QueueSize_t length);
+
+        /**
+         * Called by the kernel when it ends, with no queue lock held,
+         * to write out whatever the policy keeps.
+         */
+        virtual void Flush();
+    };
+
+    /**
+     * \brief Multiplies the length by factor each time, up to a cap.
+     *
+     * A queue that deadlocks again and again gets a few large grows
+     * instead of many small ones. The cap only limits the geometric
+     * growth, a request larger than the cap is still granted.
+     */
+    class CPN_API GeometricGrowPolicy : public GrowPolicy {
+    public:
+        /**
+         * \param factor multiplies the length, at least 1
+         * \param cap the largest length to grow to, 0 for no cap
+         */
+        GeometricGrowPolicy(double factor = 2, QueueSize_t cap = 0);
+        QueueSize_t GrowSize(const GrowRequest &req);
+    private:
+        const double factor;
+        const QueueSize_t cap;
+    };
+
+    /**
+     * \brief Grows with another policy until the bytes added by all the
+     * grows reach the budget, and after that only by what is needed.
+     */
+    class CPN_API BudgetGrowPolicy : public GrowPolicy {
+    public:
+        /**
+         * \param budget the bytes all the grows may add together
+         * \param policy the policy to use while under the budget,
+         * a GeometricGrowPolicy if not given
+         */
+        BudgetGrowPolicy(QueueSize_t budget,
+                shared_ptr<GrowPolicy> policy = shared_ptr<GrowPolicy>());
+        QueueSize_t GrowSize(const GrowRequest &req);
+        QueueSize_t InitialLength(const std::string &name, QueueSize_t length);
+        /** \return the bytes added by the grows so far */
+        QueueSize_t Used() const;
+    private:
+        const QueueSize_t budget;
+        shared_ptr<GrowPolicy> policy;
+        mutable PthreadMutex lock;
+        QueueSize_t used;
+    };
+
+    /**
+     * \brief Remembers the length each queue grew to and creates the
+     * queue with that length the next time.
+     *
+     * The lengths are kept by queue name in a JSON file which is read
+     * when the policy is created. A grow only records the length, the
+     * file is written when the kernel ends and when the policy is
+     * destroyed, never under a queue lock. It is written to a temporary
+     * file which is then renamed over the profile so a crash leaves
+     * the old profile whole. Queues without a name are not remembered.
+     */
+    class CPN_API HistoryGrowPolicy : public GrowPolicy {
+    public:
+        /**
+         * \param filename the profile, it is fine if it does not exist yet
+         * \param policy decides the grows, a GeometricGrowPolicy if not given
+         */
+        HistoryGrowPolicy(const std::string &filename,
+                shared_ptr<GrowPolicy> policy = shared_ptr<GrowPolicy>());
+        ~HistoryGrowPolicy();
+        QueueSize_t GrowSize(const GrowRequest &req);
+        QueueSize_t InitialLength(const std::string &name, QueueSize_t length);
+        void Flush();
+        /**
+         * \brief Write the profile if a length changed.
+         * \return false if the file could not be written
+         */
+        bool Save();
+    private:
+        void Load();
+
+        const std::string filename;
+        shared_ptr<GrowPolicy> policy;
+        /// Guards lengths and changed, never held while writing
+        PthreadMutex lock;
+        /// One Save at a time
+        PthreadMutex savelock;
+        typedef std::map<std::string, QueueSize_t> LengthMap;
+        LengthMap lengths;
+        bool changed;
+    };
+}
+#endif
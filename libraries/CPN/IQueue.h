@@ -52,7 +52,7 @@ namespace CPN {
          * \param chan the channel
          * \return the array
          */
-        const T* GetDequeuePtr(unsigned thresh, unsigned chan=0) {
+        const T* GetDequeuePtr(QueueSize_t thresh, unsigned chan=0) {
             return (T*) queue->GetRawDequeuePtr(GetTypeSize<T>() * thresh, chan);
         }
 
@@ -60,7 +60,7 @@ namespace CPN {
          * Dispose of count elements from the queue.
          * \param count the number to dispose of
          */
-        void Dequeue(unsigned count) {
+        void Dequeue(QueueSize_t count) {
             queue->Dequeue(GetTypeSize<T>() * count);
         }
 
@@ -70,7 +70,7 @@ namespace CPN {
          * \param count the number of elements
          * \return true on success, false if the endpoint has shutdown
          */
-        bool Dequeue(T* data, unsigned count) {
+        bool Dequeue(T* data, QueueSize_t count) {
             return queue->RawDequeue((void*)data, GetTypeSize<T>() * count);
         }
 
@@ -82,7 +82,7 @@ namespace CPN {
          * \param numChans the number of channels
          * \param chanStride the number of elements between each channel
          */
-        bool Dequeue(T* data, unsigned count, unsigned numChans, unsigned chanStride) {
+        bool Dequeue(T* data, QueueSize_t count, unsigned numChans, QueueSize_t chanStride) {
             return queue->RawDequeue((void*)data, GetTypeSize<T>() * count,
                     numChans, GetTypeSize<T>() * chanStride);
         }
@@ -90,14 +90,14 @@ namespace CPN {
         /// \return the number of channels
         unsigned NumChannels() const { return queue->NumChannels(); }
         /// \return the maximum threshold in data elements
-        unsigned MaxThreshold() const { return queue->MaxThreshold()/GetTypeSize<T>(); }
-        unsigned QueueLength() const { return queue->QueueLength()/GetTypeSize<T>(); }
+        QueueSize_t MaxThreshold() const { return queue->MaxThreshold()/GetTypeSize<T>(); }
+        QueueSize_t QueueLength() const { return queue->QueueLength()/GetTypeSize<T>(); }
         /// \return the number of data elements in the channel
-        unsigned Count() const { return queue->Count()/GetTypeSize<T>(); }
+        QueueSize_t Count() const { return queue->Count()/GetTypeSize<T>(); }
         /// \return true if empty, false otherwise
         bool Empty() const { return queue->Empty(); }
         /// \return the current channel stride, only call this right after a successful call to GetDequeuePtr.
-        unsigned ChannelStride() const { return queue->ChannelStride()/GetTypeSize<T>(); }
+        QueueSize_t ChannelStride() const { return queue->ChannelStride()/GetTypeSize<T>(); }
         /// \return the endpoint key
         Key_t GetKey() const { return queue->GetKey(); }
         /// \return the underlying reader
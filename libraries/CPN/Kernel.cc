@@ -23,6 +23,7 @@
  */
 
 #include "Kernel.h"
+#include "GrowPolicy.h"
 #include "Exceptions.h"
 #include "NodeFactory.h"
 #include "NodeBase.h"
@@ -35,17 +36,19 @@
 #include "Logger.h"
 #include "ErrnoException.h"
 #include "PthreadFunctional.h"
+#include "FiberScheduler.h"
+#include "ThreadPool.h"
+#include "NumProcs.h"
+#include "Trace.h"
+#include "StatsServer.h"
+#include "VariantToJSON.h"
 #include <stdexcept>
+#include <limits>
+#include <sstream>
+#include <set>
 
-//#define KERNEL_FUNC_TRACE
-#ifdef KERNEL_FUNC_TRACE
-#include <stdio.h>
-#define FUNCBEGIN printf("%s begin %s\n",__PRETTY_FUNCTION__, kernelname.c_str())
-#define FUNCEND printf("%s end %s\n",__PRETTY_FUNCTION__, kernelname.c_str())
-#else
-#define FUNCBEGIN
-#define FUNCEND
-#endif
+#define FUNCBEGIN LOG_TRACE(logger, "%s begin", __PRETTY_FUNCTION__)
+#define FUNCEND LOG_TRACE(logger, "%s end", __PRETTY_FUNCTION__)
 
 namespace CPN {
 
@@ -55,15 +58,27 @@ namespace CPN {
         kernelkey(0),
         context(kattr.GetContext()),
         useremote(kattr.GetRemoteEnabled()),
+        nodelock(true),
         nodecond_signal(false),
+        fiberstacksize(kattr.GetFiberStackSize()),
+        tracefile(kattr.GetTraceFile()),
+        statsfile(kattr.GetStatsFile()),
         useD4R(kattr.UseD4R()),
         swallowbrokenqueue(kattr.SwallowBrokenQueueExceptions()),
-        growmaxthresh(kattr.GrowQueueMaxThreshold())
+        growmaxthresh(kattr.GrowQueueMaxThreshold()),
+        growpolicy(kattr.GetGrowPolicy())
     {
         FUNCBEGIN;
         nodeloader.LoadSharedLib(kattr.GetSharedLibs());
         nodeloader.LoadNodeList(kattr.GetNodeLists());
         thread.reset(CreatePthreadFunctional(this, &Kernel::EntryPoint));
+        if (kattr.UseFibers()) {
+            fiberscheduler.reset(new FiberScheduler(kattr.GetFiberWorkers(), kattr.GetFiberStackSize()));
+        } else if (kattr.GetNodeThreadIdleTime() > 0) {
+            // Never more nodes than threads, a queued node could wait forever
+            nodethreads.reset(new Sync::ThreadPool(0, std::numeric_limits<unsigned>::max(),
+                        kattr.GetNodeThreadIdleTime()));
+        }
         if (!context) {
             context = Context::Local();
         }
@@ -73,6 +88,14 @@ namespace CPN {
         logger.Output(context.get());
         logger.LogLevel(context->LogLevel());
         logger.Name(kernelname);
+        if (!tracefile.empty()) {
+#ifdef CPN_TRACE
+            Tracer::Enable();
+#else
+            logger.Warn("Tracing is not compiled in, define CPN_TRACE to trace to %s",
+                    tracefile.c_str());
+#endif
+        }
 
         if (useremote) {
             SockAddrList addrlist = SocketAddress::CreateIP(kattr.GetHostName(),
@@ -80,6 +103,11 @@ namespace CPN {
             server.reset(new ConnectionServer(addrlist, context));
 
             SocketAddress addr = server->GetAddress();
+            for (std::vector<std::string>::const_iterator itr = kattr.GetListenAddresses().begin();
+                    itr != kattr.GetListenAddresses().end(); ++itr) {
+                server->Listen(SocketAddress::CreateIP(*itr, addr.GetServName()));
+                logger.Info("Also listening on %s:%s", itr->c_str(), addr.GetServName().c_str());
+            }
             kernelkey = context->SetupKernel(kernelname, addr.GetHostName(), addr.GetServName(), this);
             remotequeueholder.reset(new RemoteQueueHolder());
 
@@ -88,6 +116,27 @@ namespace CPN {
             kernelkey = context->SetupKernel(kernelname, this);
             logger.Info("New kernel");
         }
+        if (!kattr.GetStatsSocket().empty() || !kattr.GetStatsServName().empty()) {
+            // The stats are only a diagnostic, run without them on failure
+            try {
+                if (!kattr.GetStatsSocket().empty()) {
+                    statsserver.reset(new StatsServer(*this,
+                                SocketAddress::CreateLocal(kattr.GetStatsSocket()),
+                                kattr.GetStatsSocket()));
+                    logger.Info("Stats on %s", kattr.GetStatsSocket().c_str());
+                } else {
+                    statsserver.reset(new StatsServer(*this, (kattr.GetStatsHostName().empty()
+                                    ? SocketAddress::CreateIPFromServ(kattr.GetStatsServName())
+                                    : SocketAddress::CreateIP(kattr.GetStatsHostName(),
+                                        kattr.GetStatsServName())), ""));
+                    SocketAddress addr = statsserver->GetAddress();
+                    logger.Info("Stats on %s:%s", addr.GetHostName(true).c_str(),
+                            addr.GetServName().c_str());
+                }
+            } catch (const ErrnoException &e) {
+                logger.Error("Unable to start the stats server: %s", e.what());
+            }
+        }
         // Start up and don't finish until actually started.
         thread->Start();
         status.CompareAndWait(INITIALIZED);
@@ -132,6 +181,10 @@ namespace CPN {
     Key_t Kernel::CreateNode(const NodeAttr &attr) {
         FUNCBEGIN;
 
+        if (attr.GetReplicas() != 1) {
+            return CreateReplicatedNode(attr);
+        }
+
         NodeAttr nodeattr = attr;
 
         if (nodeattr.GetKernelKey() == 0) {
@@ -156,6 +209,109 @@ namespace CPN {
         return nodekey;
     }
 
+    std::vector<Key_t> Kernel::CreateNodes(const std::vector<NodeAttr> &attrs) {
+        FUNCBEGIN;
+        // Check every name before anything is created so that a taken
+        // name does not leave half of the nodes behind
+        std::set<std::string> names;
+        for (unsigned i = 0; i < attrs.size(); ++i) {
+            if (!names.insert(attrs[i].GetName()).second) {
+                throw std::invalid_argument("Node " + attrs[i].GetName() + " is given twice.");
+            }
+            NodeAttr replica = attrs[i];
+            if (attrs[i].GetReplicas() != 1 && context->GetReplicas(attrs[i].GetName(), replica)) {
+                throw std::invalid_argument("Node " + attrs[i].GetName() + " is already replicated.");
+            }
+        }
+        std::vector<Key_t> keys(attrs.size(), 0);
+        std::vector<NodeAttr> batch;
+        std::vector<unsigned> index;
+        std::map<std::string, Key_t> kernelkeys;
+        for (unsigned i = 0; i < attrs.size(); ++i) {
+            if (attrs[i].GetReplicas() != 1) { continue; }
+            NodeAttr nodeattr = attrs[i];
+            if (nodeattr.GetKernelKey() == 0) {
+                if (nodeattr.GetKernel().empty()) {
+                    nodeattr.SetKernelKey(kernelkey);
+                } else {
+                    std::map<std::string, Key_t>::iterator entry = kernelkeys.find(nodeattr.GetKernel());
+                    if (entry == kernelkeys.end()) {
+                        Key_t key = context->WaitForKernelStart(nodeattr.GetKernel());
+                        entry = kernelkeys.insert(std::make_pair(nodeattr.GetKernel(), key)).first;
+                    }
+                    nodeattr.SetKernelKey(entry->second);
+                }
+            }
+            batch.push_back(nodeattr);
+            index.push_back(i);
+        }
+        std::vector<std::pair<Key_t, std::string> > batchnames;
+        for (unsigned i = 0; i < batch.size(); ++i) {
+            batchnames.push_back(std::make_pair(batch[i].GetKernelKey(), batch[i].GetName()));
+        }
+        // Throws for a name that is taken before any node is created
+        std::vector<Key_t> nodekeys = context->CreateNodeKeys(batchnames);
+        ASSERT(nodekeys.size() == batch.size());
+        for (unsigned i = 0; i < batch.size(); ++i) {
+            batch[i].SetKey(nodekeys[i]);
+            if (batch[i].GetKernelKey() == kernelkey) {
+                InternalCreateNode(batch[i]);
+            } else {
+                context->SendCreateNode(batch[i].GetKernelKey(), batch[i]);
+            }
+            keys[index[i]] = nodekeys[i];
+        }
+        for (unsigned i = 0; i < attrs.size(); ++i) {
+            if (attrs[i].GetReplicas() != 1) {
+                keys[i] = CreateReplicatedNode(attrs[i]);
+            }
+        }
+        return keys;
+    }
+
+    static std::string IndexedName(const std::string &name, unsigned i) {
+        std::ostringstream oss;
+        oss << name << i;
+        return oss.str();
+    }
+
+    /**
+     * The node which stands for a group of replicas, it ends when
+     * every copy has ended so that waiting on the group waits on all.
+     */
+    static void ReplicaGroupNode(NodeBase *node, unsigned num) {
+        for (unsigned i = 0; i < num; ++i) {
+            node->GetKernel()->WaitForNode(IndexedName(node->GetName() + ".", i));
+        }
+    }
+
+    Key_t Kernel::CreateReplicatedNode(const NodeAttr &attr) {
+        unsigned num = attr.GetReplicas();
+        if (num == 0) {
+            num = GetNumProcs();
+            if (num == 0) { num = 1; }
+        }
+        if (attr.GetScatterSize() <= attr.GetScatterOverlap()) {
+            throw std::invalid_argument("The scatter block of replicated node "
+                    + attr.GetName() + " must be larger than its overlap.");
+        }
+        NodeAttr replica = attr;
+        replica.SetReplicas(num);
+        if (!context->SetReplicas(replica)) {
+            throw std::invalid_argument("Node " + attr.GetName() + " is already replicated.");
+        }
+        {
+            AutoFiberLock arlock(nodelock);
+            replicas.insert(std::make_pair(attr.GetName(), replica));
+        }
+        replica.SetReplicas(1);
+        for (unsigned i = 0; i < num; ++i) {
+            replica.SetName(IndexedName(attr.GetName() + ".", i));
+            CreateNode(replica);
+        }
+        return CreateFunctionNode(attr.GetName(), &ReplicaGroupNode, num);
+    }
+
     class ExternalEndpoint : public PseudoNode {
     public:
         ExternalEndpoint(const std::string &name, Key_t nodekey, shared_ptr<Context> context,
@@ -180,7 +336,7 @@ namespace CPN {
         Key_t nodekey = context->CreateNodeKey(kernelkey, name);
         shared_ptr<PseudoNode> pnode;
         pnode.reset(new ExternalEndpoint(name, nodekey, context, iswriter));
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         nodemap.insert(std::make_pair(nodekey, pnode));
         arlock.Unlock();
         context->SignalNodeStart(nodekey);
@@ -188,7 +344,7 @@ namespace CPN {
 
     shared_ptr<QueueWriter> Kernel::GetExternalOQueue(const std::string &name) {
         Key_t key = context->GetNodeKey(name);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         NodeMap::iterator entry = nodemap.find(key);
         if (entry == nodemap.end() || !entry->second->IsPurePseudo()) {
             throw std::invalid_argument("Not a valid external reader.");
@@ -203,7 +359,7 @@ namespace CPN {
 
     shared_ptr<QueueReader> Kernel::GetExternalIQueue(const std::string &name) {
         Key_t key = context->GetNodeKey(name);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         NodeMap::iterator entry = nodemap.find(key);
         if (entry == nodemap.end() || !entry->second->IsPurePseudo()) {
             throw std::invalid_argument("Not a valid external writer.");
@@ -218,7 +374,7 @@ namespace CPN {
 
     void Kernel::DestroyExternalEndpoint(const std::string &name) {
         Key_t key = context->GetNodeKey(name);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         NodeMap::iterator entry = nodemap.find(key);
         if (entry == nodemap.end() || !entry->second->IsPurePseudo()) {
             throw std::invalid_argument("Not a valid external endpoint.");
@@ -243,6 +399,9 @@ namespace CPN {
 
     void Kernel::CreateQueue(const QueueAttr &qattr) {
         FUNCBEGIN;
+        if (CreateReplicatedQueue(qattr)) {
+            return;
+        }
         // Normalize the QueueAttr into a SimpleQueueAttr
         // This gets rid of the names and translates to IDs
         SimpleQueueAttr attr = qattr;
@@ -286,6 +445,19 @@ namespace CPN {
 
         context->ConnectEndpoints(attr.GetWriterKey(), attr.GetReaderKey(), qattr.GetName());
 
+        shared_ptr<GrowPolicy> policy = attr.GetGrowPolicy();
+        if (!policy) { policy = GetGrowPolicy(); }
+        if (policy) {
+            // The policy may remember the queue by name
+            if (attr.GetName().empty()) {
+                attr.SetName(context->GetNodeName(attr.GetWriterNodeKey()) + "."
+                        + context->GetWriterName(attr.GetWriterKey()) + "->"
+                        + context->GetNodeName(attr.GetReaderNodeKey()) + "."
+                        + context->GetReaderName(attr.GetReaderKey()));
+            }
+            attr.SetLength(policy->InitialLength(attr.GetName(), attr.GetLength()));
+        }
+
         Key_t readerkernel = context->GetNodeKernel(attr.GetReaderNodeKey());
         Key_t writerkernel = context->GetNodeKernel(attr.GetWriterNodeKey());
 
@@ -318,9 +490,142 @@ namespace CPN {
         }
     }
 
+    void Kernel::CreateQueues(const std::vector<QueueAttr> &attrs) {
+        FUNCBEGIN;
+        std::vector<std::pair<std::string, std::string> > readers, writers;
+        for (unsigned i = 0; i < attrs.size(); ++i) {
+            const QueueAttr &qattr = attrs[i];
+            if (qattr.GetReaderKey() == 0 && qattr.GetReaderNodeKey() == 0
+                    && !qattr.GetReaderNode().empty()) {
+                readers.push_back(std::make_pair(qattr.GetReaderNode(), qattr.GetReaderPort()));
+            }
+            if (qattr.GetWriterKey() == 0 && qattr.GetWriterNodeKey() == 0
+                    && !qattr.GetWriterNode().empty()) {
+                writers.push_back(std::make_pair(qattr.GetWriterNode(), qattr.GetWriterPort()));
+            }
+        }
+        context->PrefetchEndpoints(readers, writers);
+        for (unsigned i = 0; i < attrs.size(); ++i) {
+            CreateQueue(attrs[i]);
+        }
+    }
+
+    bool Kernel::FindReplicas(const std::string &name, NodeAttr &attr) {
+        if (name.empty()) { return false; }
+        {
+            AutoFiberLock arlock(nodelock);
+            ReplicaMap::iterator entry = replicas.find(name);
+            if (entry != replicas.end()) {
+                attr = entry->second;
+                return true;
+            }
+        }
+        // Groups are never removed so a hit from the context can be kept.
+        if (!context->GetReplicas(name, attr)) { return false; }
+        AutoFiberLock arlock(nodelock);
+        replicas.insert(std::make_pair(name, attr));
+        return true;
+    }
+
+    /**
+     * Make a queue to or from a scatter or gather node deep enough
+     * to hold the block that node moves at once.
+     */
+    static QueueAttr FitBlock(const QueueAttr &qattr, unsigned block) {
+        QueueAttr fitted = qattr;
+        if (fitted.GetMaxThreshold() < block) {
+            fitted.SetMaxThreshold(block);
+        }
+        if (fitted.GetLength() < fitted.GetMaxThreshold()) {
+            fitted.SetLength(fitted.GetMaxThreshold());
+        }
+        return fitted;
+    }
+
+    /**
+     * If the reader or the writer of the queue is a replicated node
+     * create its scatter or gather node and connect the queue through
+     * it to every copy. Each of the queues created may in turn have
+     * a replicated node at the other end.
+     * \return false if neither end is replicated
+     */
+    bool Kernel::CreateReplicatedQueue(const QueueAttr &qattr) {
+        NodeAttr rep("", "");
+        if (FindReplicas(qattr.GetReaderNode(), rep)) {
+            const std::string &port = qattr.GetReaderPort();
+            const std::string scatter = rep.GetName() + ".scatter." + port;
+            CreateNode(NodeAttr(scatter, "ForkJoinNode")
+                    .SetKernel(rep.GetKernel())
+                    .SetKernelKey(rep.GetKernelKey())
+                    .SetParam("num_inports", 1)
+                    .SetParam("num_outports", rep.GetReplicas())
+                    .SetParam("size", rep.GetScatterSize())
+                    .SetParam("overlap", rep.GetScatterOverlap()));
+            QueueAttr head = FitBlock(qattr, rep.GetScatterSize());
+            head.SetReader(scatter, "in0");
+            CreateQueue(head);
+            for (unsigned i = 0; i < rep.GetReplicas(); ++i) {
+                QueueAttr branch = FitBlock(qattr, rep.GetScatterSize());
+                branch.SetWriter(scatter, IndexedName("out", i));
+                branch.SetReader(IndexedName(rep.GetName() + ".", i), port);
+                if (!qattr.GetName().empty()) {
+                    branch.SetName(IndexedName(qattr.GetName() + ".", i));
+                }
+                CreateQueue(branch);
+            }
+            return true;
+        }
+        if (FindReplicas(qattr.GetWriterNode(), rep)) {
+            const std::string &port = qattr.GetWriterPort();
+            const std::string gather = rep.GetName() + ".gather." + port;
+            CreateNode(NodeAttr(gather, "ForkJoinNode")
+                    .SetKernel(rep.GetKernel())
+                    .SetKernelKey(rep.GetKernelKey())
+                    .SetParam("num_inports", rep.GetReplicas())
+                    .SetParam("num_outports", 1)
+                    .SetParam("size", rep.GetGatherSize())
+                    .SetParam("overlap", 0));
+            for (unsigned i = 0; i < rep.GetReplicas(); ++i) {
+                QueueAttr branch = FitBlock(qattr, rep.GetGatherSize());
+                branch.SetWriter(IndexedName(rep.GetName() + ".", i), port);
+                branch.SetReader(gather, IndexedName("in", i));
+                if (!qattr.GetName().empty()) {
+                    branch.SetName(IndexedName(qattr.GetName() + ".", i));
+                }
+                CreateQueue(branch);
+            }
+            QueueAttr tail = FitBlock(qattr, rep.GetGatherSize());
+            tail.SetWriter(gather, "out0");
+            CreateQueue(tail);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Resolve a memory node which follows the reader or the writer
+     * to the NUMA node of that node. reader or writer is 0 when that
+     * endpoint is not on this kernel.
+     */
+    static SimpleQueueAttr PlaceQueue(const SimpleQueueAttr &attr, PseudoNode *reader, PseudoNode *writer) {
+        SimpleQueueAttr placed = attr;
+        if (attr.GetMemoryNode() == QUEUEMEMORY_READER) {
+            placed.SetMemoryNode(reader ? reader->GetNUMANode() : QUEUEMEMORY_ANY);
+        } else if (attr.GetMemoryNode() == QUEUEMEMORY_WRITER) {
+            placed.SetMemoryNode(writer ? writer->GetNUMANode() : QUEUEMEMORY_ANY);
+        }
+        return placed;
+    }
+
     void Kernel::CreateReaderEndpoint(const SimpleQueueAttr &attr) {
         ASSERT(useremote, "Cannot create remote queue without enabling remote operations.");
 
+        AutoFiberLock arlock(nodelock);
+        NodeMap::iterator entry = nodemap.find(attr.GetReaderNodeKey());
+        ASSERT(entry != nodemap.end(), "Node not found!?");
+        shared_ptr<PseudoNode> node = entry->second;
+        arlock.Unlock();
+
         shared_ptr<RemoteQueue> endp;
         endp = shared_ptr<RemoteQueue>(
                 new RemoteQueue(
@@ -328,15 +633,9 @@ namespace CPN {
                     RemoteQueue::READ,
                     server.get(),
                     remotequeueholder.get(),
-                    attr
+                    PlaceQueue(attr, node.get(), 0)
                     ));
 
-
-        Sync::AutoReentrantLock arlock(nodelock);
-        NodeMap::iterator entry = nodemap.find(attr.GetReaderNodeKey());
-        ASSERT(entry != nodemap.end(), "Node not found!?");
-        shared_ptr<PseudoNode> node = entry->second;
-        arlock.Unlock();
         remotequeueholder->AddQueue(endp);
         endp->Start();
         node->CreateReader(endp);
@@ -345,6 +644,12 @@ namespace CPN {
     void Kernel::CreateWriterEndpoint(const SimpleQueueAttr &attr) {
         ASSERT(useremote, "Cannot create remote queue without enabling remote operations.");
 
+        AutoFiberLock arlock(nodelock);
+        NodeMap::iterator entry = nodemap.find(attr.GetWriterNodeKey());
+        ASSERT(entry != nodemap.end(), "Node not found!?");
+        shared_ptr<PseudoNode> node = entry->second;
+        arlock.Unlock();
+
         shared_ptr<RemoteQueue> endp;
         endp = shared_ptr<RemoteQueue>(
                 new RemoteQueue(
@@ -352,24 +657,16 @@ namespace CPN {
                     RemoteQueue::WRITE,
                     server.get(),
                     remotequeueholder.get(),
-                    attr
+                    PlaceQueue(attr, 0, node.get())
                     ));
 
-        Sync::AutoReentrantLock arlock(nodelock);
-        NodeMap::iterator entry = nodemap.find(attr.GetWriterNodeKey());
-        ASSERT(entry != nodemap.end(), "Node not found!?");
-        shared_ptr<PseudoNode> node = entry->second;
-        arlock.Unlock();
         remotequeueholder->AddQueue(endp);
         endp->Start();
         node->CreateWriter(endp);
     }
 
     void Kernel::CreateLocalQueue(const SimpleQueueAttr &attr) {
-        shared_ptr<QueueBase> queue;
-        queue = shared_ptr<QueueBase>(new ThresholdQueue(this, attr));
-
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         NodeMap::iterator readentry = nodemap.find(attr.GetReaderNodeKey());
         ASSERT(readentry != nodemap.end(), "Tried to connect a queue to a node that doesn't exist.");
         shared_ptr<PseudoNode> readnode = readentry->second;
@@ -379,12 +676,16 @@ namespace CPN {
         shared_ptr<PseudoNode> writenode = writeentry->second;
         arlock.Unlock();
 
+        shared_ptr<QueueBase> queue;
+        queue = shared_ptr<QueueBase>(new ThresholdQueue(this,
+                    PlaceQueue(attr, readnode.get(), writenode.get())));
+
         writenode->CreateWriter(queue);
         readnode->CreateReader(queue);
     }
 
     void Kernel::InternalCreateNode(NodeAttr &nodeattr) {
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         FUNCBEGIN;
         ASSERT(status.Get() == RUNNING);
         NodeFactory *factory = GetNodeFactory(nodeattr.GetTypeName());
@@ -396,9 +697,57 @@ namespace CPN {
         node->Start();
     }
 
+    FiberScheduler *Kernel::GetFusionScheduler(const std::string &group) {
+        AutoFiberLock arlock(nodelock);
+        FusionMap::iterator entry = fusiongroups.find(group);
+        if (entry == fusiongroups.end()) {
+            shared_ptr<FiberScheduler> scheduler(new FiberScheduler(1, fiberstacksize, true));
+            entry = fusiongroups.insert(std::make_pair(group, scheduler)).first;
+        }
+        return entry->second.get();
+    }
+
+    unsigned long Kernel::NumNodeThreadsReused() {
+        if (!nodethreads.get()) { return 0; }
+        return nodethreads->NumExecuted() - nodethreads->NumSpawned();
+    }
+
+    void Kernel::GetNodeStats(std::vector<NodeStats> &stats) {
+        NodeList nodes;
+        {
+            AutoFiberLock arlock(nodelock);
+            for (NodeMap::iterator itr = nodemap.begin(); itr != nodemap.end(); ++itr) {
+                nodes.push_back(itr->second);
+            }
+        }
+        stats.resize(nodes.size());
+        for (unsigned i = 0; i < nodes.size(); ++i) {
+            nodes[i]->GetStats(stats[i]);
+        }
+    }
+
+    void Kernel::GetEndedNodeStats(std::vector<NodeStats> &stats) {
+        Sync::AutoReentrantLock arlock(datalock);
+        stats = endedstats;
+    }
+
     void Kernel::NodeTerminated(Key_t key) {
+        if (!statsfile.empty() || statsserver.get()) {
+            shared_ptr<PseudoNode> node;
+            {
+                AutoFiberLock arlock(nodelock);
+                NodeMap::iterator entry = nodemap.find(key);
+                if (entry != nodemap.end()) { node = entry->second; }
+            }
+            if (node) {
+                NodeStats stats;
+                node->GetStats(stats);
+                Sync::AutoReentrantLock arlock(datalock);
+                endedstats.push_back(stats);
+            }
+        }
         context->SignalNodeEnd(key);
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         FUNCBEGIN;
         if (status.Get() == DONE) {
             logger.Warn("Nodes running after shutdown");
@@ -426,8 +775,31 @@ namespace CPN {
         }
     }
 
+    void Kernel::WriteStatsFile() {
+        Variant doc(Variant::ObjectType);
+        doc["kernel"] = kernelname;
+        Variant nodes(Variant::ArrayType);
+        {
+            Sync::AutoReentrantLock arlock(datalock);
+            for (std::vector<NodeStats>::iterator itr = endedstats.begin();
+                    itr != endedstats.end(); ++itr) {
+                nodes.Append(StatsServer::ToVariant(*itr));
+            }
+        }
+        doc["nodes"] = nodes;
+        FILE *f = fopen(statsfile.c_str(), "w");
+        if (!f) {
+            logger.Error("Unable to write the stats to %s", statsfile.c_str());
+            return;
+        }
+        const std::string json = VariantToJSON(doc, true);
+        fwrite(json.data(), 1, json.size(), f);
+        fputc('\n', f);
+        fclose(f);
+    }
+
     void Kernel::SendWakeup() {
-        Sync::AutoReentrantLock arlock(nodelock);
+        AutoFiberLock arlock(nodelock);
         if (useremote) {
             server->Wakeup();
         }
@@ -448,7 +820,7 @@ namespace CPN {
                 }
             } else {
                 ClearGarbage();
-                Sync::AutoReentrantLock arlock(nodelock);
+                AutoFiberLock arlock(nodelock);
                 while (status.Get() == RUNNING) {
                     if (!nodecond_signal) {
                         nodecond.Wait(nodelock);
@@ -467,7 +839,7 @@ namespace CPN {
             remotequeueholder->Shutdown();
         }
         {
-            Sync::AutoReentrantLock arlock(nodelock);
+            AutoFiberLock arlock(nodelock);
             NodeMap mapcopy = nodemap;
             arlock.Unlock();
             NodeMap::iterator nitr = mapcopy.begin();
@@ -488,6 +860,22 @@ namespace CPN {
             }
         }
         ClearGarbage();
+        // Every queue is gone so no queue lock is held
+        shared_ptr<GrowPolicy> policy = GetGrowPolicy();
+        if (policy) {
+            policy->Flush();
+        }
+#ifdef CPN_TRACE
+        if (!tracefile.empty() && !Tracer::Dump(tracefile)) {
+            logger.Error("Unable to write the trace to %s", tracefile.c_str());
+        }
+#endif
+        if (!statsfile.empty()) {
+            WriteStatsFile();
+        }
+        if (statsserver.get()) {
+            statsserver->Shutdown();
+        }
         context->SignalKernelEnd(kernelkey);
         status.Post(DONE);
         FUNCEND;
@@ -536,6 +924,18 @@ namespace CPN {
         }
         logger.Error("Kernel %s (%llu) in state %s", kernelname.c_str(), kernelkey, statename.c_str());
         logger.Error("Active nodes: %u, Garbage nodes: %u", nodemap.size(), garbagenodes.size());
+        if (fiberscheduler.get()) {
+            logger.Error("Fiber workers: %u, Ready fibers: %u",
+                    fiberscheduler->NumWorkers(), fiberscheduler->NumReady());
+        }
+        if (nodethreads.get()) {
+            logger.Error("Node threads created: %lu, reused: %lu",
+                    nodethreads->NumSpawned(), NumNodeThreadsReused());
+        }
+        for (FusionMap::iterator itr = fusiongroups.begin(); itr != fusiongroups.end(); ++itr) {
+            logger.Error("Fusion group \"%s\", Ready fibers: %u", itr->first.c_str(),
+                    itr->second->NumReady());
+        }
         if (useremote) {
             server->LogState();
         }
@@ -577,5 +977,15 @@ namespace CPN {
         return growmaxthresh = grow;
     }
 
+    shared_ptr<GrowPolicy> Kernel::GetGrowPolicy() {
+        Sync::AutoReentrantLock al(datalock);
+        return growpolicy;
+    }
+
+    shared_ptr<GrowPolicy> Kernel::SetGrowPolicy(shared_ptr<GrowPolicy> policy) {
+        Sync::AutoReentrantLock al(datalock);
+        return growpolicy = policy;
+    }
+
 }
 
@@ -32,18 +32,25 @@
 #include "QueueAttr.h"
 #include "KernelBase.h"
 #include "ReentrantLock.h"
+#include "FiberScheduler.h"
 #include "StatusHandler.h"
 #include "Logger.h"
 #include "Context.h"
 #include "NodeLoader.h"
+#include "NodeStats.h"
 #include <string>
 #include <map>
 #include <vector>
 
 class Pthread;
+namespace Sync {
+    class ThreadPool;
+}
 
 namespace CPN {
 
+    class StatsServer;
+
     /**
      * \brief The Kernel declaration.
      *
@@ -70,7 +77,9 @@ namespace CPN {
          * Waits until the main loop terminates. Will not happen until
          * a terminate signal or Terminate is called.
          * Use WaitForNode if you wish to wait for the nodes to be
-         * done.
+         * done. The trace (see KernelAttr::SetTraceFile) and the
+         * stats (see KernelAttr::SetStatsFile) have been written when
+         * this returns.
          */
         void Wait();
 
@@ -95,7 +104,9 @@ namespace CPN {
          * Create a new node.
          *
          * \param attr The NodeAttr that describes the new node to create.
-         * \return the new node's key
+         * \return the new node's key, the key of the node standing
+         * for the group of copies of a replicated node
+         * (see NodeAttr::SetReplicas)
          * \throws KernelShutdownException if Wait completed or Terminate
          * has been called.
          */
@@ -109,6 +120,18 @@ namespace CPN {
             return CreateNode(NodeAttr(name_,nodetype_));
         }
 
+        /**
+         * \brief Create many nodes, asking the context for all their keys
+         * at once instead of one round trip per node.
+         *
+         * The names are all checked before any node is created, if one
+         * is taken, given twice or already replicated none are created.
+         * \param attrs the nodes to create
+         * \return the keys of the new nodes in the same order
+         * \throw std::invalid_argument
+         */
+        std::vector<Key_t> CreateNodes(const std::vector<NodeAttr> &attrs);
+
         /**
          * \brief Instantiating a function node.
          *
@@ -203,12 +226,23 @@ namespace CPN {
         /** \brief Create a new queue
          *
          * Note that the nodes for the queue must already exist.
+         * A queue to or from a replicated node is
+         * split into one queue per copy through the scatter or gather
+         * node of its port, see NodeAttr::SetReplicas.
          *
          * \param attr the attribute to use to create the queu
          * \see QueueAttr
          */
         void CreateQueue(const QueueAttr &attr);
 
+        /**
+         * \brief Create many queues, letting the context look up all the
+         * endpoints at once before creating them one by one.
+         * \param attrs the queues to create
+         * \see CreateQueue
+         */
+        void CreateQueues(const std::vector<QueueAttr> &attrs);
+
         /**
          * \return A pointer to the logger instance used by the kernel.
          */
@@ -302,6 +336,13 @@ namespace CPN {
         bool SwallowBrokenQueueExceptions();
         bool SwallowBrokenQueueExceptions(bool sbqe);
 
+        /** \brief The policy for growing the queues in an artificial
+         * deadlock, see KernelAttr::SetGrowPolicy.
+         * \return the policy or null to use CalculateGrowSize
+         */
+        shared_ptr<GrowPolicy> GetGrowPolicy();
+        shared_ptr<GrowPolicy> SetGrowPolicy(shared_ptr<GrowPolicy> policy);
+
         /**
          * @}
          */
@@ -309,10 +350,44 @@ namespace CPN {
         /** \brief Calculate the new queue size when a queue needs to grow.
          * \return the new queue size
          */
-        unsigned CalculateGrowSize(unsigned currentsize, unsigned request) {
+        QueueSize_t CalculateGrowSize(QueueSize_t currentsize, QueueSize_t request) {
             return context->CalculateGrowSize(currentsize, request);
         }
 
+        /** \return the scheduler the nodes run on or 0 when
+         * each node has its own thread (see KernelAttr::UseFibers)
+         */
+        FiberScheduler *GetFiberScheduler() { return fiberscheduler.get(); }
+
+        /** \return the single threaded scheduler the nodes of the
+         * given fusion group run on (see NodeAttr::SetFusable),
+         * created on first use
+         */
+        FiberScheduler *GetFusionScheduler(const std::string &group);
+
+        /** \return the pool of threads nodes run on or 0 when each
+         * node gets a new thread (see KernelAttr::SetNodeThreadIdleTime)
+         */
+        Sync::ThreadPool *GetNodeThreadPool() { return nodethreads.get(); }
+
+        /** \return the number of nodes which ran on a parked thread
+         * instead of creating one */
+        unsigned long NumNodeThreadsReused();
+
+        /**
+         * \brief Take a snapshot of what the nodes running on this
+         * kernel have done so far. A node logs the same numbers at
+         * the INFO level when it terminates.
+         * \param stats filled with one entry per node
+         */
+        void GetNodeStats(std::vector<NodeStats> &stats);
+        /**
+         * \brief Get the final stats of the nodes which have ended.
+         * Only kept when there is a stats file or a stats server (see
+         * KernelAttr::SetStatsFile and KernelAttr::SetStatsAddress).
+         */
+        void GetEndedNodeStats(std::vector<NodeStats> &stats);
+
     private:
         // Not copyable
         Kernel(const Kernel&);
@@ -324,7 +399,11 @@ namespace CPN {
         void CreateWriterEndpoint(const SimpleQueueAttr &attr);
         void CreateLocalQueue(const SimpleQueueAttr &attr);
         void InternalCreateNode(NodeAttr &nodeattr);
+        Key_t CreateReplicatedNode(const NodeAttr &attr);
+        bool CreateReplicatedQueue(const QueueAttr &qattr);
+        bool FindReplicas(const std::string &name, NodeAttr &attr);
         void ClearGarbage();
+        void WriteStatsFile();
 
         void *EntryPoint();
 
@@ -344,24 +423,37 @@ namespace CPN {
         shared_ptr<Context> context;
         auto_ptr<ConnectionServer> server;
         auto_ptr<RemoteQueueHolder> remotequeueholder;
+        auto_ptr<FiberScheduler> fiberscheduler;
+        auto_ptr<Sync::ThreadPool> nodethreads;
+        auto_ptr<StatsServer> statsserver;
         bool useremote;
         NodeLoader nodeloader;
 
         typedef std::map<Key_t, shared_ptr<PseudoNode> > NodeMap;
+        typedef std::map<std::string, shared_ptr<FiberScheduler> > FusionMap;
+        typedef std::map<std::string, NodeAttr> ReplicaMap;
         typedef std::vector< shared_ptr<PseudoNode> > NodeList;
 
-        // nodelock serializes access to nodemap
-        Sync::ReentrantLock nodelock;
-        Sync::ReentrantCondition nodecond;
+        // nodelock serializes access to nodemap, fusiongroups and replicas
+        FiberMutex nodelock;
+        FiberCondition<PthreadCondition> nodecond;
         bool nodecond_signal;
         NodeMap nodemap;
+        FusionMap fusiongroups;
+        ReplicaMap replicas;
+        const unsigned fiberstacksize;
+        const std::string tracefile;
+        const std::string statsfile;
         Sync::ReentrantLock garbagelock;
         NodeList garbagenodes;
 
         Sync::ReentrantLock datalock;
+        // The stats of the nodes which have ended, for the statsfile
+        std::vector<NodeStats> endedstats;
         bool useD4R;
         bool swallowbrokenqueue;
         bool growmaxthresh;
+        shared_ptr<GrowPolicy> growpolicy;
     };
 }
 
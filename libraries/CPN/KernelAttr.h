@@ -49,7 +49,9 @@ namespace CPN {
             servname(""),
             remote_enabled(false),
             useD4R(true), swallowbrokenqueue(false),
-            growmaxthresh(true)
+            growmaxthresh(true),
+            usefibers(false), fiberworkers(0), fiberstacksize(1<<18),
+            nodethreadidle(0)
         {}
 
         KernelAttr(const char* name_)
@@ -58,7 +60,9 @@ namespace CPN {
             servname(""),
             remote_enabled(false),
             useD4R(true), swallowbrokenqueue(false),
-            growmaxthresh(true)
+            growmaxthresh(true),
+            usefibers(false), fiberworkers(0), fiberstacksize(1<<18),
+            nodethreadidle(0)
         {}
 
         KernelAttr &SetName(const std::string &n) {
@@ -76,6 +80,18 @@ namespace CPN {
             return *this;
         }
 
+        /** \brief Accept remote queue connections on another address
+         * too, on the same port as the host name and serv name, so the
+         * connections of a striped queue can arrive on several
+         * interfaces (see QueueAttr::AddReaderAddress).
+         * \param host a hostname or numeric address
+         * \return this
+         */
+        KernelAttr &AddListenAddress(const std::string &host) {
+            listenaddrs.push_back(host);
+            return *this;
+        }
+
         KernelAttr &SetContext(shared_ptr<Context> ctx) {
             context = ctx;
             return *this;
@@ -101,6 +117,107 @@ namespace CPN {
             return *this;
         }
 
+        /** \brief Run the nodes of this kernel as fibers on a fixed
+         * pool of worker threads instead of giving each node its own
+         * thread. A node blocked on a queue, the context or a
+         * FiberMutex gives up its worker to another node. A node
+         * blocked on anything else (I/O, sleep, its own locks) holds its
+         * worker while blocked unless it marks the call with a
+         * FiberBlockingCall, which has another worker step in.
+         * \param enable true to use fibers (default false)
+         * \return this
+         */
+        KernelAttr &UseFibers(bool enable) {
+            usefibers = enable;
+            return *this;
+        }
+
+        /** \param num number of worker threads for the fibers,
+         * 0 (the default) for one per processor
+         * \return this
+         */
+        KernelAttr &SetFiberWorkers(unsigned num) {
+            fiberworkers = num;
+            return *this;
+        }
+
+        /** \param size the stack size for each fiber in bytes
+         * \return this
+         */
+        KernelAttr &SetFiberStackSize(unsigned size) {
+            fiberstacksize = size;
+            return *this;
+        }
+
+        /** \brief Keep the thread of a node which has ended parked for
+         * this long so a new node can run on it instead of creating a
+         * thread. Nodes which ask for their own placement, scheduling
+         * or stack size (see NodeAttr) always get a new thread.
+         * \param seconds how long an idle thread waits for a new
+         * node, 0 (the default) to give every node a new thread
+         * \return this
+         */
+        KernelAttr &SetNodeThreadIdleTime(double seconds) {
+            nodethreadidle = seconds;
+            return *this;
+        }
+
+        /** \brief Record an event trace of the nodes and queues and
+         * write it to the given file in the Chrome trace event format
+         * when the kernel is done. Only works when the library is built
+         * with CPN_TRACE defined, see Trace.h.
+         * \param filename the file to write, empty for no trace
+         * \return this
+         */
+        KernelAttr &SetTraceFile(const std::string &filename) {
+            tracefile = filename;
+            return *this;
+        }
+
+        /** \brief Write the NodeStats of every node, as each ends,
+         * to the given file as JSON when the kernel is done. The
+         * cpnanalyze tool reads this file.
+         * \param filename the file to write, empty for none
+         * \return this
+         */
+        KernelAttr &SetStatsFile(const std::string &filename) {
+            statsfile = filename;
+            return *this;
+        }
+
+        /** \brief Serve snapshots of the stats of the nodes and queues
+         * as JSON on a TCP socket while the kernel runs, see StatsServer.
+         * \param hostname the host to listen on, empty for any
+         * \param servname the port to listen on, empty for none
+         * \return this
+         */
+        KernelAttr &SetStatsAddress(const std::string &hostname, const std::string &servname) {
+            statshost = hostname;
+            statsserv = servname;
+            return *this;
+        }
+
+        /** \brief Serve the stats on a unix socket instead, see
+         * SetStatsAddress.
+         * \param path the path of the socket, empty for none
+         * \return this
+         */
+        KernelAttr &SetStatsSocket(const std::string &path) {
+            statssocket = path;
+            return *this;
+        }
+
+        /** \brief Decide how the queues of this kernel grow in an
+         * artificial deadlock, see GrowPolicy. Without one the context
+         * decides with Context::CalculateGrowSize.
+         * \param policy the policy
+         * \return this
+         */
+        KernelAttr &SetGrowPolicy(shared_ptr<GrowPolicy> policy) {
+            growpolicy = policy;
+            return *this;
+        }
+
         KernelAttr &AddSharedLib(const std::string &lib) {
             sharedlibs.push_back(lib);
             return *this;
@@ -117,6 +234,8 @@ namespace CPN {
 
         const std::string &GetServName() const { return servname; }
 
+        const std::vector<std::string> &GetListenAddresses() const { return listenaddrs; }
+
         shared_ptr<Context> GetContext() const { return context; }
 
         bool GetRemoteEnabled() const { return remote_enabled; }
@@ -127,6 +246,26 @@ namespace CPN {
 
         bool GrowQueueMaxThreshold() const { return growmaxthresh; }
 
+        bool UseFibers() const { return usefibers; }
+
+        unsigned GetFiberWorkers() const { return fiberworkers; }
+
+        unsigned GetFiberStackSize() const { return fiberstacksize; }
+
+        double GetNodeThreadIdleTime() const { return nodethreadidle; }
+
+        const std::string &GetTraceFile() const { return tracefile; }
+
+        const std::string &GetStatsFile() const { return statsfile; }
+
+        const std::string &GetStatsHostName() const { return statshost; }
+
+        const std::string &GetStatsServName() const { return statsserv; }
+
+        const std::string &GetStatsSocket() const { return statssocket; }
+
+        shared_ptr<GrowPolicy> GetGrowPolicy() const { return growpolicy; }
+
         const std::vector<std::string> &GetSharedLibs() const { return sharedlibs; }
 
         const std::vector<std::string> &GetNodeLists() const { return nodelists; }
@@ -134,11 +273,22 @@ namespace CPN {
         std::string name;
         std::string hostname;
         std::string servname;
+        std::vector<std::string> listenaddrs;
         shared_ptr<Context> context;
         bool remote_enabled;
         bool useD4R;
         bool swallowbrokenqueue;
         bool growmaxthresh;
+        bool usefibers;
+        unsigned fiberworkers;
+        unsigned fiberstacksize;
+        double nodethreadidle;
+        std::string tracefile;
+        std::string statsfile;
+        std::string statshost;
+        std::string statsserv;
+        std::string statssocket;
+        shared_ptr<GrowPolicy> growpolicy;
         std::vector<std::string> sharedlibs;
         std::vector<std::string> nodelists;
     };
@@ -42,5 +42,8 @@ namespace CPN {
     void KernelBase::NotifyTerminate() {
         ASSERT(false, "Unexpected message");
     }
+    shared_ptr<GrowPolicy> KernelBase::GetGrowPolicy() {
+        return shared_ptr<GrowPolicy>();
+    }
 }
 
@@ -50,7 +50,9 @@ namespace CPN {
         virtual bool UseD4R() = 0;
         virtual bool GrowQueueMaxThreshold() = 0;
         virtual bool SwallowBrokenQueueExceptions() = 0;
-        virtual unsigned CalculateGrowSize(unsigned currentsize, unsigned request) = 0;
+        virtual QueueSize_t CalculateGrowSize(QueueSize_t currentsize, QueueSize_t request) = 0;
+        /** \return the grow policy for the queues or null to use CalculateGrowSize */
+        virtual shared_ptr<GrowPolicy> GetGrowPolicy();
     };
 }
 
@@ -28,36 +28,50 @@
 #include "ThrowingAssert.h"
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 namespace CPN {
 
     LocalContext::LocalContext()
-        : loglevel(Logger::WARNING), numlivenodes(0), shutdown(false), counter(0)
+        : loglevel(Logger::WARNING), numlivenodes(0), shutdown(0), counter(0)
     {}
 
+    LocalContext::LocalContext(shared_ptr<LoggerOutput> out)
+        : loglevel(Logger::WARNING), logout(out), numlivenodes(0), shutdown(0), counter(0)
+    {
+        ASSERT(logout);
+        logout->LogLevel(loglevel);
+    }
+
     LocalContext::~LocalContext() {
     }
 
     void LocalContext::Log(int level, const std::string &msg) {
-        PthreadMutexProtected pl(lock);
+        if (logout) {
+            // Do not serialize every node on the context lock
+            logout->Log(level, msg);
+            return;
+        }
+        PthreadMutexProtected pl(loglock);
         if (level >= loglevel) {
             std::cerr << level << ":" << msg << std::endl;
         }
     }
 
     int LocalContext::LogLevel() const {
-        PthreadMutexProtected pl(lock);
+        PthreadMutexProtected pl(loglock);
         return loglevel;
     }
 
     int LocalContext::LogLevel(int level) {
-        PthreadMutexProtected pl(lock);
+        PthreadMutexProtected pl(loglock);
+        if (logout) { logout->LogLevel(level); }
         return loglevel = level;
     }
 
     Key_t LocalContext::SetupKernel(const std::string &name, const std::string &hostname,
             const std::string &servname, KernelBase *kernel) {
-        PthreadMutexProtected pl(lock);
+        PthreadMutexProtected pl(kernellock);
         InternalCheckTerminated();
         if (!kernel) { throw std::invalid_argument("Must have non null Kernel."); }
         if (kernelnames.find(name) != kernelnames.end()) {
@@ -78,7 +92,7 @@ namespace CPN {
     }
 
     Key_t LocalContext::SetupKernel(const std::string &name, KernelBase *kernel) {
-        PthreadMutexProtected pl(lock);
+        PthreadMutexProtected pl(kernellock);
         InternalCheckTerminated();
         if (!kernel) { throw std::invalid_argument("Must have non null Kernel."); }
         if (kernelnames.find(name) != kernelnames.end()) {
@@ -98,8 +112,8 @@ namespace CPN {
     }
 
     Key_t LocalContext::GetKernelKey(const std::string &kernel) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
+        PthreadMutexProtected pl(kernellock);
         NameMap::iterator entry = kernelnames.find(kernel);
         if (entry == kernelnames.end()) {
             throw std::invalid_argument("No such kernel");
@@ -108,137 +122,97 @@ namespace CPN {
     }
 
     std::string LocalContext::GetKernelName(Key_t kernelkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        KernelMap::iterator entry = kernelmap.find(kernelkey);
-        if (entry == kernelmap.end()) {
-            throw std::invalid_argument("No such kernel");
-        }
-        return entry->second->name;
+        return FindKernel(kernelkey)->name;
     }
 
     void LocalContext::GetKernelConnectionInfo(Key_t kernelkey, std::string &hostname, std::string &servname) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        KernelMap::iterator entry = kernelmap.find(kernelkey);
-        if (entry == kernelmap.end()) {
-            throw std::invalid_argument("No such kernel");
-        }
-        ASSERT(entry->second->allowremote, "Kernel does not have remote configured.");
-        hostname = entry->second->hostname;
-        servname = entry->second->servname;
+        shared_ptr<KernelInfo> hinfo = FindKernel(kernelkey);
+        ASSERT(hinfo->allowremote, "Kernel does not have remote configured.");
+        hostname = hinfo->hostname;
+        servname = hinfo->servname;
     }
 
     void LocalContext::SignalKernelEnd(Key_t kernelkey) {
-        PthreadMutexProtected pl(lock);
-        KernelMap::iterator entry = kernelmap.find(kernelkey);
-        if (entry == kernelmap.end()) {
-            throw std::invalid_argument("No such kernel");
-        }
-        entry->second->dead = true;
-        kernellivedead.Broadcast();
+        shared_ptr<KernelInfo> hinfo = FindKernel(kernelkey);
+        AutoFiberLock pl(statelock);
+        hinfo->dead = true;
     }
 
     Key_t LocalContext::WaitForKernelStart(const std::string &kernel) {
-        PthreadMutexProtected pl(lock);
+        AutoFiberLock pl(statelock);
         InternalCheckTerminated();
         while (true) {
-            NameMap::iterator entry = kernelnames.find(kernel);
-            if (entry != kernelnames.end()) {
-                KernelMap::iterator hentry = kernelmap.find(entry->second);
-                if (hentry->second->live) {
-                    return entry->second;
-                }
+            NameMap::iterator entry = livekernels.find(kernel);
+            if (entry != livekernels.end()) {
+                return entry->second;
             }
-            kernellivedead.Wait(lock);
+            Wait(kernelwaiters, kernel);
             InternalCheckTerminated();
         }
     }
 
     void LocalContext::SignalKernelStart(Key_t kernelkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        KernelMap::iterator entry = kernelmap.find(kernelkey);
-        if (entry == kernelmap.end()) {
-            throw std::invalid_argument("No such kernel");
-        }
-        entry->second->live = true;
-        kernellivedead.Broadcast();
+        shared_ptr<KernelInfo> hinfo = FindKernel(kernelkey);
+        AutoFiberLock pl(statelock);
+        hinfo->live = true;
+        livekernels.insert(std::make_pair(hinfo->name, kernelkey));
+        Wake(kernelwaiters, hinfo->name);
     }
 
     void LocalContext::SendCreateWriter(Key_t kernelkey, const SimpleQueueAttr &attr) {
-        KernelBase *kernel;
-        {
-            PthreadMutexProtected pl(lock);
-            InternalCheckTerminated();
-            shared_ptr<KernelInfo> hinfo = kernelmap[kernelkey];
-            kernel = hinfo->kernel;
-        }
-        ASSERT(kernel);
-        kernel->RemoteCreateWriter(attr);
+        GetKernel(kernelkey)->RemoteCreateWriter(attr);
     }
 
     void LocalContext::SendCreateReader(Key_t kernelkey, const SimpleQueueAttr &attr) {
-        KernelBase *kernel;
-        {
-            PthreadMutexProtected pl(lock);
-            InternalCheckTerminated();
-            shared_ptr<KernelInfo> hinfo = kernelmap[kernelkey];
-            kernel = hinfo->kernel;
-        }
-        ASSERT(kernel);
-        kernel->RemoteCreateReader(attr);
+        GetKernel(kernelkey)->RemoteCreateReader(attr);
     }
 
     void LocalContext::SendCreateQueue(Key_t kernelkey, const SimpleQueueAttr &attr) {
-        KernelBase *kernel;
-        {
-            PthreadMutexProtected pl(lock);
-            InternalCheckTerminated();
-            shared_ptr<KernelInfo> hinfo = kernelmap[kernelkey];
-            kernel = hinfo->kernel;
-        }
-        ASSERT(kernel);
-        kernel->RemoteCreateQueue(attr);
+        GetKernel(kernelkey)->RemoteCreateQueue(attr);
     }
 
     void LocalContext::SendCreateNode(Key_t kernelkey, const NodeAttr &attr) {
-        KernelBase *kernel;
-        {
-            PthreadMutexProtected pl(lock);
-            InternalCheckTerminated();
-            shared_ptr<KernelInfo> hinfo = kernelmap[kernelkey];
-            kernel = hinfo->kernel;
-        }
-        ASSERT(kernel);
-        kernel->RemoteCreateNode(attr);
+        GetKernel(kernelkey)->RemoteCreateNode(attr);
     }
 
     Key_t LocalContext::CreateNodeKey(Key_t kernelkey, const std::string &nodename) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        NameMap::iterator nameentry = nodenames.find(nodename);
-        Key_t key;
-        if (nameentry == nodenames.end()) {
-            shared_ptr<NodeInfo> ninfo = shared_ptr<NodeInfo>(new NodeInfo);
-            ninfo->name = nodename;
-            ninfo->started = false;
-            ninfo->dead = false;
-            ninfo->kernelkey = kernelkey;
-            key = NewKey();
-            nodenames.insert(std::make_pair(nodename, key));
-            nodemap.insert(std::make_pair(key, ninfo));
-        } else {
+        shared_ptr<NodeInfo> ninfo = shared_ptr<NodeInfo>(new NodeInfo);
+        ninfo->name = nodename;
+        ninfo->key = NewKey();
+        ninfo->started = false;
+        ninfo->dead = false;
+        ninfo->kernelkey = kernelkey;
+        // Publish by key first, nobody can look the key up until the
+        // name is published
+        NodeShard &keyshard = KeyShard(ninfo->key);
+        {
+            PthreadMutexProtected pl(keyshard.lock);
+            keyshard.nodes.insert(std::make_pair(ninfo->key, ninfo));
+        }
+        bool inserted;
+        {
+            NodeShard &nameshard = NameShard(nodename);
+            PthreadMutexProtected pl(nameshard.lock);
+            inserted = nameshard.names.insert(std::make_pair(nodename, ninfo->key)).second;
+        }
+        if (!inserted) {
+            PthreadMutexProtected pl(keyshard.lock);
+            keyshard.nodes.erase(ninfo->key);
             throw std::invalid_argument("Node " + nodename + " already exists.");
         }
-        return key;
+        return ninfo->key;
     }
 
     Key_t LocalContext::GetNodeKey(const std::string &nodename) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        NameMap::iterator nameentry = nodenames.find(nodename);
-        if (nameentry == nodenames.end()) {
+        NodeShard &shard = NameShard(nodename);
+        PthreadMutexProtected pl(shard.lock);
+        NameMap::iterator nameentry = shard.names.find(nodename);
+        if (nameentry == shard.names.end()) {
             throw std::invalid_argument("No such node");
         } else {
             return nameentry->second;
@@ -246,121 +220,89 @@ namespace CPN {
     }
 
     std::string LocalContext::GetNodeName(Key_t nodekey) {
-        PthreadMutexProtected pl(lock);
-        NodeMap::iterator entry = nodemap.find(nodekey);
-        if (entry == nodemap.end()) {
-            throw std::invalid_argument("No such node");
-        }
-        return entry->second->name;
+        return FindNode(nodekey)->name;
     }
 
     void LocalContext::SignalNodeStart(Key_t nodekey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        NodeMap::iterator entry = nodemap.find(nodekey);
-        if (entry == nodemap.end()) {
-            throw std::invalid_argument("No such node");
-        } else {
-            entry->second->started = true;
-            ++numlivenodes;
-            nodelivedead.Broadcast();
-        }
+        shared_ptr<NodeInfo> ninfo = FindNode(nodekey);
+        AutoFiberLock pl(statelock);
+        ninfo->started = true;
+        startednodes.insert(std::make_pair(ninfo->name, ninfo));
+        ++numlivenodes;
+        Wake(nodewaiters, ninfo->name);
     }
 
     void LocalContext::SignalNodeEnd(Key_t nodekey) {
-        PthreadMutexProtected pl(lock);
-        NodeMap::iterator entry = nodemap.find(nodekey);
-        if (entry == nodemap.end()) {
-            throw std::invalid_argument("No such node");
-        } else {
-            entry->second->dead = true;
-            --numlivenodes;
-            nodelivedead.Broadcast();
+        shared_ptr<NodeInfo> ninfo = FindNode(nodekey);
+        AutoFiberLock pl(statelock);
+        ninfo->dead = true;
+        --numlivenodes;
+        Wake(nodewaiters, ninfo->name);
+        if (numlivenodes == 0) {
+            allnodesend.Broadcast();
         }
     }
 
     Key_t LocalContext::WaitForNodeStart(const std::string &nodename) {
-        PthreadMutexProtected pl(lock);
+        AutoFiberLock pl(statelock);
         InternalCheckTerminated();
         while (true) {
-            NameMap::iterator nameentry = nodenames.find(nodename);
-            if (nameentry != nodenames.end()) {
-                NodeMap::iterator entry = nodemap.find(nameentry->second);
-                if (entry != nodemap.end()) {
-                    if (entry->second->started) {
-                        return entry->first;
-                    }
-                }
+            NodeNameMap::iterator entry = startednodes.find(nodename);
+            if (entry != startednodes.end()) {
+                return entry->second->key;
             }
-            nodelivedead.Wait(lock);
+            Wait(nodewaiters, nodename);
             InternalCheckTerminated();
         }
     }
 
     void LocalContext::WaitForNodeEnd(const std::string &nodename) {
-        PthreadMutexProtected pl(lock);
-        while (!shutdown) {
-            NameMap::iterator nameentry = nodenames.find(nodename);
-            if (nameentry != nodenames.end()) {
-                NodeMap::iterator entry = nodemap.find(nameentry->second);
-                if (entry != nodemap.end()) {
-                    if (entry->second->dead) {
-                        ASSERT(entry->second->started, "Node died before it started!?");
-                        return;
-                    }
-                }
+        AutoFiberLock pl(statelock);
+        while (!shutdown.Get()) {
+            NodeNameMap::iterator entry = startednodes.find(nodename);
+            if (entry != startednodes.end() && entry->second->dead) {
+                ASSERT(entry->second->started, "Node died before it started!?");
+                return;
             }
-            nodelivedead.Wait(lock);
+            Wait(nodewaiters, nodename);
         }
     }
 
     void LocalContext::WaitForAllNodeEnd() {
-        PthreadMutexProtected pl(lock);
-        while (numlivenodes > 0 && !shutdown) {
-            nodelivedead.Wait(lock);
+        AutoFiberLock pl(statelock);
+        while (numlivenodes > 0 && !shutdown.Get()) {
+            allnodesend.Wait(statelock);
         }
     }
 
+    bool LocalContext::SetReplicas(const NodeAttr &attr) {
+        InternalCheckTerminated();
+        AutoFiberLock pl(statelock);
+        return replicas.insert(std::make_pair(attr.GetName(), attr)).second;
+    }
+
+    bool LocalContext::GetReplicas(const std::string &nodename, NodeAttr &attr) {
+        InternalCheckTerminated();
+        AutoFiberLock pl(statelock);
+        std::map<std::string, NodeAttr>::iterator entry = replicas.find(nodename);
+        if (entry == replicas.end()) { return false; }
+        attr = entry->second;
+        return true;
+    }
+
     Key_t LocalContext::GetNodeKernel(Key_t nodekey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        NodeMap::iterator entry = nodemap.find(nodekey);
-        if (entry == nodemap.end()) {
-            throw std::invalid_argument("No such node");
-        }
-        return entry->second->kernelkey;
+        return FindNode(nodekey)->kernelkey;
     }
 
     Key_t LocalContext::GetCreateReaderKey(Key_t nodekey, const std::string &portname) {
-        PthreadMutexProtected pl(lock);
-        InternalCheckTerminated();
-        NodeMap::iterator entry = nodemap.find(nodekey);
-        if (entry == nodemap.end()) {
-            throw std::invalid_argument("No such node");
-        }
-        NameMap::iterator portentry = entry->second->readers.find(portname);
-        if (portentry == entry->second->readers.end()) {
-            Key_t key = NewKey();
-            entry->second->readers.insert(std::make_pair(portname, key));
-            shared_ptr<PortInfo> pinfo = shared_ptr<PortInfo>(new PortInfo);
-            pinfo->name = portname;
-            pinfo->nodekey = nodekey;
-            pinfo->opposingport = 0;
-            pinfo->dead = false;
-            readports.insert(std::make_pair(key, pinfo));
-            return key;
-        } else {
-            return portentry->second;
-        }
+        return GetCreatePortKey(nodekey, portname, true);
     }
+
     Key_t LocalContext::GetReaderNode(Key_t portkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        PortMap::iterator entry = readports.find(portkey);
-        if (entry == readports.end()) {
-            throw std::invalid_argument("No such port");
-        }
-        return entry->second->nodekey;
+        return FindPort(portkey, true)->nodekey;
     }
 
     Key_t LocalContext::GetReaderKernel(Key_t portkey) {
@@ -369,45 +311,17 @@ namespace CPN {
     }
 
     std::string LocalContext::GetReaderName(Key_t portkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        PortMap::iterator entry = readports.find(portkey);
-        if (entry == readports.end()) {
-            throw std::invalid_argument("No such port");
-        }
-        return entry->second->name;
+        return FindPort(portkey, true)->name;
     }
 
     Key_t LocalContext::GetCreateWriterKey(Key_t nodekey, const std::string &portname) {
-        PthreadMutexProtected pl(lock);
-        InternalCheckTerminated();
-        NodeMap::iterator entry = nodemap.find(nodekey);
-        if (entry == nodemap.end()) {
-            throw std::invalid_argument("No such node");
-        }
-        NameMap::iterator portentry = entry->second->writers.find(portname);
-        if (portentry == entry->second->writers.end()) {
-            Key_t key = NewKey();
-            entry->second->writers.insert(std::make_pair(portname, key));
-            shared_ptr<PortInfo> pinfo = shared_ptr<PortInfo>(new PortInfo);
-            pinfo->name = portname;
-            pinfo->nodekey = nodekey;
-            pinfo->opposingport = 0;
-            pinfo->dead = false;
-            writeports.insert(std::make_pair(key, pinfo));
-            return key;
-        } else {
-            return portentry->second;
-        }
+        return GetCreatePortKey(nodekey, portname, false);
     }
+
     Key_t LocalContext::GetWriterNode(Key_t portkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        PortMap::iterator entry = writeports.find(portkey);
-        if (entry == writeports.end()) {
-            throw std::invalid_argument("No such port");
-        }
-        return entry->second->nodekey;
+        return FindPort(portkey, false)->nodekey;
     }
 
     Key_t LocalContext::GetWriterKernel(Key_t portkey) {
@@ -416,81 +330,190 @@ namespace CPN {
     }
 
     std::string LocalContext::GetWriterName(Key_t portkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        PortMap::iterator entry = writeports.find(portkey);
-        if (entry == writeports.end()) {
-            throw std::invalid_argument("No such port");
-        }
-        return entry->second->name;
+        return FindPort(portkey, false)->name;
     }
 
     void LocalContext::ConnectEndpoints(Key_t writerkey, Key_t readerkey, const std::string &qname) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        PortMap::iterator writeentry = writeports.find(writerkey);
-        if (writeentry == writeports.end()) {
-            throw std::invalid_argument("Write port does not exist.");
+        PortShard &writeshard = PortShardOf(writerkey);
+        PortShard &readshard = PortShardOf(readerkey);
+        {
+            PthreadMutexProtected pl(writeshard.lock);
+            if (writeshard.writeports.find(writerkey) == writeshard.writeports.end()) {
+                throw std::invalid_argument("Write port does not exist.");
+            }
         }
-        PortMap::iterator readentry = readports.find(readerkey);
-        if (readentry == readports.end()) {
-            throw std::invalid_argument("Read port does not exist.");
+        {
+            PthreadMutexProtected pl(readshard.lock);
+            PortMap::iterator readentry = readshard.readports.find(readerkey);
+            if (readentry == readshard.readports.end()) {
+                throw std::invalid_argument("Read port does not exist.");
+            }
+            readentry->second->opposingport = writerkey;
+            readentry->second->qname = qname;
+        }
+        {
+            PthreadMutexProtected pl(writeshard.lock);
+            shared_ptr<PortInfo> writeinfo = writeshard.writeports[writerkey];
+            writeinfo->opposingport = readerkey;
+            writeinfo->qname = qname;
         }
-
-        writeentry->second->opposingport = readerkey;
-        readentry->second->opposingport = writerkey;
-
-        readentry->second->qname = qname;
-        writeentry->second->qname = qname;
     }
 
     Key_t LocalContext::GetReadersWriter(Key_t readerkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        PortMap::iterator readentry = readports.find(readerkey);
-        if (readentry == readports.end()) {
+        PortShard &shard = PortShardOf(readerkey);
+        PthreadMutexProtected pl(shard.lock);
+        PortMap::iterator readentry = shard.readports.find(readerkey);
+        if (readentry == shard.readports.end()) {
             throw std::invalid_argument("Read port does not exist.");
         }
         return readentry->second->opposingport;
     }
 
     Key_t LocalContext::GetWritersReader(Key_t writerkey) {
-        PthreadMutexProtected pl(lock);
         InternalCheckTerminated();
-        PortMap::iterator writeentry = writeports.find(writerkey);
-        if (writeentry == writeports.end()) {
+        PortShard &shard = PortShardOf(writerkey);
+        PthreadMutexProtected pl(shard.lock);
+        PortMap::iterator writeentry = shard.writeports.find(writerkey);
+        if (writeentry == shard.writeports.end()) {
             throw std::invalid_argument("Write port does not exist.");
         }
         return writeentry->second->opposingport;
     }
 
     void LocalContext::Terminate() {
+        shutdown.Set(1);
         KernelMap mapcopy;
         {
-            PthreadMutexProtected pl(lock);
-            shutdown = true;
-            nodelivedead.Broadcast();
-            kernellivedead.Broadcast();
+            PthreadMutexProtected pl(kernellock);
             mapcopy = kernelmap;
         }
-        KernelMap::iterator itr = mapcopy.begin();
-        while (itr != mapcopy.end()) {
-            if (!itr->second->dead) {
-                itr->second->kernel->NotifyTerminate();
+        std::vector<KernelBase*> live;
+        {
+            AutoFiberLock pl(statelock);
+            for (WaitersMap::iterator itr = kernelwaiters.begin(); itr != kernelwaiters.end(); ++itr) {
+                itr->second->cond.Broadcast();
+            }
+            for (WaitersMap::iterator itr = nodewaiters.begin(); itr != nodewaiters.end(); ++itr) {
+                itr->second->cond.Broadcast();
+            }
+            allnodesend.Broadcast();
+            for (KernelMap::iterator itr = mapcopy.begin(); itr != mapcopy.end(); ++itr) {
+                if (!itr->second->dead) {
+                    live.push_back(itr->second->kernel);
+                }
             }
-            ++itr;
         }
-}
+        for (std::vector<KernelBase*>::iterator itr = live.begin(); itr != live.end(); ++itr) {
+            (*itr)->NotifyTerminate();
+        }
+    }
 
     bool LocalContext::IsTerminated() {
-        PthreadMutexProtected pl(lock);
-        return shutdown;
+        return shutdown.Load() != 0;
     }
 
     void LocalContext::InternalCheckTerminated() {
-        if (shutdown) {
+        // A plain load so the lookups do not all write one cache line
+        if (shutdown.Load()) {
             throw ShutdownException();
         }
     }
-}
 
+    LocalContext::NodeShard &LocalContext::NameShard(const std::string &nodename) {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (std::string::const_iterator itr = nodename.begin(); itr != nodename.end(); ++itr) {
+            hash = (hash ^ uint8_t(*itr))*16777619u;
+        }
+        return nodeshards[hash % NUM_SHARDS];
+    }
+
+    shared_ptr<LocalContext::KernelInfo> LocalContext::FindKernel(Key_t kernelkey) {
+        PthreadMutexProtected pl(kernellock);
+        KernelMap::iterator entry = kernelmap.find(kernelkey);
+        if (entry == kernelmap.end()) {
+            throw std::invalid_argument("No such kernel");
+        }
+        return entry->second;
+    }
+
+    KernelBase *LocalContext::GetKernel(Key_t kernelkey) {
+        InternalCheckTerminated();
+        KernelBase *kernel = FindKernel(kernelkey)->kernel;
+        ASSERT(kernel);
+        return kernel;
+    }
+
+    shared_ptr<LocalContext::NodeInfo> LocalContext::FindNode(Key_t nodekey) {
+        NodeShard &shard = KeyShard(nodekey);
+        PthreadMutexProtected pl(shard.lock);
+        NodeMap::iterator entry = shard.nodes.find(nodekey);
+        if (entry == shard.nodes.end()) {
+            throw std::invalid_argument("No such node");
+        }
+        return entry->second;
+    }
+
+    shared_ptr<LocalContext::PortInfo> LocalContext::FindPort(Key_t portkey, bool reader) {
+        PortShard &shard = PortShardOf(portkey);
+        PthreadMutexProtected pl(shard.lock);
+        PortMap &ports = (reader ? shard.readports : shard.writeports);
+        PortMap::iterator entry = ports.find(portkey);
+        if (entry == ports.end()) {
+            throw std::invalid_argument("No such port");
+        }
+        return entry->second;
+    }
+
+    Key_t LocalContext::GetCreatePortKey(Key_t nodekey, const std::string &portname, bool reader) {
+        InternalCheckTerminated();
+        NodeShard &shard = KeyShard(nodekey);
+        PthreadMutexProtected pl(shard.lock);
+        NodeMap::iterator entry = shard.nodes.find(nodekey);
+        if (entry == shard.nodes.end()) {
+            throw std::invalid_argument("No such node");
+        }
+        NameMap &ports = (reader ? entry->second->readers : entry->second->writers);
+        NameMap::iterator portentry = ports.find(portname);
+        if (portentry != ports.end()) {
+            return portentry->second;
+        }
+        Key_t key = NewKey();
+        shared_ptr<PortInfo> pinfo = shared_ptr<PortInfo>(new PortInfo);
+        pinfo->name = portname;
+        pinfo->nodekey = nodekey;
+        pinfo->opposingport = 0;
+        pinfo->dead = false;
+        {
+            PortShard &portshard = PortShardOf(key);
+            PthreadMutexProtected ppl(portshard.lock);
+            (reader ? portshard.readports : portshard.writeports).insert(std::make_pair(key, pinfo));
+        }
+        ports.insert(std::make_pair(portname, key));
+        return key;
+    }
+
+    void LocalContext::Wait(WaitersMap &waiters, const std::string &name) {
+        shared_ptr<Waiters> &entry = waiters[name];
+        if (!entry) { entry.reset(new Waiters); }
+        shared_ptr<Waiters> w = entry;
+        ++w->count;
+        w->cond.Wait(statelock);
+        if (--w->count == 0) {
+            WaitersMap::iterator itr = waiters.find(name);
+            if (itr != waiters.end() && itr->second == w) {
+                waiters.erase(itr);
+            }
+        }
+    }
+
+    void LocalContext::Wake(WaitersMap &waiters, const std::string &name) {
+        WaitersMap::iterator entry = waiters.find(name);
+        if (entry != waiters.end()) {
+            entry->second->cond.Broadcast();
+        }
+    }
+}
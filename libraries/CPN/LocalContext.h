@@ -31,12 +31,24 @@
 #include "Context.h"
 #include "PthreadMutex.h"
 #include "PthreadCondition.h"
+#include "FiberScheduler.h"
+#include "Atomic.h"
 #include <string>
 #include <map>
 
 namespace CPN {
 
     /** \brief A local implementation of the Context interface
+     *
+     * The kernels, nodes and ports are kept in separate tables, the
+     * nodes and ports spread over shards with a lock each so that
+     * lookups from different nodes seldom wait on each other. What
+     * never changes after an entry is created is read without a lock.
+     * The start and end of kernels and nodes are kept under their own
+     * lock and only wake the threads waiting for that kernel or node.
+     *
+     * Locks are taken in the order kernel or node shard, port shard,
+     * state lock and never more than one shard of a table at a time.
      */
     class CPN_LOCAL LocalContext : public Context {
     public:
@@ -48,7 +60,9 @@ namespace CPN {
             std::string hostname;
             std::string servname;
             KernelBase *kernel;
+            /// Guarded by statelock
             bool live;
+            /// Guarded by statelock
             bool dead;
             bool allowremote;
         };
@@ -56,18 +70,25 @@ namespace CPN {
         /** Struct to hold the node information */
         struct NodeInfo {
             std::string name;
+            Key_t key;
             Key_t kernelkey;
+            /// Guarded by statelock
             bool started;
+            /// Guarded by the lock of the shard of the node
             NameMap readers;
+            /// Guarded by the lock of the shard of the node
             NameMap writers;
+            /// Guarded by statelock
             bool dead;
         };
 
         /** Struct to hold the endpoint information */
         struct PortInfo {
             std::string name;
+            /// Guarded by the lock of the shard of the port
             std::string qname;
             Key_t nodekey;
+            /// Guarded by the lock of the shard of the port
             Key_t opposingport;
             bool dead;
         };
@@ -77,6 +98,11 @@ namespace CPN {
         typedef std::map< Key_t, shared_ptr<PortInfo> > PortMap;
 
         LocalContext();
+        /**
+         * \param out where the log messages go instead of stderr,
+         * it keeps its own log level in step with the context
+         */
+        LocalContext(shared_ptr<LoggerOutput> out);
         virtual ~LocalContext();
 
         virtual void Log(int level, const std::string &msg);
@@ -108,6 +134,9 @@ namespace CPN {
         virtual void WaitForNodeEnd(const std::string &nodename);
         virtual void WaitForAllNodeEnd();
 
+        virtual bool SetReplicas(const NodeAttr &attr);
+        virtual bool GetReplicas(const std::string &nodename, NodeAttr &attr);
+
         virtual Key_t GetCreateReaderKey(Key_t nodekey, const std::string &portname);
         virtual Key_t GetReaderNode(Key_t portkey);
         virtual Key_t GetReaderKernel(Key_t portkey);
@@ -125,24 +154,76 @@ namespace CPN {
         virtual void Terminate();
         virtual bool IsTerminated();
     private:
+        enum { NUM_SHARDS = 16 };
+
+        struct NodeShard {
+            PthreadMutex lock;
+            /// The nodes whose name hashes to this shard
+            NameMap names;
+            /// The nodes whose key is in this shard
+            NodeMap nodes;
+        };
+
+        struct PortShard {
+            PthreadMutex lock;
+            PortMap readports;
+            PortMap writeports;
+        };
+
+        /** The threads waiting for one kernel or node. */
+        struct Waiters {
+            Waiters() : count(0) {}
+            FiberCondition<PthreadCondition> cond;
+            unsigned count;
+        };
+        typedef std::map< std::string, shared_ptr<Waiters> > WaitersMap;
+        typedef std::map< std::string, shared_ptr<NodeInfo> > NodeNameMap;
 
         void InternalCheckTerminated();
 
+        NodeShard &NameShard(const std::string &nodename);
+        NodeShard &KeyShard(Key_t nodekey) { return nodeshards[nodekey % NUM_SHARDS]; }
+        PortShard &PortShardOf(Key_t portkey) { return portshards[portkey % NUM_SHARDS]; }
+        shared_ptr<KernelInfo> FindKernel(Key_t kernelkey);
+        shared_ptr<NodeInfo> FindNode(Key_t nodekey);
+        shared_ptr<PortInfo> FindPort(Key_t portkey, bool reader);
+        Key_t GetCreatePortKey(Key_t nodekey, const std::string &portname, bool reader);
+        KernelBase *GetKernel(Key_t kernelkey);
+
+        /** Wait on the waiters for name, statelock must be held. */
+        void Wait(WaitersMap &waiters, const std::string &name);
+        /** Wake the waiters for name, statelock must be held. */
+        void Wake(WaitersMap &waiters, const std::string &name);
+
         int loglevel;
-        mutable PthreadMutex lock;
-        PthreadCondition nodelivedead;
-        PthreadCondition kernellivedead;
+        /// Set only by the constructor so Log needs no lock to use it
+        const shared_ptr<LoggerOutput> logout;
+        mutable PthreadMutex loglock;
+
+        PthreadMutex kernellock;
         NameMap kernelnames;
-        NameMap nodenames;
         KernelMap kernelmap;
-        NodeMap nodemap;
-        PortMap readports;
-        PortMap writeports;
+
+        NodeShard nodeshards[NUM_SHARDS];
+        PortShard portshards[NUM_SHARDS];
+
+        FiberMutex statelock;
+        /// The started kernels by name
+        NameMap livekernels;
+        /// The started nodes by name
+        NodeNameMap startednodes;
+        WaitersMap kernelwaiters;
+        WaitersMap nodewaiters;
+        FiberCondition<PthreadCondition> allnodesend;
         unsigned numlivenodes;
-        bool shutdown;
+        /// The groups of replicas by name, guarded by statelock
+        std::map<std::string, NodeAttr> replicas;
+
+        /// Set once by Terminate, read with Load by the lookups
+        Sync::Atomic<int> shutdown;
 
-        Key_t NewKey() { return ++counter; }
-        Key_t counter;
+        Key_t NewKey() { return counter.Add(1); }
+        Sync::Atomic<Key_t> counter;
     };
 
 }
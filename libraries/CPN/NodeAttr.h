@@ -28,6 +28,7 @@
 #include "CPNCommon.h"
 #include <string>
 #include <map>
+#include <vector>
 #include <sstream>
 
 namespace CPN {
@@ -52,6 +53,18 @@ namespace CPN {
      * The parameters sent to the node.
      * See SetParam and GetParam
      *
+     * Where the node thread runs and allocates memory.
+     * See AddCPU and SetNUMANode
+     *
+     * How the node thread is scheduled and its stack size.
+     * See SetSchedulePolicy, SetPriority and SetStackSize
+     *
+     * Whether the node shares a thread with other nodes.
+     * See SetFusable and SetFusionGroup
+     *
+     * How many copies of a stateless node run in parallel.
+     * See SetReplicas, SetScatterBlock and SetGatherBlock
+     *
      * Note that the key attribute are set by the kernel
      * when the node is to be created and such are overwritten.
      */
@@ -63,6 +76,15 @@ namespace CPN {
             kernelkey(0),
             name(name_),
             nodetype(nodetype_),
+            numanode(-1),
+            schedpolicy(-1),
+            priority(0),
+            stacksize(0),
+            fusable(false),
+            replicas(1),
+            scattersize(0),
+            scatteroverlap(0),
+            gathersize(0),
             key(0)
         {}
 
@@ -99,6 +121,154 @@ namespace CPN {
             return *this;
         }
 
+        /**
+         * \brief Add a processor the node thread may run on. If no
+         * processor is given the node may run anywhere.
+         * Ignored when the kernel runs nodes as fibers.
+         * \param cpu the processor number
+         * \return this
+         */
+        NodeAttr &AddCPU(unsigned cpu) {
+            cpus.push_back(cpu);
+            return *this;
+        }
+
+        NodeAttr &SetCPUs(const std::vector<unsigned> &cpus_) {
+            cpus = cpus_;
+            return *this;
+        }
+
+        /**
+         * \brief Place the node on a NUMA node. The node thread runs on
+         * the processors of the NUMA node (in addition to any given
+         * with AddCPU) and prefers its memory for what it allocates.
+         * Ignored when the kernel runs nodes as fibers.
+         * \param node the NUMA node, -1 for none
+         * \return this
+         */
+        NodeAttr &SetNUMANode(int node) {
+            numanode = node;
+            return *this;
+        }
+
+        /**
+         * \brief Give the node thread its own scheduling policy
+         * instead of inheriting the one of the kernel. Real-time
+         * policies usually need privilege, without it the node falls
+         * back to the inherited policy with a warning.
+         * Ignored when the kernel runs nodes as fibers.
+         * \param policy SCHED_FIFO, SCHED_RR, SCHED_OTHER or -1 to inherit
+         * \return this
+         */
+        NodeAttr &SetSchedulePolicy(int policy) {
+            schedpolicy = policy;
+            return *this;
+        }
+
+        /**
+         * \brief The priority to use with the policy given to
+         * SetSchedulePolicy.
+         * \param prio the priority, see sched_get_priority_min and
+         * sched_get_priority_max for the valid range of the policy
+         * \return this
+         */
+        NodeAttr &SetPriority(int prio) {
+            priority = prio;
+            return *this;
+        }
+
+        /**
+         * \brief The stack size of the node thread.
+         * Ignored when the kernel runs nodes as fibers, see
+         * KernelAttr::SetFiberStackSize.
+         * \param size in bytes, 0 for the default
+         * \return this
+         */
+        NodeAttr &SetStackSize(unsigned long size) {
+            stacksize = size;
+            return *this;
+        }
+
+        /**
+         * \brief Fuse the node with the other fusable nodes of its
+         * fusion group on the same kernel. The nodes of a group run
+         * cooperatively on a single thread: a node that enqueues enough
+         * data for a waiting reader in the group switches to it and the
+         * node runs again when the others block. Meant for chains of
+         * cheap nodes connected by local queues, the data then stays
+         * in one cache. A fused node should only block on its queues,
+         * anything else blocks the whole group.
+         * Has no effect when the kernel runs all nodes as fibers,
+         * ignores the placement, scheduling and stack size attributes.
+         * \param f true to fuse
+         * \return this
+         */
+        NodeAttr &SetFusable(bool f) {
+            fusable = f;
+            return *this;
+        }
+
+        /**
+         * \brief Make the node fusable in the given fusion group
+         * instead of the default one, see SetFusable.
+         * \param group the name of the group
+         * \return this
+         */
+        NodeAttr &SetFusionGroup(const std::string &group) {
+            fusable = true;
+            fusiongroup = group;
+            return *this;
+        }
+
+        /**
+         * \brief Run the given number of copies of the node, each
+         * on its own share of the data. Only meaningful for nodes
+         * which keep no state between blocks.
+         *
+         * The copies are named name.0 to name.N-1. Each input port of
+         * the node is fed by a ForkJoinNode named name.scatter.port
+         * which deals blocks round robin to the copies and each output
+         * port drains into a ForkJoinNode named name.gather.port which
+         * collects the blocks in the same order, so the output is
+         * the one a single node would produce. A node named name
+         * stands for the group and ends when every copy has ended.
+         * The group is recorded in the context, so the queues of the
+         * node may be created through any kernel sharing it. The
+         * ForkJoinNode type must be loadable.
+         * \param num the number of copies, 0 for one per processor
+         * \return this
+         */
+        NodeAttr &SetReplicas(unsigned num) {
+            replicas = num;
+            return *this;
+        }
+
+        /**
+         * \brief Set the block each copy of a replicated node reads
+         * from an input port, see SetReplicas.
+         * \param size the size of a block in bytes
+         * \param overlap the number of bytes at the end of a block
+         * which are repeated at the start of the next one
+         * \return this
+         */
+        NodeAttr &SetScatterBlock(unsigned size, unsigned overlap = 0) {
+            scattersize = size;
+            scatteroverlap = overlap;
+            return *this;
+        }
+
+        /**
+         * \brief Set the block each copy of a replicated node writes
+         * to an output port for each block it reads, see SetReplicas.
+         * \param size the size of a block in bytes, 0 for the scatter
+         * block size less the overlap
+         * \return this
+         */
+        NodeAttr &SetGatherBlock(unsigned size) {
+            gathersize = size;
+            return *this;
+        }
+
         NodeAttr &SetKey(Key_t key_) {
             key = key_;
             return *this;
@@ -113,6 +283,20 @@ namespace CPN {
 
         const std::map<std::string, std::string> &GetParams() const { return params; }
 
+        const std::vector<unsigned> &GetCPUs() const { return cpus; }
+        int GetNUMANode() const { return numanode; }
+        int GetSchedulePolicy() const { return schedpolicy; }
+        int GetPriority() const { return priority; }
+        unsigned long GetStackSize() const { return stacksize; }
+        bool GetFusable() const { return fusable; }
+        const std::string &GetFusionGroup() const { return fusiongroup; }
+        unsigned GetReplicas() const { return replicas; }
+        unsigned GetScatterSize() const { return scattersize; }
+        unsigned GetScatterOverlap() const { return scatteroverlap; }
+        unsigned GetGatherSize() const {
+            return gathersize ? gathersize : scattersize - scatteroverlap;
+        }
+
         Key_t GetKey() const { return key; }
 
     private:
@@ -121,6 +305,17 @@ namespace CPN {
         std::string name;
         std::string nodetype;
         std::map<std::string, std::string> params;
+        std::vector<unsigned> cpus;
+        int numanode;
+        int schedpolicy;
+        int priority;
+        unsigned long stacksize;
+        bool fusable;
+        std::string fusiongroup;
+        unsigned replicas;
+        unsigned scattersize;
+        unsigned scatteroverlap;
+        unsigned gathersize;
         Key_t key;
     };
 }
@@ -29,6 +29,14 @@
 #include "D4RDeadlockException.h"
 #include "ErrnoException.h"
 #include "PthreadFunctional.h"
+#include "FiberScheduler.h"
+#include "ThreadPool.h"
+#include "NUMA.h"
+#include "Clock.h"
+#include "Trace.h"
+#include "AutoLock.h"
+#include <sched.h>
+#include <errno.h>
 
 namespace CPN {
 
@@ -36,9 +44,128 @@ namespace CPN {
     :   PseudoNode(attr.GetName(), attr.GetKey(), ker.GetContext()),
         kernel(ker),
         type(attr.GetTypeName()),
-        params(attr.GetParams())
+        numanode(attr.GetNUMANode()),
+        pooled(false),
+        params(attr.GetParams()),
+        runner(pthread_self()),
+        started(false),
+        finished(false),
+        starttime(0),
+        startcpu(0),
+        walltime(0),
+        cputime(-1)
     {
-        thread.reset(CreatePthreadFunctional(this, &NodeBase::EntryPoint));
+        FiberScheduler *scheduler = ker.GetFiberScheduler();
+        if (!scheduler && attr.GetFusable()) {
+            scheduler = ker.GetFusionScheduler(attr.GetFusionGroup());
+        }
+        if (scheduler) {
+            if (!attr.GetCPUs().empty() || numanode >= 0) {
+                logger.Warn("CPU and NUMA placement is ignored for fibers");
+                numanode = -1;
+            }
+            if (attr.GetSchedulePolicy() >= 0 || attr.GetStackSize() > 0) {
+                logger.Warn("Scheduling and stack size are ignored for fibers");
+            }
+            fiber.reset(CreateFiberFunctional(*scheduler, this, &NodeBase::EntryPoint));
+        } else if (ker.GetNodeThreadPool() && attr.GetCPUs().empty() && numanode < 0
+                && attr.GetSchedulePolicy() < 0 && attr.GetStackSize() == 0) {
+            // Nothing special about the thread, run on a pooled one from Start
+            pooled = true;
+        } else {
+            PthreadAttr pattr;
+            SetPlacement(pattr, attr);
+            SetStack(pattr, attr);
+            if (!SetScheduling(pattr, attr)) {
+                thread.reset(CreatePthreadFunctional(this, &NodeBase::EntryPoint, pattr));
+                return;
+            }
+            try {
+                thread.reset(CreatePthreadFunctional(this, &NodeBase::EntryPoint, pattr));
+            } catch (const ErrnoException &e) {
+                if (e.Error() != EPERM) { throw; }
+                logger.Warn("Not permitted to use scheduling policy %d with priority %d,"
+                        " inheriting the scheduling instead", attr.GetSchedulePolicy(),
+                        attr.GetPriority());
+                PthreadAttr inherit;
+                SetPlacement(inherit, attr);
+                SetStack(inherit, attr);
+                thread.reset(CreatePthreadFunctional(this, &NodeBase::EntryPoint, inherit));
+            }
+        }
+    }
+
+    void NodeBase::SetStack(PthreadAttr &pattr, const NodeAttr &attr) {
+        if (attr.GetStackSize() == 0) { return; }
+#ifdef _POSIX_THREAD_ATTR_STACKSIZE
+        try {
+            pattr.StackSize(attr.GetStackSize());
+        } catch (const ErrnoException &e) {
+            logger.Warn("Unable to set the stack size to %lu: %s", attr.GetStackSize(), e.what());
+        }
+#else
+        logger.Warn("Setting the stack size is not supported on this platform");
+#endif
+    }
+
+    /**
+     * Give pattr the scheduling policy and priority from attr.
+     * \return false if attr does not ask for any
+     */
+    bool NodeBase::SetScheduling(PthreadAttr &pattr, const NodeAttr &attr) {
+        if (attr.GetSchedulePolicy() < 0) { return false; }
+#ifdef _POSIX_THREAD_ATTR_PRIORITY_SCHEDULING
+        try {
+            PthreadScheduleParam param(attr.GetPriority());
+            pattr.ExplicitScheduling();
+            pattr.SchedulePolicy(attr.GetSchedulePolicy());
+            pattr.SetScheduleParam(param);
+        } catch (const ErrnoException &e) {
+            logger.Warn("Invalid scheduling policy %d with priority %d: %s",
+                    attr.GetSchedulePolicy(), attr.GetPriority(), e.what());
+            pattr.InheritScheduling();
+            return false;
+        }
+        return true;
+#else
+        logger.Warn("Scheduling policies are not supported on this platform");
+        return false;
+#endif
+    }
+
+    /**
+     * Restrict the thread to the processors asked for in attr which
+     * this process may use. Leaves pattr alone if none are asked for.
+     */
+    void NodeBase::SetPlacement(PthreadAttr &pattr, const NodeAttr &attr) {
+#ifdef CPU_SETSIZE
+        std::vector<unsigned> cpus = attr.GetCPUs();
+        if (numanode >= 0 && !GetNUMANodeCPUs(numanode, cpus)) {
+            logger.Warn("Unknown NUMA node %d", numanode);
+        }
+        if (cpus.empty()) { return; }
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) { return; }
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        bool any = false;
+        for (std::vector<unsigned>::iterator itr = cpus.begin(); itr != cpus.end(); ++itr) {
+            if (*itr < CPU_SETSIZE && CPU_ISSET(*itr, &allowed)) {
+                CPU_SET(*itr, &mask);
+                any = true;
+            }
+        }
+        if (any) {
+            pattr.SetCPUAffinity(mask);
+        } else {
+            logger.Warn("None of the processors given are available, not setting affinity");
+        }
+#else
+        if (!attr.GetCPUs().empty() || numanode >= 0) {
+            logger.Warn("CPU affinity is not supported on this platform");
+        }
+#endif
     }
 
     NodeBase::~NodeBase() {
@@ -61,15 +188,44 @@ namespace CPN {
     }
 
     void NodeBase::Start() {
-        thread->Start();
+        if (fiber.get()) {
+            fiber->Start();
+        } else if (pooled) {
+            pooledrun = kernel.GetNodeThreadPool()->Execute(this, &NodeBase::EntryPoint);
+        } else {
+            thread->Start();
+        }
     }
 
     void NodeBase::Shutdown() {
-        thread->Join();
+        if (fiber.get()) {
+            fiber->Join();
+        } else if (pooled) {
+            if (pooledrun) { pooledrun->Wait(); }
+        } else {
+            thread->Join();
+        }
         PseudoNode::Shutdown();
     }
 
     void* NodeBase::EntryPoint() {
+        if (numanode >= 0) {
+            try {
+                SetPreferredNUMANode(numanode);
+            } catch (const ErrnoException &e) {
+                logger.Warn("Unable to prefer NUMA node %d: %s", numanode, e.what());
+            }
+        }
+        {
+            AutoLock<PthreadMutex> al(statslock);
+            runner = pthread_self();
+            starttime = MonotonicTime();
+            // A pooled thread has already used some
+            startcpu = fiber.get() ? 0 : ThreadCPUTime();
+            started = true;
+        }
+        CPN_TRACE_NAME_LANE(GetKey(), GetName());
+        CPN_TRACE_BEGIN("run", GetKey(), 0);
         try {
             kernel.GetContext()->SignalNodeStart(GetKey());
             Process();
@@ -84,7 +240,16 @@ namespace CPN {
             Logger logger(kernel.GetContext().get(), Logger::ERROR);
             logger.Name(GetName().c_str());
             logger.Info("DEADLOCK detected at %s\n", GetName().c_str());
+            CPN_TRACE_INSTANT("deadlock", GetKey(), 0, 0);
+        }
+        CPN_TRACE_END("run", GetKey(), 0);
+        {
+            AutoLock<PthreadMutex> al(statslock);
+            walltime = MonotonicTime() - starttime;
+            cputime = CPUTime();
+            finished = true;
         }
+        LogStats();
         kernel.NodeTerminated(GetKey());
         return 0;
     }
@@ -94,10 +259,61 @@ namespace CPN {
         return false;
     }
 
+    int NodeBase::GetNUMANode() const {
+        return numanode;
+    }
+
+    /**
+     * \return the CPU seconds used since the node started, negative
+     * if unknown. Must be called with statslock held.
+     */
+    double NodeBase::CPUTime() {
+        if (fiber.get()) {
+            return fiber->CPUTime();
+        }
+        const double now = (pthread_equal(runner, pthread_self())
+                ? ThreadCPUTime() : ThreadCPUTime(runner));
+        if (now < 0 || startcpu < 0) { return -1; }
+        return now - startcpu;
+    }
+
+    void NodeBase::GetStats(NodeStats &stats) {
+        PseudoNode::GetStats(stats);
+        AutoLock<PthreadMutex> al(statslock);
+        if (finished) {
+            stats.walltime = walltime;
+            stats.cputime = cputime;
+        } else if (started) {
+            stats.walltime = MonotonicTime() - starttime;
+            stats.cputime = CPUTime();
+        }
+    }
+
+    void NodeBase::LogStats() {
+        if (logger.LogLevel() > Logger::INFO) { return; }
+        NodeStats stats;
+        GetStats(stats);
+        logger.Info("wall %.6fs cpu %.6fs blocked read %.6fs write %.6fs"
+                " consumed %llu produced %llu bytes", stats.walltime, stats.cputime,
+                stats.readblocked, stats.writeblocked,
+                (unsigned long long)stats.consumed, (unsigned long long)stats.produced);
+        for (std::vector<EndpointStats>::iterator e = stats.endpoints.begin();
+                e != stats.endpoints.end(); ++e) {
+            logger.Debug("%s %s blocked %.6fs %llu bytes", (e->reader ? "reader" : "writer"),
+                    e->port.c_str(), e->blocked, (unsigned long long)e->bytes);
+        }
+    }
+
     void NodeBase::LogState() {
         PseudoNode::LogState();
-        logger.Error("Thread id: %llu, %s", (unsigned long long)((pthread_t)(*thread.get())),
-                (thread->Done() ? "done" : "running"));
+        if (fiber.get()) {
+            logger.Error("Fiber %p, %s", fiber.get(), (fiber->Done() ? "done" : "running"));
+        } else if (pooled) {
+            logger.Error("Pooled thread, %s", (pooledrun && pooledrun->Done() ? "done" : "running"));
+        } else {
+            logger.Error("Thread id: %llu, %s", (unsigned long long)((pthread_t)(*thread.get())),
+                    (thread->Done() ? "done" : "running"));
+        }
     }
 }
 
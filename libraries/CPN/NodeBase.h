@@ -31,12 +31,17 @@
 #include "NodeFactory.h"
 #include "PseudoNode.h"
 #include "ParseBool.h"
+#include "PthreadMutex.h"
 #include <sstream>
 #include <map>
 #include <string>
 #include <stdexcept>
 
 class Pthread;
+class PthreadAttr;
+namespace Sync {
+    template<typename T> class Future;
+}
 
 namespace CPN {
 
@@ -64,7 +69,10 @@ namespace CPN {
      * \brief The definition common to all nodes in the process network.
      *
      * A node is a thread of execution which lasts the
-     * lifetime of the node object.
+     * lifetime of the node object. The thread is a fiber when the
+     * kernel was told to use fibers (KernelAttr::UseFibers) and may be
+     * a parked thread of an earlier node otherwise
+     * (KernelAttr::SetNodeThreadIdleTime).
      *
      */
     class CPN_API NodeBase : public PseudoNode {
@@ -108,6 +116,12 @@ namespace CPN {
 
         bool IsPurePseudo();
 
+        int GetNUMANode() const;
+
+        /** \brief Adds the wall and CPU time of the node to what
+         * PseudoNode::GetStats reports */
+        void GetStats(NodeStats &stats);
+
         /// For debugging ONLY!
         void LogState();
     protected:
@@ -118,10 +132,30 @@ namespace CPN {
         Kernel &kernel;
     private:
         void* EntryPoint();
+        double CPUTime();
+        void LogStats();
+        void SetPlacement(PthreadAttr &pattr, const NodeAttr &attr);
+        void SetStack(PthreadAttr &pattr, const NodeAttr &attr);
+        bool SetScheduling(PthreadAttr &pattr, const NodeAttr &attr);
 
         const std::string type;
+        int numanode;
         auto_ptr<Pthread> thread;
+        auto_ptr<Fiber> fiber;
+        bool pooled;
+        shared_ptr<Sync::Future<void*> > pooledrun;
         std::map<std::string, std::string> params;
+
+        // statslock protects the fields below, written by the node
+        // thread and read by GetStats
+        PthreadMutex statslock;
+        pthread_t runner;
+        bool started;
+        bool finished;
+        double starttime;
+        double startcpu;
+        double walltime;
+        double cputime;
     };
 
 }
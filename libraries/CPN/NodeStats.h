@@ -0,0 +1,90 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Accounting of what a node has spent its time on.
+ */
+#ifndef CPN_NODESTATS_H
+#define CPN_NODESTATS_H
+#pragma once
+
+#include "CPNCommon.h"
+#include <string>
+#include <vector>
+
+namespace CPN {
+
+    /**
+     * \brief What one endpoint of a node has done.
+     *
+     * The byte counts are summed over all the channels of the queue,
+     * divide by channels for the figures of one channel.
+     */
+    struct CPN_API EndpointStats {
+        EndpointStats() : key(0), queue(0), reader(false), blocked(0), bytes(0),
+            length(0), count(0), channels(1), remote(false), linkbytes(0) {}
+        std::string port;
+        Key_t key;
+        /// The reader key of the queue, the same on both ends of it
+        Key_t queue;
+        bool reader;
+        /// Seconds spent waiting for data (reader) or freespace (writer)
+        double blocked;
+        /// Bytes dequeued (reader) or enqueued (writer)
+        uint64_t bytes;
+        /// The current length of the queue in bytes
+        uint64_t length;
+        /// The bytes currently in the queue
+        uint64_t count;
+        /// The number of channels of the queue
+        unsigned channels;
+        /// Whether the other end of the queue is in another kernel
+        bool remote;
+        /// Bytes sent (writer) or received (reader) over the connection
+        uint64_t linkbytes;
+    };
+
+    /**
+     * \brief A snapshot of what a node has done, see Kernel::GetNodeStats.
+     *
+     * A node with a lot of readblocked is starved on input, one with
+     * a lot of writeblocked is held back by its output and one whose
+     * cputime is close to its walltime is compute bound.
+     */
+    struct CPN_API NodeStats {
+        NodeStats() : key(0), walltime(0), cputime(-1),
+            readblocked(0), writeblocked(0), consumed(0), produced(0) {}
+        std::string name;
+        Key_t key;
+        /// Seconds since the node started
+        double walltime;
+        /// CPU seconds the node has used, negative if unknown
+        double cputime;
+        /// Sum over the readers of EndpointStats::blocked
+        double readblocked;
+        /// Sum over the writers of EndpointStats::blocked
+        double writeblocked;
+        /// Sum over the readers of EndpointStats::bytes
+        uint64_t consumed;
+        /// Sum over the writers of EndpointStats::bytes
+        uint64_t produced;
+        std::vector<EndpointStats> endpoints;
+    };
+}
+#endif
@@ -53,7 +53,7 @@ namespace CPN {
          * \param chan the number of channel to get the array from.
          * \return the array
          */
-        T* GetEnqueuePtr(unsigned thresh, unsigned chan=0) {
+        T* GetEnqueuePtr(QueueSize_t thresh, unsigned chan=0) {
             return (T*) queue->GetRawEnqueuePtr(GetTypeSize<T>() * thresh, chan);
         }
         
@@ -61,7 +61,7 @@ namespace CPN {
          * Add count elements to the queue on all channels.
          * \param count the number of elements
          */
-        void Enqueue(unsigned count) {
+        void Enqueue(QueueSize_t count) {
             queue->Enqueue(GetTypeSize<T>() * count);
         }
 
@@ -70,7 +70,7 @@ namespace CPN {
          * \param data the array
          * \param count the number
          */
-        void Enqueue(const T* data, unsigned count) {
+        void Enqueue(const T* data, QueueSize_t count) {
             queue->RawEnqueue((void*)data, GetTypeSize<T>() * count);
         }
 
@@ -81,7 +81,7 @@ namespace CPN {
          * \param numChans the number of channels
          * \param chanStride the number of elements between channels
          */
-        void Enqueue(const T* data, unsigned count, unsigned numChans, unsigned chanStride) {
+        void Enqueue(const T* data, QueueSize_t count, unsigned numChans, QueueSize_t chanStride) {
             queue->RawEnqueue((void*)data, GetTypeSize<T>() * count,
                     numChans, GetTypeSize<T>() * chanStride);
         }
@@ -89,12 +89,12 @@ namespace CPN {
         /// \return the number of channels
         unsigned NumChannels() const { return queue->NumChannels(); }
         /// \return the maximum threshold in data elements
-        unsigned MaxThreshold() const { return queue->MaxThreshold()/GetTypeSize<T>(); }
-        unsigned QueueLength() const { return queue->QueueLength()/GetTypeSize<T>(); }
+        QueueSize_t MaxThreshold() const { return queue->MaxThreshold()/GetTypeSize<T>(); }
+        QueueSize_t QueueLength() const { return queue->QueueLength()/GetTypeSize<T>(); }
         /// \return the amount of freespace in data elements
-        unsigned Freespace() const { return queue->Freespace()/GetTypeSize<T>(); }
+        QueueSize_t Freespace() const { return queue->Freespace()/GetTypeSize<T>(); }
         /// \return the current channel stride, only call this after a successful call to GetEnqueuePtr.
-        unsigned ChannelStride() const { return queue->ChannelStride()/GetTypeSize<T>(); }
+        QueueSize_t ChannelStride() const { return queue->ChannelStride()/GetTypeSize<T>(); }
         /// \return true if full
         bool Full() const { return queue->Full(); }
         /// \return the endpoint key
@@ -35,30 +35,56 @@ namespace CPN {
     PacketDecoder::~PacketDecoder() {}
 
     void *PacketDecoder::GetDecoderBytes(unsigned &amount) {
-        char *ptr = reinterpret_cast<char*>(&header.header);
-        amount = sizeof(header.header) - numbytes;
+        amount = HeaderLength() - numbytes;
         ASSERT(amount != 0, "Zero decoder bytes");
-        return ptr + numbytes;
+        return buffer + numbytes;
     }
 
     void PacketDecoder::ReleaseDecoderBytes(unsigned amount) {
-        ASSERT(numbytes + amount <= sizeof(header.header));
+        ASSERT(numbytes + amount <= HeaderLength());
         numbytes += amount;
-        if (numbytes == sizeof(header.header)) {
-            if (header.Valid()) {
-                FirePacket(header);
-                numbytes = 0;
-            } else {
-                // If it is not valid, what do we do??
-                // Well, we can search for the header word
-                // wont always work...
-                char *ptr = reinterpret_cast<char*>(&header.header);
-                numbytes -= 1;
-                memmove(ptr, ptr + 1, numbytes);
+        while (numbytes >= PACKET_COMPACT_PREFIXLENGTH) {
+            const bool compact = CompactPrefix(buffer);
+            uint32_t sync;
+            memcpy(&sync, buffer, sizeof(sync));
+            bool valid = compact || sync == PACKET_SYNCWORD;
+            if (valid) {
+                const unsigned length = HeaderLength();
+                if (numbytes < length) { break; }
+                if (compact) {
+                    valid = header.DecodeCompact(buffer, length);
+                } else {
+                    memcpy(&header.header, buffer, sizeof(header.header));
+                    valid = header.Valid();
+                }
+                if (valid) {
+                    Consume(length);
+                    FirePacket(header);
+                    continue;
+                }
             }
+            // If it is not valid, what do we do??
+            // Well, we can search for the header word
+            // wont always work...
+            Consume(1);
         }
     }
 
+    unsigned PacketDecoder::HeaderLength() const {
+        if (numbytes < PACKET_COMPACT_PREFIXLENGTH) {
+            return PACKET_COMPACT_PREFIXLENGTH;
+        } else if (CompactPrefix(buffer)) {
+            return buffer[3];
+        } else {
+            return sizeof(header.header);
+        }
+    }
+
+    void PacketDecoder::Consume(unsigned amount) {
+        numbytes -= amount;
+        memmove(buffer, buffer + amount, numbytes);
+    }
+
     void PacketDecoder::Reset() {
         numbytes = 0;
     }
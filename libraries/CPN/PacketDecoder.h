@@ -36,6 +36,11 @@ namespace CPN {
      * internal state will remove the information.  If the information is not
      * delt with in the event function it will be lost.  This class is ment to
      * be enherited by some other class which implements the event functions.
+     *
+     * Both the full length and the compact header formats are always
+     * accepted. The decoder first asks for the fixed prefix and then for
+     * exactly the rest of the header so it never consumes any of the data
+     * which follows a header.
      */
     class CPN_LOCAL PacketDecoder : public PacketHandler {
     public:
@@ -49,7 +54,11 @@ namespace CPN {
 
     protected:
     private:
+        unsigned HeaderLength() const;
+        void Consume(unsigned amount);
+
         Packet header;
+        uint8_t buffer[PACKET_HEADERLENGTH];
         unsigned numbytes;
     };
 
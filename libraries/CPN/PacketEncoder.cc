@@ -25,22 +25,34 @@
 
 namespace CPN {
 
-    PacketEncoder::PacketEncoder() {}
+    PacketEncoder::PacketEncoder() : compact(false) {}
 
     PacketEncoder::~PacketEncoder() {}
 
-    void PacketEncoder::SendPacket(const Packet &packet) {
+    iovec PacketEncoder::EncodeHeader(const Packet &packet, uint8_t (&buf)[PACKET_HEADERLENGTH]) const {
         iovec iov;
-        iov.iov_base = const_cast<PacketHeader*>(&packet.header);
-        iov.iov_len = sizeof(packet.header);
+        if (compact && packet.Type() != PACKET_ID_READER && packet.Type() != PACKET_ID_WRITER) {
+            iov.iov_base = buf;
+            iov.iov_len = packet.EncodeCompact(buf);
+        } else {
+            // Must use const_cast here because iovec.iov_base isn't const... :(
+            iov.iov_base = const_cast<PacketHeader*>(&packet.header);
+            iov.iov_len = sizeof(packet.header);
+        }
+        return iov;
+    }
+
+    void PacketEncoder::SendPacket(const Packet &packet) {
+        uint8_t buf[PACKET_HEADERLENGTH];
+        iovec iov = EncodeHeader(packet, buf);
         WriteBytes(&iov, 1);
     }
 
     void PacketEncoder::SendPacket(const Packet &packet, void *data) {
         ASSERT(data);
+        uint8_t buf[PACKET_HEADERLENGTH];
         iovec iov[2];
-        iov[0].iov_base = const_cast<PacketHeader*>(&packet.header);
-        iov[0].iov_len = sizeof(packet.header);
+        iov[0] = EncodeHeader(packet, buf);
         iov[1].iov_base = data;
         iov[1].iov_len = packet.DataLength();
         WriteBytes(&iov[0], 2);
@@ -35,19 +35,34 @@
 namespace CPN {
     /** Take the various message types that can be sent over the wire
      * and encode them into byte representation.
+     *
+     * Headers are sent in the full length format until CompactHeaders(true)
+     * is called, which should only be done once the other end has said it
+     * understands the compact format. ID packets are always sent full length
+     * so they can be read by any version.
      */
     class CPN_LOCAL PacketEncoder {
     public:
         PacketEncoder();
         virtual ~PacketEncoder();
 
+        void CompactHeaders(bool enable) { compact = enable; }
+        bool CompactHeaders() const { return compact; }
+
+        /**
+         * Encode the header of packet in the current format.
+         * \param packet the packet
+         * \param buf storage for the encoded header if needed
+         * \return an iovec that refers to the encoded header
+         */
+        iovec EncodeHeader(const Packet &packet, uint8_t (&buf)[PACKET_HEADERLENGTH]) const;
+
         template<typename Queue_t>
         void SendEnqueue(const Packet &packet, Queue_t &queue) {
             ASSERT(packet.Type() == PACKET_ENQUEUE);
             std::vector<iovec> iovs;
-            // Must use const_cast here because iovec.iov_base isn't const... :(
-            iovec header = { const_cast<PacketHeader*>(&packet.header), sizeof(packet.header) };
-            iovs.push_back(header);
+            uint8_t buf[PACKET_HEADERLENGTH];
+            iovs.push_back(EncodeHeader(packet, buf));
             for (unsigned i = 0; i < queue.NumChannels(); ++i) {
                 iovec iov;
                 iov.iov_base = const_cast<void*>(queue.GetRawDequeuePtr(packet.Count(), i));
@@ -64,6 +79,7 @@ namespace CPN {
     protected:
         virtual void WriteBytes(const iovec *iov, unsigned iovcnt) = 0;
     private:
+        bool compact;
     };
 
     class CPN_LOCAL BufferedPacketEncoder : public PacketEncoder {
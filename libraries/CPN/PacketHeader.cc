@@ -23,9 +23,84 @@
 
 #include "PacketHeader.h"
 #include "ThrowingAssert.h"
+#include <algorithm>
 
 namespace CPN {
 
+    static uint8_t *PutVarInt(uint8_t *ptr, uint64_t val) {
+        while (val >= 0x80) {
+            *ptr++ = uint8_t(val) | 0x80;
+            val >>= 7;
+        }
+        *ptr++ = uint8_t(val);
+        return ptr;
+    }
+
+    static const uint8_t *GetVarInt(const uint8_t *ptr, const uint8_t *end, uint64_t &val) {
+        val = 0;
+        for (unsigned shift = 0; ptr != end && shift < 64; shift += 7) {
+            const uint8_t byte = *ptr++;
+            val |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) { return ptr; }
+        }
+        return 0;
+    }
+
+    static const double FRACTION_SCALE = 4294967295.0;
+
+    void EncodeFraction(double frac, uint8_t *buf) {
+        frac = std::max(0.0, std::min(1.0, frac));
+        const uint32_t val = uint32_t(frac * FRACTION_SCALE + 0.5);
+        buf[0] = uint8_t(val >> 24);
+        buf[1] = uint8_t(val >> 16);
+        buf[2] = uint8_t(val >> 8);
+        buf[3] = uint8_t(val);
+    }
+
+    double DecodeFraction(const uint8_t *buf) {
+        const uint32_t val = (uint32_t(buf[0]) << 24) | (uint32_t(buf[1]) << 16)
+            | (uint32_t(buf[2]) << 8) | uint32_t(buf[3]);
+        return double(val) / FRACTION_SCALE;
+    }
+
+    unsigned Packet::EncodeCompact(uint8_t *buf) const {
+        const uint64_t fields[] = { DataLength(), Count(), QueueSize(), ReadClock(), WriteClock() };
+        uint8_t flags = 0;
+        uint8_t *ptr = buf + PACKET_COMPACT_PREFIXLENGTH;
+        for (unsigned i = 0; i < sizeof(fields)/sizeof(fields[0]); ++i) {
+            if (fields[i] != 0) {
+                flags |= 1 << i;
+                ptr = PutVarInt(ptr, fields[i]);
+            }
+        }
+        const unsigned length = ptr - buf;
+        buf[0] = PACKET_COMPACT_MAGIC;
+        buf[1] = uint8_t(Type());
+        buf[2] = flags;
+        buf[3] = uint8_t(length);
+        return length;
+    }
+
+    bool Packet::DecodeCompact(const uint8_t *buf, unsigned len) {
+        if (len < PACKET_COMPACT_PREFIXLENGTH || !CompactPrefix(buf) || buf[3] != len) {
+            return false;
+        }
+        uint64_t fields[5] = { 0, 0, 0, 0, 0 };
+        const uint8_t *ptr = buf + PACKET_COMPACT_PREFIXLENGTH;
+        const uint8_t *end = buf + len;
+        for (unsigned i = 0; i < 5; ++i) {
+            if (buf[2] & (1 << i)) {
+                ptr = GetVarInt(ptr, end, fields[i]);
+                if (!ptr) { return false; }
+            }
+        }
+        if (ptr != end) { return false; }
+        Init(fields[0], static_cast<PacketType_t>(buf[1]));
+        Count(fields[1]).QueueSize(fields[2]);
+        ReadClock(fields[3]).WriteClock(fields[4]);
+        return true;
+    }
+
     PacketHandler::~PacketHandler() {}
 
     void PacketHandler::FirePacket(const Packet &packet) {
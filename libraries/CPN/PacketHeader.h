@@ -47,6 +47,57 @@ namespace CPN {
         PACKET_HEADERLENGTH = 64
     };
 
+    /** \brief Protocol versions exchanged in the ID packets.
+     *
+     * A peer only sends compact headers after the other end has
+     * announced (in its ID packet) that it understands them.
+     */
+    enum {
+        PACKET_VERSION_LEGACY = 0,
+        PACKET_VERSION_COMPACT = 1,
+        PACKET_VERSION = PACKET_VERSION_COMPACT
+    };
+
+    /** \brief Constants for the compact header format.
+     *
+     * A compact header is a four byte prefix (magic, type, field flags and
+     * total header length) followed by the fields named in the flags, each
+     * encoded as a variable length (LEB128) unsigned integer. Fields which
+     * are zero are not sent. The magic byte can never be the first byte of a
+     * full length header so the decoder can always tell the two apart.
+     */
+    enum {
+        PACKET_COMPACT_MAGIC = 0xC5,
+        PACKET_COMPACT_PREFIXLENGTH = 4,
+        PACKET_COMPACT_DATALENGTH = 0x01,
+        PACKET_COMPACT_COUNT = 0x02,
+        PACKET_COMPACT_QUEUESIZE = 0x04,
+        PACKET_COMPACT_READCLOCK = 0x08,
+        PACKET_COMPACT_WRITECLOCK = 0x10,
+        PACKET_COMPACT_ALLFIELDS = 0x1F,
+        /// Each of the five fields takes at most 10 bytes
+        PACKET_COMPACT_MAXLENGTH = PACKET_COMPACT_PREFIXLENGTH + 5*10
+    };
+
+    /** \brief A fraction in [0, 1] in the body of a packet, such as the
+     * split of a remote queue in a grow packet, is sent as a 32 bit
+     * fixed point number in network byte order.
+     */
+    enum {
+        PACKET_FRACTIONLENGTH = 4
+    };
+
+    /**
+     * \param frac the fraction, clamped to [0, 1]
+     * \param buf storage for PACKET_FRACTIONLENGTH bytes
+     */
+    CPN_LOCAL void EncodeFraction(double frac, uint8_t *buf);
+    /**
+     * \param buf the PACKET_FRACTIONLENGTH bytes of an encoded fraction
+     * \return the fraction, within 2^-32 of the one encoded
+     */
+    CPN_LOCAL double DecodeFraction(const uint8_t *buf);
+
     /**
      * The packet types.
      */
@@ -61,7 +112,9 @@ namespace CPN {
         PACKET_D4RTAG,
 
         PACKET_ID_READER,
-        PACKET_ID_WRITER
+        PACKET_ID_WRITER,
+
+        PACKET_NUMTYPES
     };
 
     struct CPN_LOCAL PacketHeader {
@@ -88,6 +141,15 @@ namespace CPN {
                 };
 
                 uint32_t queueSize; // only used for grow packet
+                uint32_t version; // only used for ID packet
+
+                // Upper halves of the 64 bit values, peers which
+                // predate these leave them zero.
+                uint32_t dataLengthHigh;
+                uint32_t countHigh;
+                uint32_t queueSizeHigh;
+
+                uint32_t stripe; // only used for ID packet
             };
             uint8_t pad[PACKET_HEADERLENGTH];
         };
@@ -110,42 +172,79 @@ namespace CPN {
     class CPN_LOCAL Packet {
     public:
         Packet() { memset(&header, 0, sizeof(header)); }
-        Packet(uint32_t datalen, PacketType_t type) { Init(datalen, type); }
+        Packet(uint64_t datalen, PacketType_t type) { Init(datalen, type); }
         Packet(PacketType_t type) { Init(0, type); }
         Packet(const PacketHeader &ph) : header(ph) {}
 
-        Packet &Init(uint32_t datalen, PacketType_t type) {
-            InitPacket(&header, datalen, type);
-            return *this;
+        Packet &Init(uint64_t datalen, PacketType_t type) {
+            InitPacket(&header, 0, type);
+            return DataLength(datalen);
         }
 
-        uint32_t DataLength() const { return header.dataLength; }
+        uint64_t DataLength() const { return Join(header.dataLength, header.dataLengthHigh); }
         PacketType_t Type() const { return static_cast<PacketType_t>(header.dataType); }
-        uint32_t QueueSize() const { return header.queueSize; }
+        uint64_t QueueSize() const { return Join(header.queueSize, header.queueSizeHigh); }
         uint64_t SourceKey() const { return header.srckey; }
         uint64_t DestinationKey() const { return header.dstkey; }
-        uint32_t Requested() const { return header.requested; }
-        uint32_t MaxThreshold() const { return header.maxThresh; }
-        uint32_t Count() const { return header.count; }
+        uint64_t Requested() const { return Join(header.requested, header.countHigh); }
+        uint64_t MaxThreshold() const { return Join(header.maxThresh, header.countHigh); }
+        uint64_t Count() const { return Join(header.count, header.countHigh); }
         uint64_t ReadClock() const { return header.readclock; }
         uint64_t WriteClock() const { return header.writeclock; }
+        uint32_t Version() const { return header.version; }
+        uint32_t Stripe() const { return header.stripe; }
         bool Valid() const { return ValidPacket(&header); }
 
-        Packet &DataLength(uint32_t dl) { header.dataLength = dl; return *this; }
+        Packet &DataLength(uint64_t dl) { Split(dl, header.dataLength, header.dataLengthHigh); return *this; }
         Packet &Type(PacketType_t t) { header.dataType = t; return *this; }
-        Packet &QueueSize(uint32_t qs) { header.queueSize = qs; return *this; }
+        Packet &QueueSize(uint64_t qs) { Split(qs, header.queueSize, header.queueSizeHigh); return *this; }
         Packet &SourceKey(uint64_t k) { header.srckey = k; return *this; }
         Packet &DestinationKey(uint64_t k) { header.dstkey = k; return *this; }
-        Packet &Requested(uint32_t r) { header.requested = r; return *this; }
-        Packet &MaxThreshold(uint32_t mt) { header.maxThresh = mt; return *this; }
-        Packet &Count(uint32_t cnt) { header.count = cnt; return *this; }
+        Packet &Requested(uint64_t r) { Split(r, header.requested, header.countHigh); return *this; }
+        Packet &MaxThreshold(uint64_t mt) { Split(mt, header.maxThresh, header.countHigh); return *this; }
+        Packet &Count(uint64_t cnt) { Split(cnt, header.count, header.countHigh); return *this; }
         Packet &ReadClock(uint64_t c) { header.readclock = c; return *this; }
         Packet &WriteClock(uint64_t c) { header.writeclock = c; return *this; }
+        Packet &Version(uint32_t v) { header.version = v; return *this; }
+        Packet &Stripe(uint32_t s) { header.stripe = s; return *this; }
+
+        /**
+         * Encode this packet as a compact header.
+         * \param buf storage of at least PACKET_COMPACT_MAXLENGTH bytes
+         * \return the number of bytes used
+         */
+        unsigned EncodeCompact(uint8_t *buf) const;
+        /**
+         * Decode a compact header into this packet.
+         * \param buf the complete compact header
+         * \param len the number of bytes in buf
+         * \return true if buf held a valid compact header
+         */
+        bool DecodeCompact(const uint8_t *buf, unsigned len);
 
     public:
         PacketHeader header;
+    private:
+        static uint64_t Join(uint32_t low, uint32_t high) {
+            return (uint64_t(high) << 32) | low;
+        }
+        static void Split(uint64_t val, uint32_t &low, uint32_t &high) {
+            low = uint32_t(val);
+            high = uint32_t(val >> 32);
+        }
     };
 
+    /**
+     * \return true if the given prefix starts a compact header.
+     */
+    inline bool CompactPrefix(const uint8_t *prefix) CPN_LOCAL {
+        return prefix[0] == PACKET_COMPACT_MAGIC
+            && prefix[1] < PACKET_NUMTYPES
+            && (prefix[2] & ~PACKET_COMPACT_ALLFIELDS) == 0
+            && prefix[3] >= PACKET_COMPACT_PREFIXLENGTH
+            && prefix[3] <= PACKET_COMPACT_MAXLENGTH;
+    }
+
     /**
      * This class makes it easy to process packets.
      */
@@ -26,11 +26,27 @@
 
 namespace CPN {
 
+    /**
+     * The D4R node of a pseudo node. Signaling its queues takes their
+     * FiberMutex, which can suspend a fiber, so the list lock held
+     * meanwhile must be a FiberMutex as well.
+     */
+    class FiberD4RNode : public D4R::Node {
+    public:
+        FiberD4RNode(Key_t key) : D4R::Node(key) {}
+    protected:
+        void LockQueues() { listlock.Lock(); }
+        void UnlockQueues() { listlock.Unlock(); }
+    private:
+        FiberMutex listlock;
+    };
+
     PseudoNode::PseudoNode(const std::string &n, Key_t k, shared_ptr<Context> ctx)
         : logger(ctx.get(), Logger::WARNING, n),
+        lock(true),
         name(n),
         nodekey(k),
-        d4rnode(new D4R::Node(k)),
+        d4rnode(new FiberD4RNode(k)),
         context(ctx)
     {
     }
@@ -51,9 +67,9 @@ namespace CPN {
     }
 
     void PseudoNode::CreateReader(shared_ptr<QueueBase> q) {
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         Key_t readerkey = q->GetReaderKey();
-        d4rnode->AddReader(q);
+        d4rnode->AddReader(q.get());
         q->SetReaderNode(d4rnode);
         q->SignalReaderTagChanged();
         ASSERT(readermap.find(readerkey) == readermap.end(), "The reader already exists");
@@ -64,9 +80,9 @@ namespace CPN {
     }
 
     void PseudoNode::CreateWriter(shared_ptr<QueueBase> q) {
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         Key_t writerkey = q->GetWriterKey();
-        d4rnode->AddWriter(q);
+        d4rnode->AddWriter(q.get());
         q->SetWriterNode(d4rnode);
         q->SignalWriterTagChanged();
         ASSERT(writermap.find(writerkey) == writermap.end(), "The writer already exists.");
@@ -77,7 +93,7 @@ namespace CPN {
     }
 
     void PseudoNode::Shutdown() {
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         ReaderMap readers;
         readers.swap(readermap);
         WriterMap writers;
@@ -85,41 +101,59 @@ namespace CPN {
         arl.Unlock();
         for (ReaderMap::iterator i = readers.begin(); i != readers.end(); ++i) {
             i->second->GetQueue()->ShutdownReader();
+            d4rnode->RemoveReader(i->second->GetQueue().get());
         }
         for (WriterMap::iterator i = writers.begin(); i != writers.end(); ++i) {
             i->second->GetQueue()->ShutdownWriter();
+            d4rnode->RemoveWriter(i->second->GetQueue().get());
         }
         readers.clear();
         writers.clear();
 
     }
 
+    static EndpointStats ReaderStats(shared_ptr<QueueReader> reader) {
+        EndpointStats stats;
+        reader->GetQueue()->GetEndpointStats(stats, true);
+        return stats;
+    }
+
+    static EndpointStats WriterStats(shared_ptr<QueueWriter> writer) {
+        EndpointStats stats;
+        writer->GetQueue()->GetEndpointStats(stats, false);
+        return stats;
+    }
+
     void PseudoNode::ReleaseReader(Key_t ekey) {
         shared_ptr<QueueReader> reader;
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         ReaderMap::iterator entry = readermap.find(ekey);
         if (entry != readermap.end()) {
             reader = entry->second;
             readermap.erase(entry);
+            released.push_back(ReaderStats(reader));
         }
         arl.Unlock();
+        if (reader) { d4rnode->RemoveReader(reader->GetQueue().get()); }
         reader.reset();
     }
 
     void PseudoNode::ReleaseWriter(Key_t ekey) {
         shared_ptr<QueueWriter> writer;
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         WriterMap::iterator entry = writermap.find(ekey);
         if (entry != writermap.end()) {
             writer = entry->second;
             writermap.erase(entry);
+            released.push_back(WriterStats(writer));
         }
         arl.Unlock();
+        if (writer) { d4rnode->RemoveWriter(writer->GetQueue().get()); }
         writer.reset();
     }
 
     void PseudoNode::NotifyTerminate() {
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         cond.Signal();
         WriterMap::iterator witr = writermap.begin();
         while (witr != writermap.end()) { (witr++)->second->NotifyTerminate(); }
@@ -128,7 +162,7 @@ namespace CPN {
     }
 
     shared_ptr<QueueReader> PseudoNode::GetReader(Key_t ekey) {
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         shared_ptr<QueueReader> reader;
         while (!reader) {
             ReaderMap::iterator entry = readermap.find(ekey);
@@ -143,7 +177,7 @@ namespace CPN {
     }
 
     shared_ptr<QueueWriter> PseudoNode::GetWriter(Key_t ekey) {
-        Sync::AutoReentrantLock arl(lock);
+        AutoFiberLock arl(lock);
         shared_ptr<QueueWriter> writer;
         while (!writer) {
             WriterMap::iterator entry = writermap.find(ekey);
@@ -162,6 +196,44 @@ namespace CPN {
         return true;
     }
 
+    int PseudoNode::GetNUMANode() const {
+        return -1;
+    }
+
+    void PseudoNode::GetStats(NodeStats &stats) {
+        stats.name = name;
+        stats.key = nodekey;
+        AutoFiberLock arl(lock);
+        std::vector<EndpointStats> endpoints = released;
+        for (ReaderMap::iterator r = readermap.begin(); r != readermap.end(); ++r) {
+            endpoints.push_back(ReaderStats(r->second));
+        }
+        for (WriterMap::iterator w = writermap.begin(); w != writermap.end(); ++w) {
+            endpoints.push_back(WriterStats(w->second));
+        }
+        std::map<Key_t, std::string> names = portnames;
+        arl.Unlock();
+        for (std::vector<EndpointStats>::iterator e = endpoints.begin(); e != endpoints.end(); ++e) {
+            std::map<Key_t, std::string>::iterator entry = names.find(e->key);
+            if (entry != names.end()) {
+                e->port = entry->second;
+            } else {
+                e->port = (e->reader ? context->GetReaderName(e->key) : context->GetWriterName(e->key));
+                arl.Lock();
+                portnames[e->key] = e->port;
+                arl.Unlock();
+            }
+            if (e->reader) {
+                stats.readblocked += e->blocked;
+                stats.consumed += e->bytes;
+            } else {
+                stats.writeblocked += e->blocked;
+                stats.produced += e->bytes;
+            }
+        }
+        stats.endpoints.swap(endpoints);
+    }
+
     void PseudoNode::LogState() {
         logger.Error("Logging (key: %llu), %u readers, %u writers",
                 nodekey, readermap.size(), writermap.size());
@@ -21,8 +21,10 @@
 
 #include "CPNCommon.h"
 #include "QueueBase.h"
-#include "ReentrantLock.h"
+#include "FiberScheduler.h"
+#include "NodeStats.h"
 #include <map>
+#include <vector>
 
 namespace D4R {
     class Node;
@@ -68,6 +70,13 @@ namespace CPN {
         /** \brief Perform actions (like joining a thread) before destruction */
         virtual void Shutdown();
         virtual bool IsPurePseudo();
+        /** \return the NUMA node this node was placed on or -1 */
+        virtual int GetNUMANode() const;
+        /**
+         * \brief Fill in stats with what the endpoints of this node,
+         * including the released ones, have done so far.
+         */
+        virtual void GetStats(NodeStats &stats);
 
         /// For debugging ONLY!
         virtual void LogState();
@@ -81,8 +90,8 @@ namespace CPN {
         shared_ptr<QueueWriter> GetWriter(Key_t ekey);
 
 
-        Sync::ReentrantLock lock;
-        Sync::ReentrantCondition cond;
+        FiberMutex lock;
+        FiberCondition<PthreadCondition> cond;
         const std::string name;
         const Key_t nodekey;
         shared_ptr<D4R::Node> d4rnode;
@@ -91,6 +100,10 @@ namespace CPN {
         typedef std::map<Key_t, shared_ptr<QueueWriter> > WriterMap;
         ReaderMap readermap;
         WriterMap writermap;
+        // What the released endpoints did
+        std::vector<EndpointStats> released;
+        // Endpoint key to port name, so stats do not ask the context again
+        std::map<Key_t, std::string> portnames;
 
         shared_ptr<Context> context;
     };
@@ -29,6 +29,7 @@
 #include "CPNCommon.h"
 #include "QueueDatatypes.h"
 #include <string>
+#include <vector>
 
 namespace CPN {
     
@@ -51,6 +52,10 @@ namespace CPN {
      * The default number of channels is one.
      *
      * The default queue hint is to not use the ThresholdQueue see SetHint
+     *
+     * The default number of connections for a remote queue is one.
+     *
+     * The default is no preference for the NUMA node of the queue memory.
      */
     class CPN_API QueueAttr {
     public:
@@ -59,16 +64,18 @@ namespace CPN {
             queueLength(0), maxThreshold(0),
             numChannels(1), alpha(0.5),
             readerkey(0), writerkey(0), readernodekey(0), writernodekey(0),
-            maxwritethreshold(0)
+            maxwritethreshold(0), numConnections(1), linkRate(0), adaptiveAlpha(false),
+            memoryNode(QUEUEMEMORY_ANY)
         {}
 
-        QueueAttr(const unsigned queueLength_,
-                const unsigned maxThreshold_)
+        QueueAttr(const QueueSize_t queueLength_,
+                const QueueSize_t maxThreshold_)
             : queuehint(QUEUEHINT_DEFAULT), datatype(TypeName<void>()),
             queueLength(queueLength_), maxThreshold(maxThreshold_),
             numChannels(1), alpha(0.5),
             readerkey(0), writerkey(0), readernodekey(0), writernodekey(0),
-            maxwritethreshold(0)
+            maxwritethreshold(0), numConnections(1), linkRate(0), adaptiveAlpha(false),
+            memoryNode(QUEUEMEMORY_ANY)
             {}
 
         /** \brief alpha is used by the remote queue to decide how
@@ -84,16 +91,101 @@ namespace CPN {
             return *this;
         }
 
-        QueueAttr &SetMaxWriteThreshold(unsigned mwt) {
+        /** \brief Let the remote queue move the split given by alpha at
+         * runtime. The writer side watches where the blocking happens and
+         * how full each side is when it does and moves capacity toward the
+         * side that needs it. alpha is then only the starting point.
+         * \param adapt true to enable
+         * \return this
+         */
+        QueueAttr &SetAdaptiveAlpha(bool adapt) {
+            adaptiveAlpha = adapt;
+            return *this;
+        }
+
+        /** \brief Prefer a NUMA node for the memory of the queue.
+         * Only the mirrored buffers of the ThresholdQueue can be placed.
+         * \param node a NUMA node number or one of QUEUEMEMORY_ANY,
+         * QUEUEMEMORY_READER or QUEUEMEMORY_WRITER to follow the
+         * NUMA node given to that endpoint's node
+         * \return this
+         */
+        QueueAttr &SetMemoryNode(int node) {
+            memoryNode = node;
+            return *this;
+        }
+
+        QueueAttr &SetMaxWriteThreshold(QueueSize_t mwt) {
             maxwritethreshold = mwt;
             return *this;
         }
 
+        /** \brief Stripe a remote queue over more than one connection.
+         * The packets are sent round robin over the connections and
+         * reassembled in order on the reader side. Has no effect on a
+         * queue that is not remote.
+         * \param num the number of connections (at least one)
+         * \return this
+         */
+        QueueAttr &SetNumConnections(unsigned num) {
+            numConnections = (num == 0 ? 1 : num);
+            return *this;
+        }
+
+        /** \brief The rate in bytes per second the link of a remote
+         * queue is expected to carry. With the round trip time measured
+         * when the queue connects it sizes the socket buffers to the
+         * bandwidth-delay product. Has no effect on a queue that is not
+         * remote.
+         * \param rate bytes per second, 0 (the default) when unknown
+         * \return this
+         */
+        QueueAttr &SetLinkRate(double rate) {
+            linkRate = rate;
+            return *this;
+        }
+
+        /** \brief Add a local address on the writer side to bind the
+         * remote queue connections to. The connections are spread round
+         * robin over the addresses given so they can use several
+         * interfaces.
+         * \param host a hostname or numeric address
+         * \return this
+         */
+        QueueAttr &AddLocalAddress(const std::string &host) {
+            localAddresses.push_back(host);
+            return *this;
+        }
+
+        /** \brief Add an address of the reader kernel for the remote
+         * queue connections to go to. The connections are spread round
+         * robin over the addresses given, the reader kernel must listen
+         * on them (see KernelAttr::AddListenAddress). Without any the
+         * connections go to the host the reader kernel registered.
+         * \param host a hostname or numeric address
+         * \return this
+         */
+        QueueAttr &AddReaderAddress(const std::string &host) {
+            readerAddresses.push_back(host);
+            return *this;
+        }
+
         QueueAttr &SetName(const std::string &qname) {
             queuename = qname;
             return *this;
         }
 
+        /** \brief Decide how this queue grows in an artificial deadlock
+         * instead of the policy of the kernel, see GrowPolicy.
+         * Only used when the queue is created on this kernel.
+         * \param policy the policy
+         * \return this
+         */
+        QueueAttr &SetGrowPolicy(shared_ptr<GrowPolicy> policy) {
+            growpolicy = policy;
+            return *this;
+        }
+
         QueueAttr &SetEndpoints(const std::string &readernode, const std::string &readerport,
                 const std::string &writernode, const std::string &writerport) {
             SetReader(readernode, readerport);
@@ -153,12 +245,12 @@ namespace CPN {
             return *this;
         }
 
-        QueueAttr &SetLength(unsigned length) {
+        QueueAttr &SetLength(QueueSize_t length) {
             queueLength = length;
             return *this;
         }
 
-        QueueAttr &SetMaxThreshold(unsigned maxthresh) {
+        QueueAttr &SetMaxThreshold(QueueSize_t maxthresh) {
             maxThreshold = maxthresh;
             return *this;
         }
@@ -196,21 +288,28 @@ namespace CPN {
         Key_t GetReaderNodeKey() const { return readernodekey; }
         Key_t GetWriterKey() const { return writerkey; }
         Key_t GetReaderKey() const { return readerkey; }
-        unsigned GetLength() const { return queueLength; }
-        unsigned GetMaxThreshold() const { return maxThreshold; }
+        QueueSize_t GetLength() const { return queueLength; }
+        QueueSize_t GetMaxThreshold() const { return maxThreshold; }
         unsigned GetNumChannels() const { return numChannels; }
         QueueHint_t GetHint() const { return queuehint; }
         const std::string &GetDatatype() const { return datatype; }
         double GetAlpha() const { return alpha; }
+        bool GetAdaptiveAlpha() const { return adaptiveAlpha; }
+        int GetMemoryNode() const { return memoryNode; }
         const std::string &GetName() const { return queuename; }
-        unsigned GetMaxWriteThreshold() const { return maxwritethreshold; }
+        QueueSize_t GetMaxWriteThreshold() const { return maxwritethreshold; }
+        unsigned GetNumConnections() const { return numConnections; }
+        double GetLinkRate() const { return linkRate; }
+        const std::vector<std::string> &GetLocalAddresses() const { return localAddresses; }
+        const std::vector<std::string> &GetReaderAddresses() const { return readerAddresses; }
+        shared_ptr<GrowPolicy> GetGrowPolicy() const { return growpolicy; }
 
     private:
         QueueHint_t queuehint;
         std::string datatype;
         std::string queuename;
-        unsigned queueLength;
-        unsigned maxThreshold;
+        QueueSize_t queueLength;
+        QueueSize_t maxThreshold;
         unsigned numChannels;
         double alpha;
         std::string readernodename;
@@ -221,7 +320,14 @@ namespace CPN {
         Key_t writerkey;
         Key_t readernodekey;
         Key_t writernodekey;
-        unsigned maxwritethreshold;
+        QueueSize_t maxwritethreshold;
+        unsigned numConnections;
+        double linkRate;
+        std::vector<std::string> localAddresses;
+        std::vector<std::string> readerAddresses;
+        bool adaptiveAlpha;
+        int memoryNode;
+        shared_ptr<GrowPolicy> growpolicy;
     };
 
     /**
@@ -234,7 +340,8 @@ namespace CPN {
             : queuehint(QUEUEHINT_DEFAULT),
             queueLength(0), maxThreshold(0),
             numChannels(0), alpha(0.5),
-            maxwritethreshold(0)
+            maxwritethreshold(0), numConnections(1), linkRate(0), adaptiveAlpha(false),
+            memoryNode(QUEUEMEMORY_ANY)
         {}
         SimpleQueueAttr(const QueueAttr &attr)
             : queuehint(attr.GetHint()),
@@ -247,7 +354,15 @@ namespace CPN {
             writerkey(attr.GetWriterKey()),
             readernodekey(attr.GetReaderNodeKey()),
             writernodekey(attr.GetWriterNodeKey()),
-            maxwritethreshold(attr.GetMaxWriteThreshold())
+            maxwritethreshold(attr.GetMaxWriteThreshold()),
+            numConnections(attr.GetNumConnections()),
+            linkRate(attr.GetLinkRate()),
+            localAddresses(attr.GetLocalAddresses()),
+            readerAddresses(attr.GetReaderAddresses()),
+            adaptiveAlpha(attr.GetAdaptiveAlpha()),
+            memoryNode(attr.GetMemoryNode()),
+            queuename(attr.GetName()),
+            growpolicy(attr.GetGrowPolicy())
         {}
 
         SimpleQueueAttr &SetAlpha(double a) {
@@ -255,11 +370,41 @@ namespace CPN {
             return *this;
         }
 
-        SimpleQueueAttr &SetMaxWriteThreshold(unsigned mwt) {
+        SimpleQueueAttr &SetAdaptiveAlpha(bool adapt) {
+            adaptiveAlpha = adapt;
+            return *this;
+        }
+
+        SimpleQueueAttr &SetMemoryNode(int node) {
+            memoryNode = node;
+            return *this;
+        }
+
+        SimpleQueueAttr &SetMaxWriteThreshold(QueueSize_t mwt) {
             maxwritethreshold = mwt;
             return *this;
         }
 
+        SimpleQueueAttr &SetNumConnections(unsigned num) {
+            numConnections = (num == 0 ? 1 : num);
+            return *this;
+        }
+
+        SimpleQueueAttr &SetLinkRate(double rate) {
+            linkRate = rate;
+            return *this;
+        }
+
+        SimpleQueueAttr &SetLocalAddresses(const std::vector<std::string> &hosts) {
+            localAddresses = hosts;
+            return *this;
+        }
+
+        SimpleQueueAttr &SetReaderAddresses(const std::vector<std::string> &hosts) {
+            readerAddresses = hosts;
+            return *this;
+        }
+
         SimpleQueueAttr &SetHint(QueueHint_t hint) {
             queuehint = hint;
             return *this;
@@ -276,12 +421,12 @@ namespace CPN {
             return *this;
         }
 
-        SimpleQueueAttr &SetLength(unsigned length) {
+        SimpleQueueAttr &SetLength(QueueSize_t length) {
             queueLength = length;
             return *this;
         }
 
-        SimpleQueueAttr &SetMaxThreshold(unsigned maxthresh) {
+        SimpleQueueAttr &SetMaxThreshold(QueueSize_t maxthresh) {
             maxThreshold = maxthresh;
             return *this;
         }
@@ -311,30 +456,57 @@ namespace CPN {
             return *this;
         }
 
+        SimpleQueueAttr &SetName(const std::string &qname) {
+            queuename = qname;
+            return *this;
+        }
+
+        SimpleQueueAttr &SetGrowPolicy(shared_ptr<GrowPolicy> policy) {
+            growpolicy = policy;
+            return *this;
+        }
+
 
         Key_t GetWriterNodeKey() const { return writernodekey; }
         Key_t GetReaderNodeKey() const { return readernodekey; }
         Key_t GetWriterKey() const { return writerkey; }
         Key_t GetReaderKey() const { return readerkey; }
-        unsigned GetLength() const { return queueLength; }
-        unsigned GetMaxThreshold() const { return maxThreshold; }
+        QueueSize_t GetLength() const { return queueLength; }
+        QueueSize_t GetMaxThreshold() const { return maxThreshold; }
         unsigned GetNumChannels() const { return numChannels; }
         QueueHint_t GetHint() const { return queuehint; }
         const std::string &GetDatatype() const { return datatype; }
         double GetAlpha() const { return alpha; }
-        unsigned GetMaxWriteThreshold() const { return maxwritethreshold; }
+        bool GetAdaptiveAlpha() const { return adaptiveAlpha; }
+        int GetMemoryNode() const { return memoryNode; }
+        QueueSize_t GetMaxWriteThreshold() const { return maxwritethreshold; }
+        unsigned GetNumConnections() const { return numConnections; }
+        double GetLinkRate() const { return linkRate; }
+        const std::vector<std::string> &GetLocalAddresses() const { return localAddresses; }
+        const std::vector<std::string> &GetReaderAddresses() const { return readerAddresses; }
+        /** The name of the queue, when there is a grow policy the kernel names it after its endpoints if it had none */
+        const std::string &GetName() const { return queuename; }
+        shared_ptr<GrowPolicy> GetGrowPolicy() const { return growpolicy; }
     private:
         QueueHint_t queuehint;
         std::string datatype;
-        unsigned queueLength;
-        unsigned maxThreshold;
+        QueueSize_t queueLength;
+        QueueSize_t maxThreshold;
         unsigned numChannels;
         double alpha;
         Key_t readerkey;
         Key_t writerkey;
         Key_t readernodekey;
         Key_t writernodekey;
-        unsigned maxwritethreshold;
+        QueueSize_t maxwritethreshold;
+        unsigned numConnections;
+        double linkRate;
+        std::vector<std::string> localAddresses;
+        std::vector<std::string> readerAddresses;
+        bool adaptiveAlpha;
+        int memoryNode;
+        std::string queuename;
+        shared_ptr<GrowPolicy> growpolicy;
     };
 }
 #endif
@@ -26,7 +26,11 @@
 #include "QueueAttr.h"
 #include "KernelBase.h"
 #include "Context.h"
+#include "GrowPolicy.h"
+#include "Clock.h"
+#include "Trace.h"
 #include <sstream>
+#include <algorithm>
 #include <string.h>
 
 namespace CPN {
@@ -35,6 +39,8 @@ namespace CPN {
     QueueBase::QueueBase(KernelBase *k, const SimpleQueueAttr &attr)
         : readerkey(attr.GetReaderKey()),
         writerkey(attr.GetWriterKey()),
+        readernodekey(attr.GetReaderNodeKey()),
+        writernodekey(attr.GetWriterNodeKey()),
         readshutdown(false),
         writeshutdown(false),
         readrequest(0),
@@ -43,11 +49,17 @@ namespace CPN {
         dequeuethresh(0),
         indequeue(false),
         inenqueue(false),
+        readerwoken(false),
         kernel(k),
         useD4R(kernel->UseD4R()),
         logger(kernel->GetContext().get(), Logger::DEBUG),
-        datatype(attr.GetDatatype())
+        datatype(attr.GetDatatype()),
+        readblocktime(0),
+        writeblocktime(0),
+        name(attr.GetName()),
+        growpolicy(attr.GetGrowPolicy())
     {
+        if (!growpolicy) { growpolicy = kernel->GetGrowPolicy(); }
         std::ostringstream oss;
         oss << "Queue(" << writerkey << ", " << readerkey << ")";
         logger.Name(oss.str());
@@ -55,7 +67,7 @@ namespace CPN {
 
     QueueBase::~QueueBase() {}
 
-    const void *QueueBase::GetRawDequeuePtr(unsigned thresh, unsigned chan) {
+    const void *QueueBase::GetRawDequeuePtr(QueueSize_t thresh, unsigned chan) {
         kernel->CheckTerminated();
         AutoLock<QueueBase> al(*this);
         if (indequeue) { ASSERT(dequeuethresh >= thresh); }
@@ -68,7 +80,7 @@ namespace CPN {
             }
             if (readshutdown) { throw BrokenQueueException(readerkey); }
             if (thresh > UnlockedMaxThreshold() && kernel->GrowQueueMaxThreshold()) {
-                //printf("Grow(%u, %u)\n", 2*thresh, thresh);
+                LOG_TRACE(logger, "Grow(%llu, %llu)", 2*thresh, thresh);
                 UnlockedGrow(2*thresh, thresh);
                 Signal();
             } else if (WriteBlocked() && kernel->GrowQueueMaxThreshold()) {
@@ -76,22 +88,29 @@ namespace CPN {
                 Signal();
             } else {
                 readrequest = thresh;
+                const double start = MonotonicTime();
+                CPN_TRACE_BEGIN("read blocked", readernodekey, readerkey);
                 WaitForData();
+                CPN_TRACE_END("read blocked", readernodekey, readerkey);
+                readblocktime += MonotonicTime() - start;
                 readrequest = 0;
+                readerwoken = false;
             }
         }
     }
 
-    void QueueBase::Dequeue(unsigned count) {
+    void QueueBase::Dequeue(QueueSize_t count) {
         AutoLock<QueueBase> al(*this);
         dequeuethresh = 0;
         indequeue = false;
         if (readshutdown) { throw BrokenQueueException(readerkey); }
+        CPN_TRACE_INSTANT("dequeue", readernodekey, readerkey, count);
+        LOG_TRACE(logger, "Dequeue(%llu)", count);
         InternalDequeue(count);
         NotifyFreespace();
     }
 
-    bool QueueBase::RawDequeue(void* data, unsigned count, unsigned numChans, unsigned chanStride) {
+    bool QueueBase::RawDequeue(void* data, QueueSize_t count, unsigned numChans, QueueSize_t chanStride) {
         const void *src = GetRawDequeuePtr(count, 0);
         char *dest = (char*)data;
         if (!src) { return false; }
@@ -106,11 +125,11 @@ namespace CPN {
         return true;
     }
 
-    bool QueueBase::RawDequeue(void *data, unsigned count) {
+    bool QueueBase::RawDequeue(void *data, QueueSize_t count) {
         return RawDequeue(data, count, 1, 0);
     }
 
-    void *QueueBase::GetRawEnqueuePtr(unsigned thresh, unsigned chan) {
+    void *QueueBase::GetRawEnqueuePtr(QueueSize_t thresh, unsigned chan) {
         kernel->CheckTerminated();
         AutoLock<QueueBase> al(*this);
         if (inenqueue) { ASSERT(enqueuethresh >= thresh); }
@@ -124,7 +143,7 @@ namespace CPN {
             }
             if (readshutdown || writeshutdown) { throw BrokenQueueException(writerkey); }
             if (thresh > UnlockedMaxThreshold() && kernel->GrowQueueMaxThreshold()) {
-                //printf("Grow(%u, %u)\n", 2*thresh, thresh);
+                LOG_TRACE(logger, "Grow(%llu, %llu)", 2*thresh, thresh);
                 UnlockedGrow(2*thresh, thresh);
                 Signal();
             } else if (!grown && ReadBlocked() && kernel->GrowQueueMaxThreshold()) {
@@ -133,22 +152,40 @@ namespace CPN {
                 grown = true;
             } else {
                 writerequest = thresh;
+                const double start = MonotonicTime();
+                CPN_TRACE_BEGIN("write blocked", writernodekey, readerkey);
                 WaitForFreespace();
+                CPN_TRACE_END("write blocked", writernodekey, readerkey);
+                writeblocktime += MonotonicTime() - start;
                 writerequest = 0;
             }
         }
     }
 
-    void QueueBase::Enqueue(unsigned count) {
-        AutoLock<QueueBase> al(*this);
-        enqueuethresh = 0;
-        inenqueue = false;
-        if (writeshutdown) { throw BrokenQueueException(writerkey); }
-        InternalEnqueue(count);
-        NotifyData();
+    void QueueBase::Enqueue(QueueSize_t count) {
+        bool handoff = false;
+        {
+            AutoLock<QueueBase> al(*this);
+            enqueuethresh = 0;
+            inenqueue = false;
+            if (writeshutdown) { throw BrokenQueueException(writerkey); }
+            CPN_TRACE_INSTANT("enqueue", writernodekey, readerkey, count);
+            LOG_TRACE(logger, "Enqueue(%llu)", count);
+            InternalEnqueue(count);
+            if (NotifyData()) { readerwoken = true; }
+            // Only hand off once a fused reader has half a queue to
+            // consume, switching for every block costs more than it saves.
+            // The reader may have been woken by an earlier block.
+            handoff = readerwoken && 2*UnlockedCount() >= UnlockedQueueLength();
+            if (handoff) { readerwoken = false; }
+        }
+        if (handoff) {
+            // Let a fused reader consume the data while it is hot
+            Fiber::HandOff();
+        }
     }
 
-    void QueueBase::RawEnqueue(const void *data, unsigned count, unsigned numChans, unsigned chanStride) {
+    void QueueBase::RawEnqueue(const void *data, QueueSize_t count, unsigned numChans, QueueSize_t chanStride) {
         void *dest = GetRawEnqueuePtr(count, 0);
         const char *src = (char*)data;
         memcpy(dest, src, count);
@@ -161,7 +198,7 @@ namespace CPN {
     }
 
 
-    void QueueBase::RawEnqueue(const void* data, unsigned count) {
+    void QueueBase::RawEnqueue(const void* data, QueueSize_t count) {
         return RawEnqueue(data, count, 1, 0);
     }
 
@@ -170,7 +207,7 @@ namespace CPN {
         return UnlockedNumChannels();
     }
 
-    unsigned QueueBase::Count() const {
+    QueueSize_t QueueBase::Count() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedCount();
     }
@@ -180,7 +217,7 @@ namespace CPN {
         return UnlockedEmpty();
     }
 
-    unsigned QueueBase::Freespace() const {
+    QueueSize_t QueueBase::Freespace() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedFreespace();
     }
@@ -190,27 +227,27 @@ namespace CPN {
         return UnlockedFull();
     }
 
-    unsigned QueueBase::MaxThreshold() const {
+    QueueSize_t QueueBase::MaxThreshold() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedMaxThreshold();
     }
 
-    unsigned QueueBase::QueueLength() const {
+    QueueSize_t QueueBase::QueueLength() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedQueueLength();
     }
 
-    unsigned QueueBase::EnqueueChannelStride() const {
+    QueueSize_t QueueBase::EnqueueChannelStride() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedEnqueueChannelStride();
     }
 
-    unsigned QueueBase::DequeueChannelStride() const {
+    QueueSize_t QueueBase::DequeueChannelStride() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedDequeueChannelStride();
     }
 
-    void QueueBase::Grow(unsigned queueLen, unsigned maxThresh) {
+    void QueueBase::Grow(QueueSize_t queueLen, QueueSize_t maxThresh) {
         AutoLock<QueueBase> al(*this);
         UnlockedGrow(queueLen, maxThresh);
     }
@@ -235,16 +272,39 @@ namespace CPN {
         Signal();
     }
 
-    unsigned QueueBase::NumEnqueued() const {
+    QueueSize_t QueueBase::NumEnqueued() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedNumEnqueued();
     }
 
-    unsigned QueueBase::NumDequeued() const {
+    QueueSize_t QueueBase::NumDequeued() const {
         AutoLock<const QueueBase> al(*this);
         return UnlockedNumDequeued();
     }
 
+    double QueueBase::ReadBlockedTime() const {
+        AutoLock<const QueueBase> al(*this);
+        return readblocktime;
+    }
+
+    double QueueBase::WriteBlockedTime() const {
+        AutoLock<const QueueBase> al(*this);
+        return writeblocktime;
+    }
+
+    void QueueBase::GetEndpointStats(EndpointStats &stats, bool reader) const {
+        AutoLock<const QueueBase> al(*this);
+        stats.key = (reader ? readerkey : writerkey);
+        stats.queue = readerkey;
+        stats.reader = reader;
+        stats.blocked = (reader ? readblocktime : writeblocktime);
+        // The queue counts bytes per channel
+        stats.channels = UnlockedNumChannels();
+        stats.bytes = stats.channels * (reader ? UnlockedNumDequeued() : UnlockedNumEnqueued());
+        stats.length = stats.channels * UnlockedQueueLength();
+        stats.count = stats.channels * UnlockedCount();
+    }
+
     void QueueBase::WaitForData() {
         if (useD4R) {
             ReadBlock();
@@ -260,10 +320,11 @@ namespace CPN {
         return UnlockedCount() < readrequest && !(readshutdown || writeshutdown);
     }
 
-    void QueueBase::NotifyData() {
+    bool QueueBase::NotifyData() {
         if (UnlockedCount() >= readrequest) {
-            cond.Broadcast();
+            return cond.Broadcast();
         }
+        return false;
     }
 
     void QueueBase::WaitForFreespace() {
@@ -293,18 +354,30 @@ namespace CPN {
     }
 
     void QueueBase::Detect() {
-        unsigned size = kernel->CalculateGrowSize(UnlockedCount(), writerequest);
-        logger.Debug("Detect: Grow(%u, %u)", size, writerequest);
+        QueueSize_t size;
+        if (growpolicy) {
+            GrowRequest req;
+            req.name = name;
+            req.count = UnlockedCount();
+            req.length = UnlockedQueueLength();
+            req.request = writerequest;
+            req.numchannels = UnlockedNumChannels();
+            size = std::max(growpolicy->GrowSize(req), req.count + req.request);
+        } else {
+            size = kernel->CalculateGrowSize(UnlockedCount(), writerequest);
+        }
+        CPN_TRACE_INSTANT("d4r detect", writernodekey, readerkey, size);
+        logger.Debug("Detect: Grow(%llu, %llu)", size, writerequest);
         UnlockedGrow(size, writerequest);
-        logger.Debug("New size: (%u, %u)", UnlockedQueueLength(), UnlockedMaxThreshold());
+        logger.Debug("New size: (%llu, %llu)", UnlockedQueueLength(), UnlockedMaxThreshold());
     }
 
-    unsigned QueueBase::ReadRequest() {
+    QueueSize_t QueueBase::ReadRequest() {
         AutoLock<QueueBase> al(*this);
         return readrequest;
     }
 
-    unsigned QueueBase::WriteRequest() {
+    QueueSize_t QueueBase::WriteRequest() {
         AutoLock<QueueBase> al(*this);
         return writerequest;
     }
@@ -321,15 +394,15 @@ namespace CPN {
 
     void QueueBase::LogState() {
         logger.Error("Printing state (w:%llu r:%llu)", readerkey, writerkey);
-        logger.Error("size: %u, maxthresh: %u count: %u free: %u",
+        logger.Error("size: %llu, maxthresh: %llu count: %llu free: %llu",
                 UnlockedQueueLength(), UnlockedMaxThreshold(), UnlockedCount(), UnlockedFreespace());
-        logger.Error("readrequest: %u, writerequest: %u numenqueued: %u, numdequeued: %u",
+        logger.Error("readrequest: %llu, writerequest: %llu numenqueued: %llu, numdequeued: %llu",
                 readrequest, writerequest, UnlockedNumEnqueued(), UnlockedNumDequeued());
         if (indequeue) {
-            logger.Error("Indequeue (thresh: %u)", dequeuethresh);
+            logger.Error("Indequeue (thresh: %llu)", dequeuethresh);
         }
         if (inenqueue) {
-            logger.Error("Inenqueue (thresh: %u)", enqueuethresh);
+            logger.Error("Inenqueue (thresh: %llu)", enqueuethresh);
         }
         if (readshutdown) {
             logger.Error("Reader shutdown");
@@ -27,8 +27,10 @@
 #include "CPNCommon.h"
 #include "PthreadMutex.h"
 #include "PthreadCondition.h"
+#include "FiberScheduler.h"
 #include "D4RQueue.h"
 #include "Logger.h"
+#include "NodeStats.h"
 
 namespace CPN {
 
@@ -51,7 +53,7 @@ namespace CPN {
          * \return A void* to a block of memory containing thresh bytes
          * or 0 if there are not thresh bytes available.
          */
-        const void *GetRawDequeuePtr(unsigned thresh, unsigned chan);
+        const void *GetRawDequeuePtr(QueueSize_t thresh, unsigned chan);
 
         /**
          * This function is used to remove elements from the queue.
@@ -59,7 +61,7 @@ namespace CPN {
          * called.
          * \param count the number of bytes to remove from the queue
          */
-        void Dequeue(unsigned count);
+        void Dequeue(QueueSize_t count);
 
         /**
          * Dequeue data from the queue directly into the memory pointed to by
@@ -73,8 +75,8 @@ namespace CPN {
          * the channels in data.
          * \return true on success false on failure
          */
-        bool RawDequeue(void *data, unsigned count,
-                unsigned numChans, unsigned chanStride);
+        bool RawDequeue(void *data, QueueSize_t count,
+                unsigned numChans, QueueSize_t chanStride);
 
         /**
          * A version of RawDequeue to use when there is only 1 channel.
@@ -82,7 +84,7 @@ namespace CPN {
          * \param count the number of bytes to enqueue
          * \return true on success false if we have reached the end of the queue
          */
-        bool RawDequeue(void *data, unsigned count);
+        bool RawDequeue(void *data, QueueSize_t count);
 
         /**
          * Return a pointer to a buffer of memory that contains
@@ -97,7 +99,7 @@ namespace CPN {
          * \param chan the channel to use
          * \return void* to the memory buffer, 0 if not enough space available
          */
-        void *GetRawEnqueuePtr(unsigned thresh, unsigned chan);
+        void *GetRawEnqueuePtr(QueueSize_t thresh, unsigned chan);
 
         /**
          * This function is used to release the buffer obtained with
@@ -110,7 +112,7 @@ namespace CPN {
          * \param count the number of bytes to be placed in the buffer
          * \invariant count <= thresh from GetRawEnqueuePtr
          */
-        void Enqueue(unsigned count);
+        void Enqueue(QueueSize_t count);
 
         /**
          * This function shall be equivalent to
@@ -127,15 +129,15 @@ namespace CPN {
          * \param chanStride the distance in bytes between the beginning of
          * the channels in data.
          */
-        void RawEnqueue(const void *data, unsigned count,
-                unsigned numChans, unsigned chanStride);
+        void RawEnqueue(const void *data, QueueSize_t count,
+                unsigned numChans, QueueSize_t chanStride);
 
         /**
          * A version of RawEnqueue to use when there is only 1 channel.
          * \param data pointer to the memory to enqueue
          * \param count the number of bytes to enqueue
          */
-        void RawEnqueue(const void *data, unsigned count);
+        void RawEnqueue(const void *data, QueueSize_t count);
 
 
         /**
@@ -146,7 +148,7 @@ namespace CPN {
         /**
          * \return the number of bytes in the queue.
          */
-        unsigned Count() const;
+        QueueSize_t Count() const;
 
         /**
          * \return true if the queue is empty
@@ -157,7 +159,7 @@ namespace CPN {
          * \return the number of bytes we can add to the queue without
          * blocking.
          */
-        unsigned Freespace() const;
+        QueueSize_t Freespace() const;
 
         /**
          * \return true if the queue is full, false otherwise
@@ -168,26 +170,26 @@ namespace CPN {
          * \return the maximum threshold this queue supports
          * in bytes
          */
-        unsigned MaxThreshold() const;
+        QueueSize_t MaxThreshold() const;
 
         /**
          * \return the maximum number of bytes that can be
          * put in this queue.
          */
-        unsigned QueueLength() const;
+        QueueSize_t QueueLength() const;
 
         /**
          * \return The current enqueue channel stride.
          * This value is only guaranteed to be consistent inbetween a call
          * to GetEnqueuePtr and Enqueue.
          */
-        unsigned EnqueueChannelStride() const;
+        QueueSize_t EnqueueChannelStride() const;
         /**
          * \return The current dequeue channel stride.
          * This value is only guaranteed to be consistent inbetween a call
          * to GetDequeuePtr and Dequeue.
          */
-        unsigned DequeueChannelStride() const;
+        QueueSize_t DequeueChannelStride() const;
 
         /**
          * Ensure that this queue has at least queueLen bytes
@@ -199,7 +201,7 @@ namespace CPN {
          * \param queueLen the next queue length
          * \param maxThresh the next max threshold
          */
-        void Grow(unsigned queueLen, unsigned maxThresh);
+        void Grow(QueueSize_t queueLen, QueueSize_t maxThresh);
 
         /** \return the writer key associated with this queue */
         Key_t GetWriterKey() const { return writerkey; }
@@ -218,23 +220,35 @@ namespace CPN {
         void Unlock() const { lock.Unlock(); }
 
         /// \brief For unit tests
-        unsigned ReadRequest();
+        QueueSize_t ReadRequest();
         /// \brief For unit tests
-        unsigned WriteRequest();
+        QueueSize_t WriteRequest();
         bool IsReaderShutdown();
         bool IsWriterShutdown();
 
         /// For debugging ONLY!! Otherwise non deterministic output
         virtual void LogState();
 
-        unsigned NumEnqueued() const;
-        unsigned NumDequeued() const;
+        QueueSize_t NumEnqueued() const;
+        QueueSize_t NumDequeued() const;
+        /** \return the seconds the reader has spent waiting for data */
+        double ReadBlockedTime() const;
+        /** \return the seconds the writer has spent waiting for freespace */
+        double WriteBlockedTime() const;
+        /**
+         * \brief Fill in the queue part of the stats of one of its ends
+         * at once, everything but the port.
+         * \param stats the stats to fill in
+         * \param reader true for the reader end, false for the writer
+         */
+        virtual void GetEndpointStats(EndpointStats &stats, bool reader) const;
     protected:
         QueueBase(KernelBase *k, const SimpleQueueAttr &attr);
 
         virtual void WaitForData();
         virtual bool ReadBlocked();
-        void NotifyData();
+        /** \return true if a waiting fiber was woken */
+        bool NotifyData();
         virtual void WaitForFreespace();
         virtual bool WriteBlocked();
         void NotifyFreespace();
@@ -244,42 +258,50 @@ namespace CPN {
 
         virtual void Detect();
 
-        virtual const void *InternalGetRawDequeuePtr(unsigned thresh, unsigned chan) = 0;
-        virtual void InternalDequeue(unsigned count) = 0;
-        virtual void *InternalGetRawEnqueuePtr(unsigned thresh, unsigned chan) = 0;
-        virtual void InternalEnqueue(unsigned count) = 0;
+        virtual const void *InternalGetRawDequeuePtr(QueueSize_t thresh, unsigned chan) = 0;
+        virtual void InternalDequeue(QueueSize_t count) = 0;
+        virtual void *InternalGetRawEnqueuePtr(QueueSize_t thresh, unsigned chan) = 0;
+        virtual void InternalEnqueue(QueueSize_t count) = 0;
 
         virtual unsigned UnlockedNumChannels() const = 0;
-        virtual unsigned UnlockedCount() const = 0;
+        virtual QueueSize_t UnlockedCount() const = 0;
         virtual bool UnlockedEmpty() const = 0;
-        virtual unsigned UnlockedFreespace() const = 0;
+        virtual QueueSize_t UnlockedFreespace() const = 0;
         virtual bool UnlockedFull() const = 0;
-        virtual unsigned UnlockedMaxThreshold() const = 0;
-        virtual unsigned UnlockedQueueLength() const = 0;
-        virtual unsigned UnlockedEnqueueChannelStride() const = 0;
-        virtual unsigned UnlockedDequeueChannelStride() const = 0;
-        virtual void UnlockedGrow(unsigned queueLen, unsigned maxThresh) = 0;
+        virtual QueueSize_t UnlockedMaxThreshold() const = 0;
+        virtual QueueSize_t UnlockedQueueLength() const = 0;
+        virtual QueueSize_t UnlockedEnqueueChannelStride() const = 0;
+        virtual QueueSize_t UnlockedDequeueChannelStride() const = 0;
+        virtual void UnlockedGrow(QueueSize_t queueLen, QueueSize_t maxThresh) = 0;
         virtual void UnlockedShutdownReader();
         virtual void UnlockedShutdownWriter();
-        virtual unsigned UnlockedNumEnqueued() const = 0;
-        virtual unsigned UnlockedNumDequeued() const = 0;
+        virtual QueueSize_t UnlockedNumEnqueued() const = 0;
+        virtual QueueSize_t UnlockedNumDequeued() const = 0;
 
         const Key_t readerkey;
         const Key_t writerkey;
+        const Key_t readernodekey;
+        const Key_t writernodekey;
         bool readshutdown;
         bool writeshutdown;
-        unsigned readrequest;
-        unsigned writerequest;
-        unsigned enqueuethresh;
-        unsigned dequeuethresh;
+        QueueSize_t readrequest;
+        QueueSize_t writerequest;
+        QueueSize_t enqueuethresh;
+        QueueSize_t dequeuethresh;
         bool indequeue;
         bool inenqueue;
+        /// An enqueue woke the reader which has not run since
+        bool readerwoken;
         KernelBase *kernel;
         bool useD4R;
         Logger logger;
-        mutable PthreadMutex lock;
-        PthreadCondition cond;
+        mutable FiberMutex lock;
+        FiberCondition<PthreadCondition> cond;
         std::string datatype;
+        double readblocktime;
+        double writeblocktime;
+        const std::string name;
+        shared_ptr<GrowPolicy> growpolicy;
     };
 
     /**
@@ -55,7 +55,7 @@ namespace CPN {
          * 0 if the writer has disconnected and there is not enough
          * data to fill the request.
          */
-        const void* GetRawDequeuePtr(unsigned thresh, unsigned chan=0) {
+        const void* GetRawDequeuePtr(QueueSize_t thresh, unsigned chan=0) {
             return queue->GetRawDequeuePtr(thresh, chan);
         }
 
@@ -66,7 +66,7 @@ namespace CPN {
          * \param count the number of bytes to remove from the queue
          * \invariant count <= thresh from GetRawDequeuePtr
          */
-        void Dequeue(unsigned count) { queue->Dequeue(count); }
+        void Dequeue(QueueSize_t count) { queue->Dequeue(count); }
 
         /**
          * Dequeue data from the queue directly into the memory pointed to by
@@ -81,8 +81,8 @@ namespace CPN {
          * \return true on success or false if the writer has disconnected and
          * there is not enough data to fill the request.
          */
-        bool RawDequeue(void *data, unsigned count,
-                unsigned numChans, unsigned chanStride) {
+        bool RawDequeue(void *data, QueueSize_t count,
+                unsigned numChans, QueueSize_t chanStride) {
             return queue->RawDequeue(data, count, numChans, chanStride);
         }
 
@@ -93,7 +93,7 @@ namespace CPN {
          * \return true on success or false if the writer has disconnected and
          * there is not enough data to fill the request.
          */
-        bool RawDequeue(void *data, unsigned count) { return queue->RawDequeue(data, count); }
+        bool RawDequeue(void *data, QueueSize_t count) { return queue->RawDequeue(data, count); }
 
         /**
          * \return the number of channels supported by this queue.
@@ -103,9 +103,9 @@ namespace CPN {
         /**
          * \return the maximum threshold this queue supports.
          */
-        unsigned MaxThreshold() const { return queue->MaxThreshold(); }
+        QueueSize_t MaxThreshold() const { return queue->MaxThreshold(); }
 
-        unsigned QueueLength() const { return queue->QueueLength(); }
+        QueueSize_t QueueLength() const { return queue->QueueLength(); }
         /**
          * An accessor method for the number of elements currently in
          * the queue.
@@ -114,7 +114,7 @@ namespace CPN {
          *
          * \return the number of elements in the queue.
          */
-        unsigned Count() const { return queue->Count(); }
+        QueueSize_t Count() const { return queue->Count(); }
 
         /**
          * \warning This function violates the rules of CPN.
@@ -132,7 +132,7 @@ namespace CPN {
          * guaranteed to be consistent when called between calls to GetRawDequeuePtr
          * and Dequeue.
          */
-        unsigned ChannelStride() const { return queue->DequeueChannelStride(); }
+        QueueSize_t ChannelStride() const { return queue->DequeueChannelStride(); }
 
         /**
          * \return the key associated with this endpoint
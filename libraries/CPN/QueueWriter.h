@@ -57,7 +57,7 @@ namespace CPN {
          * blocks until thresh bytes available
          * \throws BrokenQueueException if the reader is released
          */
-        void* GetRawEnqueuePtr(unsigned thresh, unsigned chan=0) {
+        void* GetRawEnqueuePtr(QueueSize_t thresh, unsigned chan=0) {
             return queue->GetRawEnqueuePtr(thresh, chan);
         }
 
@@ -72,7 +72,7 @@ namespace CPN {
          * \param count the number of bytes to be placed in the buffer
          * \invariant count <= thresh from GetRawEnqueuePtr
          */
-        void Enqueue(unsigned count) { queue->Enqueue(count); }
+        void Enqueue(QueueSize_t count) { queue->Enqueue(count); }
 
         /**
          * This function shall be equivalent to
@@ -90,8 +90,8 @@ namespace CPN {
          * the channels in data.
          * \throws BrokenQueueException if the reader is released
          */
-        void RawEnqueue(const void *data, unsigned count,
-                unsigned numChans, unsigned chanStride) {
+        void RawEnqueue(const void *data, QueueSize_t count,
+                unsigned numChans, QueueSize_t chanStride) {
             queue->RawEnqueue(data, count, numChans, chanStride);
         }
 
@@ -101,7 +101,7 @@ namespace CPN {
          * \param count the number of bytes to enqueue
          * \throws BrokenQueueException if the reader is released
          */
-        void RawEnqueue(const void *data, unsigned count) { queue->RawEnqueue(data, count); }
+        void RawEnqueue(const void *data, QueueSize_t count) { queue->RawEnqueue(data, count); }
 
         /**
          * \return the number of channels supported by this queue.
@@ -111,16 +111,16 @@ namespace CPN {
         /**
          * \return the maximum threshold this queue supports.
          */
-        unsigned MaxThreshold() const { return queue->MaxThreshold(); }
+        QueueSize_t MaxThreshold() const { return queue->MaxThreshold(); }
 
-        unsigned QueueLength() const { return queue->QueueLength(); }
+        QueueSize_t QueueLength() const { return queue->QueueLength(); }
         /**
          * Get the space available in elements.
          * \warning This function violates the rules of CPN.
          * \return the number of bytes we can add to the queue without
          * blocking.
          */
-        unsigned Freespace() const { return queue->Freespace(); }
+        QueueSize_t Freespace() const { return queue->Freespace(); }
 
         /**
          * Test if the queue is currently full.
@@ -134,7 +134,7 @@ namespace CPN {
          * guaranteed to be consistent when called between calls to GetRawEnqueuePtr
          * and Enqueue.
          */
-        unsigned ChannelStride() const { return queue->EnqueueChannelStride(); }
+        QueueSize_t ChannelStride() const { return queue->EnqueueChannelStride(); }
 
         /**
          * \return the typename for this queue
@@ -59,6 +59,8 @@ namespace CPN {
         RCTXMT_SIGNAL_NODE_END,
         RCTXMT_GET_NODE_INFO,
         RCTXMT_GET_NUM_NODE_LIVE,
+        RCTXMT_SET_REPLICAS,
+        RCTXMT_GET_REPLICAS,
         /** @} */
 
         /**
@@ -81,8 +83,13 @@ namespace CPN {
          * @{
          */
         RCTXMT_TERMINATE,
-        RCTXMT_LOG
+        RCTXMT_LOG,
         /** @} */
+
+        /**
+         * Many requests in one message, see RemoteContextServer.h.
+         */
+        RCTXMT_BATCH
     };
 }
 #endif
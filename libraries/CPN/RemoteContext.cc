@@ -56,6 +56,7 @@ void RemoteContext::SendMessage(const Variant &msg) {
     if (!sock.Closed() && !endwrite) {
         std::string message = VariantToJSON(msg);
         //printf("<<< %s\n", message.c_str());
+        CPN::FiberBlockingCall blocking;
         sock.Write(message.data(), message.size());
     }
 }
@@ -97,13 +98,13 @@ void *RemoteContext::EntryPoint() {
 }
 
 void RemoteContext::EndWrite() {
-    PthreadMutexProtected alock(lock);
+    CPN::AutoFiberLock alock(lock);
     endwrite = true;
     sock.ShutdownWrite();
 }
 
 bool RemoteContext::IsEndWrite() {
-    PthreadMutexProtected alock(lock);
+    CPN::AutoFiberLock alock(lock);
     return endwrite;
 }
 
@@ -31,6 +31,7 @@
 #include "PthreadFunctional.h"
 #include "ErrnoException.h"
 #include <stdexcept>
+#include <set>
 
 namespace CPN {
 
@@ -46,17 +47,17 @@ namespace CPN {
     }
 
     int RemoteContextClient::LogLevel() const {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         return loglevel;
     }
 
     int RemoteContextClient:: LogLevel(int level) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         return loglevel = level;
     }
 
     void RemoteContextClient::Log(int level, const std::string &logmsg) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         if (level >= loglevel) {
             Variant msg(Variant::ObjectType);
             msg["type"] = RCTXMT_LOG;
@@ -67,7 +68,7 @@ namespace CPN {
 
     Key_t RemoteContextClient::SetupKernel(const std::string &name, const std::string &hostname,
             const std::string &servname, KernelBase *kernel) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         if (!kernel) { throw std::invalid_argument("Must have non null Kernel."); }
         Variant msg(Variant::ObjectType);
@@ -79,14 +80,19 @@ namespace CPN {
         if (!reply["success"].IsTrue()) {
            throw std::invalid_argument("Cannot create two kernels with the same name");
         }
+        CacheKernel(reply["kernelinfo"]);
         Key_t key = reply["kernelinfo"]["key"].AsNumber<Key_t>();
         kernels.insert(std::make_pair(key, kernel));
         return key;
     }
 
     Key_t RemoteContextClient::GetKernelKey(const std::string &kernel) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
+        NameKeyMap::iterator entry = kernelnames.find(kernel);
+        if (entry != kernelnames.end()) {
+            return entry->second;
+        }
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_GET_KERNEL_INFO;
         msg["name"] = kernel;
@@ -94,48 +100,40 @@ namespace CPN {
         if (!reply["success"].IsTrue()) {
             throw std::invalid_argument("No such kernel");
         }
+        CacheKernel(reply["kernelinfo"]);
         return reply["kernelinfo"]["key"].AsNumber<Key_t>();
     }
 
     std::string RemoteContextClient::GetKernelName(Key_t kernelkey) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
-        Variant msg(Variant::ObjectType);
-        msg["type"] = RCTXMT_GET_KERNEL_INFO;
-        msg["key"] = kernelkey;
-        Variant reply = RemoteCall(msg);
-        if (!reply["success"].IsTrue()) {
-            throw std::invalid_argument("No such kernel");
-        }
-        return reply["kernelinfo"]["name"].AsString();
+        return LookupKernel(kernelkey).name;
     }
 
     void RemoteContextClient::GetKernelConnectionInfo(Key_t kernelkey, std::string &hostname, std::string &servname) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
-        Variant msg(Variant::ObjectType);
-        msg["type"] = RCTXMT_GET_KERNEL_INFO;
-        msg["key"] = kernelkey;
-        Variant reply = RemoteCall(msg);
-        if (!reply["success"].IsTrue()) {
-            throw std::invalid_argument("No such kernel");
-        }
-        Variant kernelinfo = reply["kernelinfo"];
-        hostname = kernelinfo["hostname"].AsString();
-        servname = kernelinfo["servname"].AsString();
+        KernelFacts facts = LookupKernel(kernelkey);
+        hostname = facts.hostname;
+        servname = facts.servname;
     }
 
     void RemoteContextClient::SignalKernelEnd(Key_t kernelkey) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_SIGNAL_KERNEL_END;
         msg["key"] = kernelkey;
         SendMessage(msg);
         kernels.erase(kernelkey);
+        std::map<Key_t, KernelFacts>::iterator entry = kernelcache.find(kernelkey);
+        if (entry != kernelcache.end()) {
+            kernelnames.erase(entry->second.name);
+            kernelcache.erase(entry);
+        }
     }
 
     Key_t RemoteContextClient::WaitForKernelStart(const std::string &kernel) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         GenericWaiterPtr genwait = NewGenericWaiter();
         Variant msg(Variant::ObjectType);
@@ -144,6 +142,7 @@ namespace CPN {
         Variant reply = RemoteCall(msg);
         if (reply["success"].IsTrue()) {
             Variant kernelinfo = reply["kernelinfo"];
+            CacheKernel(kernelinfo);
             if (kernelinfo["live"].IsTrue()) {
                 return kernelinfo["key"].AsNumber<Key_t>();
             }
@@ -166,7 +165,7 @@ namespace CPN {
     }
 
     void RemoteContextClient::SignalKernelStart(Key_t kernelkey) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         Variant msg(Variant::ObjectType);
         msg["key"] = kernelkey;
@@ -175,25 +174,25 @@ namespace CPN {
     }
 
     void RemoteContextClient::SendCreateWriter(Key_t kernelkey, const SimpleQueueAttr &attr) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         SendQueueMsg(kernelkey, RCTXMT_CREATE_WRITER, attr);
     }
 
     void RemoteContextClient::SendCreateReader(Key_t kernelkey, const SimpleQueueAttr &attr) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         SendQueueMsg(kernelkey, RCTXMT_CREATE_READER, attr);
     }
 
     void RemoteContextClient::SendCreateQueue(Key_t kernelkey, const SimpleQueueAttr &attr) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         SendQueueMsg(kernelkey, RCTXMT_CREATE_QUEUE, attr);
     }
 
     void RemoteContextClient::SendCreateNode(Key_t kernelkey, const NodeAttr &attr) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         Variant msg(Variant::ObjectType);
         msg["msgtype"] = "kernel";
@@ -209,6 +208,18 @@ namespace CPN {
                 e = params.end(); i != e; ++i) {
             nodeattr["param"][i->first] = i->second;
         }
+        Variant cpus(Variant::ArrayType);
+        for (std::vector<unsigned>::const_iterator itr = attr.GetCPUs().begin();
+                itr != attr.GetCPUs().end(); ++itr) {
+            cpus.Append(*itr);
+        }
+        nodeattr["cpus"] = cpus;
+        nodeattr["numanode"] = attr.GetNUMANode();
+        nodeattr["schedpolicy"] = attr.GetSchedulePolicy();
+        nodeattr["priority"] = attr.GetPriority();
+        nodeattr["stacksize"] = attr.GetStackSize();
+        nodeattr["fusable"] = attr.GetFusable();
+        nodeattr["fusiongroup"] = attr.GetFusionGroup();
         nodeattr["key"] = attr.GetKey();
         msg["nodeattr"] = nodeattr;
         SendMessage(msg);
@@ -225,6 +236,24 @@ namespace CPN {
                 attr.SetParam(i->first, i->second.AsString());
             }
         }
+        if (msg["cpus"].IsArray()) {
+            for (unsigned i = 0; i < msg["cpus"].Size(); ++i) {
+                attr.AddCPU(msg["cpus"].At(i).AsUnsigned());
+            }
+        }
+        if (msg["numanode"].IsNumber()) {
+            attr.SetNUMANode(msg["numanode"].AsInt());
+        }
+        if (msg["schedpolicy"].IsNumber()) {
+            attr.SetSchedulePolicy(msg["schedpolicy"].AsInt());
+            attr.SetPriority(msg["priority"].AsInt());
+        }
+        if (msg["stacksize"].IsNumber()) {
+            attr.SetStackSize(msg["stacksize"].AsNumber<unsigned long>());
+        }
+        if (msg["fusable"].IsTrue()) {
+            attr.SetFusionGroup(msg["fusiongroup"].AsString());
+        }
         return attr;
     }
 
@@ -244,7 +273,24 @@ namespace CPN {
         queueattr["readernodekey"] = attr.GetReaderNodeKey();
         queueattr["writernodekey"] = attr.GetWriterNodeKey();
         queueattr["alpha"] = attr.GetAlpha();
+        queueattr["adaptivealpha"] = attr.GetAdaptiveAlpha();
         queueattr["maxwritethreshold"] = attr.GetMaxWriteThreshold();
+        queueattr["numconnections"] = attr.GetNumConnections();
+        queueattr["linkrate"] = attr.GetLinkRate();
+        queueattr["memorynode"] = attr.GetMemoryNode();
+        queueattr["name"] = attr.GetName();
+        Variant localaddrs(Variant::ArrayType);
+        for (std::vector<std::string>::const_iterator itr = attr.GetLocalAddresses().begin();
+                itr != attr.GetLocalAddresses().end(); ++itr) {
+            localaddrs.Append(*itr);
+        }
+        queueattr["localaddresses"] = localaddrs;
+        Variant readeraddrs(Variant::ArrayType);
+        for (std::vector<std::string>::const_iterator itr = attr.GetReaderAddresses().begin();
+                itr != attr.GetReaderAddresses().end(); ++itr) {
+            readeraddrs.Append(*itr);
+        }
+        queueattr["readeraddresses"] = readeraddrs;
         msg["queueattr"] = queueattr;
         SendMessage(msg);
     }
@@ -253,20 +299,47 @@ namespace CPN {
         SimpleQueueAttr attr;
         attr.SetHint(msg["queuehint"].AsNumber<CPN::QueueHint_t>());
         attr.SetDatatype(msg["datatype"].AsString());
-        attr.SetLength(msg["queueLength"].AsUnsigned());
-        attr.SetMaxThreshold(msg["maxThreshold"].AsUnsigned());
+        attr.SetLength(msg["queueLength"].AsNumber<QueueSize_t>());
+        attr.SetMaxThreshold(msg["maxThreshold"].AsNumber<QueueSize_t>());
         attr.SetNumChannels(msg["numChannels"].AsUnsigned());
         attr.SetReaderKey(msg["readerkey"].AsNumber<Key_t>());
         attr.SetWriterKey(msg["writerkey"].AsNumber<Key_t>());
         attr.SetReaderNodeKey(msg["readernodekey"].AsNumber<Key_t>());
         attr.SetWriterNodeKey(msg["writernodekey"].AsNumber<Key_t>());
         attr.SetAlpha(msg["alpha"].AsDouble());
-        attr.SetMaxWriteThreshold(msg["maxwritethreshold"].AsUnsigned());
+        attr.SetAdaptiveAlpha(msg["adaptivealpha"].IsTrue());
+        attr.SetMaxWriteThreshold(msg["maxwritethreshold"].AsNumber<QueueSize_t>());
+        if (msg["numconnections"].IsNumber()) {
+            attr.SetNumConnections(msg["numconnections"].AsUnsigned());
+        }
+        if (msg["linkrate"].IsNumber()) {
+            attr.SetLinkRate(msg["linkrate"].AsDouble());
+        }
+        if (msg["memorynode"].IsNumber()) {
+            attr.SetMemoryNode(msg["memorynode"].AsInt());
+        }
+        if (msg["name"].IsString()) {
+            attr.SetName(msg["name"].AsString());
+        }
+        if (msg["localaddresses"].IsArray()) {
+            std::vector<std::string> localaddrs;
+            for (unsigned i = 0; i < msg["localaddresses"].Size(); ++i) {
+                localaddrs.push_back(msg["localaddresses"].At(i).AsString());
+            }
+            attr.SetLocalAddresses(localaddrs);
+        }
+        if (msg["readeraddresses"].IsArray()) {
+            std::vector<std::string> readeraddrs;
+            for (unsigned i = 0; i < msg["readeraddresses"].Size(); ++i) {
+                readeraddrs.push_back(msg["readeraddresses"].At(i).AsString());
+            }
+            attr.SetReaderAddresses(readeraddrs);
+        }
         return attr;
     }
 
     Key_t RemoteContextClient::CreateNodeKey(Key_t kernelkey, const std::string &nodename) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_CREATE_NODE_KEY;
@@ -276,12 +349,67 @@ namespace CPN {
         if (!(reply["success"].IsTrue())) {
             throw std::invalid_argument("Node " + nodename + " already exists.");
         }
+        CacheNode(reply["nodeinfo"]);
         return reply["nodeinfo"]["key"].AsNumber<Key_t>();
     }
 
+    std::vector<Key_t> RemoteContextClient::CreateNodeKeys(const std::vector<std::pair<Key_t, std::string> > &nodes) {
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        // Check all the names first so a taken one allocates nothing
+        std::vector<Variant> msgs;
+        for (unsigned i = 0; i < nodes.size(); ++i) {
+            if (nodenames.find(nodes[i].second) != nodenames.end()) {
+                throw std::invalid_argument("Node " + nodes[i].second + " already exists.");
+            }
+            Variant msg(Variant::ObjectType);
+            msg["type"] = RCTXMT_GET_NODE_INFO;
+            msg["name"] = nodes[i].second;
+            msgs.push_back(msg);
+        }
+        std::vector<ReplyPtr> replies = RemoteCallBatch(msgs);
+        std::string taken;
+        for (unsigned i = 0; i < replies.size(); ++i) {
+            Variant reply = WaitReply(replies[i]);
+            if (reply["success"].IsTrue() && taken.empty()) {
+                taken = nodes[i].second;
+            }
+        }
+        if (!taken.empty()) {
+            throw std::invalid_argument("Node " + taken + " already exists.");
+        }
+        msgs.clear();
+        for (unsigned i = 0; i < nodes.size(); ++i) {
+            Variant msg(Variant::ObjectType);
+            msg["type"] = RCTXMT_CREATE_NODE_KEY;
+            msg["kernelkey"] = nodes[i].first;
+            msg["name"] = nodes[i].second;
+            msgs.push_back(msg);
+        }
+        replies = RemoteCallBatch(msgs);
+        std::vector<Key_t> keys;
+        for (unsigned i = 0; i < replies.size(); ++i) {
+            Variant reply = WaitReply(replies[i]);
+            if (reply["success"].IsTrue()) {
+                CacheNode(reply["nodeinfo"]);
+                keys.push_back(reply["nodeinfo"]["key"].AsNumber<Key_t>());
+            } else if (taken.empty()) {
+                taken = nodes[i].second;
+            }
+        }
+        if (!taken.empty()) {
+            throw std::invalid_argument("Node " + taken + " already exists.");
+        }
+        return keys;
+    }
+
     Key_t RemoteContextClient::GetNodeKey(const std::string &nodename) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
+        NameKeyMap::iterator entry = nodenames.find(nodename);
+        if (entry != nodenames.end()) {
+            return entry->second;
+        }
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_GET_NODE_INFO;
         msg["name"] = nodename;
@@ -289,25 +417,18 @@ namespace CPN {
         if (!(reply["success"].IsTrue())) {
             throw std::invalid_argument("No such node");
         }
-        ASSERT(reply["success"].IsTrue(), "msg: %s", VariantToJSON(reply).c_str());
+        CacheNode(reply["nodeinfo"]);
         return reply["nodeinfo"]["key"].AsNumber<Key_t>();
     }
 
     std::string RemoteContextClient::GetNodeName(Key_t nodekey) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
-        Variant msg(Variant::ObjectType);
-        msg["type"] = RCTXMT_GET_NODE_INFO;
-        msg["key"] = nodekey;
-        Variant reply = RemoteCall(msg);
-        if (!(reply["success"].IsTrue())) {
-            throw std::invalid_argument("No such node");
-        }
-        return reply["nodeinfo"]["name"].AsString();
+        return LookupNode(nodekey).name;
     }
 
     void RemoteContextClient::SignalNodeStart(Key_t nodekey) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_SIGNAL_NODE_START;
@@ -316,7 +437,7 @@ namespace CPN {
     }
 
     void RemoteContextClient::SignalNodeEnd(Key_t nodekey) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_SIGNAL_NODE_END;
         msg["key"] = nodekey;
@@ -324,8 +445,12 @@ namespace CPN {
     }
 
     Key_t RemoteContextClient::WaitForNodeStart(const std::string &nodename) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
+        NameKeyMap::iterator cached = nodenames.find(nodename);
+        if (cached != nodenames.end() && nodecache[cached->second].started) {
+            return cached->second;
+        }
         GenericWaiterPtr genwait = NewGenericWaiter();
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_GET_NODE_INFO;
@@ -334,6 +459,7 @@ namespace CPN {
 
         if (reply["success"].IsTrue()) {
             Variant nodeinfo = reply["nodeinfo"];
+            CacheNode(nodeinfo);
             if (nodeinfo["started"].IsTrue()) {
                 return nodeinfo["key"].AsNumber<Key_t>();
             }
@@ -356,7 +482,7 @@ namespace CPN {
     }
 
     void RemoteContextClient::WaitForNodeEnd(const std::string &nodename) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         if (shutdown) { return; }
         GenericWaiterPtr genwait = NewGenericWaiter();
 
@@ -370,6 +496,7 @@ namespace CPN {
            return;
        }
         if (reply["success"].IsTrue()) {
+            CacheNode(reply["nodeinfo"]);
             if (reply["nodeinfo"]["dead"].IsTrue()) {
                 return;
             }
@@ -392,7 +519,7 @@ namespace CPN {
     }
 
     void RemoteContextClient::WaitForAllNodeEnd() {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         if (shutdown) { return; }
         GenericWaiterPtr genwait = NewGenericWaiter();
         Variant msg(Variant::ObjectType);
@@ -423,68 +550,150 @@ namespace CPN {
         }
     }
 
-    Key_t RemoteContextClient::GetNodeKernel(Key_t nodekey) {
-        PthreadMutexProtected plock(lock);
+    bool RemoteContextClient::SetReplicas(const NodeAttr &attr) {
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         Variant msg(Variant::ObjectType);
-        msg["type"] = RCTXMT_GET_NODE_INFO;
-        msg["key"] = nodekey;
+        msg["type"] = RCTXMT_SET_REPLICAS;
+        Variant group(Variant::ObjectType);
+        group["name"] = attr.GetName();
+        group["kernel"] = attr.GetKernel();
+        group["kernelkey"] = attr.GetKernelKey();
+        group["replicas"] = attr.GetReplicas();
+        group["scattersize"] = attr.GetScatterSize();
+        group["scatteroverlap"] = attr.GetScatterOverlap();
+        group["gathersize"] = attr.GetGatherSize();
+        msg["group"] = group;
         Variant reply = RemoteCall(msg);
-        if (!(reply["success"].IsTrue())) {
-            throw std::invalid_argument("No such node");
-        }
-        return reply["nodeinfo"]["kernelkey"].AsNumber<Key_t>();
+        return reply["success"].IsTrue();
     }
 
+    bool RemoteContextClient::GetReplicas(const std::string &nodename, NodeAttr &attr) {
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        Variant msg(Variant::ObjectType);
+        msg["type"] = RCTXMT_GET_REPLICAS;
+        msg["name"] = nodename;
+        Variant reply = RemoteCall(msg);
+        if (!reply["success"].IsTrue()) { return false; }
+        const Variant group = reply["group"];
+        attr = NodeAttr(group["name"].AsString(), "");
+        attr.SetKernel(group["kernel"].AsString());
+        attr.SetKernelKey(group["kernelkey"].AsNumber<Key_t>());
+        attr.SetReplicas(group["replicas"].AsUnsigned());
+        attr.SetScatterBlock(group["scattersize"].AsUnsigned(), group["scatteroverlap"].AsUnsigned());
+        attr.SetGatherBlock(group["gathersize"].AsUnsigned());
+        return true;
+    }
+
+    Key_t RemoteContextClient::GetNodeKernel(Key_t nodekey) {
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupNode(nodekey).kernelkey;
+    }
+
+    void RemoteContextClient::PrefetchEndpoints(const std::vector<std::pair<std::string, std::string> > &readers,
+            const std::vector<std::pair<std::string, std::string> > &writers) {
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        // First the nodes that are not known to have started
+        std::vector<std::pair<std::string, std::string> > ports(readers);
+        ports.insert(ports.end(), writers.begin(), writers.end());
+        std::vector<Variant> msgs;
+        std::set<std::string> asked;
+        for (unsigned i = 0; i < ports.size(); ++i) {
+            const std::string &nodename = ports[i].first;
+            NameKeyMap::iterator cached = nodenames.find(nodename);
+            if (cached != nodenames.end() && nodecache[cached->second].started) { continue; }
+            if (!asked.insert(nodename).second) { continue; }
+            Variant msg(Variant::ObjectType);
+            msg["type"] = RCTXMT_GET_NODE_INFO;
+            msg["name"] = nodename;
+            msgs.push_back(msg);
+        }
+        std::vector<ReplyPtr> replies = RemoteCallBatch(msgs);
+        for (unsigned i = 0; i < replies.size(); ++i) {
+            Variant reply = WaitReply(replies[i]);
+            if (reply["success"].IsTrue()) {
+                CacheNode(reply["nodeinfo"]);
+            }
+        }
+        // Then the endpoints of the nodes that exist
+        msgs.clear();
+        std::vector<std::pair<PortKeyMap*, std::pair<Key_t, std::string> > > asking;
+        for (unsigned i = 0; i < ports.size(); ++i) {
+            NameKeyMap::iterator node = nodenames.find(ports[i].first);
+            if (node == nodenames.end()) { continue; }
+            const bool reader = i < readers.size();
+            PortKeyMap &portkeys = (reader ? readerkeys : writerkeys);
+            const std::pair<Key_t, std::string> port(node->second, ports[i].second);
+            if (portkeys.find(port) != portkeys.end()) { continue; }
+            Variant msg(Variant::ObjectType);
+            msg["type"] = (reader ? RCTXMT_GET_CREATE_READER_KEY : RCTXMT_GET_CREATE_WRITER_KEY);
+            msg["nodekey"] = port.first;
+            msg["name"] = port.second;
+            msgs.push_back(msg);
+            asking.push_back(std::make_pair(&portkeys, port));
+        }
+        replies = RemoteCallBatch(msgs);
+        for (unsigned i = 0; i < replies.size(); ++i) {
+            Variant reply = WaitReply(replies[i]);
+            if (reply["success"].IsTrue()) {
+                CacheEndpoint(reply["endpointinfo"]);
+                asking[i].first->insert(std::make_pair(asking[i].second,
+                            reply["endpointinfo"]["key"].AsNumber<Key_t>()));
+            }
+        }
+    }
 
     Key_t RemoteContextClient::GetCreateReaderKey(Key_t nodekey, const std::string &portname) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         return GetCreateEndpointKey(RCTXMT_GET_CREATE_READER_KEY, nodekey, portname);
     }
 
     Key_t RemoteContextClient::GetReaderNode(Key_t portkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_READER_INFO, portkey);
-        return info["nodekey"].AsNumber<Key_t>();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_READER_INFO, portkey, false).nodekey;
     }
 
     Key_t RemoteContextClient::GetReaderKernel(Key_t portkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_READER_INFO, portkey);
-        return info["kernelkey"].AsNumber<Key_t>();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_READER_INFO, portkey, false).kernelkey;
     }
 
     std::string RemoteContextClient::GetReaderName(Key_t portkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_READER_INFO, portkey);
-        return info["name"].AsString();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_READER_INFO, portkey, false).name;
     }
 
     Key_t RemoteContextClient::GetCreateWriterKey(Key_t nodekey, const std::string &portname) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         return GetCreateEndpointKey(RCTXMT_GET_CREATE_WRITER_KEY, nodekey, portname);
     }
 
     Key_t RemoteContextClient::GetWriterNode(Key_t portkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_WRITER_INFO, portkey);
-        return info["nodekey"].AsNumber<Key_t>();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_WRITER_INFO, portkey, false).nodekey;
     }
 
     Key_t RemoteContextClient::GetWriterKernel(Key_t portkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_WRITER_INFO, portkey);
-        return info["kernelkey"].AsNumber<Key_t>();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_WRITER_INFO, portkey, false).kernelkey;
     }
 
     std::string RemoteContextClient::GetWriterName(Key_t portkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_WRITER_INFO, portkey);
-        return info["name"].AsString();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_WRITER_INFO, portkey, false).name;
     }
 
     void RemoteContextClient::ConnectEndpoints(Key_t writerkey, Key_t readerkey, const std::string &qname) {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         InternalCheckTerminated();
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_CONNECT_ENDPOINTS;
@@ -492,22 +701,24 @@ namespace CPN {
         msg["writerkey"] = writerkey;
         msg["qname"] = qname;
         SendMessage(msg);
+        // The opposing keys are left to the server, the next lookup
+        // of a connection that is not cached asks for it
     }
 
     Key_t RemoteContextClient::GetReadersWriter(Key_t readerkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_READER_INFO, readerkey);
-        return info["writerkey"].AsNumber<Key_t>();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_READER_INFO, readerkey, true).opposingkey;
     }
 
     Key_t RemoteContextClient::GetWritersReader(Key_t writerkey) {
-        PthreadMutexProtected plock(lock);
-        Variant info = GetEndpointInfo(RCTXMT_GET_WRITER_INFO, writerkey);
-        return info["readerkey"].AsNumber<Key_t>();
+        AutoFiberLock plock(lock);
+        InternalCheckTerminated();
+        return LookupEndpoint(RCTXMT_GET_WRITER_INFO, writerkey, true).opposingkey;
     }
 
     void RemoteContextClient::Terminate() {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         if (!shutdown) {
             InternalTerminate();
             Variant msg(Variant::ObjectType);
@@ -519,7 +730,7 @@ namespace CPN {
     void *RemoteContextClient::TerminateThread() {
         KernelMap mapcopy;
         {
-            PthreadMutexProtected plock(lock);
+            AutoFiberLock plock(lock);
             mapcopy = kernels;
         }
         KernelMap::iterator itr, end;
@@ -537,7 +748,7 @@ namespace CPN {
         shutdown = true;
         WaiterMap::iterator cwitr = callwaiters.begin();
         while (cwitr != callwaiters.end()) {
-            cwitr->second->cond.Signal();
+            cwitr->second->Cancel();
             ++cwitr;
         }
         WaiterList::iterator gwitr;
@@ -554,7 +765,7 @@ namespace CPN {
     }
 
     bool RemoteContextClient::IsTerminated() {
-        PthreadMutexProtected plock(lock);
+        AutoFiberLock plock(lock);
         return shutdown;
     }
 
@@ -568,10 +779,6 @@ namespace CPN {
         }
     }
 
-    void RemoteContextClient::AddWaiter(WaiterInfo *info) {
-        callwaiters.insert(std::make_pair(info->waiterid, info));
-    }
-
     RemoteContextClient::GenericWaiterPtr RemoteContextClient::NewGenericWaiter() {
         GenericWaiterPtr gw = GenericWaiterPtr(new GenericWaiter);
         waiters.push_back(gw);
@@ -583,7 +790,14 @@ namespace CPN {
     }
 
     void RemoteContextClient::DispatchMessage(const Variant &msg) {
-        AutoLock<PthreadMutex> plock(lock);
+        if (msg["msgtype"].IsString() && msg["msgtype"].AsString() == "batch") {
+            Variant messages = msg["messages"];
+            for (unsigned i = 0; i < messages.Size(); ++i) {
+                DispatchMessage(messages.At(i));
+            }
+            return;
+        }
+        AutoFiberLock plock(lock);
         if (msg["type"].AsNumber<RCTXMT_t>() == RCTXMT_TERMINATE) {
             InternalTerminate();
             return;
@@ -597,11 +811,15 @@ namespace CPN {
             WaiterMap::iterator entry;
             entry = callwaiters.find(tranid);
             ASSERT(entry != callwaiters.end());
-            entry->second->msg = msg;
-            entry->second->signaled = true;
-            entry->second->cond.Signal();
+            entry->second->Set(msg);
             callwaiters.erase(entry);
         } else if (msgtype == "broadcast") {
+            if (msg["kernelinfo"].IsObject()) {
+                CacheKernel(msg["kernelinfo"]);
+            }
+            if (msg["nodeinfo"].IsObject()) {
+                CacheNode(msg["nodeinfo"]);
+            }
             WaiterList::iterator entry;
             entry = waiters.begin();
             while (entry != waiters.end()) {
@@ -648,6 +866,12 @@ namespace CPN {
 
     Key_t RemoteContextClient::GetCreateEndpointKey(RCTXMT_t msgtype, Key_t nodekey, const std::string &portname) {
         InternalCheckTerminated();
+        PortKeyMap &ports = (msgtype == RCTXMT_GET_CREATE_READER_KEY ? readerkeys : writerkeys);
+        const std::pair<Key_t, std::string> port(nodekey, portname);
+        PortKeyMap::iterator entry = ports.find(port);
+        if (entry != ports.end()) {
+            return entry->second;
+        }
         Variant msg(Variant::ObjectType);
         msg["type"] = msgtype;
         msg["nodekey"] = nodekey;
@@ -656,7 +880,10 @@ namespace CPN {
         if (!reply["success"].IsTrue()) {
             throw std::invalid_argument("No such port");
         }
-        return reply["endpointinfo"]["key"].AsNumber<Key_t>();
+        CacheEndpoint(reply["endpointinfo"]);
+        const Key_t key = reply["endpointinfo"]["key"].AsNumber<Key_t>();
+        ports.insert(std::make_pair(port, key));
+        return key;
     }
 
     Variant RemoteContextClient::GetEndpointInfo(RCTXMT_t msgtype, Key_t portkey) {
@@ -669,15 +896,165 @@ namespace CPN {
         return reply["endpointinfo"];
     }
 
-    Variant RemoteContextClient::RemoteCall(Variant msg) {
-        WaiterInfo winfo(NewTranID());
-        AddWaiter(&winfo);
-        msg["msgid"] = winfo.waiterid;
+    void RemoteContextClient::CacheKernel(const Variant &kernelinfo) {
+        const Key_t key = kernelinfo["key"].AsNumber<Key_t>();
+        if (kernelcache.find(key) == kernelcache.end()) {
+            KernelFacts facts;
+            facts.name = kernelinfo["name"].AsString();
+            facts.hostname = kernelinfo["hostname"].AsString();
+            facts.servname = kernelinfo["servname"].AsString();
+            kernelcache.insert(std::make_pair(key, facts));
+            kernelnames.insert(std::make_pair(facts.name, key));
+        }
+    }
+
+    RemoteContextClient::NodeFacts RemoteContextClient::CacheNode(const Variant &nodeinfo) {
+        const Key_t key = nodeinfo["key"].AsNumber<Key_t>();
+        NodeFacts facts;
+        facts.name = nodeinfo["name"].AsString();
+        facts.kernelkey = nodeinfo["kernelkey"].AsNumber<Key_t>();
+        facts.started = nodeinfo["started"].IsTrue();
+        if (nodeinfo["dead"].IsTrue()) {
+            // A dead node never comes back, nothing about it is kept
+            ForgetNode(key);
+            return facts;
+        }
+        std::map<Key_t, NodeFacts>::iterator entry = nodecache.find(key);
+        if (entry == nodecache.end()) {
+            entry = nodecache.insert(std::make_pair(key, facts)).first;
+            nodenames.insert(std::make_pair(facts.name, key));
+        }
+        // A message may be older than what is cached, started never goes back
+        entry->second.started = entry->second.started || facts.started;
+        return entry->second;
+    }
+
+    void RemoteContextClient::ForgetNode(Key_t nodekey) {
+        std::map<Key_t, NodeFacts>::iterator node = nodecache.find(nodekey);
+        if (node != nodecache.end()) {
+            nodenames.erase(node->second.name);
+            nodecache.erase(node);
+        }
+        std::map<Key_t, EndpointFacts>::iterator endpoint = endpointcache.begin();
+        while (endpoint != endpointcache.end()) {
+            if (endpoint->second.nodekey == nodekey) {
+                endpointcache.erase(endpoint++);
+            } else {
+                ++endpoint;
+            }
+        }
+        PortKeyMap *portkeys[] = { &readerkeys, &writerkeys };
+        for (unsigned i = 0; i < 2; ++i) {
+            PortKeyMap::iterator begin = portkeys[i]->lower_bound(std::make_pair(nodekey, std::string()));
+            PortKeyMap::iterator end = begin;
+            while (end != portkeys[i]->end() && end->first.first == nodekey) { ++end; }
+            portkeys[i]->erase(begin, end);
+        }
+    }
+
+    void RemoteContextClient::CacheEndpoint(const Variant &endpointinfo) {
+        const Key_t key = endpointinfo["key"].AsNumber<Key_t>();
+        std::map<Key_t, EndpointFacts>::iterator entry = endpointcache.find(key);
+        if (entry == endpointcache.end()) {
+            EndpointFacts facts;
+            facts.name = endpointinfo["name"].AsString();
+            facts.nodekey = endpointinfo["nodekey"].AsNumber<Key_t>();
+            facts.kernelkey = endpointinfo["kernelkey"].AsNumber<Key_t>();
+            facts.opposingkey = 0;
+            entry = endpointcache.insert(std::make_pair(key, facts)).first;
+        }
+        if (endpointinfo["writerkey"].IsNumber()) {
+            entry->second.opposingkey = endpointinfo["writerkey"].AsNumber<Key_t>();
+        } else if (endpointinfo["readerkey"].IsNumber()) {
+            entry->second.opposingkey = endpointinfo["readerkey"].AsNumber<Key_t>();
+        }
+    }
+
+    RemoteContextClient::KernelFacts RemoteContextClient::LookupKernel(Key_t kernelkey) {
+        std::map<Key_t, KernelFacts>::iterator entry = kernelcache.find(kernelkey);
+        if (entry != kernelcache.end()) {
+            return entry->second;
+        }
+        Variant msg(Variant::ObjectType);
+        msg["type"] = RCTXMT_GET_KERNEL_INFO;
+        msg["key"] = kernelkey;
+        Variant reply = RemoteCall(msg);
+        if (!reply["success"].IsTrue()) {
+            throw std::invalid_argument("No such kernel");
+        }
+        CacheKernel(reply["kernelinfo"]);
+        return kernelcache[kernelkey];
+    }
+
+    RemoteContextClient::NodeFacts RemoteContextClient::LookupNode(Key_t nodekey) {
+        std::map<Key_t, NodeFacts>::iterator entry = nodecache.find(nodekey);
+        if (entry != nodecache.end()) {
+            return entry->second;
+        }
+        Variant msg(Variant::ObjectType);
+        msg["type"] = RCTXMT_GET_NODE_INFO;
+        msg["key"] = nodekey;
+        Variant reply = RemoteCall(msg);
+        if (!(reply["success"].IsTrue())) {
+            throw std::invalid_argument("No such node");
+        }
+        return CacheNode(reply["nodeinfo"]);
+    }
+
+    RemoteContextClient::EndpointFacts RemoteContextClient::LookupEndpoint(RCTXMT_t msgtype, Key_t portkey, bool connected) {
+        std::map<Key_t, EndpointFacts>::iterator entry = endpointcache.find(portkey);
+        if (entry != endpointcache.end() && (!connected || entry->second.opposingkey != 0)) {
+            return entry->second;
+        }
+        CacheEndpoint(GetEndpointInfo(msgtype, portkey));
+        return endpointcache[portkey];
+    }
+
+    RemoteContextClient::ReplyPtr RemoteContextClient::RemoteCallAsync(Variant msg) {
+        InternalCheckTerminated();
+        ReplyPtr reply(new Sync::Future<Variant>);
+        const unsigned tranid = NewTranID();
+        callwaiters.insert(std::make_pair(tranid, reply));
+        msg["msgid"] = tranid;
         SendMessage(msg);
-        while (!winfo.signaled) {
-            winfo.cond.Wait(lock);
-            InternalCheckTerminated();
+        return reply;
+    }
+
+    std::vector<RemoteContextClient::ReplyPtr> RemoteContextClient::RemoteCallBatch(const std::vector<Variant> &msgs) {
+        InternalCheckTerminated();
+        std::vector<ReplyPtr> replies;
+        if (msgs.empty()) { return replies; }
+        Variant messages(Variant::ArrayType);
+        for (unsigned i = 0; i < msgs.size(); ++i) {
+            ReplyPtr reply(new Sync::Future<Variant>);
+            const unsigned tranid = NewTranID();
+            callwaiters.insert(std::make_pair(tranid, reply));
+            Variant msg = msgs[i];
+            msg["msgid"] = tranid;
+            messages.Append(msg);
+            replies.push_back(reply);
         }
-        return winfo.msg;
+        Variant batch(Variant::ObjectType);
+        batch["type"] = RCTXMT_BATCH;
+        batch["messages"] = messages;
+        SendMessage(batch);
+        return replies;
+    }
+
+    Variant RemoteContextClient::WaitReply(ReplyPtr reply) {
+        {
+            AutoUnlock<FiberMutex> unlock(lock);
+            FiberBlockingCall blocking;
+            reply->Wait();
+        }
+        InternalCheckTerminated();
+        if (reply->IsCanceled()) {
+            throw ShutdownException();
+        }
+        return reply->Get();
+    }
+
+    Variant RemoteContextClient::RemoteCall(Variant msg) {
+        return WaitReply(RemoteCallAsync(msg));
     }
 }
@@ -31,8 +31,13 @@
 #include "NodeAttr.h"
 #include "PthreadMutex.h"
 #include "PthreadCondition.h"
+#include "FiberScheduler.h"
 #include "Variant.h"
+#include "Future.h"
 #include <list>
+#include <vector>
+#include <map>
+#include <utility>
 
 class Pthread;
 
@@ -44,6 +49,21 @@ namespace CPN {
      * An implementor only needs to override SendMessage to send the necessary
      * messages to the RemoteContextServer and then call DispatchMessage for the
      * replies from the server.
+     *
+     * What the server never changes once it is set, the names, keys,
+     * kernels and connections of kernels, nodes and endpoints, is kept
+     * in a cache filled from the replies and the broadcasts so that
+     * asking for it again needs no round trip. That a node has started
+     * is cached as well as it never goes back. When a node ends it and
+     * its endpoints are dropped from the cache, and so is a kernel of
+     * this client when it ends, so the cache only holds what is live.
+     * Connections are cached from the server's answers only.
+     *
+     * A call to the server does not have to wait for its reply before
+     * the next is sent, CreateNodeKeys and PrefetchEndpoints send all
+     * their requests in batch messages and then wait for the replies.
+     * CreateNodeKeys asks for all the names in one batch before it
+     * creates them in another so a taken name allocates nothing.
      */
     class RemoteContextClient : public Context {
     public:
@@ -69,6 +89,7 @@ namespace CPN {
         virtual void SendCreateNode(CPN::Key_t kernelkey, const CPN::NodeAttr &attr);
 
         virtual CPN::Key_t CreateNodeKey(CPN::Key_t kernelkey, const std::string &nodename);
+        virtual std::vector<CPN::Key_t> CreateNodeKeys(const std::vector<std::pair<CPN::Key_t, std::string> > &nodes);
         virtual CPN::Key_t GetNodeKey(const std::string &nodename);
         virtual std::string GetNodeName(CPN::Key_t nodekey);
         virtual CPN::Key_t GetNodeKernel(CPN::Key_t nodekey);
@@ -79,7 +100,12 @@ namespace CPN {
         virtual void WaitForNodeEnd(const std::string &nodename);
         virtual void WaitForAllNodeEnd();
 
+        virtual bool SetReplicas(const NodeAttr &attr);
+        virtual bool GetReplicas(const std::string &nodename, NodeAttr &attr);
 
+
+        virtual void PrefetchEndpoints(const std::vector<std::pair<std::string, std::string> > &readers,
+                const std::vector<std::pair<std::string, std::string> > &writers);
         virtual CPN::Key_t GetCreateReaderKey(CPN::Key_t nodekey, const std::string &portname);
         virtual CPN::Key_t GetReaderNode(CPN::Key_t portkey);
         virtual CPN::Key_t GetReaderKernel(CPN::Key_t portkey);
@@ -113,50 +139,98 @@ namespace CPN {
          */
         virtual void SendMessage(const Variant &msg) = 0;
 
-        mutable PthreadMutex lock;
-    private:
+        /**
+         * The reply to a call to the RemoteContextServer, canceled
+         * when the context terminates.
+         */
+        typedef shared_ptr<Sync::Future<Variant> > ReplyPtr;
 
+        /** \brief Send a request without waiting for the reply. */
+        ReplyPtr RemoteCallAsync(Variant msg);
+        /** \brief Send the requests in one batch message. */
+        std::vector<ReplyPtr> RemoteCallBatch(const std::vector<Variant> &msgs);
         /**
-         * Struct to hold information for a call to the RemoteContextServer
-         * which returns a result. This is used by RemoteCall.
+         * \brief Wait for a reply, releasing the lock meanwhile.
+         * \throw ShutdownException
          */
-        struct WaiterInfo {
-            WaiterInfo(unsigned wid) : waiterid(wid), signaled(false) {}
-            unsigned waiterid;
-            PthreadCondition cond;
-            bool signaled;
-            Variant msg;
-        };
+        Variant WaitReply(ReplyPtr reply);
+        Variant RemoteCall(Variant msg);
+
+        mutable FiberMutex lock;
+    private:
 
         /**
          * Struct used to hold information for when we wish to
          * listen to all incoming broadcasts.
          */
         struct GenericWaiter {
-            PthreadCondition cond;
+            FiberCondition<PthreadCondition> cond;
             std::list<Variant> messages;
         };
         typedef shared_ptr<GenericWaiter> GenericWaiterPtr;
 
         void SendQueueMsg(CPN::Key_t kernelkey, RCTXMT_t msgtype, const CPN::SimpleQueueAttr &attr);
         unsigned NewTranID();
-        void AddWaiter(WaiterInfo *info);
         GenericWaiterPtr NewGenericWaiter();
         void InternalTerminate();
         void InternalCheckTerminated();
         void *TerminateThread();
-        Variant RemoteCall(Variant msg);
 
         CPN::Key_t GetCreateEndpointKey(RCTXMT_t msgtype, CPN::Key_t nodekey, const std::string &portname);
         Variant GetEndpointInfo(RCTXMT_t msgtype, CPN::Key_t portkey);
 
+        struct KernelFacts {
+            std::string name;
+            std::string hostname;
+            std::string servname;
+        };
+
+        struct NodeFacts {
+            std::string name;
+            CPN::Key_t kernelkey;
+            bool started;
+        };
+
+        struct EndpointFacts {
+            std::string name;
+            CPN::Key_t nodekey;
+            CPN::Key_t kernelkey;
+            /// The key of the other end, 0 until connected
+            CPN::Key_t opposingkey;
+        };
+
+        void CacheKernel(const Variant &kernelinfo);
+        /** \return the facts of the node, a dead node is not cached */
+        NodeFacts CacheNode(const Variant &nodeinfo);
+        /** \brief Drop a node and its endpoints from the cache. */
+        void ForgetNode(CPN::Key_t nodekey);
+        void CacheEndpoint(const Variant &endpointinfo);
+        /** \return the cached facts, asking the server on a miss */
+        KernelFacts LookupKernel(CPN::Key_t kernelkey);
+        NodeFacts LookupNode(CPN::Key_t nodekey);
+        /**
+         * \param connected also ask the server if the endpoint is not
+         * known to be connected yet
+         */
+        EndpointFacts LookupEndpoint(RCTXMT_t msgtype, CPN::Key_t portkey, bool connected);
+
         auto_ptr<Pthread> terminateThread;
-        typedef std::map<unsigned, WaiterInfo*> WaiterMap;
+        typedef std::map<unsigned, ReplyPtr> WaiterMap;
         WaiterMap callwaiters;
         typedef std::list<weak_ptr<GenericWaiter> > WaiterList;
         WaiterList waiters;
         typedef std::map<CPN::Key_t, CPN::KernelBase*> KernelMap;
         KernelMap kernels;
+
+        typedef std::map<std::string, CPN::Key_t> NameKeyMap;
+        typedef std::map<std::pair<CPN::Key_t, std::string>, CPN::Key_t> PortKeyMap;
+        std::map<CPN::Key_t, KernelFacts> kernelcache;
+        NameKeyMap kernelnames;
+        std::map<CPN::Key_t, NodeFacts> nodecache;
+        NameKeyMap nodenames;
+        std::map<CPN::Key_t, EndpointFacts> endpointcache;
+        PortKeyMap readerkeys;
+        PortKeyMap writerkeys;
         unsigned trancounter;
         bool shutdown;
         int loglevel;
@@ -31,7 +31,8 @@
 namespace CPN {
 
     RemoteContextServer::RemoteContextServer()
-        : debuglevel(0), shutdown(false), numlivenodes(0), keycount(0)
+        : debuglevel(0), shutdown(false), numlivenodes(0), keycount(0),
+        batching(false)
     {
     }
 
@@ -87,6 +88,12 @@ namespace CPN {
         case RCTXMT_GET_NUM_NODE_LIVE:
             GetNumNodeLive(sender, msg);
             break;
+        case RCTXMT_SET_REPLICAS:
+            SetReplicas(sender, msg);
+            break;
+        case RCTXMT_GET_REPLICAS:
+            GetReplicas(sender, msg);
+            break;
         case RCTXMT_GET_CREATE_READER_KEY:
             GetCreateEndpointKey(sender, msg);
             break;
@@ -108,11 +115,79 @@ namespace CPN {
         case RCTXMT_LOG:
             LogMessage(sender + ":" + msg["msg"].AsString());
             break;
+        case RCTXMT_BATCH:
+            DispatchBatch(sender, msg);
+            break;
         default:
             ASSERT(false);
         }
     }
 
+    void RemoteContextServer::DispatchBatch(const std::string &sender, const Variant &msg) {
+        const Variant messages = msg["messages"];
+        if (batching) {
+            // A batch in a batch is just more of the same batch
+            for (unsigned i = 0; i < messages.Size(); ++i) {
+                DispatchMessage(sender, messages.At(i));
+            }
+            return;
+        }
+        batching = true;
+        batchsender = sender;
+        batchreplies = Variant(Variant::ArrayType);
+        try {
+            for (unsigned i = 0; i < messages.Size(); ++i) {
+                DispatchMessage(sender, messages.At(i));
+            }
+        } catch (...) {
+            // The sender waits for a reply to every request in the batch
+            std::set<unsigned> answered;
+            for (unsigned i = 0; i < batchreplies.Size(); ++i) {
+                answered.insert(batchreplies.At(i)["msgid"].AsUnsigned());
+            }
+            FailUnanswered(messages, answered, batchreplies);
+            SendBatchReplies(sender);
+            throw;
+        }
+        SendBatchReplies(sender);
+    }
+
+    void RemoteContextServer::FailUnanswered(const Variant &messages,
+            const std::set<unsigned> &answered, Variant &replies) {
+        for (unsigned i = 0; i < messages.Size(); ++i) {
+            const Variant &msg = messages.At(i);
+            if (msg["messages"].IsArray()) {
+                FailUnanswered(msg["messages"], answered, replies);
+            } else if (msg["msgid"].IsNumber() && answered.count(msg["msgid"].AsUnsigned()) == 0) {
+                Variant reply(Variant::ObjectType);
+                reply["msgtype"] = "reply";
+                reply["msgid"] = msg["msgid"];
+                reply["success"] = false;
+                replies.Append(reply);
+            }
+        }
+    }
+
+    void RemoteContextServer::SendBatchReplies(const std::string &sender) {
+        batching = false;
+        Variant replies = batchreplies;
+        batchreplies = Variant();
+        if (replies.Size() > 0) {
+            Variant reply(Variant::ObjectType);
+            reply["msgtype"] = "batch";
+            reply["messages"] = replies;
+            SendReply(sender, reply);
+        }
+    }
+
+    void RemoteContextServer::SendReply(const std::string &recipient, const Variant &reply) {
+        if (batching && recipient == batchsender) {
+            batchreplies.Append(reply);
+        } else {
+            SendMessage(recipient, reply);
+        }
+    }
+
     void RemoteContextServer::Terminate() {
         Variant msg(Variant::ObjectType);
         msg["type"] = RCTXMT_TERMINATE;
@@ -144,7 +219,7 @@ namespace CPN {
             reply["success"] = true;
             reply["kernelinfo"] = kernelinfo.Copy();
         }
-        SendMessage(sender, reply);
+        SendReply(sender, reply);
     }
 
     void RemoteContextServer::SignalKernelStart(const Variant &msg) {
@@ -178,7 +253,7 @@ namespace CPN {
         if (msg["name"].IsString()) {
             NameKeyMap::iterator entry = kernelmap.find(msg["name"].AsString());
             if (entry == kernelmap.end()) {
-                SendMessage(sender, reply);
+                SendReply(sender, reply);
                 return;
             }
             kernelkey = entry->second;
@@ -191,7 +266,7 @@ namespace CPN {
             reply["success"] = true;
             reply["kernelinfo"] = entry->second.Copy();
         }
-        SendMessage(sender, reply);
+        SendReply(sender, reply);
     }
 
     void RemoteContextServer::CreateNodeKey(const std::string &sender, const Variant &msg) {
@@ -217,7 +292,7 @@ namespace CPN {
             reply["success"] = true;
             reply["nodeinfo"] = nodeinfo.Copy();
         }
-        SendMessage(sender, reply);
+        SendReply(sender, reply);
     }
 
     void RemoteContextServer::SignalNodeStart(const Variant &msg) {
@@ -253,7 +328,7 @@ namespace CPN {
         if (msg["name"].IsString()) {
             NameKeyMap::iterator entry = nodemap.find(msg["name"].AsString());
             if (entry == nodemap.end()) {
-                SendMessage(sender, reply);
+                SendReply(sender, reply);
                 return;
             }
             nodekey = entry->second;
@@ -266,7 +341,7 @@ namespace CPN {
             ASSERT(reply["nodeinfo"]["type"].AsString() == "nodeinfo");
             reply["success"] = true;
         }
-        SendMessage(sender, reply);
+        SendReply(sender, reply);
     }
 
     void RemoteContextServer::GetNumNodeLive(const std::string &sender, const Variant &msg) {
@@ -275,7 +350,37 @@ namespace CPN {
         reply["msgtype"] = "reply";
         reply["numlivenodes"] = numlivenodes;
         reply["success"] = true;
-        SendMessage(sender, reply);
+        SendReply(sender, reply);
+    }
+
+    void RemoteContextServer::SetReplicas(const std::string &sender, const Variant &msg) {
+        Variant reply(Variant::ObjectType);
+        reply["msgid"] = msg["msgid"];
+        reply["msgtype"] = "reply";
+        const std::string name = msg["group"]["name"].AsString();
+        if (replicamap.find(name) != replicamap.end()) {
+            reply["success"] = false;
+        } else {
+            dbprintf(2, "Node %s replicated %u times\n", name.c_str(),
+                    msg["group"]["replicas"].AsUnsigned());
+            replicamap[name] = msg["group"].Copy();
+            reply["success"] = true;
+        }
+        SendReply(sender, reply);
+    }
+
+    void RemoteContextServer::GetReplicas(const std::string &sender, const Variant &msg) {
+        Variant reply(Variant::ObjectType);
+        reply["msgid"] = msg["msgid"];
+        reply["msgtype"] = "reply";
+        std::map<std::string, Variant>::iterator entry = replicamap.find(msg["name"].AsString());
+        if (entry == replicamap.end()) {
+            reply["success"] = false;
+        } else {
+            reply["success"] = true;
+            reply["group"] = entry->second.Copy();
+        }
+        SendReply(sender, reply);
     }
 
     void RemoteContextServer::GetCreateEndpointKey(const std::string &sender, const Variant &msg) {
@@ -309,7 +414,7 @@ namespace CPN {
             reply["endpointinfo"] = epinfo.Copy();
             reply["success"] = true;
         }
-        SendMessage(sender, reply);
+        SendReply(sender, reply);
     }
 
     void RemoteContextServer::GetEndpointInfo(const std::string &sender, const Variant &msg) {
@@ -324,7 +429,7 @@ namespace CPN {
             reply["endpointinfo"] = entry->second.Copy();
             ASSERT(reply["endpointinfo"]["type"].AsString() == "endpointinfo");
         }
-        SendMessage(sender, reply);
+        SendReply(sender, reply);
 
     }
 
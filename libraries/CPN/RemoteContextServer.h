@@ -25,6 +25,7 @@
 #pragma once
 #include "CPNCommon.h"
 #include "Variant.h"
+#include <set>
 
 /*
     All requests have a field named 'type' which contains a number from RCTXMT_t.
@@ -47,6 +48,22 @@
         "kernelinfo" or "nodeinfo" or "endpointinfo" etc.
     }
 
+    Many requests can be sent in one message, they are handled in order
+    as if sent one after the other. The replies to them are sent back
+    together in one message in the same order. If handling one of them
+    fails the rest are not handled and each request that has no reply
+    yet gets one with "success" false.
+
+    batch = {
+        "type"      : RCTXMT_BATCH,
+        "messages"  : [ request, ... ]
+    }
+
+    batchreply = {
+        "msgtype"   : "batch",
+        "messages"  : [ reply, ... ]
+    }
+
     There is another type of message called broadcast that is sent out by
     the server on certain events.
 
@@ -149,6 +166,16 @@ namespace CPN {
         void dbprintf(int level, const char *fmt, ...);
     private:
 
+        void DispatchBatch(const std::string &sender, const Variant &msg);
+        /** \brief Add a failed reply to replies for each request in
+         * messages whose msgid is not in answered. */
+        void FailUnanswered(const Variant &messages, const std::set<unsigned> &answered, Variant &replies);
+        /** \brief End the batch and send the replies kept for it. */
+        void SendBatchReplies(const std::string &sender);
+        /** \brief Send a reply, or keep it for the batch reply if it
+         * answers a request in a batch from recipient. */
+        void SendReply(const std::string &recipient, const Variant &reply);
+
         void SetupKernel(const std::string &sender, const Variant &msg);
         void SignalKernelStart(const Variant &msg);
         void SignalKernelEnd(const Variant &msg);
@@ -158,6 +185,8 @@ namespace CPN {
         void SignalNodeEnd(const Variant &msg);
         void GetNodeInfo(const std::string &sender, const Variant &msg);
         void GetNumNodeLive(const std::string &sender, const Variant &msg);
+        void SetReplicas(const std::string &sender, const Variant &msg);
+        void GetReplicas(const std::string &sender, const Variant &msg);
         void GetCreateEndpointKey(const std::string &sender, const Variant &msg);
         void GetEndpointInfo(const std::string &sender, const Variant &msg);
         void ConnectEndpoints(const Variant &msg);
@@ -172,12 +201,18 @@ namespace CPN {
         typedef std::map<std::string, Key_t> NameKeyMap;
         NameKeyMap kernelmap;
         NameKeyMap nodemap;
+        /// The groups of replicas by name
+        std::map<std::string, Variant> replicamap;
 
         int debuglevel;
         bool shutdown;
         unsigned numlivenodes;
 
         Key_t keycount;
+
+        bool batching;
+        std::string batchsender;
+        Variant batchreplies;
     };
 }
 #endif
@@ -32,19 +32,50 @@
 #include "ErrnoException.h"
 #include "ThrowingAssert.h"
 #include "D4RNode.h"
+#include "Trace.h"
 #include <errno.h>
+#include <string.h>
 #include <algorithm>
+#include <limits>
 #include <sstream>
+#include <fstream>
 
-#if _DEBUG
-#define FUNC_TRACE(logger) logger.Trace("%s %s", __PRETTY_FUNCTION__, GetState().c_str())
-#else
-#define FUNC_TRACE(logger)
-#endif
+// GetState is only called when the trace is on, see LOG_TRACE
+#define FUNC_TRACE(logger) LOG_TRACE(logger, "%s %s", __PRETTY_FUNCTION__, GetState().c_str())
 
 
 namespace CPN {
 
+    /// Net votes needed before the adaptive split moves
+    static const int ADAPT_VOTES = 8;
+    /// How far alpha moves each time
+    static const double ADAPT_STEP = 0.125;
+    /// Never hand all of the queue to one side
+    static const double ADAPT_MINALPHA = 0.125;
+    static const double ADAPT_MAXALPHA = 0.875;
+
+    /// Size of the buffers between a stripe thread and the action thread
+    static const unsigned STRIPE_BUFFERSIZE = 1<<18;
+    /// Most a stripe thread moves in one system call
+    static const unsigned STRIPE_CHUNKSIZE = 1<<16;
+
+    RemoteQueue::Stripe::Stripe(RemoteQueue *q, shared_ptr<SocketHandle> s)
+        : queue(q),
+        sock(s),
+        inbuf(STRIPE_BUFFERSIZE, STRIPE_CHUNKSIZE, 1),
+        outbuf(STRIPE_BUFFERSIZE, STRIPE_CHUNKSIZE, 1),
+        error(0),
+        eof(false),
+        shutdownwrite(false),
+        writeshut(false),
+        stop(false),
+        sleeping(false)
+    {}
+
+    void *RemoteQueue::Stripe::EntryPoint() {
+        return queue->StripeEntryPoint(*this);
+    }
+
     RemoteQueue::RemoteQueue(KernelBase *k, Mode_t mode_,
                 ConnectionServer *s, RemoteQueueHolder *h, const SimpleQueueAttr &attr)
         : ThresholdQueue(k, attr, QueueLength(attr.GetLength(), attr.GetMaxThreshold(), attr.GetAlpha(), mode_)),
@@ -52,9 +83,17 @@ namespace CPN {
         actionTick(false),
         mode(mode_),
         alpha(attr.GetAlpha()),
+        adaptive(attr.GetAdaptiveAlpha()),
+        splitvotes(0),
+        totallength(attr.GetLength()),
         maxwritethreshold(attr.GetMaxWriteThreshold()),
         server(s),
         holder(h),
+        localaddrs(attr.GetLocalAddresses()),
+        linkrate(attr.GetLinkRate()),
+        sendstripe(0),
+        recvstripe(0),
+        rtt(-1),
         mocknode(new D4R::Node(mode_ == READ ? attr.GetWriterNodeKey() : attr.GetReaderNodeKey())),
         clock(0),
         readclock(0),
@@ -63,12 +102,18 @@ namespace CPN {
         writerlength(QueueLength(attr.GetLength(), attr.GetMaxThreshold(), attr.GetAlpha(), WRITE)),
         bytecount(0),
         pendingBlock(false),
+        sentID(false),
         sentEnd(false),
         pendingGrow(false),
+        pendingShrink(false),
         pendingD4RTag(false),
         tagUpdated(false),
-        dead(false)
+        dead(false),
+        linkbytes(0)
     {
+        for (unsigned i = 0; i < attr.GetNumConnections(); ++i) {
+            socks.push_back(shared_ptr<SocketHandle>(new SocketHandle));
+        }
         PthreadAttr pattr;
         pattr.StackSize(1<<16); // magic number, the file thread shouldn't use any more than this
         fileThread = auto_ptr<Pthread>(CreatePthreadFunctional(this, &RemoteQueue::FileThreadEntryPoint, pattr));
@@ -84,7 +129,7 @@ namespace CPN {
         else { oss << "w"; }
         oss << ", r:" << readerkey << ", w:" << writerkey << ")";
         logger.Name(oss.str());
-        logger.Trace("Constructed");
+        LOG_TRACE(logger, "Constructed");
     }
 
     RemoteQueue::~RemoteQueue() {
@@ -92,8 +137,7 @@ namespace CPN {
         Signal();
         actionCond.Broadcast();
         FUNC_TRACE(logger);
-        std::string clockstr = ClockString();
-        logger.Trace("Destructed (c: %s)", clockstr.c_str());
+        LOG_TRACE(logger, "Destructed (c: %s)", ClockString().c_str());
         fileThread->Start();
         fileThread->Join();
         actionThread->Start();
@@ -118,7 +162,7 @@ namespace CPN {
         Signal();
     }
 
-    unsigned RemoteQueue::UnlockedCount() const {
+    QueueSize_t RemoteQueue::UnlockedCount() const {
         if (mode == READ) {
             return queue->Count();
         } else {
@@ -134,22 +178,24 @@ namespace CPN {
         }
     }
 
-    unsigned RemoteQueue::UnlockedQueueLength() const {
+    QueueSize_t RemoteQueue::UnlockedQueueLength() const {
         return readerlength + writerlength;
     }
 
-    void RemoteQueue::UnlockedGrow(unsigned queueLen, unsigned maxThresh) {
+    void RemoteQueue::UnlockedGrow(QueueSize_t queueLen, QueueSize_t maxThresh) {
         FUNC_TRACE(logger);
         if (queueLen <= UnlockedQueueLength() && maxThresh <= UnlockedMaxThreshold()) return;
         while (pendingGrow && !dead) {
             Signal();
             actionCond.Wait(lock);
         }
-        const unsigned maxthresh = std::max<unsigned>(queue->MaxThreshold(), maxThresh);
-        readerlength = QueueLength(queueLen, maxthresh, alpha, READ);
-        writerlength = QueueLength(queueLen, maxthresh, alpha, WRITE);
-        const unsigned newlen = (mode == WRITE ? writerlength : readerlength);
+        const QueueSize_t maxthresh = std::max<QueueSize_t>(queue->MaxThreshold(), maxThresh);
+        totallength = std::max(totallength, queueLen);
+        readerlength = QueueLength(totallength, maxthresh, alpha, READ);
+        writerlength = QueueLength(totallength, maxthresh, alpha, WRITE);
+        const QueueSize_t newlen = (mode == WRITE ? writerlength : readerlength);
         ThresholdQueue::UnlockedGrow(newlen, maxthresh);
+        ResizeSocketBuffers();
         pendingGrow = true;
         Signal();
     }
@@ -175,6 +221,9 @@ namespace CPN {
         pendingBlock = true;
         tagUpdated = false;
         uint64_t saveclock = clock + 1;
+        // Our side is full, if the reader side is mostly empty its
+        // memory would do more good over here.
+        VoteSplit(bytecount <= readerlength/2 ? 1 : 0);
         Signal();
         while (WriteBlocked() && (!tagUpdated || saveclock > writeclock)) {
             Wait();
@@ -184,14 +233,14 @@ namespace CPN {
         }
     }
 
-    void RemoteQueue::InternalDequeue(unsigned count) {
+    void RemoteQueue::InternalDequeue(QueueSize_t count) {
         ASSERT(mode == READ);
         FUNC_TRACE(logger);
         ThresholdQueue::InternalDequeue(count);
         Signal();
     }
 
-    void RemoteQueue::InternalEnqueue(unsigned count) {
+    void RemoteQueue::InternalEnqueue(QueueSize_t count) {
         ASSERT(mode == WRITE);
         FUNC_TRACE(logger);
         ThresholdQueue::InternalEnqueue(count);
@@ -227,10 +276,10 @@ namespace CPN {
         ASSERT(mode == READ);
         ASSERT(!writeshutdown);
         const unsigned numchannels = queue->NumChannels();
-        unsigned count = packet.Count();
+        QueueSize_t count = packet.Count();
         if (count > queue->Freespace() || count > queue->MaxThreshold()) {
             logger.Warn("Enqueue packet too large, silently growing queue. "
-                    "Packet size: %u, Freespace: %u, MaxThresh: %u, QueueLength: %u",
+                    "Packet size: %llu, Freespace: %llu, MaxThresh: %llu, QueueLength: %llu",
                     count, queue->Freespace(), queue->MaxThreshold(), queue->QueueLength());
             ThresholdQueue::UnlockedGrow(queue->Count() + count, count);
         }
@@ -243,19 +292,25 @@ namespace CPN {
             iovs.push_back(iov);
         }
         inenqueue = true;
-        {
+        if (!stripes.empty()) {
+            // The stripe thread has the bytes, wait for them under the lock
+            for (unsigned i = 0; i < iovs.size(); ++i) {
+                RecvAll(iovs[i].iov_base, iovs[i].iov_len);
+            }
+        } else {
             AutoUnlock<QueueBase> aul(*this);
-            unsigned numread = 0;
-            unsigned numtoread = packet.DataLength();
+            QueueSize_t numread = 0;
+            QueueSize_t numtoread = packet.DataLength();
             unsigned i = 0;
             while (numread < numtoread) {
-                unsigned num = sock.Readv(&iovs[i], iovs.size() - i);
+                unsigned num = RecvSocket().Readv(&iovs[i], iovs.size() - i);
                     if (num == 0) {
-                        if (sock.Eof()) {
+                        if (RecvSocket().Eof()) {
                             return;
                         }
                     }
                 numread += num;
+                linkbytes.Add(num);
                 if (numread == numtoread) break;
                 while (iovs[i].iov_len <= num) {
                     num -= iovs[i].iov_len;
@@ -274,12 +329,14 @@ namespace CPN {
     }
 
     void RemoteQueue::SendEnqueuePacket() {
-        unsigned count = queue->Count();
+        QueueSize_t count = queue->Count();
         const unsigned numchannels = queue->NumChannels();
-        const unsigned maxthresh = queue->MaxThreshold();
-        const unsigned expectedfree = std::max(readerlength, maxthresh) - bytecount;
+        const QueueSize_t maxthresh = queue->MaxThreshold();
+        const QueueSize_t window = std::max(readerlength, maxthresh);
+        // The window may have just been shrunk by a change in the split
+        const QueueSize_t expectedfree = window > bytecount ? window - bytecount : 0;
         if (maxwritethreshold > 0) {
-            unsigned maxwrite = maxwritethreshold/numchannels;
+            QueueSize_t maxwrite = maxwritethreshold/numchannels;
             if (maxwrite == 0) maxwrite = 1;
             if (count > maxwrite) { count = maxwrite; }
         }
@@ -287,14 +344,14 @@ namespace CPN {
         if (count > expectedfree) { count = expectedfree; }
         if (count == 0) { return; }
         FUNC_TRACE(logger);
-        const unsigned datalength = count * numchannels;
+        const QueueSize_t datalength = count * numchannels;
         Packet packet(datalength, PACKET_ENQUEUE);
         SetupPacket(packet);
         packet.Count(count);
 
         std::vector<iovec> iovs;
-        iovec header = { &packet.header, sizeof(packet.header) };
-        iovs.push_back(header);
+        uint8_t buf[PACKET_HEADERLENGTH];
+        iovs.push_back(PacketEncoder::EncodeHeader(packet, buf));
         for (unsigned i = 0; i < numchannels; ++i) {
             iovec iov;
             iov.iov_base = const_cast<void*>(ThresholdQueue::InternalGetRawDequeuePtr(packet.Count(), i));
@@ -303,9 +360,12 @@ namespace CPN {
             iovs.push_back(iov);
         }
         indequeue = true;
-        {
+        if (stripes.empty()) {
             AutoUnlock<QueueBase> aul(*this);
             WriteBytes(&iovs[0], iovs.size());
+        } else {
+            // Only copies into the buffer of the stripe
+            WriteBytes(&iovs[0], iovs.size());
         }
         indequeue = false;
         ThresholdQueue::InternalDequeue(packet.Count());
@@ -327,7 +387,7 @@ namespace CPN {
         FUNC_TRACE(logger);
         Packet packet(PACKET_DEQUEUE);
         SetupPacket(packet);
-        const unsigned count = bytecount - queue->Count();
+        const QueueSize_t count = bytecount - queue->Count();
         packet.Count(count);
         PacketEncoder::SendPacket(packet);
         bytecount -= count;
@@ -344,6 +404,8 @@ namespace CPN {
                 pendingD4RTag = true;
             }
         }
+        // The reader is starved while data waits over here
+        VoteSplit(queue->Count() >= writerlength/2 ? -1 : 0);
     }
 
     void RemoteQueue::SendReadBlockPacket() {
@@ -390,7 +452,7 @@ namespace CPN {
         SetupPacket(packet);
         PacketEncoder::SendPacket(packet);
         try {
-            sock.ShutdownWrite();
+            ShutdownWriteSockets();
         } catch (const ErrnoException &e) {
             logger.Debug("Error trying to close the write end: %s", e.what());
         }
@@ -411,7 +473,7 @@ namespace CPN {
         SetupPacket(packet);
         PacketEncoder::SendPacket(packet);
         try {
-            sock.ShutdownWrite();
+            ShutdownWriteSockets();
         } catch (const ErrnoException &e) {
             logger.Debug("Error trying to close the read end: %s", e.what());
         }
@@ -420,21 +482,84 @@ namespace CPN {
     void RemoteQueue::GrowPacket(const Packet &packet) {
         UpdateClock(packet);
         FUNC_TRACE(logger);
-        const unsigned queueLen = packet.QueueSize();
-        const unsigned maxthresh = std::max<unsigned>(queue->MaxThreshold(), packet.MaxThreshold());
-        readerlength = QueueLength(queueLen, maxthresh, alpha, READ);
-        writerlength = QueueLength(queueLen, maxthresh, alpha, WRITE);
-        const unsigned newlen = (mode == WRITE ? writerlength : readerlength);
+        if (packet.DataLength() > 0) {
+            ASSERT(packet.DataLength() == PACKET_FRACTIONLENGTH);
+            uint8_t buf[PACKET_FRACTIONLENGTH];
+            RecvAll(buf, sizeof(buf));
+            // The writer owns the split, the reader follows it
+            if (mode == READ) {
+                alpha = DecodeFraction(buf);
+                pendingShrink = true;
+            }
+        }
+        totallength = std::max<QueueSize_t>(totallength, packet.QueueSize());
+        const QueueSize_t maxthresh = std::max<QueueSize_t>(queue->MaxThreshold(), packet.MaxThreshold());
+        readerlength = QueueLength(totallength, maxthresh, alpha, READ);
+        writerlength = QueueLength(totallength, maxthresh, alpha, WRITE);
+        const QueueSize_t newlen = (mode == WRITE ? writerlength : readerlength);
         ThresholdQueue::UnlockedGrow(newlen, maxthresh);
+        ResizeSocketBuffers();
     }
 
     void RemoteQueue::SendGrowPacket() {
         FUNC_TRACE(logger);
         Packet packet(PACKET_GROW);
         SetupPacket(packet);
-        packet.QueueSize(readerlength + writerlength);
+        packet.QueueSize(totallength);
         packet.MaxThreshold(queue->MaxThreshold());
-        PacketEncoder::SendPacket(packet);
+        if (adaptive && mode == WRITE) {
+            uint8_t buf[PACKET_FRACTIONLENGTH];
+            EncodeFraction(alpha, buf);
+            packet.DataLength(sizeof(buf));
+            PacketEncoder::SendPacket(packet, buf);
+        } else {
+            PacketEncoder::SendPacket(packet);
+        }
+    }
+
+    /**
+     * Called by the writer side each time one of the two sides blocks.
+     * A vote is cast for the side that would have benefited from more of
+     * the queue, zero when the block says nothing about the split. Once
+     * enough votes one way have gathered alpha is moved one step and the
+     * new split is sent to the reader with a grow packet. The side which
+     * lost gives its memory back once what it holds fits, see TryShrink.
+     */
+    void RemoteQueue::VoteSplit(int vote) {
+        if (!adaptive || mode != WRITE || vote == 0 || sentEnd || dead) { return; }
+        splitvotes += vote;
+        if (splitvotes < ADAPT_VOTES && splitvotes > -ADAPT_VOTES) { return; }
+        double newalpha = alpha + (splitvotes > 0 ? ADAPT_STEP : -ADAPT_STEP);
+        splitvotes = 0;
+        newalpha = std::max(ADAPT_MINALPHA, std::min(ADAPT_MAXALPHA, newalpha));
+        if (newalpha == alpha) { return; }
+        logger.Debug("Moving the split from %f to %f", alpha, newalpha);
+        alpha = newalpha;
+        const QueueSize_t maxthresh = queue->MaxThreshold();
+        readerlength = QueueLength(totallength, maxthresh, alpha, READ);
+        writerlength = QueueLength(totallength, maxthresh, alpha, WRITE);
+        ThresholdQueue::UnlockedGrow(writerlength, maxthresh);
+        ResizeSocketBuffers();
+        pendingGrow = true;
+        pendingShrink = true;
+        Signal();
+    }
+
+    /**
+     * Shrink the half of the queue on this side down to its share of
+     * the split. The writer only sends what fits the reader window so
+     * both sides drain below their share, until then this is retried
+     * each time the action thread runs.
+     */
+    void RemoteQueue::TryShrink() {
+        const QueueSize_t len = std::max<QueueSize_t>(mode == WRITE ? writerlength : readerlength,
+                queue->MaxThreshold());
+        if (UnlockedLocalLength() <= len) {
+            pendingShrink = false;
+        } else if (ThresholdQueue::UnlockedShrink(len)) {
+            logger.Debug("Shrunk to %llu for the split %f", UnlockedLocalLength(), alpha);
+            pendingShrink = false;
+        }
     }
 
     void RemoteQueue::D4RTagPacket(const Packet &packet) {
@@ -442,8 +567,7 @@ namespace CPN {
         FUNC_TRACE(logger);
         ASSERT(packet.DataLength() == sizeof(D4R::Tag));
         D4R::Tag tag;
-        unsigned numread = sock.Read(&tag, sizeof(tag));
-        ASSERT(numread == sizeof(tag));
+        RecvAll(&tag, sizeof(tag));
         tagUpdated = true;
         Signal();
         mocknode->SetPublicTag(tag);
@@ -469,35 +593,184 @@ namespace CPN {
     }
 
     void RemoteQueue::IDReaderPacket(const Packet &packet) {
-        ASSERT(false, "Unexpected packet");
+        FUNC_TRACE(logger);
+        ASSERT(mode == WRITE, "Unexpected packet");
+        NegotiateVersion(packet);
     }
 
     void RemoteQueue::IDWriterPacket(const Packet &packet) {
-        ASSERT(false, "Unexpected packet");
+        FUNC_TRACE(logger);
+        ASSERT(mode == READ, "Unexpected packet");
+        NegotiateVersion(packet);
+    }
+
+    /**
+     * The writer announces its protocol version in the ID packet it
+     * connects with (see ConnectionServer). When that version knows the
+     * compact headers, the first thing the reader sends is an ID packet
+     * in the full length format with its own version, after which both
+     * ends may use compact headers. A writer which announced nothing is
+     * never sent an ID packet. The clock fields share storage with the
+     * keys so this packet does not tick the clock.
+     */
+    void RemoteQueue::SendIDPacket() {
+        FUNC_TRACE(logger);
+        Packet packet(mode == READ ? PACKET_ID_READER : PACKET_ID_WRITER);
+        if (mode == READ) {
+            packet.SourceKey(readerkey).DestinationKey(writerkey);
+        } else {
+            packet.SourceKey(writerkey).DestinationKey(readerkey);
+        }
+        packet.Version(PACKET_VERSION);
+        PacketEncoder::SendPacket(packet);
+        // The writer announced that it reads compact headers
+        PacketEncoder::CompactHeaders(true);
+    }
+
+    void RemoteQueue::NegotiateVersion(const Packet &packet) {
+        ASSERT(packet.DestinationKey() == GetKey(), "ID packet for another queue");
+        // The decoder accepts either format so we can switch as
+        // soon as we know the other end can read compact headers.
+        if (packet.Version() >= PACKET_VERSION_COMPACT) {
+            PacketEncoder::CompactHeaders(true);
+        }
+        logger.Debug("Peer protocol version %u, compact headers %s", packet.Version(),
+                PacketEncoder::CompactHeaders() ? "on" : "off");
     }
 
     void RemoteQueue::Read() {
-        while (sock.Readable()) {
+        while (RecvReady()) {
             unsigned numtoread = 0;
             void *ptr = PacketDecoder::GetDecoderBytes(numtoread);
-            unsigned numread = sock.Recv(ptr, numtoread, false);
+            unsigned numread = Recv(ptr, numtoread);
             if (numread == 0) {
-                if (sock.Eof()) {
+                if (Eof()) {
                     logger.Debug("Read EOF");
                 }
                 break;
             } else {
+                if (mode == READ && stripes.empty()) { linkbytes.Add(numread); }
                 PacketDecoder::ReleaseDecoderBytes(numread);
+                if (socks.size() > 1 && PacketDecoder::NumBytes() == 0) {
+                    // A whole packet has been handled, the next one
+                    // is on the next connection.
+                    recvstripe = (recvstripe + 1) % socks.size();
+                }
             }
         }
     }
 
+    bool RemoteQueue::RecvReady() const {
+        if (stripes.empty()) {
+            return socks.front()->Readable();
+        }
+        const Stripe &stripe = *stripes[recvstripe];
+        return !stripe.inbuf.Empty() || stripe.error != 0;
+    }
+
+    /**
+     * Receive what is available on the current connection without
+     * blocking.
+     * \return the number of bytes received, 0 if none are ready
+     */
+    unsigned RemoteQueue::Recv(void *ptr, unsigned len) {
+        if (stripes.empty()) {
+            return RecvSocket().Recv(ptr, len, false);
+        }
+        Stripe &stripe = *stripes[recvstripe];
+        const unsigned num = std::min(len, std::min(stripe.inbuf.Count(), stripe.inbuf.MaxThreshold()));
+        if (num == 0) {
+            if (stripe.error != 0) {
+                throw ErrnoException(stripe.error);
+            }
+            return 0;
+        }
+        const bool wasfull = stripe.inbuf.Full();
+        memcpy(ptr, stripe.inbuf.GetRawDequeuePtr(num), num);
+        stripe.inbuf.Dequeue(num);
+        if (wasfull) {
+            WakeStripe(stripe);
+        }
+        return num;
+    }
+
+    /**
+     * Receive exactly len bytes of the packet being decoded from the
+     * current connection, waiting for them. Called with the lock held.
+     */
+    void RemoteQueue::RecvAll(void *ptr, QueueSize_t len) {
+        char *dest = static_cast<char*>(ptr);
+        while (len > 0) {
+            const unsigned chunk = unsigned(std::min<QueueSize_t>(len, std::numeric_limits<unsigned>::max()));
+            unsigned num = 0;
+            if (stripes.empty()) {
+                num = RecvSocket().Read(dest, chunk);
+                if (num == 0 && RecvSocket().Eof()) {
+                    throw ErrnoException("Connection closed in the middle of a packet", EPIPE);
+                }
+                if (mode == READ) { linkbytes.Add(num); }
+            } else {
+                num = Recv(dest, chunk);
+                if (num == 0) {
+                    if (stripes[recvstripe]->eof || dead) {
+                        throw ErrnoException("Connection closed in the middle of a packet", EPIPE);
+                    }
+                    stripeCond.Wait(lock);
+                }
+            }
+            dest += num;
+            len -= num;
+        }
+    }
+
+    /**
+     * Send one packet. With a single connection this writes to the
+     * socket, with several it is called with the lock held and copies
+     * the packet into the buffer of the stripe for its thread to send.
+     */
     void RemoteQueue::WriteBytes(const iovec *iov, unsigned iovcnt) {
-        unsigned total = 0;
+        QueueSize_t total = 0;
         for (unsigned i = 0; i < iovcnt; ++i) { total += iov[i].iov_len; }
-        unsigned numwritten = 0;
+        CPN_TRACE_INSTANT("send", (mode == WRITE ? writernodekey : readernodekey), readerkey, total);
+        if (!stripes.empty()) {
+            Stripe &stripe = *stripes[sendstripe];
+            bool wake = false;
+            for (unsigned i = 0; i < iovcnt; ++i) {
+                const char *src = static_cast<const char*>(iov[i].iov_base);
+                QueueSize_t left = iov[i].iov_len;
+                while (left > 0) {
+                    if (stripe.error != 0) {
+                        throw ErrnoException(stripe.error);
+                    }
+                    if (stripe.stop || dead) {
+                        throw ErrnoException("Connection closed", EPIPE);
+                    }
+                    const unsigned num = unsigned(std::min<QueueSize_t>(left,
+                                std::min(stripe.outbuf.Freespace(), stripe.outbuf.MaxThreshold())));
+                    if (num == 0) {
+                        if (wake) {
+                            WakeStripe(stripe);
+                            wake = false;
+                        }
+                        stripeCond.Wait(lock);
+                        continue;
+                    }
+                    wake = wake || stripe.outbuf.Empty();
+                    memcpy(stripe.outbuf.GetRawEnqueuePtr(num), src, num);
+                    stripe.outbuf.Enqueue(num);
+                    src += num;
+                    left -= num;
+                }
+            }
+            if (wake) {
+                WakeStripe(stripe);
+            }
+            sendstripe = (sendstripe + 1) % socks.size();
+            return;
+        }
+        QueueSize_t numwritten = 0;
         while (numwritten < total) {
-            unsigned num = sock.Writev(iov, iovcnt);
+            unsigned num = SendSocket().Writev(iov, iovcnt);
             numwritten += num;
             if (numwritten == total) break;
             while (iov->iov_len <= num) {
@@ -509,7 +782,7 @@ namespace CPN {
                 // Finish writing this section...
                 unsigned amount = num;
                 while (amount < iov->iov_len) {
-                    amount += sock.Write(((char*)iov->iov_base) + amount, iov->iov_len - amount);
+                    amount += SendSocket().Write(((char*)iov->iov_base) + amount, iov->iov_len - amount);
                 }
                 ++iov;
                 --iovcnt;
@@ -517,6 +790,311 @@ namespace CPN {
             }
         }
         ASSERT(total == numwritten);
+        if (mode == WRITE) { linkbytes.Add(total); }
+    }
+
+    double RemoteQueue::GetAlpha() const {
+        AutoLock<const QueueBase> al(*this);
+        return alpha;
+    }
+
+    QueueSize_t RemoteQueue::LocalQueueLength() const {
+        AutoLock<const QueueBase> al(*this);
+        return UnlockedLocalLength();
+    }
+
+    void RemoteQueue::GetEndpointStats(EndpointStats &stats, bool reader) const {
+        QueueBase::GetEndpointStats(stats, reader);
+        stats.remote = true;
+        stats.linkbytes = linkbytes.Get();
+    }
+
+    void RemoteQueue::Connect() {
+        std::vector<shared_ptr<ConnectionServer::PendingConnection> > conns;
+        for (unsigned i = 0; i < socks.size(); ++i) {
+            if (mode == WRITE) {
+                conns.push_back(server->ConnectWriter(GetKey(), i, localaddrs));
+            } else {
+                conns.push_back(server->ConnectReader(GetKey(), i));
+            }
+        }
+        bool connected = true;
+        unsigned peerversion = PACKET_VERSION;
+        for (unsigned i = 0; i < socks.size(); ++i) {
+            if (conns[i]) {
+                socks[i]->Reset();
+                socks[i]->FD(conns[i]->Get());
+                peerversion = std::min(peerversion, conns[i]->PeerVersion());
+            }
+            connected = connected && !socks[i]->Closed();
+        }
+        if (!connected) {
+            CloseSockets();
+        }
+        AutoLock<QueueBase> al(*this);
+        // A new connection starts in the full length format, and only a
+        // reader whose writer announced a version in the handshake
+        // answers with an ID packet. Any other peer may be a version
+        // that does not know ID packets in band.
+        PacketEncoder::CompactHeaders(false);
+        sentID = !(mode == READ && peerversion >= PACKET_VERSION_COMPACT);
+    }
+
+    bool RemoteQueue::Eof() const {
+        if (!stripes.empty()) {
+            // The end shows up in order, after the packets before it
+            const Stripe &stripe = *stripes[recvstripe];
+            return stripe.eof && stripe.inbuf.Empty();
+        }
+        for (unsigned i = 0; i < socks.size(); ++i) {
+            if (socks[i]->Eof()) { return true; }
+        }
+        return false;
+    }
+
+    void RemoteQueue::CloseSockets() {
+        if (!stripes.empty()) {
+            // The stripe threads send what they have and the file
+            // thread closes the sockets, see StopStripes
+            for (unsigned i = 0; i < stripes.size(); ++i) {
+                stripes[i]->stop = true;
+                WakeStripe(*stripes[i]);
+            }
+            return;
+        }
+        for (unsigned i = 0; i < socks.size(); ++i) {
+            if (!socks[i]->Closed()) {
+                socks[i]->Close();
+            }
+        }
+    }
+
+    /**
+     * Linux grows the socket buffers on its own up to the last field of
+     * tcp_wmem (tcp_rmem). Setting a size turns that off and caps the
+     * buffer at wmem_max (rmem_max) instead.
+     * \return the most the system grows a buffer to, 0 if unknown
+     */
+    static int ReadAutoTuneLimit(const char *path) {
+        std::ifstream in(path);
+        int low = 0, def = 0, high = 0;
+        if (in >> low >> def >> high) {
+            return high;
+        }
+        return 0;
+    }
+
+    /**
+     * The limits are read the first time they are needed, they only
+     * change when somebody sets them by hand.
+     */
+    static int AutoTuneLimit(bool send) {
+#if defined(OS_LINUX)
+        static const int sendlimit = ReadAutoTuneLimit("/proc/sys/net/ipv4/tcp_wmem");
+        static const int recvlimit = ReadAutoTuneLimit("/proc/sys/net/ipv4/tcp_rmem");
+        return (send ? sendlimit : recvlimit);
+#else
+        return 0;
+#endif
+    }
+
+    int RemoteQueue::SocketBufferSize(QueueSize_t window, double rtt, double linkrate, unsigned numsocks) {
+        const double bdp = (rtt > 0 && linkrate > 0 ? rtt * linkrate : 0);
+        const double want = (bdp + double(window))/numsocks + PACKET_HEADERLENGTH;
+        const int maxsize = std::numeric_limits<int>::max()/2;
+        return (want > double(maxsize) ? maxsize : int(want));
+    }
+
+    /**
+     * The link stays busy when the buffers hold the bandwidth-delay
+     * product plus the bytes the queue lets the writer hand over before
+     * it hears back: readerlength, and for the writer never more than
+     * its own writerlength. The buffers are only set when the system
+     * would not grow them that far on its own, and only ever grown.
+     */
+    void RemoteQueue::ResizeSocketBuffers() {
+        if (Closed()) { return; }
+        const bool send = (mode == WRITE);
+        const QueueSize_t window = (send ? std::min(readerlength, writerlength) : readerlength);
+        const double bdp = (rtt > 0 && linkrate > 0 ? rtt * linkrate : 0);
+        const int size = SocketBufferSize(window, rtt, linkrate, socks.size());
+        if (size <= AutoTuneLimit(send)) {
+            logger.Debug("Socket buffers left to the system, %d needed (bdp %f B, window %llu B, rtt %f s)",
+                    size, bdp, window, rtt);
+            return;
+        }
+        int capped = size;
+        try {
+            for (unsigned i = 0; i < socks.size(); ++i) {
+                SocketHandle &sock = *socks[i];
+                if ((send ? sock.GetSendBufferSize() : sock.GetReceiveBufferSize()) >= size) {
+                    continue;
+                }
+                if (send) {
+                    sock.SetSendBufferSize(size);
+                } else {
+                    sock.SetReceiveBufferSize(size);
+                }
+                const int actual = (send ? sock.GetSendBufferSize() : sock.GetReceiveBufferSize());
+                capped = std::min(capped, actual);
+            }
+        } catch (const ErrnoException &e) {
+            logger.Warn("Unable to size socket buffers to %d: %s", size, e.what());
+        }
+        if (capped < size) {
+            logger.Warn("Socket buffers capped at %d instead of %d, raise %s", capped, size,
+                    send ? "net.core.wmem_max" : "net.core.rmem_max");
+        }
+        logger.Debug("Socket buffers %d (bdp %f B, window %llu B, rtt %f s)", size, bdp, window, rtt);
+    }
+
+    void RemoteQueue::ShutdownWriteSockets() {
+        if (!stripes.empty()) {
+            for (unsigned i = 0; i < stripes.size(); ++i) {
+                stripes[i]->shutdownwrite = true;
+                WakeStripe(*stripes[i]);
+            }
+            return;
+        }
+        for (unsigned i = 0; i < socks.size(); ++i) {
+            socks[i]->ShutdownWrite();
+        }
+    }
+
+    /**
+     * Give each connection its own thread when there is more than one.
+     * Called with the lock held before the action thread starts.
+     */
+    void RemoteQueue::StartStripes() {
+        if (socks.size() < 2) { return; }
+        PthreadAttr pattr;
+        pattr.StackSize(1<<16);
+        for (unsigned i = 0; i < socks.size(); ++i) {
+            socks[i]->SetBlocking(false);
+            shared_ptr<Stripe> stripe(new Stripe(this, socks[i]));
+            stripe->thread = auto_ptr<Pthread>(CreatePthreadFunctional(stripe.get(), &Stripe::EntryPoint, pattr));
+            stripes.push_back(stripe);
+        }
+        for (unsigned i = 0; i < stripes.size(); ++i) {
+            stripes[i]->thread->Start();
+        }
+    }
+
+    /**
+     * Stop the stripe threads, waiting for them to send what they
+     * have, and close the sockets. Called by the file thread without
+     * the lock when the queue is done.
+     */
+    void RemoteQueue::StopStripes() {
+        if (stripes.empty()) { return; }
+        {
+            AutoLock<QueueBase> al(*this);
+            for (unsigned i = 0; i < stripes.size(); ++i) {
+                stripes[i]->stop = true;
+                WakeStripe(*stripes[i]);
+            }
+        }
+        for (unsigned i = 0; i < stripes.size(); ++i) {
+            stripes[i]->thread->Join();
+        }
+        for (unsigned i = 0; i < socks.size(); ++i) {
+            if (!socks[i]->Closed()) {
+                socks[i]->Close();
+            }
+        }
+    }
+
+    void RemoteQueue::WakeStripe(Stripe &stripe) {
+        if (stripe.sleeping) {
+            stripe.sleeping = false;
+            stripe.wakeup.SendWakeup();
+        }
+    }
+
+    /**
+     * The thread of a connection of a striped queue. Moves bytes from
+     * the socket into inbuf and from outbuf to the socket, the system
+     * calls without the lock, and polls only for what it has room or
+     * bytes for.
+     */
+    void *RemoteQueue::StripeEntryPoint(Stripe &stripe) {
+        SocketHandle &sock = *stripe.sock;
+        AutoLock<QueueBase> al(*this);
+        try {
+            while (true) {
+                bool received = false;
+                bool sent = false;
+                if (!stripe.stop && !stripe.eof && !stripe.inbuf.Full()) {
+                    unsigned num = std::min(stripe.inbuf.Freespace(), stripe.inbuf.MaxThreshold());
+                    void *ptr = stripe.inbuf.GetRawEnqueuePtr(num);
+                    {
+                        AutoUnlock<QueueBase> aul(*this);
+                        num = sock.Read(ptr, num);
+                    }
+                    if (num > 0) {
+                        stripe.inbuf.Enqueue(num);
+                        if (mode == READ) { linkbytes.Add(num); }
+                        received = true;
+                    } else if (sock.Eof()) {
+                        stripe.eof = true;
+                        received = true;
+                    }
+                }
+                if (!stripe.outbuf.Empty()) {
+                    unsigned num = std::min(stripe.outbuf.Count(), stripe.outbuf.MaxThreshold());
+                    const void *ptr = stripe.outbuf.GetRawDequeuePtr(num);
+                    {
+                        AutoUnlock<QueueBase> aul(*this);
+                        num = sock.Write(ptr, num);
+                    }
+                    if (num > 0) {
+                        stripe.outbuf.Dequeue(num);
+                        if (mode == WRITE) { linkbytes.Add(num); }
+                        sent = true;
+                    }
+                }
+                if (stripe.outbuf.Empty() && stripe.shutdownwrite && !stripe.writeshut) {
+                    stripe.writeshut = true;
+                    try {
+                        sock.ShutdownWrite();
+                    } catch (const ErrnoException &e) {
+                        logger.Debug("Error trying to close the write end: %s", e.what());
+                    }
+                }
+                if (received) {
+                    Signal();
+                }
+                if (received || sent) {
+                    stripeCond.Broadcast();
+                    continue;
+                }
+                if (stripe.stop && (stripe.outbuf.Empty() || kernel->IsTerminated())) {
+                    break;
+                }
+                // Only poll for what there is room or bytes for
+                sock.Readable(stripe.stop || stripe.eof || stripe.inbuf.Full());
+                sock.Writeable(stripe.outbuf.Empty());
+                stripe.sleeping = true;
+                {
+                    AutoUnlock<QueueBase> aul(*this);
+                    FileHandle *fds[2];
+                    fds[0] = &sock;
+                    fds[1] = &stripe.wakeup;
+                    FileHandle::Poll(fds, fds + 2, -1);
+                    stripe.wakeup.Read();
+                }
+                stripe.sleeping = false;
+            }
+        } catch (const ErrnoException &e) {
+            logger.Debug("Connection error (e: %d): %s", e.Error(), e.what());
+            stripe.error = e.Error();
+            if (stripe.error == 0) { stripe.error = EPIPE; }
+        }
+        stripe.eof = true;
+        stripe.outbuf.Clear();
+        Signal();
+        stripeCond.Broadcast();
+        return 0;
     }
 
     void *RemoteQueue::FileThreadEntryPoint() {
@@ -536,30 +1114,35 @@ namespace CPN {
                             break;
                         }
                     }
-                    if (sock.Closed()) {
+                    if (Closed()) {
                         logger.Debug("Connecting");
-                        shared_ptr<Sync::Future<int> > conn;
-                        if (mode == WRITE) {
-                            conn = server->ConnectWriter(GetKey());
-                        } else {
-                            conn = server->ConnectReader(GetKey());
-                        }
-                        if (conn) {
-                            sock.Reset();
-                            sock.FD(conn->Get());
-                        }
-                        if (sock.Closed()) {
+                        Connect();
+                        if (Closed()) {
                             logger.Debug("Connection Failed");
                         } else {
-                            logger.Debug("Connected");
+                            logger.Debug("Connected (%u connections)", (unsigned)socks.size());
+                            for (unsigned i = 0; i < socks.size(); ++i) {
+                                socks[i]->SetNoDelay(true);
+                            }
+                            {
+                                AutoLock<QueueBase> al(*this);
+                                rtt = socks.front()->GetRoundTripTime();
+                                ResizeSocketBuffers();
+                                StartStripes();
+                            }
                             actionThread->Start();
-                            sock.SetNoDelay(true);
+                        }
+                    } else if (!stripes.empty()) {
+                        // The stripe threads do the I/O, wait for the end
+                        AutoLock<QueueBase> al(*this);
+                        while (!dead) {
+                            actionCond.Wait(lock);
                         }
                     } else {
                         FileHandle *fds[2];
-                        fds[0] = &sock;
+                        fds[0] = socks.front().get();
                         fds[1] = holder->GetWakeup();
-                        FileHandle::Poll(fds, fds+2, -1);
+                        FileHandle::Poll(fds, fds + 2, -1);
                         {
                             AutoLock<QueueBase> al(*this);
                             Signal();
@@ -585,9 +1168,11 @@ namespace CPN {
             ShutdownWriter();
             Shutdown();
         } catch (...) {
+            StopStripes();
             holder->CleanupQueue(GetKey());
             throw;
         }
+        StopStripes();
         holder->CleanupQueue(GetKey());
         server->Wakeup();
         return 0;
@@ -613,16 +1198,14 @@ namespace CPN {
     }
 
     void RemoteQueue::InternalCheckStatus() {
-        if (sock.Closed()) {
+        if (Closed()) {
             return;
         }
 
         bool terminated = kernel->IsTerminated();
-        if (sock.Eof() && !(readshutdown || writeshutdown)) {
+        if (Eof() && !(readshutdown || writeshutdown)) {
             if (terminated) {
-                if (!sock.Closed()) {
-                    sock.Close();
-                }
+                CloseSockets();
                 UnlockedShutdown();
                 return;
             }
@@ -634,8 +1217,17 @@ namespace CPN {
         }
 
         try {
+            if (!sentID) {
+                SendIDPacket();
+                sentID = true;
+            }
+
             Read();
 
+            if (pendingShrink) {
+                TryShrink();
+            }
+
             if (pendingGrow && !sentEnd) {
                 SendGrowPacket();
                 pendingGrow = false;
@@ -684,7 +1276,7 @@ namespace CPN {
                         std::string clockstr = ClockString();
                         logger.Debug("Closing the socket (c: %s)", clockstr.c_str());
                     }
-                    sock.Close();
+                    CloseSockets();
                     dead = true;
                     actionCond.Broadcast();
                 }
@@ -725,7 +1317,7 @@ namespace CPN {
                         std::string clockstr = ClockString();
                         logger.Debug("Closing the socket (c: %s)", clockstr.c_str());
                     }
-                    sock.Close();
+                    CloseSockets();
                     dead = true;
                     actionCond.Broadcast();
                 }
@@ -736,6 +1328,7 @@ namespace CPN {
     }
 
     void RemoteQueue::UpdateClock(const Packet &packet) {
+        CPN_TRACE_INSTANT("recv", (mode == WRITE ? writernodekey : readernodekey), readerkey, packet.DataLength());
         writeclock = packet.WriteClock();
         readclock = packet.ReadClock();
         if (mode == READ) {
@@ -764,7 +1357,7 @@ namespace CPN {
         case EBADF:
         case ECONNRESET:
             try {
-                sock.Close();
+                CloseSockets();
             } catch (const ErrnoException &e) {}
             dead = true;
             actionCond.Broadcast();
@@ -780,12 +1373,12 @@ namespace CPN {
         }
     }
 
-    unsigned RemoteQueue::QueueLength(unsigned length, unsigned maxthresh, double alpha, Mode_t mode) {
-        unsigned writerlen = unsigned(((double)length)*alpha);
+    QueueSize_t RemoteQueue::QueueLength(QueueSize_t length, QueueSize_t maxthresh, double alpha, Mode_t mode) {
+        QueueSize_t writerlen = QueueSize_t(((double)length)*alpha);
         if (mode == READ) {
-            return std::max<unsigned>(length - writerlen, maxthresh);
+            return std::max<QueueSize_t>(length - writerlen, maxthresh);
         } else {
-            return std::max<unsigned>(writerlen, maxthresh);
+            return std::max<QueueSize_t>(writerlen, maxthresh);
         }
     }
 
@@ -804,8 +1397,8 @@ namespace CPN {
             << ",te: " << UnlockedNumEnqueued() << ",td: " << UnlockedNumDequeued()
             << ",M: " << (mode == READ ? "r" : "w") << ",rl: " << readerlength
             << ",wl: " << writerlength << ",c: " << ClockString() << ",bc: "
-            << bytecount << ",pb: " << pendingBlock << ",se: " << sentEnd
-            << ",pg: " << pendingGrow << ",pd4r: " << pendingD4RTag
+            << bytecount << ",pb: " << pendingBlock << ",sid: " << sentID << ",se: " << sentEnd
+            << ",pg: " << pendingGrow << ",ps: " << pendingShrink << ",pd4r: " << pendingD4RTag
             << ",d: " << dead;
         if (readshutdown) {
             oss << ",readshutdown";
@@ -819,7 +1412,7 @@ namespace CPN {
     void RemoteQueue::LogState() {
         ThresholdQueue::LogState();
         std::string clockstr = ClockString();
-        logger.Error("Mode: %s, Readerlength: %u, Writerlength %u, Clock: %s, bytecount: %u",
+        logger.Error("Mode: %s, Readerlength: %llu, Writerlength %llu, Clock: %s, bytecount: %llu",
                 mode == READ ? "read" : "write", readerlength, writerlength, clockstr.c_str(), bytecount);
         logger.Error("PendingBlock: %s, SentEnd: %s, PendingGrow: %s, PendingD4R: %s, Dead: %s",
                 BoolString(pendingBlock), BoolString(sentEnd), BoolString(pendingGrow),
@@ -827,8 +1420,26 @@ namespace CPN {
         logger.Error("FileThread id: %llu, Running: %s, ActionThread id: %llu, Running: %s",
                 (unsigned long long)((pthread_t)(*fileThread)), BoolString(fileThread->Running()),
                 (unsigned long long)((pthread_t)(*actionThread)), BoolString(actionThread->Running()));
-        if (sock.Closed()) {
+        logger.Error("Connections: %u, send: %u, recv: %u, rtt: %f",
+                (unsigned)socks.size(), sendstripe, recvstripe, rtt);
+        for (unsigned i = 0; i < stripes.size(); ++i) {
+            logger.Error("Stripe %u in: %u, out: %u, error: %d, eof: %s, stop: %s", i,
+                    stripes[i]->inbuf.Count(), stripes[i]->outbuf.Count(), stripes[i]->error,
+                    BoolString(stripes[i]->eof), BoolString(stripes[i]->stop));
+        }
+        logger.Error("Alpha: %f, Adaptive: %s, Votes: %d",
+                alpha, BoolString(adaptive), splitvotes);
+        if (Closed()) {
             logger.Error("Socket closed");
+        } else {
+            for (unsigned i = 0; i < socks.size(); ++i) {
+                try {
+                    logger.Error("Connection %u SO_SNDBUF: %d, SO_RCVBUF: %d", i,
+                            socks[i]->GetSendBufferSize(), socks[i]->GetReceiveBufferSize());
+                } catch (const ErrnoException &e) {
+                    logger.Error("Connection %u: %s", i, e.what());
+                }
+            }
         }
     }
 }
@@ -28,6 +28,11 @@
 #include "PacketDecoder.h"
 #include "PacketEncoder.h"
 #include "SocketHandle.h"
+#include "WakeupHandle.h"
+#include "CircularQueue.h"
+#include "PthreadCondition.h"
+#include "Atomic.h"
+#include <vector>
 
 /*
  * Forward declarations.
@@ -44,6 +49,19 @@ namespace CPN {
     /**
      * The RemoteQueue is a specialization of the ThresholdQueue which is split in half
      * across a socket. This class works closely with ConnectionServer and RemoteQueueHolder.
+     *
+     * The queue may be striped over several connections (see
+     * QueueAttr::SetNumConnections). Packet n in each direction is sent on
+     * connection n modulo the number of connections and the receiver reads
+     * the connections in the same order, so the packet stream is exactly
+     * the one a single connection would carry. Each connection of a striped
+     * queue has its own thread (see Stripe) so the connections move their
+     * bytes in parallel, and the connections may go to different addresses
+     * of the reader (see QueueAttr::AddReaderAddress).
+     *
+     * With QueueAttr::SetAdaptiveAlpha the writer side moves the split
+     * between the two halves at runtime and tells the reader side with
+     * a grow packet carrying the new alpha.
      */
     class RemoteQueue
         : public ThresholdQueue,
@@ -76,21 +94,64 @@ namespace CPN {
         void Shutdown();
 
 
+        void GetEndpointStats(EndpointStats &stats, bool reader) const;
+
+        /** \return the fraction of the queue on the writer side */
+        double GetAlpha() const;
+        /** \return the length of the half of the queue on this side */
+        QueueSize_t LocalQueueLength() const;
+
+        /**
+         * \return the socket buffer size that keeps the link busy, the
+         * bandwidth-delay product plus window split over numsocks
+         * connections and a packet header, at most INT_MAX/2
+         * \param window the bytes sent before an answer comes back
+         * \param rtt the round trip time in seconds, 0 if unknown
+         * \param linkrate the bytes per second of the link, 0 if unknown
+         * \param numsocks the number of connections of the queue
+         */
+        static int SocketBufferSize(QueueSize_t window, double rtt, double linkrate, unsigned numsocks);
+
         /// For debug ONLY!
         void LogState();
     private:
+        /**
+         * A connection of a striped queue. Its thread moves the bytes
+         * between the socket and the two buffers, the action thread
+         * encodes into outbuf and decodes from inbuf. All the fields
+         * are protected by the queue lock.
+         */
+        class Stripe {
+        public:
+            Stripe(RemoteQueue *q, shared_ptr<SocketHandle> s);
+            void *EntryPoint();
+
+            RemoteQueue *const queue;
+            shared_ptr<SocketHandle> sock;
+            auto_ptr<Pthread> thread;
+            CircularQueue inbuf;
+            CircularQueue outbuf;
+            WakeupHandle wakeup;
+            int error; // The error the thread stopped on, 0 for none
+            bool eof; // Nothing more will be put in inbuf
+            bool shutdownwrite; // Shut down the write end once outbuf is empty
+            bool writeshut;
+            bool stop; // Stop once outbuf is empty
+            bool sleeping; // The thread is polling, send a wakeup for it to notice changes
+        };
+
         void UnlockedShutdown();
 
-        unsigned UnlockedCount() const;
+        QueueSize_t UnlockedCount() const;
         bool UnlockedEmpty() const;
-        unsigned UnlockedQueueLength() const;
-        void UnlockedGrow(unsigned queueLen, unsigned maxThresh);
+        QueueSize_t UnlockedQueueLength() const;
+        void UnlockedGrow(QueueSize_t queueLen, QueueSize_t maxThresh);
 
         void Signal();
         void WaitForData();
         void WaitForFreespace();
-        void InternalDequeue(unsigned count);
-        void InternalEnqueue(unsigned count);
+        void InternalDequeue(QueueSize_t count);
+        void InternalEnqueue(QueueSize_t count);
         void UnlockedSignalReaderTagChanged();
         void UnlockedSignalWriterTagChanged();
 
@@ -109,13 +170,34 @@ namespace CPN {
         void SendEndOfReadPacket();
         void GrowPacket(const Packet &packet);
         void SendGrowPacket();
+        void VoteSplit(int vote);
+        void TryShrink();
         void D4RTagPacket(const Packet &packet);
         void SendD4RTagPacket();
         void IDReaderPacket(const Packet &packet);
         void IDWriterPacket(const Packet &packet);
+        void SendIDPacket();
+        void NegotiateVersion(const Packet &packet);
 
         void Read();
         void WriteBytes(const iovec *iov, unsigned iovcnt);
+        bool RecvReady() const;
+        unsigned Recv(void *ptr, unsigned len);
+        void RecvAll(void *ptr, QueueSize_t len);
+
+        void Connect();
+        bool Closed() const { return socks.front()->Closed() || (!stripes.empty() && stripes.front()->stop); }
+        bool Eof() const;
+        void CloseSockets();
+        void ShutdownWriteSockets();
+        void ResizeSocketBuffers();
+        SocketHandle &SendSocket() { return *socks[sendstripe]; }
+        SocketHandle &RecvSocket() { return *socks[recvstripe]; }
+
+        void StartStripes();
+        void StopStripes();
+        void WakeStripe(Stripe &stripe);
+        void *StripeEntryPoint(Stripe &stripe);
 
         void *FileThreadEntryPoint();
         void *ActionThreadEntryPoint();
@@ -125,7 +207,7 @@ namespace CPN {
         std::string ClockString() const;
 
         void HandleError(const ErrnoException &e);
-        static unsigned QueueLength(unsigned length, unsigned maxthresh, double alpha, Mode_t mode);
+        static QueueSize_t QueueLength(QueueSize_t length, QueueSize_t maxthresh, double alpha, Mode_t mode);
 
         /// For debugging.
         std::string GetState();
@@ -134,21 +216,31 @@ namespace CPN {
         auto_ptr<Pthread> actionThread;
         bool pendingAction;
         bool actionTick;
-        PthreadCondition actionCond;
+        FiberCondition<PthreadCondition> actionCond;
 
         const Mode_t mode;
-        const double alpha;
-        unsigned maxwritethreshold;
+        double alpha;
+        const bool adaptive;
+        int splitvotes; // Positive favors the writer side, negative the reader side
+        QueueSize_t totallength; // The length requested, before the split
+        QueueSize_t maxwritethreshold;
         ConnectionServer *const server;
         RemoteQueueHolder *const holder;
-        SocketHandle sock;
+        const std::vector<std::string> localaddrs;
+        const double linkrate; // Expected bytes per second, 0 if unknown
+        std::vector<shared_ptr<SocketHandle> > socks;
+        std::vector<shared_ptr<Stripe> > stripes; // Empty with a single connection
+        FiberCondition<PthreadCondition> stripeCond; // The stripes made progress
+        unsigned sendstripe; // Connection the next packet is sent on
+        unsigned recvstripe; // Connection the next packet is read from
+        double rtt; // Round trip time measured at connection, negative if unknown
         shared_ptr<D4R::Node> mocknode;
         uint64_t clock; // Our clock value
         uint64_t readclock; // Last knowledge of the reader clock
         uint64_t writeclock; // Last knowledge of the writer clock
 
-        unsigned readerlength;
-        unsigned writerlength;
+        QueueSize_t readerlength;
+        QueueSize_t writerlength;
 
         /**
          * When in write mode this is the number of bytes that we think
@@ -156,15 +248,20 @@ namespace CPN {
          * the number of bytes that we have read from the socket minus
          * the number of bytes that have been dequeued.
          */
-        unsigned bytecount;
+        QueueSize_t bytecount;
 
         bool pendingBlock;
+        bool sentID;
         bool sentEnd;
         bool pendingGrow;
+        bool pendingShrink; // The split moved, give back memory when it fits
         bool pendingD4RTag;
         bool tagUpdated;
 
         bool dead;
+        // Bytes sent (WRITE) or received (READ) on the sockets, read
+        // by GetEndpointStats without waiting for the lock
+        Sync::Atomic<uint64_t> linkbytes;
     };
 }
 #endif
@@ -0,0 +1,367 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+#include "StatsServer.h"
+#include "Kernel.h"
+#include "VariantToJSON.h"
+#include "PthreadFunctional.h"
+#include "ErrnoException.h"
+#include "AutoLock.h"
+#include "Clock.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace CPN {
+
+    StatsServer::StatsServer(Kernel &k, const SockAddrList &addrs, const std::string &path_)
+        : kernel(k),
+        path(path_),
+        start(MonotonicTime()),
+        logger(k.GetContext().get(), Logger::INFO),
+        shutdown(false)
+    {
+        logger.Name(k.GetName() + ".stats");
+        if (!path.empty()) {
+            // A socket left behind by an earlier run
+            unlink(path.c_str());
+        }
+        server.Listen(addrs);
+        thread.reset(CreatePthreadFunctional(this, &StatsServer::EntryPoint));
+        thread->Start();
+    }
+
+    StatsServer::~StatsServer() {
+        Shutdown();
+    }
+
+    void StatsServer::Shutdown() {
+        {
+            AutoLock<PthreadMutex> al(lock);
+            if (shutdown) { return; }
+            shutdown = true;
+        }
+        wakeup.SendWakeup();
+        thread->Join();
+        server.Close();
+        if (!path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+
+    SocketAddress StatsServer::GetAddress() {
+        SocketAddress addr;
+        addr.SetFromSockName(server.FD());
+        return addr;
+    }
+
+    Variant StatsServer::ToVariant(const NodeStats &stats) {
+        Variant node(Variant::ObjectType);
+        node["name"] = stats.name;
+        node["key"] = stats.key;
+        node["walltime"] = stats.walltime;
+        node["cputime"] = stats.cputime;
+        node["readblocked"] = stats.readblocked;
+        node["writeblocked"] = stats.writeblocked;
+        node["consumed"] = stats.consumed;
+        node["produced"] = stats.produced;
+        Variant endpoints(Variant::ArrayType);
+        for (std::vector<EndpointStats>::const_iterator e = stats.endpoints.begin();
+                e != stats.endpoints.end(); ++e) {
+            Variant endpoint(Variant::ObjectType);
+            endpoint["port"] = e->port;
+            endpoint["key"] = e->key;
+            endpoint["queue"] = e->queue;
+            endpoint["reader"] = e->reader;
+            endpoint["blocked"] = e->blocked;
+            endpoint["bytes"] = e->bytes;
+            endpoint["length"] = e->length;
+            endpoint["count"] = e->count;
+            endpoint["channels"] = e->channels;
+            if (e->remote) {
+                endpoint["remote"] = true;
+                endpoint["linkbytes"] = e->linkbytes;
+            }
+            endpoints.Append(endpoint);
+        }
+        node["endpoints"] = endpoints;
+        return node;
+    }
+
+    void *StatsServer::EntryPoint() {
+        while (true) {
+            std::vector<FileHandle*> files;
+            files.push_back(&server);
+            files.push_back(&wakeup);
+            double timeout = -1;
+            double now = MonotonicTime();
+            for (ClientList::iterator c = clients.begin(); c != clients.end(); ++c) {
+                files.push_back((*c)->sock.get());
+                if ((*c)->interval > 0) {
+                    const double wait = std::max(0.0, (*c)->next - now);
+                    timeout = (timeout < 0 ? wait : std::min(timeout, wait));
+                }
+            }
+            try {
+                FileHandle::Poll(files.begin(), files.end(), timeout);
+            } catch (const ErrnoException &e) {
+                logger.Error("Poll failed (e: %d): %s", e.Error(), e.what());
+            }
+            wakeup.Read();
+            {
+                AutoLock<PthreadMutex> al(lock);
+                if (shutdown) { break; }
+            }
+            now = MonotonicTime();
+            if (server.Readable()) {
+                server.Readable(false);
+                try {
+                    const int fd = server.Accept();
+                    if (fd >= 0) {
+                        shared_ptr<Client> client(new Client(fd));
+                        client->sock->SetBlocking(false);
+                        // Poll a client for output only when a send
+                        // fell short, see Flush
+                        client->sock->Writeable(true);
+                        clients.push_back(client);
+                    }
+                } catch (const ErrnoException &e) {
+                    logger.Error("Accept failed (e: %d): %s", e.Error(), e.what());
+                }
+            }
+            ClientList::iterator c = clients.begin();
+            while (c != clients.end()) {
+                bool alive = true;
+                if ((*c)->sock->Readable()) {
+                    alive = HandleInput(**c, now);
+                }
+                if (alive && !(*c)->output.empty() && (*c)->sock->Writeable()) {
+                    alive = Flush(**c);
+                }
+                if (alive && (*c)->interval > 0 && (*c)->next <= now) {
+                    alive = Send(**c, Delta(**c, now));
+                    (*c)->next = std::max((*c)->next + (*c)->interval, now);
+                }
+                if (alive) {
+                    ++c;
+                } else {
+                    c = clients.erase(c);
+                }
+            }
+        }
+        clients.clear();
+        return 0;
+    }
+
+    /**
+     * \return false if the client has gone away
+     */
+    bool StatsServer::HandleInput(Client &client, double now) {
+        // Read until the socket runs dry, the poll only waits on a
+        // socket which is not Readable
+        while (client.sock->Readable()) {
+            char buf[256];
+            unsigned num = 0;
+            try {
+                num = client.sock->Read(buf, sizeof(buf));
+            } catch (const ErrnoException &) {
+                return false;
+            }
+            if (num == 0) {
+                if (client.sock->Eof()) { return false; }
+                continue;
+            }
+            client.input.append(buf, num);
+            std::string::size_type end;
+            while ((end = client.input.find('\n')) != std::string::npos) {
+                std::string command = client.input.substr(0, end);
+                client.input.erase(0, end + 1);
+                if (!command.empty() && command[command.size() - 1] == '\r') {
+                    command.erase(command.size() - 1);
+                }
+                if (!Command(client, command, now)) { return false; }
+            }
+            // Nobody sends commands that long
+            if (client.input.size() >= 4096) { return false; }
+        }
+        return true;
+    }
+
+    /**
+     * \return false if the client has gone away
+     */
+    bool StatsServer::Command(Client &client, const std::string &command, double now) {
+        if (command == "snapshot") {
+            return Send(client, Snapshot(client, now));
+        } else if (command.compare(0, 7, "stream ") == 0) {
+            const double interval = strtod(command.c_str() + 7, 0);
+            if (interval > 0) {
+                client.interval = interval;
+                client.next = now + interval;
+                return Send(client, Snapshot(client, now));
+            } else {
+                Variant error(Variant::ObjectType);
+                error["error"] = "stream needs a positive interval in seconds";
+                return Send(client, error);
+            }
+        } else if (command == "stop") {
+            client.interval = 0;
+        } else if (!command.empty()) {
+            Variant error(Variant::ObjectType);
+            error["error"] = "unknown command " + command;
+            return Send(client, error);
+        }
+        return true;
+    }
+
+    /**
+     * Queue msg for the client and send what the socket takes.
+     * \return false if the client has gone away or fell too far behind
+     */
+    bool StatsServer::Send(Client &client, const Variant &msg) {
+        const std::string line = VariantToJSON(msg) + "\n";
+        // A single message larger than the limit is still sent whole
+        if (!client.output.empty() && client.output.size() + line.size() > MAX_PENDING) {
+            logger.Warn("Dropping a stats client %u bytes behind", unsigned(client.output.size()));
+            return false;
+        }
+        client.output.append(line);
+        return Flush(client);
+    }
+
+    /**
+     * Send as much of the output of the client as the socket takes
+     * without blocking, a short send leaves the socket not Writeable
+     * so that the next poll waits for room.
+     * \return false if the client has gone away
+     */
+    bool StatsServer::Flush(Client &client) {
+        SocketHandle::SendOpts opts;
+#ifndef OS_DARWIN
+        opts.NoSignal(false);
+#endif
+        try {
+            unsigned written = 0;
+            while (written < client.output.size() && client.sock->Writeable()) {
+                const unsigned num = client.sock->Send(client.output.data() + written,
+                        client.output.size() - written, opts);
+                if (num == 0 && !client.sock->Good()) { return false; }
+                written += num;
+            }
+            client.output.erase(0, written);
+        } catch (const ErrnoException &) {
+            return false;
+        }
+        return true;
+    }
+
+    Variant StatsServer::Snapshot(Client &client, double now) {
+        std::vector<NodeStats> running;
+        std::vector<NodeStats> ended;
+        kernel.GetNodeStats(running);
+        kernel.GetEndedNodeStats(ended);
+        Variant msg(Variant::ObjectType);
+        msg["kernel"] = kernel.GetName();
+        msg["time"] = now - start;
+        msg["threadsreused"] = kernel.NumNodeThreadsReused();
+        Variant nodes(Variant::ArrayType);
+        client.previous.clear();
+        for (std::vector<NodeStats>::iterator n = running.begin(); n != running.end(); ++n) {
+            nodes.Append(ToVariant(*n));
+            client.previous[n->key] = *n;
+        }
+        msg["nodes"] = nodes;
+        Variant endednodes(Variant::ArrayType);
+        for (std::vector<NodeStats>::iterator n = ended.begin(); n != ended.end(); ++n) {
+            endednodes.Append(ToVariant(*n));
+        }
+        msg["ended"] = endednodes;
+        client.last = now;
+        return msg;
+    }
+
+    Variant StatsServer::Delta(Client &client, double now) {
+        std::vector<NodeStats> running;
+        kernel.GetNodeStats(running);
+        const double interval = now - client.last;
+        Variant msg(Variant::ObjectType);
+        msg["time"] = now - start;
+        msg["interval"] = interval;
+        Variant nodes(Variant::ArrayType);
+        std::map<Key_t, NodeStats> current;
+        for (std::vector<NodeStats>::iterator n = running.begin(); n != running.end(); ++n) {
+            current[n->key] = *n;
+            std::map<Key_t, NodeStats>::iterator prev = client.previous.find(n->key);
+            if (prev == client.previous.end()) {
+                Variant node = ToVariant(*n);
+                node["new"] = true;
+                nodes.Append(node);
+                continue;
+            }
+            const NodeStats &p = prev->second;
+            Variant node(Variant::ObjectType);
+            node["name"] = n->name;
+            node["key"] = n->key;
+            node["walltime"] = n->walltime;
+            node["cputime"] = (n->cputime < 0 || p.cputime < 0 ? -1 : n->cputime - p.cputime);
+            node["readblocked"] = n->readblocked - p.readblocked;
+            node["writeblocked"] = n->writeblocked - p.writeblocked;
+            node["consumed"] = n->consumed - p.consumed;
+            node["produced"] = n->produced - p.produced;
+            std::map<Key_t, const EndpointStats*> before;
+            for (std::vector<EndpointStats>::const_iterator e = p.endpoints.begin();
+                    e != p.endpoints.end(); ++e) {
+                before[e->key] = &*e;
+            }
+            Variant endpoints(Variant::ArrayType);
+            for (std::vector<EndpointStats>::iterator e = n->endpoints.begin();
+                    e != n->endpoints.end(); ++e) {
+                EndpointStats zero;
+                const EndpointStats &b = (before.count(e->key) ? *before[e->key] : zero);
+                Variant endpoint(Variant::ObjectType);
+                endpoint["port"] = e->port;
+                endpoint["key"] = e->key;
+                endpoint["count"] = e->count;
+                endpoint["length"] = e->length;
+                endpoint["channels"] = e->channels;
+                endpoint["blocked"] = e->blocked - b.blocked;
+                endpoint["bytes"] = e->bytes - b.bytes;
+                endpoint["rate"] = (interval > 0 ? (e->bytes - b.bytes)/interval : 0);
+                if (e->remote) {
+                    endpoint["linkrate"] = (interval > 0 ? (e->linkbytes - b.linkbytes)/interval : 0);
+                }
+                endpoints.Append(endpoint);
+            }
+            node["endpoints"] = endpoints;
+            nodes.Append(node);
+        }
+        msg["nodes"] = nodes;
+        Variant ended(Variant::ArrayType);
+        for (std::map<Key_t, NodeStats>::iterator p = client.previous.begin();
+                p != client.previous.end(); ++p) {
+            if (!current.count(p->first)) { ended.Append(p->first); }
+        }
+        msg["ended"] = ended;
+        client.previous.swap(current);
+        client.last = now;
+        return msg;
+    }
+}
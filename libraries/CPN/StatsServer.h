@@ -0,0 +1,132 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief A socket a running kernel answers with JSON snapshots of
+ * what its nodes and queues are doing.
+ */
+#ifndef CPN_STATSSERVER_H
+#define CPN_STATSSERVER_H
+#pragma once
+
+#include "CPNCommon.h"
+#include "NodeStats.h"
+#include "ServerSocketHandle.h"
+#include "SocketHandle.h"
+#include "WakeupHandle.h"
+#include "PthreadMutex.h"
+#include "Logger.h"
+#include "Variant.h"
+#include <map>
+#include <vector>
+
+class Pthread;
+
+namespace CPN {
+
+    class Kernel;
+
+    /**
+     * \brief Serves the stats of a kernel, see KernelAttr::SetStatsAddress
+     * and KernelAttr::SetStatsSocket.
+     *
+     * A client sends one command per line and gets one line of JSON
+     * per answer:
+     * - "snapshot" answers with the kernel counters and the NodeStats
+     *   (see ToVariant) of the running and the ended nodes.
+     * - "stream <seconds>" answers with a snapshot and then every given
+     *   seconds with what changed: counters as differences, queue
+     *   counts and lengths as they are and the rate of each queue and
+     *   remote link.
+     *
+     * Queue bytes, counts, lengths and rates are summed over the
+     * channels of the queue, see EndpointStats.
+     * - "stop" ends a stream.
+     *
+     * The server runs on its own thread. A snapshot only holds the
+     * kernel node lock long enough to copy the list of nodes and each
+     * queue lock long enough to copy its counters, the nodes never wait
+     * on the server. The sockets do not block, what a client has not
+     * read yet waits in its buffer and a client which falls more than
+     * MAX_PENDING bytes behind is dropped.
+     */
+    class CPN_LOCAL StatsServer {
+    public:
+        /**
+         * \param k the kernel to serve the stats of
+         * \param addrs the addresses to listen on
+         * \param path the path of the unix socket in addrs if it is one,
+         * removed when the server shuts down
+         */
+        StatsServer(Kernel &k, const SockAddrList &addrs, const std::string &path);
+        ~StatsServer();
+
+        /** \brief Close the connections and stop the server thread. */
+        void Shutdown();
+
+        /** \return the address the server is listening on */
+        SocketAddress GetAddress();
+
+        /** \return stats as a JSON ready Variant */
+        static Variant ToVariant(const NodeStats &stats);
+
+        /// The most a client may leave unread before it is dropped
+        static const unsigned MAX_PENDING = 1 << 20;
+    private:
+        StatsServer(const StatsServer&);
+        StatsServer &operator=(const StatsServer&);
+
+        struct Client {
+            Client(int fd) : sock(new SocketHandle(fd)), interval(0), next(0), last(0) {}
+            shared_ptr<SocketHandle> sock;
+            std::string input;
+            /// Sent but not yet taken by the socket
+            std::string output;
+            /// Seconds between deltas, 0 when not streaming
+            double interval;
+            double next;
+            /// When the last snapshot or delta was taken
+            double last;
+            /// The node stats at that time
+            std::map<Key_t, NodeStats> previous;
+        };
+        typedef std::vector<shared_ptr<Client> > ClientList;
+
+        void *EntryPoint();
+        bool HandleInput(Client &client, double now);
+        bool Command(Client &client, const std::string &command, double now);
+        bool Send(Client &client, const Variant &msg);
+        bool Flush(Client &client);
+        Variant Snapshot(Client &client, double now);
+        Variant Delta(Client &client, double now);
+
+        Kernel &kernel;
+        const std::string path;
+        const double start;
+        Logger logger;
+        ServerSocketHandle server;
+        WakeupHandle wakeup;
+        ClientList clients;
+        auto_ptr<Pthread> thread;
+
+        PthreadMutex lock;
+        bool shutdown;
+    };
+}
+#endif
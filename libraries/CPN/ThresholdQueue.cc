@@ -25,7 +25,9 @@
 #include "ThresholdQueue.h"
 #include "QueueAttr.h"
 #include "ThrowingAssert.h"
+#include "Trace.h"
 #include <cstring>
+#include <algorithm>
 
 namespace CPN {
 
@@ -34,16 +36,20 @@ namespace CPN {
     {
         ThresholdQueueAttr qattr(attr.GetLength(), attr.GetMaxThreshold(),
                 attr.GetNumChannels(), attr.GetHint() == QUEUEHINT_THRESHOLD);
+        qattr.MemoryNode(attr.GetMemoryNode() < 0 ? -1 : attr.GetMemoryNode());
         queue = new TQImpl(qattr);
+        CPN_TRACE_INSTANT("queue", writernodekey, readerkey, queue->QueueLength());
     }
 
     ThresholdQueue::ThresholdQueue(KernelBase *k, const SimpleQueueAttr &attr,
-            unsigned length)
+            QueueSize_t length)
         : QueueBase(k, attr), queue(0), oldqueue(0), enqueueUseOld(false), dequeueUseOld(false)
     {
         ThresholdQueueAttr qattr(length, attr.GetMaxThreshold(),
                 attr.GetNumChannels(), attr.GetHint() == QUEUEHINT_THRESHOLD);
+        qattr.MemoryNode(attr.GetMemoryNode() < 0 ? -1 : attr.GetMemoryNode());
         queue = new TQImpl(qattr);
+        CPN_TRACE_INSTANT("queue", writernodekey, readerkey, queue->QueueLength());
     }
 
 
@@ -54,7 +60,7 @@ namespace CPN {
         oldqueue = 0;
     }
 
-    void *ThresholdQueue::InternalGetRawEnqueuePtr(unsigned thresh, unsigned chan) {
+    void *ThresholdQueue::InternalGetRawEnqueuePtr(QueueSize_t thresh, unsigned chan) {
         void *ret = 0;
         if (enqueueUseOld) {
             ASSERT(inenqueue);
@@ -66,12 +72,12 @@ namespace CPN {
         return ret;
     }
 
-    void ThresholdQueue::InternalEnqueue(unsigned count) {
+    void ThresholdQueue::InternalEnqueue(QueueSize_t count) {
         if (enqueueUseOld) {
             oldqueue->Dequeue(oldqueue->Count());
             oldqueue->Enqueue(count);
 
-            unsigned count;
+            QueueSize_t count;
             while ( (count = oldqueue->Count()) != 0 ) {
                 if (count > oldqueue->MaxThreshold()) {
                     count = oldqueue->MaxThreshold();
@@ -99,7 +105,7 @@ namespace CPN {
         return queue->NumChannels();
     }
 
-    unsigned ThresholdQueue::UnlockedEnqueueChannelStride() const {
+    QueueSize_t ThresholdQueue::UnlockedEnqueueChannelStride() const {
         if (enqueueUseOld) {
             return oldqueue->ChannelStride();
         } else {
@@ -107,7 +113,7 @@ namespace CPN {
         }
     }
 
-    unsigned ThresholdQueue::UnlockedDequeueChannelStride() const {
+    QueueSize_t ThresholdQueue::UnlockedDequeueChannelStride() const {
         if (dequeueUseOld) {
             return oldqueue->ChannelStride();
         } else {
@@ -115,7 +121,7 @@ namespace CPN {
         }
     }
 
-    unsigned ThresholdQueue::UnlockedFreespace() const {
+    QueueSize_t ThresholdQueue::UnlockedFreespace() const {
         return queue->Freespace();
     }
 
@@ -123,7 +129,7 @@ namespace CPN {
         return queue->Full();
     }
 
-    const void *ThresholdQueue::InternalGetRawDequeuePtr(unsigned thresh, unsigned chan) {
+    const void *ThresholdQueue::InternalGetRawDequeuePtr(QueueSize_t thresh, unsigned chan) {
         const void *ret = 0;
         if (dequeueUseOld) {
             // The ONLY reason this code path should be followed is if the node made a getdequeueptr
@@ -137,7 +143,7 @@ namespace CPN {
         return ret;
     }
 
-    void ThresholdQueue::InternalDequeue(unsigned count) {
+    void ThresholdQueue::InternalDequeue(QueueSize_t count) {
         if (dequeueUseOld) {
             dequeueUseOld = false;
             delete oldqueue;
@@ -146,7 +152,7 @@ namespace CPN {
         queue->Dequeue(count);
     }
 
-    unsigned ThresholdQueue::UnlockedCount() const {
+    QueueSize_t ThresholdQueue::UnlockedCount() const {
         return queue->Count();
     }
 
@@ -154,24 +160,25 @@ namespace CPN {
         return queue->Empty();
     }
 
-    unsigned ThresholdQueue::UnlockedMaxThreshold() const {
+    QueueSize_t ThresholdQueue::UnlockedMaxThreshold() const {
         return queue->MaxThreshold();
     }
 
-    unsigned ThresholdQueue::UnlockedQueueLength() const {
+    QueueSize_t ThresholdQueue::UnlockedQueueLength() const {
         return queue->QueueLength();
     }
 
-    unsigned ThresholdQueue::UnlockedNumEnqueued() const {
+    QueueSize_t ThresholdQueue::UnlockedNumEnqueued() const {
         return queue->ElementsEnqueued();
     }
 
-    unsigned ThresholdQueue::UnlockedNumDequeued() const {
+    QueueSize_t ThresholdQueue::UnlockedNumDequeued() const {
         return queue->ElementsDequeued();
     }
 
-    void ThresholdQueue::UnlockedGrow(unsigned queueLen, unsigned maxThresh) {
+    void ThresholdQueue::UnlockedGrow(QueueSize_t queueLen, QueueSize_t maxThresh) {
         if (queueLen <= queue->QueueLength() && maxThresh <= queue->MaxThreshold()) return;
+        CPN_TRACE_INSTANT("grow", readernodekey, readerkey, queueLen);
         ASSERT(!(inenqueue && indequeue), "Unhandled grow case of having an outstanding dequeue and enqueue");
         if (oldqueue) {
             // If the old queue is still around we have to still be in the same state
@@ -192,7 +199,21 @@ namespace CPN {
         }
     }
 
-    ThresholdQueue::TQImpl::TQImpl(unsigned length, unsigned maxthresh, unsigned numchan)
+    bool ThresholdQueue::UnlockedShrink(QueueSize_t queueLen) {
+        queueLen = std::max<QueueSize_t>(queueLen, queue->MaxThreshold());
+        if (queueLen >= queue->QueueLength()) return false;
+        if (inenqueue || indequeue || oldqueue) return false;
+        if (queue->Count() > queueLen) return false;
+        CPN_TRACE_INSTANT("shrink", readernodekey, readerkey, queueLen);
+        queue->Resize(queueLen, queue->MaxThreshold(), false);
+        return true;
+    }
+
+    QueueSize_t ThresholdQueue::UnlockedLocalLength() const {
+        return queue->QueueLength();
+    }
+
+    ThresholdQueue::TQImpl::TQImpl(QueueSize_t length, QueueSize_t maxthresh, unsigned numchan)
         : ThresholdQueueBase(1, length, maxthresh, numchan)
     {
     }
@@ -202,14 +223,22 @@ namespace CPN {
     {
     }
 
-    ThresholdQueue::TQImpl *ThresholdQueue::TQImpl::Grow(unsigned queueLen, unsigned maxThresh, bool copy) {
+    ThresholdQueue::TQImpl *ThresholdQueue::TQImpl::Grow(QueueSize_t queueLen, QueueSize_t maxThresh, bool copy) {
         // ignore the do-nothing case
         if (queueLen <= QueueLength() && maxThresh <= MaxThreshold()) return 0;
         
         // we don't do any shrinking
         if (maxThresh <= MaxThreshold()) maxThresh = MaxThreshold();
         if (queueLen <= QueueLength()) queueLen = QueueLength();
-        
+        return Resize(queueLen, maxThresh, copy);
+    }
+
+    /**
+     * Move everything to a new buffer of the given size, which must
+     * hold what is in the queue now.
+     */
+    ThresholdQueue::TQImpl *ThresholdQueue::TQImpl::Resize(QueueSize_t queueLen, QueueSize_t maxThresh, bool copy) {
+        ASSERT(Count() <= queueLen);
         // keep our old info around
         auto_ptr<TQImpl> oldQueue = auto_ptr<TQImpl>(new TQImpl(*this));    // just duplicate the pointers
         // Save the head and tail, these are the only member variables
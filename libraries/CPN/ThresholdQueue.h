@@ -45,31 +45,41 @@ namespace CPN {
     class CPN_LOCAL ThresholdQueue : public QueueBase {
     public:
         ThresholdQueue(KernelBase *k, const SimpleQueueAttr &attr);
-        ThresholdQueue(KernelBase *k, const SimpleQueueAttr &attr, unsigned length);
+        ThresholdQueue(KernelBase *k, const SimpleQueueAttr &attr, QueueSize_t length);
         ~ThresholdQueue();
 
     protected:
-        virtual void *InternalGetRawEnqueuePtr(unsigned thresh, unsigned chan);
-        virtual void InternalEnqueue(unsigned count);
+        virtual void *InternalGetRawEnqueuePtr(QueueSize_t thresh, unsigned chan);
+        virtual void InternalEnqueue(QueueSize_t count);
 
 
-        virtual const void *InternalGetRawDequeuePtr(unsigned thresh, unsigned chan);
-        virtual void InternalDequeue(unsigned count);
+        virtual const void *InternalGetRawDequeuePtr(QueueSize_t thresh, unsigned chan);
+        virtual void InternalDequeue(QueueSize_t count);
 
         virtual unsigned UnlockedNumChannels() const;
-        virtual unsigned UnlockedMaxThreshold() const;
-        virtual unsigned UnlockedQueueLength() const;
-        virtual unsigned UnlockedFreespace() const;
+        virtual QueueSize_t UnlockedMaxThreshold() const;
+        virtual QueueSize_t UnlockedQueueLength() const;
+        virtual QueueSize_t UnlockedFreespace() const;
         virtual bool UnlockedFull() const;
-        virtual unsigned UnlockedCount() const;
+        virtual QueueSize_t UnlockedCount() const;
         virtual bool UnlockedEmpty() const;
-        virtual unsigned UnlockedEnqueueChannelStride() const;
-        virtual unsigned UnlockedDequeueChannelStride() const;
+        virtual QueueSize_t UnlockedEnqueueChannelStride() const;
+        virtual QueueSize_t UnlockedDequeueChannelStride() const;
 
-        unsigned UnlockedNumEnqueued() const;
-        unsigned UnlockedNumDequeued() const;
+        QueueSize_t UnlockedNumEnqueued() const;
+        QueueSize_t UnlockedNumDequeued() const;
 
-        virtual void UnlockedGrow(unsigned queueLen, unsigned maxThresh);
+        virtual void UnlockedGrow(QueueSize_t queueLen, QueueSize_t maxThresh);
+        /**
+         * Give memory back by making the queue shorter. Only done when
+         * nobody has a pointer into the queue and what is in it fits,
+         * the max threshold is kept.
+         * \param queueLen the new length
+         * \return true if the queue was made shorter
+         */
+        bool UnlockedShrink(QueueSize_t queueLen);
+        /** \return the length of the memory of this queue */
+        QueueSize_t UnlockedLocalLength() const;
 
     protected:
         /**
@@ -78,10 +88,11 @@ namespace CPN {
         class TQImpl : public ThresholdQueueBase {
         public:
             typedef ThresholdQueueBase::ulong ulong;
-            TQImpl(unsigned length, unsigned maxthres, unsigned numchan);
+            TQImpl(QueueSize_t length, QueueSize_t maxthres, unsigned numchan);
             TQImpl(const ThresholdQueueAttr &attr);
 
-            TQImpl *Grow(unsigned queueLen, unsigned maxThresh, bool copy);
+            TQImpl *Grow(QueueSize_t queueLen, QueueSize_t maxThresh, bool copy);
+            TQImpl *Resize(QueueSize_t queueLen, QueueSize_t maxThresh, bool copy);
         };
         TQImpl *queue;
         TQImpl *oldqueue;
@@ -0,0 +1,200 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+#include "Trace.h"
+
+#ifdef CPN_TRACE
+
+#include "Clock.h"
+#include "PthreadMutex.h"
+#include "PthreadKey.h"
+#include "AutoLock.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace CPN {
+
+    namespace {
+
+        struct TraceEvent {
+            double time;
+            const char *name;
+            Key_t lane;
+            Key_t queue;
+            uint64_t value;
+            char phase;
+        };
+
+        bool EventBefore(const TraceEvent &a, const TraceEvent &b) {
+            return a.time < b.time;
+        }
+
+        /**
+         * A ring of the most recent events of one thread. Only the
+         * owning thread writes, head is published after the event so
+         * a reader can tell which events it may have seen torn.
+         */
+        struct TraceBuffer {
+            TraceBuffer() : head(0) {}
+
+            void Add(char phase, const char *name, Key_t lane, Key_t queue, uint64_t value) {
+                const unsigned long h = head;
+                TraceEvent &event = events[h % SIZE];
+                event.time = MonotonicTime();
+                event.name = name;
+                event.lane = lane;
+                event.queue = queue;
+                event.value = value;
+                event.phase = phase;
+                __sync_synchronize();
+                head = h + 1;
+            }
+
+            void Copy(std::vector<TraceEvent> &out) const {
+                const unsigned long end = head;
+                __sync_synchronize();
+                const unsigned long start = (end > SIZE ? end - SIZE : 0);
+                std::vector<TraceEvent> copy;
+                for (unsigned long i = start; i < end; ++i) {
+                    copy.push_back(events[i % SIZE]);
+                }
+                __sync_synchronize();
+                // Drop the events which were overwritten while copying
+                const unsigned long after = head;
+                const unsigned long valid = (after > SIZE ? after - SIZE : 0);
+                for (unsigned long i = std::max(start, valid); i < end; ++i) {
+                    out.push_back(copy[i - start]);
+                }
+            }
+
+            static const unsigned long SIZE = 1 << 15;
+            TraceEvent events[SIZE];
+            volatile unsigned long head;
+        };
+
+        PthreadMutex registrylock;
+        // Every buffer ever made, a buffer outlives its thread so that
+        // the events are still there to dump
+        std::vector<TraceBuffer*> buffers;
+        // Buffers whose thread has exited, handed to new threads
+        std::vector<TraceBuffer*> retired;
+        std::map<Key_t, std::string> lanenames;
+
+        void RetireBuffer(TraceBuffer *buffer) {
+            AutoLock<PthreadMutex> al(registrylock);
+            retired.push_back(buffer);
+        }
+
+        PthreadKey<TraceBuffer*> currentbuffer(&RetireBuffer);
+
+        TraceBuffer *GetBuffer() {
+            TraceBuffer *buffer = currentbuffer.Get();
+            if (!buffer) {
+                AutoLock<PthreadMutex> al(registrylock);
+                if (retired.empty()) {
+                    buffer = new TraceBuffer;
+                    buffers.push_back(buffer);
+                } else {
+                    buffer = retired.back();
+                    retired.pop_back();
+                }
+                currentbuffer.Set(buffer);
+            }
+            return buffer;
+        }
+
+        void WriteString(FILE *f, const std::string &str) {
+            fputc('"', f);
+            for (std::string::const_iterator c = str.begin(); c != str.end(); ++c) {
+                if (*c == '"' || *c == '\\') {
+                    fputc('\\', f);
+                    fputc(*c, f);
+                } else if ((unsigned char)*c < 0x20) {
+                    fprintf(f, "\\u%04x", (unsigned)(unsigned char)*c);
+                } else {
+                    fputc(*c, f);
+                }
+            }
+            fputc('"', f);
+        }
+    }
+
+    bool Tracer::enabled = false;
+
+    void Tracer::Enable() {
+        enabled = true;
+    }
+
+    void Tracer::Record(char phase, const char *name, Key_t lane, Key_t queue, uint64_t value) {
+        GetBuffer()->Add(phase, name, lane, queue, value);
+    }
+
+    void Tracer::NameLane(Key_t lane, const std::string &name) {
+        if (!enabled) { return; }
+        AutoLock<PthreadMutex> al(registrylock);
+        lanenames[lane] = name;
+    }
+
+    bool Tracer::Dump(const std::string &filename) {
+        std::vector<TraceEvent> events;
+        std::map<Key_t, std::string> names;
+        {
+            AutoLock<PthreadMutex> al(registrylock);
+            for (std::vector<TraceBuffer*>::iterator b = buffers.begin(); b != buffers.end(); ++b) {
+                (*b)->Copy(events);
+            }
+            names = lanenames;
+        }
+        // Events of a node may be in several buffers
+        std::stable_sort(events.begin(), events.end(), EventBefore);
+        FILE *f = fopen(filename.c_str(), "w");
+        if (!f) { return false; }
+        const int pid = getpid();
+        const double origin = events.empty() ? 0 : events.front().time;
+        fprintf(f, "{\"traceEvents\":[\n");
+        bool first = true;
+        for (std::map<Key_t, std::string>::iterator n = names.begin(); n != names.end(); ++n) {
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%llu,\"args\":{\"name\":",
+                    (first ? "" : ",\n"), pid, (unsigned long long)n->first);
+            WriteString(f, n->second);
+            fprintf(f, "}}");
+            first = false;
+        }
+        for (std::vector<TraceEvent>::iterator e = events.begin(); e != events.end(); ++e) {
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"cpn\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%llu",
+                    (first ? "" : ",\n"), e->name, e->phase, 1e6*(e->time - origin), pid,
+                    (unsigned long long)e->lane);
+            if (e->phase == 'i') {
+                fprintf(f, ",\"s\":\"t\"");
+            }
+            fprintf(f, ",\"args\":{\"queue\":%llu,\"value\":%llu}}",
+                    (unsigned long long)e->queue, (unsigned long long)e->value);
+            first = false;
+        }
+        fprintf(f, "\n]}\n");
+        return fclose(f) == 0;
+    }
+}
+
+#endif
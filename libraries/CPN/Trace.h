@@ -0,0 +1,92 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief An event trace of the process network which can be viewed
+ * as a timeline in chrome://tracing or Perfetto.
+ *
+ * The trace is only compiled in when CPN_TRACE is defined (make
+ * USE_CPN_TRACE=1), otherwise the CPN_TRACE_ macros are empty. When
+ * compiled in a kernel records events once KernelAttr::SetTraceFile
+ * is given and writes them out in the Chrome trace event format when
+ * Kernel::Wait returns.
+ *
+ * Every thread records into its own ring buffer without locking,
+ * only the most recent events of each thread are kept. The events
+ * are shown per node: each node is a row (tid) named after it.
+ */
+#ifndef CPN_TRACE_H
+#define CPN_TRACE_H
+#pragma once
+
+#include "CPNCommon.h"
+#include <string>
+
+#ifdef CPN_TRACE
+
+namespace CPN {
+
+    class CPN_LOCAL Tracer {
+    public:
+        /** \brief Start recording events. */
+        static void Enable();
+        static bool Enabled() { return enabled; }
+
+        /**
+         * \brief Record an event if enabled.
+         * \param phase 'B' to begin a slice, 'E' to end it or 'i'
+         * for an instant
+         * \param name the name of the event, must be a string literal
+         * \param lane the key of the node the event belongs to
+         * \param queue the reader key of the queue involved or 0
+         * \param value a size or count to go with the event
+         */
+        static void Event(char phase, const char *name, Key_t lane, Key_t queue, uint64_t value) {
+            if (enabled) { Record(phase, name, lane, queue, value); }
+        }
+
+        /** \brief Show the events of lane under the given name. */
+        static void NameLane(Key_t lane, const std::string &name);
+
+        /**
+         * \brief Write the events recorded so far to filename as
+         * Chrome trace event JSON.
+         * \return false if the file could not be written
+         */
+        static bool Dump(const std::string &filename);
+    private:
+        static void Record(char phase, const char *name, Key_t lane, Key_t queue, uint64_t value);
+        static bool enabled;
+    };
+}
+
+#define CPN_TRACE_BEGIN(name, lane, queue) CPN::Tracer::Event('B', name, lane, queue, 0)
+#define CPN_TRACE_END(name, lane, queue) CPN::Tracer::Event('E', name, lane, queue, 0)
+#define CPN_TRACE_INSTANT(name, lane, queue, value) CPN::Tracer::Event('i', name, lane, queue, value)
+#define CPN_TRACE_NAME_LANE(lane, name) CPN::Tracer::NameLane(lane, name)
+
+#else
+
+#define CPN_TRACE_BEGIN(name, lane, queue) do {} while (0)
+#define CPN_TRACE_END(name, lane, queue) do {} while (0)
+#define CPN_TRACE_INSTANT(name, lane, queue, value) do {} while (0)
+#define CPN_TRACE_NAME_LANE(lane, name) do {} while (0)
+
+#endif
+#endif
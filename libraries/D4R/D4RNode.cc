@@ -36,40 +36,57 @@ namespace D4R {
 
     Node::Node(uint64_t key)
         : publicTag(key),
-        privateTag(key)
+        privateTag(key),
+        tagseq(0)
     {
     }
 
     Node::~Node() {}
 
+    Tag Node::ReadTag(const Tag &tag) const {
+        while (true) {
+            const unsigned seq = tagseq.Get();
+            if (seq & 1) { continue; }
+            Tag t = tag;
+            if (tagseq.Get() == seq) { return t; }
+        }
+    }
+
+    void Node::PublishTags(const Tag &pub, const Tag &priv) {
+        tagseq.Add(1);
+        publicTag = pub;
+        privateTag = priv;
+        tagseq.Add(1);
+    }
+
     Tag Node::GetPublicTag() const {
-        AutoLock<PthreadMutex> al(taglock);
-        return publicTag;
+        return ReadTag(publicTag);
     }
 
     void Node::SetPublicTag(const Tag &t) {
         AutoLock<PthreadMutex> al(taglock);
-        publicTag = t;
+        PublishTags(t, privateTag);
     }
 
     Tag Node::GetPrivateTag() const {
-        AutoLock<PthreadMutex> al(taglock);
-        return privateTag;
+        return ReadTag(privateTag);
     }
 
     void Node::SetPrivateTag(const Tag &t) {
         AutoLock<PthreadMutex> al(taglock);
-        privateTag = t;
+        PublishTags(publicTag, t);
     }
 
-    void Node::Block(const Tag &t, unsigned qsize) {
+    void Node::Block(const Tag &t, uint64_t qsize) {
         AutoLock<PthreadMutex> al(taglock);
-        privateTag.QueueSize(qsize);
-        privateTag.Count(std::max(publicTag.Count(), t.Count()) + 1);
-        DEBUG("Node %llu:%llu block %d\n", privateTag.Count(), privateTag.Key(), (int)privateTag.QueueSize());
-        publicTag = privateTag;
+        Tag priv = privateTag;
+        priv.QueueSize(qsize);
+        priv.Count(std::max(publicTag.Count(), t.Count()) + 1);
+        DEBUG("Node %llu:%llu block %d\n", priv.Count(), priv.Key(), (int)priv.QueueSize());
+        const bool changed = (publicTag != priv);
+        PublishTags(priv, priv);
         al.Unlock();
-        SignalTagChanged();
+        if (changed) { SignalTagChanged(); }
     }
 
     bool Node::Transmit(const Tag &t) {
@@ -81,11 +98,12 @@ namespace D4R {
                     publicTag.Count(), publicTag.Key(), (int)publicTag.QueueSize(), publicTag.QueueKey(),
                     t.Count(), t.Key(), (int)t.QueueSize(), t.QueueKey());
 
-            uint128_t priority = std::min(privateTag.Priority(), t.Priority());
-            publicTag = t;
-            publicTag.Priority(priority);
+            Tag pub = t;
+            pub.Priority(std::min(privateTag.Priority(), t.Priority()));
+            const bool changed = (publicTag != pub);
+            PublishTags(pub, privateTag);
             al.Unlock();
-            SignalTagChanged();
+            if (changed) { SignalTagChanged(); }
         } else if (publicTag == t) {
 
             DEBUG("Transfer: publicTag == t\n\tPrivate: (%llu, %llu, %d, %llu)\n\tPublic: (%llu, %llu, %d, %llu)\n\t     t: (%llu, %llu, %d, %llu)\n",
@@ -103,49 +121,53 @@ namespace D4R {
         return false;
     }
 
-    void Node::AddReader(weak_ptr<QueueBase> q) {
-        AutoLock<PthreadMutex> al(taglock);
-        readerlist.push_back(q);
+    /** Holds the queue lists of a node through LockQueues */
+    class Node::QueueListLock {
+    public:
+        QueueListLock(Node &n) : node(n) { node.LockQueues(); }
+        ~QueueListLock() { node.UnlockQueues(); }
+    private:
+        Node &node;
+    };
+
+    void Node::LockQueues() {
+        queuelock.Lock();
     }
-    void Node::AddWriter(weak_ptr<QueueBase> q) {
-        AutoLock<PthreadMutex> al(taglock);
-        writerlist.push_back(q);
+
+    void Node::UnlockQueues() {
+        queuelock.Unlock();
     }
 
-    void SignalReader(shared_ptr<QueueBase> q) {
-        q->SignalReaderTagChanged();
+    void Node::AddReader(QueueBase *q) {
+        QueueListLock al(*this);
+        readerlist.push_back(q);
     }
 
-    void SignalWriter(shared_ptr<QueueBase> q) {
-        q->SignalWriterTagChanged();
+    void Node::AddWriter(QueueBase *q) {
+        QueueListLock al(*this);
+        writerlist.push_back(q);
     }
 
-    typedef std::list<weak_ptr<QueueBase> > QueueList;
-    void GetQueues(QueueList &qlist, std::list<shared_ptr<QueueBase> > &out) {
-        QueueList::iterator itr, end;
-        itr = qlist.begin();
-        end = qlist.end();
-        while (itr != end) {
-            shared_ptr<QueueBase> q = itr->lock();
-            if (q) {
-                out.push_back(q);
-                ++itr;
-            } else {
-                itr = qlist.erase(itr);
-            }
-        }
+    void Node::RemoveReader(QueueBase *q) {
+        QueueListLock al(*this);
+        readerlist.erase(std::remove(readerlist.begin(), readerlist.end(), q), readerlist.end());
+    }
+
+    void Node::RemoveWriter(QueueBase *q) {
+        QueueListLock al(*this);
+        writerlist.erase(std::remove(writerlist.begin(), writerlist.end(), q), writerlist.end());
     }
 
     void Node::SignalTagChanged() {
-        std::list<shared_ptr<QueueBase> > readers;
-        std::list<shared_ptr<QueueBase> > writers;
-        {
-            AutoLock<PthreadMutex> al(taglock);
-            GetQueues(readerlist, readers);
-            GetQueues(writerlist, writers);
+        // Holding the list lock keeps the queues from being removed, it
+        // is never taken while holding a queue lock
+        QueueListLock al(*this);
+        for (QueueList::iterator itr = readerlist.begin(); itr != readerlist.end(); ++itr) {
+            (*itr)->SignalReaderTagChanged();
+        }
+        for (QueueList::iterator itr = writerlist.begin(); itr != writerlist.end(); ++itr) {
+            (*itr)->SignalWriterTagChanged();
         }
-        std::for_each(readers.begin(), readers.end(), &SignalReader);
-        std::for_each(writers.begin(), writers.end(), &SignalWriter);
     }
 
 }
@@ -25,7 +25,8 @@
 #pragma once
 #include "D4RTag.h"
 #include "PthreadMutex.h"
-#include <list>
+#include "Atomic.h"
+#include <vector>
 #include <tr1/memory>
 namespace D4R {
 
@@ -65,6 +66,11 @@ namespace D4R {
  * ACTIVATE:
  * Go back to normal activity.
  *
+ * The tags are published seqlock style. Only one thread at a time
+ * changes the tags, under taglock, and makes tagseq odd while it does
+ * so the queues can read the tags without taking any lock. A change
+ * that leaves the public tag as it was is not signaled.
+ *
  */
 
     using std::tr1::weak_ptr;
@@ -79,13 +85,16 @@ namespace D4R {
      * readers and writers are notified.
      * Note that SetPrivateTag and SetPublicTag do not notify
      * the readers and writers.
+     *
+     * The node does not own the queues, whoever adds a queue must
+     * remove it again before the queue is destroyed.
      */
     class Node {
     public:
 
         Node(uint64_t key);
 
-        ~Node();
+        virtual ~Node();
 
         Tag GetPublicTag() const;
         void SetPublicTag(const Tag &t);
@@ -95,11 +104,19 @@ namespace D4R {
         /**
          * \param q add the q to the readers.
          */
-        void AddReader(weak_ptr<QueueBase> q);
+        void AddReader(QueueBase *q);
         /**
          * \param q Add the q to the writers.
          */
-        void AddWriter(weak_ptr<QueueBase> q);
+        void AddWriter(QueueBase *q);
+        /**
+         * Stop notifying q, once this returns no notification to q
+         * is in progress.
+         * @{
+         */
+        void RemoveReader(QueueBase *q);
+        void RemoveWriter(QueueBase *q);
+        /** @} */
 
         /**
          * Perform the block operation.
@@ -108,7 +125,7 @@ namespace D4R {
          * \param qsize The size of the queue if we are blocking
          * on write or -1 if we are blocking on read.
          */
-        void Block(const Tag &t, unsigned qsize);
+        void Block(const Tag &t, uint64_t qsize);
         /**
          * Called by the queue when the Tag on the node we
          * are blocked on changes.
@@ -120,13 +137,33 @@ namespace D4R {
         bool Transmit(const Tag &t);
 
     protected:
+        /**
+         * Lock and unlock the reader and writer lists. The lock is held
+         * while the queues are signaled, which takes the queue locks, so
+         * when those can suspend the caller (a fiber) so must this one.
+         * The default is queuelock.
+         * @{
+         */
+        virtual void LockQueues();
+        virtual void UnlockQueues();
+        /** @} */
         void SignalTagChanged();
+        /** Must hold taglock, publishes publicTag and privateTag. */
+        void PublishTags(const Tag &pub, const Tag &priv);
+        Tag ReadTag(const Tag &tag) const;
 
         Tag publicTag;
         Tag privateTag;
+        /// Odd while the tags are being changed
+        Sync::Atomic<unsigned> tagseq;
+        /// Serializes the changes to the tags
         mutable PthreadMutex taglock;
-        std::list<weak_ptr<QueueBase> > readerlist;
-        std::list<weak_ptr<QueueBase> > writerlist;
+        /// Held while signaling so a queue is not removed under us
+        PthreadMutex queuelock;
+        class QueueListLock;
+        typedef std::vector<QueueBase*> QueueList;
+        QueueList readerlist;
+        QueueList writerlist;
     private:
         Node(const Node&);
         Node &operator=(const Node&);
@@ -102,7 +102,7 @@ namespace D4R {
         }
     }
 
-    void QueueBase::WriteBlock(unsigned qsize) {
+    void QueueBase::WriteBlock(uint64_t qsize) {
         if (!reader) {
             while (WriteBlocked() && !reader) {
                 Wait();
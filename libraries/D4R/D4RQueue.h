@@ -67,7 +67,7 @@ namespace D4R {
          * and if it is reentrant then a single unlock will
          * release the lock.
          */
-        void WriteBlock(unsigned qsize);
+        void WriteBlock(uint64_t qsize);
 
         /**
          * \return true if we are blocked
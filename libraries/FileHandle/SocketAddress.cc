@@ -120,6 +120,17 @@ SockAddrList SocketAddress::CreateIP(const std::string &hostname, unsigned serv)
     return Lookup(hostname.c_str(), 0, AF_UNSPEC, serv);
 }
 
+SockAddrList SocketAddress::CreateLocal(const std::string &path) {
+    SocketAddress addr;
+    if (path.size() >= sizeof(addr.address.un.sun_path)) {
+        throw ErrnoException("Unix socket path too long", ENAMETOOLONG);
+    }
+    addr.address.un.sun_family = AF_UNIX;
+    memcpy(addr.address.un.sun_path, path.c_str(), path.size() + 1);
+    addr.length = sizeof(addr.address.un);
+    return SockAddrList(1, addr);
+}
+
 SocketAddress::SocketAddress(addrinfo *info) {
     length = info->ai_addrlen;
     memcpy(&address, info->ai_addr, length);
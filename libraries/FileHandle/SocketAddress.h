@@ -74,6 +74,12 @@ public:
      */
     static SockAddrList CreateIP(const char* hostname, unsigned serv);
     static SockAddrList CreateIP(const std::string &hostname, unsigned serv);
+    /**
+     * \param path the path of a unix domain socket
+     * \return a list holding the local address for path
+     * \throws ErrnoException if the path is too long
+     */
+    static SockAddrList CreateLocal(const std::string &path);
 
     SocketAddress();
     SocketAddress(addrinfo *info);
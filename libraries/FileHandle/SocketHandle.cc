@@ -61,13 +61,40 @@ void SocketHandle::Connect(const SockAddrList &addrs) {
     if (!success) throw ErrnoException(error);
 }
 
+void SocketHandle::Connect(const SockAddrList &addrs, const SockAddrList &local) {
+    int error = EAFNOSUPPORT;
+    bool success = false;
+    for (SockAddrList::const_iterator itr = addrs.begin();
+            itr != addrs.end() && !success; ++itr) {
+        for (SockAddrList::const_iterator litr = local.begin();
+                litr != local.end(); ++litr) {
+            if (litr->Family() != itr->Family()) { continue; }
+            success = Connect(*itr, &*litr, error);
+            if (success) break;
+        }
+    }
+    if (!success) throw ErrnoException(error);
+}
+
 bool SocketHandle::Connect(const SocketAddress &addr, int &error) {
+    return Connect(addr, 0, error);
+}
+
+bool SocketHandle::Connect(const SocketAddress &addr, const SocketAddress *local, int &error) {
     ASSERT(Closed(), "Already connected!");
     int nfd = socket(addr.Family(), SOCK_STREAM, 0);
     if (nfd < 0) {
         error = errno;
         return false;
     }
+    if (local) {
+        SocketAddress localaddr = *local;
+        if (bind(nfd, localaddr.GetAddr(), localaddr.GetLen()) < 0) {
+            error = errno;
+            close(nfd);
+            return false;
+        }
+    }
     SocketAddress address = addr;
     bool loop = true;
     while (loop) {
@@ -332,5 +359,18 @@ bool SocketHandle::GetNoDelay() {
     return flag == 0 ? false : true;
 }
 
+double SocketHandle::GetRoundTripTime() {
+#ifdef TCP_INFO
+    tcp_info info;
+    socklen_t len = sizeof(info);
+    if (getsockopt(FD(), IPPROTO_TCP, TCP_INFO, &info, &len) < 0) {
+        throw ErrnoException();
+    }
+    return info.tcpi_rtt * 1e-6;
+#else
+    return -1;
+#endif
+}
+
 
 
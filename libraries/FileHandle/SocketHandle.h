@@ -59,6 +59,15 @@ public:
      */
     void Connect(const SockAddrList &addrs);
 
+    /**
+     * \brief Create a new socket, bind it to a local address of the
+     * same family and try to connect to one of the addresses in the
+     * address list. Used to pick which interface a connection goes out on.
+     * \param addrs the addresses to try to connect to
+     * \param local the local addresses to bind to
+     */
+    void Connect(const SockAddrList &addrs, const SockAddrList &local);
+
     /**
      * \brief Shutdown the read end of this socket.
      * This does NOT close the socket! Any future attempt to read
@@ -134,7 +143,15 @@ public:
     void SetNoDelay(bool nodelay);
     bool GetNoDelay();
 
+    /**
+     * \return the smoothed round trip time the system has measured
+     * for this connection in seconds, or a negative number if the
+     * system does not report it.
+     */
+    double GetRoundTripTime();
+
 private:
     bool Connect(const SocketAddress &addr, int &error);
+    bool Connect(const SocketAddress &addr, const SocketAddress *local, int &error);
 };
 #endif
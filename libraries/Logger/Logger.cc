@@ -45,24 +45,25 @@ Logger::Logger(LoggerOutput *lo, int dfltlvl)
     : logout(lo), loglevel(WARNING), defaultlevel(dfltlvl), adjust(0)
 {
     ASSERT(logout);
-    loglevel = logout->LogLevel();
+    loglevel.Set(logout->LogLevel());
 }
 
 Logger::Logger(LoggerOutput *lo, int dfltlevel, const std::string &nm)
-    : logout(lo), loglevel(WARNING), defaultlevel(dfltlevel), name(nm)
+    : logout(lo), loglevel(WARNING), defaultlevel(dfltlevel), adjust(0), name(nm)
 {
     ASSERT(logout);
-    loglevel = logout->LogLevel();
+    loglevel.Set(logout->LogLevel());
 }
 
 int Logger::LogLevel() const {
     Sync::AutoReentrantLock arl(lock);
-    return loglevel;
+    return loglevel.Load();
 }
 
 int Logger::LogLevel(int level) {
     Sync::AutoReentrantLock arl(lock);
-    return loglevel = level;
+    loglevel.Set(level);
+    return level;
 }
 
 int Logger::DefaultLevel() const {
@@ -106,14 +107,14 @@ LoggerOutput *Logger::Output(LoggerOutput *output) {
 }
 
 void Logger::Log(int level, const std::string &msg) {
+    if (level < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (level < loglevel) { return; }
     if (logout) { logout->Log(level + adjust, name + ":" + msg); }
 }
 
 void Logger::Logf(int level, const char *fmt, ...) {
+    if (level < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (level < loglevel) { return; }
     va_list ap;
     va_start(ap, fmt);
     vLogf(level, fmt, ap);
@@ -122,7 +123,7 @@ void Logger::Logf(int level, const char *fmt, ...) {
 
 void Logger::Logf(const char *fmt, ...) {
     Sync::AutoReentrantLock arl(lock);
-    if (defaultlevel < loglevel) { return; }
+    if (defaultlevel < loglevel.Load()) { return; }
     va_list ap;
     va_start(ap, fmt);
     vLogf(defaultlevel, fmt, ap);
@@ -130,11 +131,23 @@ void Logger::Logf(const char *fmt, ...) {
 }
 
 void Logger::vLogf(int level, const char *fmt, va_list ap) {
+    if (level < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (level < loglevel) { return; }
+    // Most messages fit on the stack, skip the heap for those
+    char stackbuff[256];
+    {
+        va_list ap_copy;
+        va_copy(ap_copy, ap);
+        int n = vsnprintf(stackbuff, sizeof(stackbuff), fmt, ap_copy);
+        va_end(ap_copy);
+        if (n > -1 && unsigned(n) < sizeof(stackbuff)) {
+            Log(level, std::string(stackbuff, n));
+            return;
+        }
+    }
     // This code was based on an example of how
     // to use vsnprintf in the unix man pages.
-    std::vector<char> buff(128);
+    std::vector<char> buff(sizeof(stackbuff)*2);
     while (1) {
         /* Try to print in the allocated space. */
         va_list ap_copy;
@@ -157,8 +170,8 @@ void Logger::vLogf(int level, const char *fmt, va_list ap) {
 }
 
 void Logger::Error(const char *fmt, ...) {
+    if (ERROR < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (ERROR < loglevel) { return; }
     va_list ap;
     va_start(ap, fmt);
     vLogf(ERROR, fmt, ap);
@@ -166,8 +179,8 @@ void Logger::Error(const char *fmt, ...) {
 }
 
 void Logger::Warn(const char *fmt, ...) {
+    if (WARNING < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (WARNING < loglevel) { return; }
     va_list ap;
     va_start(ap, fmt);
     vLogf(WARNING, fmt, ap);
@@ -175,8 +188,8 @@ void Logger::Warn(const char *fmt, ...) {
 }
 
 void Logger::Info(const char *fmt, ...) {
+    if (INFO < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (INFO < loglevel) { return; }
     va_list ap;
     va_start(ap, fmt);
     vLogf(INFO, fmt, ap);
@@ -184,8 +197,8 @@ void Logger::Info(const char *fmt, ...) {
 }
 
 void Logger::Debug(const char *fmt, ...) {
+    if (DEBUG < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (DEBUG < loglevel) { return; }
     va_list ap;
     va_start(ap, fmt);
     vLogf(DEBUG, fmt, ap);
@@ -193,8 +206,8 @@ void Logger::Debug(const char *fmt, ...) {
 }
 
 void Logger::Trace(const char *fmt, ...) {
+    if (TRACE < loglevel.Load()) { return; }
     Sync::AutoReentrantLock arl(lock);
-    if (TRACE < loglevel) { return; }
     va_list ap;
     va_start(ap, fmt);
     vLogf(TRACE, fmt, ap);
@@ -26,6 +26,7 @@
 #define LOGGER_H
 #pragma once
 #include "ReentrantLock.h"
+#include "Atomic.h"
 #include <string>
 #include <cstdarg>
 /**
@@ -71,6 +72,13 @@ public:
     int LogLevel() const;
     int LogLevel(int level);
 
+    /**
+     * \return true if a message at level would be logged. Reads the
+     * cached level without taking the lock so it is cheap enough to
+     * check before building a message.
+     */
+    bool Enabled(int level) const { return level >= loglevel.Load(); }
+
     int DefaultLevel() const;
     int DefaultLevel(int level);
 
@@ -105,7 +113,8 @@ private:
 
     Sync::ReentrantLock lock;
     LoggerOutput *logout;
-    int loglevel;
+    /// Written under lock, read without it by Enabled
+    Sync::Atomic<int> loglevel;
     int defaultlevel;
     int adjust;
     std::string name;
@@ -127,20 +136,39 @@ private:
 
 struct ScopeTrace {
     ScopeTrace(Logger &l, const char *fn, unsigned ln)
-        : logger(l), fname(fn), line(ln)
+        : logger(l), fname(fn), line(ln), enabled(l.Enabled(Logger::TRACE))
     {
-        logger.Trace("Enter %s:%u", fname, line);
+        if (enabled) { logger.Trace("Enter %s:%u", fname, line); }
     }
     ~ScopeTrace() {
-        logger.Trace("Exit %s:%u", fname, line);
+        if (enabled) { logger.Trace("Exit %s:%u", fname, line); }
     }
     Logger &logger;
     const char *fname;
     unsigned line;
+    const bool enabled;
 };
+
+/*
+ * Trace messages for the hot paths. They are only compiled in when
+ * _DEBUG is defined (make TRACE=1), otherwise they are empty and the
+ * arguments are never evaluated. When compiled in they check the cached
+ * level of the logger (see Logger::Enabled) before formatting anything,
+ * so the arguments are only evaluated when the message is logged.
+ */
+#define LOGGER_CONCAT_(a, b) a ## b
+#define LOGGER_CONCAT(a, b) LOGGER_CONCAT_(a, b)
+#ifdef _DEBUG
+// Logs a printf style message at Logger::TRACE
+#define LOG_TRACE(logger, ...) \
+    do { if ((logger).Enabled(Logger::TRACE)) { (logger).Trace(__VA_ARGS__); } } while (0)
 // Will create a tracer on the stack which outputs a trace message of
 // Enterying function and exiting function and it will use the symbol
-// scoperace[linenumber]
-#define SCOPE_TRACE(logger) ScopeTrace scopetracer__LINE__ (logger, __PRETTY_FUNCTION__, __LINE__)
+// scopetracer[linenumber]
+#define SCOPE_TRACE(logger) ScopeTrace LOGGER_CONCAT(scopetracer, __LINE__) (logger, __PRETTY_FUNCTION__, __LINE__)
+#else
+#define LOG_TRACE(logger, ...) do {} while (0)
+#define SCOPE_TRACE(logger) do {} while (0)
+#endif
 
 #endif
@@ -0,0 +1,285 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+
+#include "LoggerAsyncOutput.h"
+#include "PthreadFunctional.h"
+#include "AutoLock.h"
+#include "AutoUnlock.h"
+#include "ErrnoException.h"
+#include <set>
+#include <string.h>
+#include <errno.h>
+
+namespace {
+    /// Every message in a ring starts with one of these
+    struct Record {
+        uint32_t length;
+        int32_t level;
+    };
+    /// The length of a record that skips to the start of the ring
+    const uint32_t WRAP = 0xFFFFFFFF;
+
+    inline uint64_t Align(uint64_t n) {
+        return (n + sizeof(Record) - 1) & ~uint64_t(sizeof(Record) - 1);
+    }
+
+    /// The ring index wraps with a mask so round up to a power of two
+    unsigned RingSize(unsigned size) {
+        unsigned ret = 256;
+        while (ret < size) { ret <<= 1; }
+        return ret;
+    }
+
+    /**
+     * The rings of all LoggerAsyncOutput objects which are not freed
+     * yet. A thread may exit after its ring is freed, so ThreadExit
+     * only touches rings found here. Never freed, as threads may still
+     * exit during static destruction.
+     */
+    struct LiveRings {
+        PthreadMutex lock;
+        std::set<const void*> rings;
+    };
+
+    LiveRings &GetLiveRings() {
+        static LiveRings *live = new LiveRings;
+        return *live;
+    }
+}
+
+LoggerAsyncOutput::Ring::Ring(unsigned size_)
+    : orphaned(0), buffer(0), size(size_), head(0), tail(0)
+{
+    buffer = new char[size];
+}
+
+LoggerAsyncOutput::Ring::~Ring() {
+    delete[] buffer;
+}
+
+bool LoggerAsyncOutput::Ring::Push(int level, const char *msg, unsigned len) {
+    // A message longer than half the ring would not leave room for
+    // anything else
+    if (sizeof(Record) + len > size/2) { len = size/2 - sizeof(Record); }
+    const uint64_t need = sizeof(Record) + Align(len);
+    uint64_t h = head.Get();
+    const uint64_t t = tail.Get();
+    uint64_t offset = h & (size - 1);
+    if (offset + need > size) {
+        // Does not fit before the end, skip to the start
+        if (h + (size - offset) + need - t > size) { return false; }
+        reinterpret_cast<Record*>(buffer + offset)->length = WRAP;
+        h += size - offset;
+        offset = 0;
+    } else if (h + need - t > size) {
+        return false;
+    }
+    Record *record = reinterpret_cast<Record*>(buffer + offset);
+    record->length = len;
+    record->level = level;
+    memcpy(record + 1, msg, len);
+    // Publishes the record to the writer
+    head.Set(h + need);
+    return true;
+}
+
+void LoggerAsyncOutput::Ring::Drain(std::string &out) {
+    const uint64_t h = head.Get();
+    uint64_t t = tail.Get();
+    while (t != h) {
+        const uint64_t offset = t & (size - 1);
+        const Record *record = reinterpret_cast<const Record*>(buffer + offset);
+        if (record->length == WRAP) {
+            t += size - offset;
+            continue;
+        }
+        char prefix[16];
+        const int n = snprintf(prefix, sizeof(prefix), "%d:", record->level);
+        out.append(prefix, n);
+        out.append(reinterpret_cast<const char*>(record + 1), record->length);
+        out.push_back('\n');
+        t += sizeof(Record) + Align(record->length);
+    }
+    // Gives the space back to the owning thread
+    tail.Set(t);
+}
+
+LoggerAsyncOutput::LoggerAsyncOutput(int level, const std::string &filename,
+        unsigned ringsize_, double interval_)
+    : loglevel(level),
+    dropped(0),
+    ringsize(RingSize(ringsize_)),
+    interval(interval_),
+    file(stdout),
+    threadring(&LoggerAsyncOutput::ThreadExit),
+    reporteddropped(0),
+    flushrequested(0),
+    flushed(0),
+    shutdown(false),
+    thread(0)
+{
+    if (!filename.empty()) {
+        file = fopen(filename.c_str(), "a");
+        if (!file) {
+            throw ErrnoException("Unable to open the log file", errno);
+        }
+    }
+    thread = CreatePthreadFunctional(this, &LoggerAsyncOutput::EntryPoint);
+    thread->Start();
+}
+
+LoggerAsyncOutput::~LoggerAsyncOutput() {
+    {
+        AutoLock<PthreadMutex> al(lock);
+        shutdown = true;
+        cond.Broadcast();
+    }
+    thread->Join();
+    delete thread;
+    // Also the rings of threads still alive, which may exit at any time
+    for (RingList::iterator itr = rings.begin(); itr != rings.end(); ++itr) {
+        DeleteRing(*itr);
+    }
+    if (file != stdout) {
+        fclose(file);
+    }
+}
+
+int LoggerAsyncOutput::LogLevel() const {
+    return loglevel.Get();
+}
+
+int LoggerAsyncOutput::LogLevel(int level) {
+    loglevel.Set(level);
+    return level;
+}
+
+void LoggerAsyncOutput::Log(int level, const std::string &msg) {
+    if (level < loglevel.Get()) { return; }
+    if (!GetRing()->Push(level, msg.data(), msg.size())) {
+        dropped.Add(1);
+    }
+}
+
+void LoggerAsyncOutput::Flush() {
+    AutoLock<PthreadMutex> al(lock);
+    const unsigned request = ++flushrequested;
+    cond.Broadcast();
+    while (int(flushed - request) < 0) {
+        cond.Wait(lock);
+    }
+}
+
+uint64_t LoggerAsyncOutput::Dropped() const {
+    return dropped.Get();
+}
+
+/**
+ * Called by pthreads when a thread that logged exits, the writer
+ * thread drops the ring once it is drained.
+ */
+void LoggerAsyncOutput::ThreadExit(Ring *ring) {
+    LiveRings &live = GetLiveRings();
+    AutoLock<PthreadMutex> al(live.lock);
+    if (live.rings.count(ring) > 0) {
+        ring->orphaned.Set(1);
+    }
+}
+
+void LoggerAsyncOutput::DeleteRing(Ring *ring) {
+    {
+        LiveRings &live = GetLiveRings();
+        AutoLock<PthreadMutex> al(live.lock);
+        live.rings.erase(ring);
+    }
+    delete ring;
+}
+
+LoggerAsyncOutput::Ring *LoggerAsyncOutput::GetRing() {
+    Ring *ring = threadring.Get();
+    if (!ring) {
+        ring = new Ring(ringsize);
+        {
+            LiveRings &live = GetLiveRings();
+            AutoLock<PthreadMutex> al(live.lock);
+            live.rings.insert(ring);
+        }
+        {
+            AutoLock<PthreadMutex> al(lock);
+            rings.push_back(ring);
+        }
+        threadring.Set(ring);
+    }
+    return ring;
+}
+
+void *LoggerAsyncOutput::EntryPoint() {
+    std::string batch;
+    AutoLock<PthreadMutex> al(lock);
+    while (true) {
+        const unsigned request = flushrequested;
+        const bool done = shutdown;
+        batch.clear();
+        const bool busy = DrainRings(batch);
+        if (busy) {
+            AutoUnlock<PthreadMutex> au(lock);
+            fwrite(batch.data(), 1, batch.size(), file);
+            fflush(file);
+        }
+        flushed = request;
+        cond.Broadcast();
+        if (done) { break; }
+        // Keep going while there is a burst of messages
+        if (!busy && flushrequested == request && !shutdown) {
+            cond.TimedWait(lock, interval);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Must be called with lock held.
+ * \return true if there is anything to write
+ */
+bool LoggerAsyncOutput::DrainRings(std::string &batch) {
+    RingList::iterator itr = rings.begin();
+    while (itr != rings.end()) {
+        // Read before draining, the thread may log right up to its exit
+        const bool orphaned = (*itr)->orphaned.Get();
+        (*itr)->Drain(batch);
+        if (orphaned) {
+            DeleteRing(*itr);
+            itr = rings.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+    const uint64_t numdropped = dropped.Get();
+    if (numdropped != reporteddropped) {
+        char msg[128];
+        const int n = snprintf(msg, sizeof(msg), "%d:LoggerAsyncOutput:%llu messages dropped\n",
+                int(Logger::WARNING), (unsigned long long)(numdropped - reporteddropped));
+        batch.append(msg, n);
+        reporteddropped = numdropped;
+    }
+    return !batch.empty();
+}
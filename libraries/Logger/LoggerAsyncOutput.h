@@ -0,0 +1,136 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief A LoggerOutput which never makes the logging thread wait.
+ */
+
+#ifndef LOGGERASYNCOUTPUT_H
+#define LOGGERASYNCOUTPUT_H
+#pragma once
+#include "Logger.h"
+#include "Atomic.h"
+#include "PthreadMutex.h"
+#include "PthreadCondition.h"
+#include "PthreadKey.h"
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+
+class Pthread;
+
+/**
+ * \brief A LoggerOutput that hands messages to a writer thread.
+ *
+ * Each logging thread gets its own ring buffer the first time it logs.
+ * Log only copies the message into that ring, without taking a lock,
+ * and the writer thread drains all the rings and writes what it found
+ * in one batch, as long as there is something to write. The writer
+ * thread also adds the "level:" prefix that LoggerStdOutput puts in
+ * front of a message.
+ *
+ * A message that does not fit in the ring is dropped and counted
+ * rather than waiting for the writer to catch up. The writer reports
+ * how many were dropped. The order of messages from one thread is
+ * kept, messages from different threads are only ordered by batch.
+ */
+class LoggerAsyncOutput : public LoggerOutput {
+public:
+    /**
+     * \param level the log level
+     * \param filename the file to append to, empty for stdout
+     * \param ringsize the bytes in the ring of each thread, rounded up
+     * to a power of two
+     * \param interval seconds the writer waits when there was nothing
+     * to write
+     * \throw ErrnoException if the file cannot be opened
+     */
+    LoggerAsyncOutput(int level, const std::string &filename = std::string(),
+            unsigned ringsize = 65536, double interval = 0.05);
+    /**
+     * Writes what is left and stops the writer thread. No thread may
+     * log to this object any more. The rings of all threads, whether
+     * they are still alive or not, are freed.
+     */
+    ~LoggerAsyncOutput();
+
+    int LogLevel() const;
+    int LogLevel(int level);
+    void Log(int level, const std::string &msg);
+
+    /** \brief Wait until everything logged before the call is written. */
+    void Flush();
+
+    /** \return the number of messages dropped so far */
+    uint64_t Dropped() const;
+private:
+    LoggerAsyncOutput(const LoggerAsyncOutput&);
+    LoggerAsyncOutput &operator=(const LoggerAsyncOutput&);
+
+    /**
+     * Single producer single consumer ring of messages. Only the
+     * owning thread moves head and only the writer thread moves tail.
+     *
+     * The LoggerAsyncOutput owns the ring. The owning thread only
+     * marks it orphaned when it exits, and only while the ring is
+     * still registered, so the thread may outlive the ring.
+     */
+    class Ring {
+    public:
+        Ring(unsigned size);
+        ~Ring();
+        /** \return false if there is no room for the message */
+        bool Push(int level, const char *msg, unsigned len);
+        /** \brief Append the formatted messages to out. */
+        void Drain(std::string &out);
+        /// Set once the owning thread has exited
+        Sync::Atomic<int> orphaned;
+    private:
+        char *buffer;
+        const uint64_t size;
+        Sync::Atomic<uint64_t> head;
+        Sync::Atomic<uint64_t> tail;
+    };
+    typedef std::vector<Ring*> RingList;
+
+    static void ThreadExit(Ring *ring);
+    static void DeleteRing(Ring *ring);
+    Ring *GetRing();
+    void *EntryPoint();
+    bool DrainRings(std::string &batch);
+
+    Sync::Atomic<int> loglevel;
+    Sync::Atomic<uint64_t> dropped;
+    const unsigned ringsize;
+    const double interval;
+    FILE *file;
+    PthreadKey<Ring*> threadring;
+
+    PthreadMutex lock;
+    PthreadCondition cond;
+    RingList rings;
+    uint64_t reporteddropped;
+    unsigned flushrequested;
+    unsigned flushed;
+    bool shutdown;
+    Pthread *thread;
+};
+
+#endif
@@ -56,6 +56,10 @@ int MirrorBufferSet::Supported(void)
     #define MAP_FAILED      ((void*)-1)
 #endif
 
+#if defined(OS_LINUX)
+    #include <sys/syscall.h>
+#endif
+
 #ifndef MAP_NORESERVE
     // not defined in AIX, IRIX, LinuxPPC
     #define MAP_NORESERVE   (0)
@@ -86,12 +90,13 @@ int MirrorBufferSet::Supported(void)
 
 
 //-----------------------------------------------------------------------------
-MirrorBufferSet::MirrorBufferSet(ulong bufferSz, ulong mirrorSz, int nBuffers)
+MirrorBufferSet::MirrorBufferSet(ulong bufferSz, ulong mirrorSz, int nBuffers, int memNode)
 //-----------------------------------------------------------------------------
 :   bufferBase(0),
     bufferSize(bufferSz),
     mirrorSize(mirrorSz),
-    numBuffers(nBuffers)
+    numBuffers(nBuffers),
+    memoryNode(memNode)
 {
     fileName[0] = 0;
     ulong pageSize = PageSize();
@@ -182,6 +187,11 @@ MirrorBufferSet::MirrorBufferSet(ulong bufferSz, ulong mirrorSz, int nBuffers)
         }
     }
 
+    // set the placement now, before any page is touched
+    if (memoryNode >= 0) {
+        BindMemoryNode(baseAddr, numBytes, memoryNode);
+    }
+
     // close the file
     if ( close(fd) ) {
         perror("close");
@@ -189,6 +199,30 @@ MirrorBufferSet::MirrorBufferSet(ulong bufferSz, ulong mirrorSz, int nBuffers)
 }
 
 
+//-----------------------------------------------------------------------------
+void MirrorBufferSet::BindMemoryNode(void* addr, ulong len, int memNode)
+//	only the pages entirely inside the range are bound, so that
+//	memory sharing a page with the range is left alone
+//-----------------------------------------------------------------------------
+{
+#if defined(OS_LINUX) && defined(SYS_mbind)
+    const int mpolPreferred = 1;    // MPOL_PREFERRED from linux/mempolicy.h
+    const ulong bits = 8*sizeof(unsigned long);
+    const ulong maxNode = 1024;
+    if (memNode < 0 || ulong(memNode) >= maxNode) return;
+    ulong pageSize = PageSize();
+    ulong first = ((ulong)addr + pageSize - 1) / pageSize * pageSize;
+    ulong last = ((ulong)addr + len) / pageSize * pageSize;
+    if (last <= first) return;
+    unsigned long mask[maxNode/bits] = {0};
+    mask[memNode/bits] |= 1UL << (memNode%bits);
+    if ( syscall(SYS_mbind, first, last-first, mpolPreferred, mask, maxNode, 0) ) {
+        fprintf1((stderr,"MirrorBufferSet: mbind to node %d failed\n", memNode));
+    }
+#endif
+}
+
+
 //-----------------------------------------------------------------------------
 int MirrorBufferSet::GetFileDescriptor(void)
 //-----------------------------------------------------------------------------
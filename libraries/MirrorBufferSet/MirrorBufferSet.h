@@ -26,18 +26,22 @@ class MirrorBufferSet {
   public:
 	typedef unsigned long ulong;
 
-	MirrorBufferSet(ulong bufferSz, ulong mirrorSz, int nBuffers = 1);
+	MirrorBufferSet(ulong bufferSz, ulong mirrorSz, int nBuffers = 1, int memNode = -1);
    ~MirrorBufferSet(void);
 
 	ulong BufferSize(void) const { return bufferSize; }
 	ulong MirrorSize(void) const { return mirrorSize; }
 	ulong NumBuffers(void) const { return numBuffers; }
+	int MemoryNode(void) const { return memoryNode; }
 
 	enum { eNotSupported=0, eSupportedPosixShm, eSupportedTmpFile };
 
 	static int Supported(void);
 	static ulong PageSize(void);
 
+	//	prefer NUMA node memNode for the whole pages in [addr, addr+len)
+	static void BindMemoryNode(void* addr, ulong len, int memNode);
+
 	operator void* (void) const { return bufferBase; }
 
   protected:
@@ -47,6 +51,7 @@ class MirrorBufferSet {
 	ulong	bufferSize;
 	ulong	mirrorSize;
 	int		numBuffers;
+	int		memoryNode;
 	char	fileName[112];
 };
 
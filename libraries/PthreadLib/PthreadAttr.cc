@@ -182,6 +182,23 @@ void PthreadAttr::GetScheduleParam(PthreadScheduleParam& sp)
 #endif
 
 
+#ifdef CPU_SETSIZE
+//-----------------------------------------------------------------------------
+void PthreadAttr::SetCPUAffinity(const cpu_set_t& cpus)
+//-----------------------------------------------------------------------------
+{
+	TrapError(pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus));
+}
+
+//-----------------------------------------------------------------------------
+void PthreadAttr::GetCPUAffinity(cpu_set_t& cpus)
+//-----------------------------------------------------------------------------
+{
+	TrapError(pthread_attr_getaffinity_np(&attr, sizeof(cpus), &cpus));
+}
+#endif
+
+
 #ifdef _POSIX_THREAD_ATTR_PRIORITY_SCHEDULING
 //-----------------------------------------------------------------------------
 int PthreadAttr::SchedulePolicy(int policy)
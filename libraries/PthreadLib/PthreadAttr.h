@@ -89,6 +89,12 @@ class PthreadAttr : public PthreadErrorHandler {
 	void SetScheduleParam(PthreadScheduleParam& sp);
   #endif
 
+  #ifdef CPU_SETSIZE
+	//	Thread CPU Affinity (a GNU extension)
+	void GetCPUAffinity(cpu_set_t& cpus);
+	void SetCPUAffinity(const cpu_set_t& cpus);
+  #endif
+
 	//	Thread Scheduling Scope
 	void	SystemScope(void)		{ ScheduleScope(PTHREAD_SCOPE_SYSTEM); }
 	void	ProcessScope(void)		{ ScheduleScope(PTHREAD_SCOPE_PROCESS); }
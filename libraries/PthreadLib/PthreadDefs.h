@@ -60,6 +60,12 @@
                 	#undef _POSIX_THREAD_PRIO_PROTECT
                 #endif
                
+		// Nobody defines this one, the attribute scheduling calls
+		// come with the thread priority scheduling option
+		#if !defined(_POSIX_THREAD_ATTR_PRIORITY_SCHEDULING) && defined(_POSIX_THREAD_PRIORITY_SCHEDULING) && (_POSIX_THREAD_PRIORITY_SCHEDULING > 0)
+			#define _POSIX_THREAD_ATTR_PRIORITY_SCHEDULING _POSIX_THREAD_PRIORITY_SCHEDULING
+		#endif
+
 		#if !defined POSIX_PRIO_NONE
 			#define POSIX_PRIO_NONE		PTHREAD_PRIO_NONE
 			#define POSIX_PRIO_INHERIT	PTHREAD_PRIO_INHERIT
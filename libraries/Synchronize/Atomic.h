@@ -77,6 +77,12 @@ namespace Sync {
 
         T Get() const { return __sync_val_compare_and_swap(&val, T(), T()); }
 
+        /**
+         * A plain read without the locked operation and barrier of Get,
+         * for a value that is checked often and may be seen a little late.
+         */
+        T Load() const { return val; }
+
     private:
         mutable volatile T val;
     };
@@ -30,14 +30,16 @@ namespace Sync {
 
     ThreadPool::ThreadPool(unsigned minthreads_, unsigned maxthreads_, double timeout_)
         : shutdown(false), minthreads(minthreads_), maxthreads(maxthreads_),
-        numthreads(0), numtasks(0), waiting(0), timeout(timeout_), needscleanup(false)
+        numthreads(0), numtasks(0), waiting(0), timeout(timeout_), needscleanup(false),
+        numspawned(0), numexecuted(0)
     {
         if (minthreads > maxthreads) maxthreads = minthreads;
     }
     
     ThreadPool::ThreadPool()
         : shutdown(false), minthreads(0), maxthreads(2*NumProcessorsOnline()),
-        numthreads(0), numtasks(0), waiting(0), timeout(60)
+        numthreads(0), numtasks(0), waiting(0), timeout(60), needscleanup(false),
+        numspawned(0), numexecuted(0)
     {
     }
 
@@ -51,6 +53,7 @@ namespace Sync {
         threads.insert(thread);
         thread->Start();
         ++numthreads;
+        ++numspawned;
     }
 
     void ThreadPool::Wait() {
@@ -93,13 +96,25 @@ namespace Sync {
         ASSERT(!shutdown, "Cannot execute on a shutdown threadpool");
         taskqueue.push_back(r);
         ++numtasks;
+        ++numexecuted;
         InternalCleanup();
-        if (waiting == 0 && numthreads < maxthreads) {
+        // A waiting thread may not have taken an earlier task yet
+        if (taskqueue.size() > waiting && numthreads < maxthreads) {
             Spawn();
         }
         enqueue_cond.Signal();
     }
 
+    unsigned long ThreadPool::NumSpawned() {
+        AutoLock<PthreadMutex> al(lock);
+        return numspawned;
+    }
+
+    unsigned long ThreadPool::NumExecuted() {
+        AutoLock<PthreadMutex> al(lock);
+        return numexecuted;
+    }
+
     void ThreadPool::InternalCleanup() {
         if (needscleanup) {
             ThreadSet::iterator cur, end;
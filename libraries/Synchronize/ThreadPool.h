@@ -52,6 +52,11 @@ namespace Sync {
         void Shutdown();
         using Executor::Execute;
         void Execute(shared_ptr<Runnable> r);
+
+        /** \return the number of threads created so far */
+        unsigned long NumSpawned();
+        /** \return the number of tasks started so far */
+        unsigned long NumExecuted();
     private:
     
         PthreadMutex lock;
@@ -69,6 +74,8 @@ namespace Sync {
         unsigned waiting;
         double timeout;
         bool needscleanup;
+        unsigned long numspawned;
+        unsigned long numexecuted;
 
         void Spawn();
         void InternalCleanup();
@@ -17,7 +17,8 @@ class ThresholdQueueAttr {
 	ThresholdQueueAttr(ulong queueLen, ulong maxThresh, ulong numChans=1,
 		bool useMBS_=1, ulong chanOffst=0, ulong baseOffst=0)
 		: queueLength(queueLen), maxThreshold(maxThresh), numChannels(numChans),
-			useMBS(useMBS_), chanOffset(chanOffst), baseOffset(baseOffst) {}
+			useMBS(useMBS_), chanOffset(chanOffst), baseOffset(baseOffst),
+			memNode(-1) {}
 
 	ulong	QueueLength(void) const			{ return queueLength; }
 	ulong	QueueLength(ulong queueLen)		{ return queueLength = queueLen; }
@@ -29,6 +30,10 @@ class ThresholdQueueAttr {
 	void	UseMBS(bool useMBS_, ulong chanOffst=0, ulong baseOffst=0)
 		{ useMBS=useMBS_; chanOffset=chanOffst; baseOffset=baseOffst; }
 
+	//	NUMA node to place the buffer on, -1 for no preference
+	int		MemoryNode(void) const			{ return memNode; }
+	int		MemoryNode(int node)			{ return memNode = node; }
+
   protected:
 	ulong	queueLength;
 	ulong	maxThreshold;
@@ -36,6 +41,7 @@ class ThresholdQueueAttr {
 	bool	useMBS;
 	ulong	chanOffset;
 	ulong	baseOffset;
+	int		memNode;
 	
 	friend class ThresholdQueueBase;
 };
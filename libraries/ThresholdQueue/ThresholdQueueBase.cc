@@ -23,7 +23,7 @@ ThresholdQueueBase::ThresholdQueueBase(ulong elemSize, ulong queueLen,
 	queueLength(queueLen), 
 	maxThreshold(maxThresh),
 	numChannels(numChans),
-	chanOffset(0), baseOffset(0),
+	chanOffset(0), baseOffset(0), memNode(-1),
 	mbs(0), base(0)
 {
 	if (maxThreshold<1)
@@ -44,7 +44,7 @@ ThresholdQueueBase::ThresholdQueueBase(ulong elemSize, const ThresholdQueueAttr&
 	queueLength(attr.queueLength), 
 	maxThreshold(attr.maxThreshold),
 	numChannels(attr.numChannels),
-	chanOffset(0), baseOffset(0),
+	chanOffset(0), baseOffset(0), memNode(attr.memNode),
 	mbs(0), base(0)
 {
 	if (maxThreshold<1)
@@ -79,7 +79,7 @@ void ThresholdQueueBase::AllocateBuf(ulong queueLen, ulong maxThresh,
         ulong bufSz = queueLen * elementSize;
         ulong mirSz = maxThresh-1 + baseOffset + (numChannels-1)*chanOffset;
         mirSz *= elementSize;
-        mbs = new MirrorBufferSet(bufSz, mirSz, numChannels);
+        mbs = new MirrorBufferSet(bufSz, mirSz, numChannels, memNode);
         // MirrorBufferSet may have just resized everything...
         queueLength  = mbs->BufferSize() / elementSize;
         maxThreshold = mbs->MirrorSize() / elementSize + 1;
@@ -93,6 +93,8 @@ void ThresholdQueueBase::AllocateBuf(ulong queueLen, ulong maxThresh,
         maxThreshold = maxThresh;
         channelStride = queueLength + maxThreshold - 1;
 		base = malloc(channelStride * numChannels * elementSize);
+		if (memNode >= 0)
+			MirrorBufferSet::BindMemoryNode(base, channelStride * numChannels * elementSize, memNode);
     }
     Reset();
 }
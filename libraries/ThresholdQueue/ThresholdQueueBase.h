@@ -72,6 +72,7 @@
 //	useMBS		- use MirrorBufferSet to get mirroring with virtual memory
 //	chanOffset	- additional channel-to-channel offset to reduce cache thrashing
 //	baseOffset	- additional base offset to reduce cache thrashing
+//	memNode		- NUMA node to prefer for the buffer pages (or -1)
 //		These offsets are in bytes, and do not apply unless useVMM=1
 //		These are performance tuning parameters. They should be a multiple of
 //			the number of bytes in a cache line, and a multiple of sizeof(T)
@@ -123,6 +124,7 @@ class ThresholdQueueBase {
 	ulong	queueLength, maxThreshold;
 	ulong	numChannels, channelStride;
 	ulong	chanOffset, baseOffset;
+	int		memNode;
 	ulong	elementsEnqueued, elementsDequeued;
 	void*	base;
 	MirrorBufferSet*	mbs;
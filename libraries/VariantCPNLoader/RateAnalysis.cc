@@ -0,0 +1,352 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+#include "RateAnalysis.h"
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+
+using CPN::QueueSize_t;
+using std::string;
+
+namespace {
+    const unsigned NO_COMPONENT = std::numeric_limits<unsigned>::max();
+    // More firings than this in a period is not worth simulating
+    const unsigned long long MAX_FIRINGS = 1000000;
+
+    /** \return false if a*b does not fit */
+    bool Multiply(unsigned long long a, unsigned long long b, unsigned long long &result) {
+        if (a != 0 && b > std::numeric_limits<unsigned long long>::max()/a) { return false; }
+        result = a*b;
+        return true;
+    }
+
+    unsigned long long GCD(unsigned long long a, unsigned long long b) {
+        while (b != 0) {
+            const unsigned long long t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    QueueSize_t RateValue(const string &where, const char *what, Variant v) {
+        if (!v.IsNumber() || v.AsLongDouble() < 1) {
+            throw std::invalid_argument("The " + string(what) + " of " + where
+                    + " must be a positive number");
+        }
+        return v.AsNumber<QueueSize_t>();
+    }
+}
+
+RateAnalysis::RateAnalysis(Variant nodelist, Variant queuelist) {
+    std::map<string, unsigned> index;
+    if (nodelist.IsArray()) {
+        for (Variant::ListIterator itr = nodelist.ListBegin(); itr != nodelist.ListEnd(); ++itr) {
+            if (!itr->IsObject() || !itr->At("name").IsString()) { continue; }
+            Node node;
+            node.name = itr->At("name").AsString();
+            node.inputs = ParseRates(node.name, itr->At("inputrates"), true);
+            node.outputs = ParseRates(node.name, itr->At("outputrates"), false);
+            node.component = NO_COMPONENT;
+            node.repetitions = 0;
+            node.fired = 0;
+            node.rank = 0;
+            if (node.inputs.empty() && node.outputs.empty()) { continue; }
+            index[node.name] = nodes.size();
+            nodes.push_back(node);
+        }
+    }
+    if (!queuelist.IsArray()) { return; }
+    for (unsigned i = 0; i < queuelist.Size(); ++i) {
+        Variant queue = queuelist[i];
+        if (!queue.IsObject()) { continue; }
+        const string writer = queue["writernode"].AsString();
+        const string writerport = queue["writerport"].AsString();
+        const string reader = queue["readernode"].AsString();
+        const string readerport = queue["readerport"].AsString();
+        std::map<string, unsigned>::iterator w = index.find(writer), r = index.find(reader);
+        if (w == index.end() || r == index.end()) { continue; }
+        RateMap::iterator out = nodes[w->second].outputs.find(writerport);
+        RateMap::iterator in = nodes[r->second].inputs.find(readerport);
+        if (out == nodes[w->second].outputs.end() || in == nodes[r->second].inputs.end()) { continue; }
+        Edge edge;
+        edge.name = writer + "." + writerport + "->" + reader + "." + readerport;
+        edge.queue = i;
+        edge.writer = w->second;
+        edge.reader = r->second;
+        edge.produce = out->second.rate;
+        edge.initial = out->second.initial;
+        edge.consume = in->second.rate;
+        edge.peek = in->second.peek;
+        edge.tokens = 0;
+        edge.fill = 0;
+        nodes[edge.writer].outedges.push_back(edges.size());
+        nodes[edge.reader].inedges.push_back(edges.size());
+        edges.push_back(edge);
+    }
+}
+
+RateAnalysis::RateMap RateAnalysis::ParseRates(const string &node, Variant rates, bool input) {
+    RateMap result;
+    if (rates.IsNull()) { return result; }
+    if (!rates.IsObject()) {
+        throw std::invalid_argument("The port rates of " + node + " must be an object");
+    }
+    for (Variant::MapIterator itr = rates.MapBegin(); itr != rates.MapEnd(); ++itr) {
+        const string where = node + "." + itr->first;
+        Rate rate;
+        rate.initial = 0;
+        if (itr->second.IsObject()) {
+            rate.rate = RateValue(where, "rate", itr->second["rate"]);
+            rate.peek = rate.rate;
+            if (input && !itr->second["peek"].IsNull()) {
+                rate.peek = RateValue(where, "peek", itr->second["peek"]);
+                if (rate.peek < rate.rate) {
+                    throw std::invalid_argument("The peek of " + where + " is less than its rate");
+                }
+            }
+            if (!input && !itr->second["initial"].IsNull()) {
+                rate.initial = itr->second["initial"].AsNumber<QueueSize_t>();
+            }
+        } else {
+            rate.rate = RateValue(where, "rate", itr->second);
+            rate.peek = rate.rate;
+        }
+        result[itr->first] = rate;
+    }
+    return result;
+}
+
+bool RateAnalysis::Run() {
+    if (edges.empty()) { return true; }
+    SolveBalance();
+    RankNodes();
+    Simulate();
+    return problems.empty();
+}
+
+bool RateAnalysis::SolveBalance() {
+    // Each node fires num/den times as often as the first node of its component
+    std::vector<unsigned long long> num(nodes.size(), 0), den(nodes.size(), 1);
+    unsigned numcomponents = 0;
+    for (unsigned start = 0; start < nodes.size(); ++start) {
+        if (nodes[start].component != NO_COMPONENT) { continue; }
+        const unsigned component = numcomponents++;
+        failed.push_back(false);
+        std::vector<unsigned> members(1, start);
+        nodes[start].component = component;
+        num[start] = 1;
+        for (unsigned m = 0; m < members.size(); ++m) {
+            const unsigned n = members[m];
+            for (unsigned dir = 0; dir < 2; ++dir) {
+                const std::vector<unsigned> &adjacent = (dir == 0 ? nodes[n].outedges : nodes[n].inedges);
+                for (unsigned a = 0; a < adjacent.size(); ++a) {
+                    const Edge &edge = edges[adjacent[a]];
+                    // writer fires * produce == reader fires * consume
+                    const unsigned other = (dir == 0 ? edge.reader : edge.writer);
+                    unsigned long long onum = 0, oden = 1;
+                    if (Multiply(num[n], (dir == 0 ? edge.produce : edge.consume), onum)
+                            && Multiply(den[n], (dir == 0 ? edge.consume : edge.produce), oden)) {
+                        const unsigned long long g = GCD(onum, oden);
+                        onum /= g;
+                        oden /= g;
+                    } else {
+                        // Still visit the rest so the whole component is failed
+                        onum = 0;
+                        oden = 1;
+                        Fail(component, "The rates around queue " + edge.name + " overflow");
+                    }
+                    if (nodes[other].component == NO_COMPONENT) {
+                        nodes[other].component = component;
+                        num[other] = onum;
+                        den[other] = oden;
+                        members.push_back(other);
+                    } else if (num[other] != onum || den[other] != oden) {
+                        Fail(component, "The rates of queue " + edge.name + " are inconsistent");
+                    }
+                }
+            }
+        }
+        if (failed[component]) { continue; }
+        const string overflow = "The period of " + nodes[start].name + " overflows";
+        unsigned long long lcm = 1;
+        for (unsigned m = 0; m < members.size() && !failed[component]; ++m) {
+            if (!Multiply(lcm/GCD(lcm, den[members[m]]), den[members[m]], lcm)) {
+                Fail(component, overflow);
+            }
+        }
+        unsigned long long g = 0;
+        for (unsigned m = 0; m < members.size() && !failed[component]; ++m) {
+            const unsigned n = members[m];
+            if (!Multiply(num[n], lcm/den[n], nodes[n].repetitions)) {
+                Fail(component, overflow);
+            }
+            g = GCD(g, nodes[n].repetitions);
+        }
+        if (failed[component]) { continue; }
+        unsigned long long total = 0;
+        for (unsigned m = 0; m < members.size(); ++m) {
+            nodes[members[m]].repetitions /= g;
+            if (nodes[members[m]].repetitions > MAX_FIRINGS - total) {
+                Fail(component, "The period of " + nodes[start].name
+                        + " fires too many times to simulate");
+                break;
+            }
+            total += nodes[members[m]].repetitions;
+        }
+        // The simulation runs writers up to two periods, which has to
+        // fit in the token counts
+        for (unsigned m = 0; m < members.size() && !failed[component]; ++m) {
+            const Node &node = nodes[members[m]];
+            for (unsigned o = 0; o < node.outedges.size(); ++o) {
+                const Edge &edge = edges[node.outedges[o]];
+                unsigned long long produced = 0;
+                if (!Multiply(2*node.repetitions, edge.produce, produced)
+                        || produced > std::numeric_limits<unsigned long long>::max() - edge.initial) {
+                    Fail(component, "The tokens on queue " + edge.name + " overflow");
+                    break;
+                }
+            }
+        }
+    }
+    return problems.empty();
+}
+
+void RateAnalysis::RankNodes() {
+    // A topological order ignoring queues with initial tokens, the
+    // later a node is the further downstream it is
+    std::vector<unsigned> indegree(nodes.size(), 0);
+    for (unsigned e = 0; e < edges.size(); ++e) {
+        if (edges[e].initial == 0) { ++indegree[edges[e].reader]; }
+    }
+    std::deque<unsigned> ready;
+    for (unsigned n = 0; n < nodes.size(); ++n) {
+        if (indegree[n] == 0) { ready.push_back(n); }
+    }
+    unsigned rank = 0;
+    while (!ready.empty()) {
+        const unsigned n = ready.front();
+        ready.pop_front();
+        nodes[n].rank = ++rank;
+        for (unsigned o = 0; o < nodes[n].outedges.size(); ++o) {
+            const Edge &edge = edges[nodes[n].outedges[o]];
+            if (edge.initial == 0 && --indegree[edge.reader] == 0) {
+                ready.push_back(edge.reader);
+            }
+        }
+    }
+}
+
+void RateAnalysis::Simulate() {
+    unsigned pending = 0;
+    for (unsigned n = 0; n < nodes.size(); ++n) {
+        if (!failed[nodes[n].component]) { ++pending; }
+    }
+    for (unsigned e = 0; e < edges.size(); ++e) {
+        edges[e].tokens = edges[e].initial;
+        edges[e].fill = edges[e].initial;
+    }
+    while (pending > 0) {
+        // Prefer nodes that have not finished the period, then the
+        // node furthest downstream, to keep the queues small
+        unsigned best = NO_COMPONENT;
+        for (unsigned n = 0; n < nodes.size(); ++n) {
+            const Node &node = nodes[n];
+            if (failed[node.component] || node.fired >= 2*node.repetitions || !CanFire(node)) {
+                continue;
+            }
+            if (best == NO_COMPONENT) {
+                best = n;
+                continue;
+            }
+            const bool behind = node.fired < node.repetitions;
+            const bool bestbehind = nodes[best].fired < nodes[best].repetitions;
+            if (behind != bestbehind ? behind : node.rank > nodes[best].rank) {
+                best = n;
+            }
+        }
+        if (best == NO_COMPONENT) { break; }
+        Fire(nodes[best]);
+        if (nodes[best].fired == nodes[best].repetitions) { --pending; }
+    }
+    for (unsigned n = 0; n < nodes.size(); ++n) {
+        const Node &node = nodes[n];
+        if (!failed[node.component] && node.fired < node.repetitions) {
+            Fail(node.component, "The graph around " + node.name
+                    + " cannot complete a period, a cycle needs more initial tokens");
+        }
+    }
+}
+
+bool RateAnalysis::CanFire(const Node &node) const {
+    for (unsigned i = 0; i < node.inedges.size(); ++i) {
+        const Edge &edge = edges[node.inedges[i]];
+        if (edge.tokens < edge.peek) { return false; }
+    }
+    return true;
+}
+
+void RateAnalysis::Fire(Node &node) {
+    for (unsigned i = 0; i < node.inedges.size(); ++i) {
+        Edge &edge = edges[node.inedges[i]];
+        edge.tokens -= edge.consume;
+    }
+    for (unsigned o = 0; o < node.outedges.size(); ++o) {
+        Edge &edge = edges[node.outedges[o]];
+        edge.tokens += edge.produce;
+        edge.fill = std::max(edge.fill, edge.tokens);
+    }
+    ++node.fired;
+}
+
+void RateAnalysis::Fail(unsigned component, const string &problem) {
+    if (!failed[component]) {
+        failed[component] = true;
+        problems.push_back(problem);
+    }
+}
+
+Variant RateAnalysis::Apply(Variant queuelist) const {
+    Variant result = queuelist.Copy();
+    for (unsigned e = 0; e < edges.size(); ++e) {
+        const Edge &edge = edges[e];
+        if (failed.empty() || failed[nodes[edge.writer].component]) { continue; }
+        Variant queue = result[edge.queue];
+        const QueueSize_t threshold = std::max(queue["threshold"].AsNumber<QueueSize_t>(),
+                std::max(edge.produce, edge.peek));
+        const QueueSize_t size = std::max(queue["size"].AsNumber<QueueSize_t>(),
+                std::max(QueueSize_t(edge.fill), threshold));
+        queue["threshold"] = threshold;
+        queue["size"] = size;
+    }
+    return result;
+}
+
+Variant RateAnalysis::Repetitions() const {
+    Variant result(Variant::ObjectType);
+    for (unsigned n = 0; n < nodes.size(); ++n) {
+        if (failed.empty() || failed[nodes[n].component]) { continue; }
+        result[nodes[n].name] = nodes[n].repetitions;
+    }
+    return result;
+}
@@ -0,0 +1,128 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Static buffer sizes for graphs with fixed rates.
+ */
+#ifndef RATEANALYSIS_H
+#define RATEANALYSIS_H
+#pragma once
+#include "CPNCommon.h"
+#include "Variant.h"
+#include <string>
+#include <vector>
+#include <map>
+
+/**
+ * Synchronous dataflow analysis of the rate annotations of a graph in
+ * the VariantCPNLoader form.
+ *
+ * A node may give the rates of its ports, in the same units as the
+ * queue size, as
+ * \code
+ * "inputrates": { "port": 64, "other": { "rate": 48, "peek": 64 } },
+ * "outputrates": { "port": 64, "loop": { "rate": 8, "initial": 8 } }
+ * \endcode
+ * meaning that each time the node fires it reads rate from each input,
+ * looking at peek before it does, and writes rate to each output. An
+ * initial amount is written once before the first firing. Only queues
+ * with rates on both ends are analysed.
+ *
+ * The balance equations give how many times each node fires in a
+ * period. A period is then simulated, firing the node furthest
+ * downstream that can fire and letting nodes run up to one period ahead
+ * for readers that peek. The most each queue holds in that schedule is
+ * enough for the graph to run without an artificial deadlock. Parts of
+ * the graph with inconsistent rates or that cannot complete a period
+ * are reported and left alone.
+ */
+class RateAnalysis {
+public:
+    /**
+     * \throw std::invalid_argument if a rate is not a positive number
+     * or a peek is less than its rate
+     */
+    RateAnalysis(Variant nodelist, Variant queuelist);
+
+    /** \return true if any queue has rates on both ends */
+    bool HasRates() const { return !edges.empty(); }
+
+    /**
+     * Solve the balance equations and simulate a period.
+     * \return false if part of the graph could not be analysed, see
+     * Problems
+     */
+    bool Run();
+
+    /**
+     * \return a copy of queuelist with the size and threshold of each
+     * analysed queue raised to what it needs
+     */
+    Variant Apply(Variant queuelist) const;
+
+    /** \return how many times each analysed node fires in a period */
+    Variant Repetitions() const;
+
+    const std::vector<std::string> &Problems() const { return problems; }
+
+private:
+    struct Rate {
+        CPN::QueueSize_t rate;
+        CPN::QueueSize_t peek;
+        CPN::QueueSize_t initial;
+    };
+    typedef std::map<std::string, Rate> RateMap;
+    struct Node {
+        std::string name;
+        RateMap inputs;
+        RateMap outputs;
+        std::vector<unsigned> inedges;
+        std::vector<unsigned> outedges;
+        unsigned component;
+        unsigned long long repetitions;
+        unsigned long long fired;
+        unsigned rank;
+    };
+    struct Edge {
+        std::string name;
+        unsigned queue;
+        unsigned writer;
+        unsigned reader;
+        CPN::QueueSize_t produce;
+        CPN::QueueSize_t consume;
+        CPN::QueueSize_t peek;
+        CPN::QueueSize_t initial;
+        unsigned long long tokens;
+        unsigned long long fill;
+    };
+
+    static RateMap ParseRates(const std::string &node, Variant rates, bool input);
+    bool SolveBalance();
+    void RankNodes();
+    void Simulate();
+    bool CanFire(const Node &node) const;
+    void Fire(Node &node);
+    void Fail(unsigned component, const std::string &problem);
+
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    std::vector<bool> failed;
+    std::vector<std::string> problems;
+};
+#endif
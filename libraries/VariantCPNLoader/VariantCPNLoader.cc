@@ -23,11 +23,22 @@
 #include "VariantCPNLoader.h"
 #include "VariantToJSON.h"
 #include "RemoteContext.h"
+#include "GrowPolicy.h"
+#include "RateAnalysis.h"
+#include "LoggerAsyncOutput.h"
 #include <set>
 #include <map>
+#include <vector>
+#include <sched.h>
+#include <stdexcept>
 
 using CPN::shared_ptr;
 using CPN::Context;
+using CPN::GrowPolicy;
+using CPN::GeometricGrowPolicy;
+using CPN::BudgetGrowPolicy;
+using CPN::HistoryGrowPolicy;
+using CPN::QueueSize_t;
 using std::string;
 using std::set;
 using std::pair;
@@ -42,6 +53,10 @@ void VariantCPNLoader::UseD4R(bool value) {
     config["d4r"] = value;
 }
 
+void VariantCPNLoader::UseFibers(bool value) {
+    config["fibers"] = value;
+}
+
 void VariantCPNLoader::GrowQueueMaxThreshold(bool value) {
     config["grow-queue-max-threshold"] = value;
 }
@@ -50,6 +65,10 @@ void VariantCPNLoader::SwallowBrokenQueueExceptions(bool value) {
     config["swallow-broken-queue-exceptions"] = value;
 }
 
+void VariantCPNLoader::PresizeQueues(bool value) {
+    config["presize-queues"] = value;
+}
+
 void VariantCPNLoader::AddLib(const std::string &filename) {
     config["libs"].Append(filename);
 }
@@ -154,7 +173,13 @@ shared_ptr<Context> VariantCPNLoader::LoadContext(Variant v) {
         context = Context::Local();
     } else {
         if (v["host"].IsNull() && v["port"].IsNull()) {
-            context = Context::Local();
+            if (v["logfile"].IsNull()) {
+                context = Context::Local();
+            } else {
+                // An empty name logs to stdout
+                shared_ptr<LoggerOutput> out(new LoggerAsyncOutput(Logger::WARNING, v["logfile"].AsString()));
+                context = Context::Local(out);
+            }
         } else {
             SockAddrList addrs = SocketAddress::CreateIP(
                     v["host"].AsString(),
@@ -171,6 +196,32 @@ shared_ptr<Context> VariantCPNLoader::LoadContext(Variant v) {
     return context;
 }
 
+shared_ptr<GrowPolicy> VariantCPNLoader::LoadGrowPolicy(Variant v) {
+    shared_ptr<GrowPolicy> policy;
+    if (v.IsNull()) {
+        return policy;
+    }
+    const std::string type = (v.IsString() ? v.AsString() : v["type"].AsString());
+    if (type == "geometric") {
+        double factor = 2;
+        QueueSize_t cap = 0;
+        if (v.IsObject()) {
+            if (!v["factor"].IsNull()) { factor = v["factor"].AsDouble(); }
+            if (!v["cap"].IsNull()) { cap = v["cap"].AsNumber<QueueSize_t>(); }
+        }
+        policy.reset(new GeometricGrowPolicy(factor, cap));
+    } else if (type == "budget") {
+        policy.reset(new BudgetGrowPolicy(v["budget"].AsNumber<QueueSize_t>(),
+                    LoadGrowPolicy(v["policy"])));
+    } else if (type == "history") {
+        policy.reset(new HistoryGrowPolicy(v["file"].AsString(),
+                    LoadGrowPolicy(v["policy"])));
+    } else {
+        throw std::invalid_argument("Unknown grow policy " + type);
+    }
+    return policy;
+}
+
 void VariantCPNLoader::KernelName(const std::string &name) {
     config["name"] = name;
 }
@@ -194,6 +245,12 @@ CPN::KernelAttr VariantCPNLoader::GetKernelAttr(Variant args) {
     if (!args["port"].IsNull()) {
         attr.SetServName(args["port"].AsString());
     }
+    if (args["listen-addresses"].IsArray()) {
+        for (Variant::ListIterator itr = args["listen-addresses"].ListBegin();
+                itr != args["listen-addresses"].ListEnd(); ++itr) {
+            attr.AddListenAddress(itr->AsString());
+        }
+    }
 
     if (!args["d4r"].IsNull()) {
         attr.UseD4R(args["d4r"].AsBool());
@@ -204,6 +261,21 @@ CPN::KernelAttr VariantCPNLoader::GetKernelAttr(Variant args) {
     if (!args["grow-queue-max-threshold"].IsNull()) {
         attr.GrowQueueMaxThreshold(args["grow-queue-max-threshold"].AsBool());
     }
+    if (!args["grow-policy"].IsNull()) {
+        attr.SetGrowPolicy(LoadGrowPolicy(args["grow-policy"]));
+    }
+    if (!args["fibers"].IsNull()) {
+        attr.UseFibers(args["fibers"].AsBool());
+    }
+    if (!args["fiber-workers"].IsNull()) {
+        attr.SetFiberWorkers(args["fiber-workers"].AsUnsigned());
+    }
+    if (!args["fiber-stack-size"].IsNull()) {
+        attr.SetFiberStackSize(args["fiber-stack-size"].AsUnsigned());
+    }
+    if (!args["node-thread-idle"].IsNull()) {
+        attr.SetNodeThreadIdleTime(args["node-thread-idle"].AsDouble());
+    }
     if (args["libs"].IsArray()) {
         for (Variant::ListIterator itr = args["libs"].ListBegin(); itr != args["libs"].ListEnd(); ++itr) {
             attr.AddSharedLib(itr->AsString());
@@ -218,26 +290,50 @@ CPN::KernelAttr VariantCPNLoader::GetKernelAttr(Variant args) {
 }
 
 void VariantCPNLoader::Setup(CPN::Kernel *kernel, Variant args) {
+    Variant queues = args["queues"];
+    if (args["presize-queues"].IsTrue()) {
+        queues = PresizeQueues(args["nodes"], queues, kernel->GetLogger());
+    }
     LoadNodes(kernel, args["nodes"], args["nodemap"]);
-    LoadQueues(kernel, args["queues"]);
+    LoadQueues(kernel, queues);
+}
+
+Variant VariantCPNLoader::PresizeQueues(Variant nodelist, Variant queuelist, LoggerOutput *logout) {
+    RateAnalysis analysis(nodelist, queuelist);
+    if (!analysis.HasRates()) {
+        return queuelist;
+    }
+    if (!analysis.Run() && logout) {
+        Logger logger(logout, Logger::WARNING, "VariantCPNLoader");
+        for (unsigned i = 0; i < analysis.Problems().size(); ++i) {
+            logger.Warn("Not presizing queues: %s", analysis.Problems()[i].c_str());
+        }
+    }
+    return analysis.Apply(queuelist);
 }
 
 void VariantCPNLoader::LoadNodes(CPN::Kernel *kernel, Variant nodelist, Variant nodemap) {
     if (!nodelist.IsArray()) {
         return;
     }
+    std::vector<CPN::NodeAttr> attrs;
     Variant::ConstListIterator itr, end;
     itr = nodelist.ListBegin();
     end = nodelist.ListEnd();
     while (itr != end) {
         if (itr->IsObject()) {
-            LoadNode(kernel, *itr, nodemap);
+            attrs.push_back(GetNodeAttr(*itr, nodemap));
         }
         ++itr;
     }
+    kernel->CreateNodes(attrs);
 }
 
 void VariantCPNLoader::LoadNode(CPN::Kernel *kernel, Variant attr, Variant nodemap) {
+    kernel->CreateNode(GetNodeAttr(attr, nodemap));
+}
+
+CPN::NodeAttr VariantCPNLoader::GetNodeAttr(Variant attr, Variant nodemap) {
     CPN::NodeAttr nattr(attr["name"].AsString(), attr["type"].AsString());
     if (nodemap.IsObject() && nodemap.At(nattr.GetName()).IsString()) {
         nattr.SetKernel(nodemap.At(nattr.GetName()).AsString());
@@ -252,26 +348,77 @@ void VariantCPNLoader::LoadNode(CPN::Kernel *kernel, Variant attr, Variant nodem
             nattr.SetParam(i->first, i->second.AsString());
         }
     }
-    kernel->CreateNode(nattr);
+    if (attr["cpus"].IsArray()) {
+        for (Variant::ListIterator itr = attr["cpus"].ListBegin();
+                itr != attr["cpus"].ListEnd(); ++itr) {
+            nattr.AddCPU(itr->AsUnsigned());
+        }
+    } else if (attr["cpus"].IsNumber()) {
+        nattr.AddCPU(attr["cpus"].AsUnsigned());
+    }
+    if (!attr["numanode"].IsNull()) {
+        nattr.SetNUMANode(attr["numanode"].AsInt());
+    }
+    if (attr["schedpolicy"].IsNumber()) {
+        nattr.SetSchedulePolicy(attr["schedpolicy"].AsInt());
+    } else if (attr["schedpolicy"].IsString()) {
+        std::string policy = attr["schedpolicy"].AsString();
+        if (policy == "fifo") {
+            nattr.SetSchedulePolicy(SCHED_FIFO);
+        } else if (policy == "rr") {
+            nattr.SetSchedulePolicy(SCHED_RR);
+        } else if (policy == "other") {
+            nattr.SetSchedulePolicy(SCHED_OTHER);
+        }
+    }
+    if (!attr["priority"].IsNull()) {
+        nattr.SetPriority(attr["priority"].AsInt());
+    }
+    if (!attr["stacksize"].IsNull()) {
+        nattr.SetStackSize(attr["stacksize"].AsNumber<unsigned long>());
+    }
+    if (attr["fusiongroup"].IsString()) {
+        nattr.SetFusionGroup(attr["fusiongroup"].AsString());
+    } else if (!attr["fusable"].IsNull()) {
+        nattr.SetFusable(attr["fusable"].IsTrue());
+    }
+    if (attr["replicas"].IsString() && attr["replicas"].AsString() == "auto") {
+        nattr.SetReplicas(0);
+    } else if (!attr["replicas"].IsNull()) {
+        nattr.SetReplicas(attr["replicas"].AsUnsigned());
+    }
+    if (!attr["scattersize"].IsNull()) {
+        nattr.SetScatterBlock(attr["scattersize"].AsUnsigned(), attr["scatteroverlap"].AsUnsigned());
+    }
+    if (!attr["gathersize"].IsNull()) {
+        nattr.SetGatherBlock(attr["gathersize"].AsUnsigned());
+    }
+    return nattr;
 }
 
 void VariantCPNLoader::LoadQueues(CPN::Kernel *kernel, Variant queuelist) {
     if (!queuelist.IsArray()) {
         return;
     }
+    std::vector<CPN::QueueAttr> attrs;
     Variant::ConstListIterator itr, end;
     itr = queuelist.ListBegin();
     end = queuelist.ListEnd();
     while (itr != end) {
         if (itr->IsObject()) {
-            LoadQueue(kernel, *itr);
+            attrs.push_back(GetQueueAttr(*itr));
         }
         ++itr;
     }
+    kernel->CreateQueues(attrs);
 }
 
 void VariantCPNLoader::LoadQueue(CPN::Kernel *kernel, Variant attr) {
-    CPN::QueueAttr qattr(attr["size"].AsUnsigned(), attr["threshold"].AsUnsigned());
+    kernel->CreateQueue(GetQueueAttr(attr));
+}
+
+CPN::QueueAttr VariantCPNLoader::GetQueueAttr(Variant attr) {
+    CPN::QueueAttr qattr(attr["size"].AsNumber<CPN::QueueSize_t>(), attr["threshold"].AsNumber<CPN::QueueSize_t>());
     qattr.SetReader(attr["readernode"].AsString(), attr["readerport"].AsString());
     qattr.SetWriter(attr["writernode"].AsString(), attr["writerport"].AsString());
     if (!attr["type"].IsNull()) {
@@ -292,13 +439,48 @@ void VariantCPNLoader::LoadQueue(CPN::Kernel *kernel, Variant attr) {
     if (!attr["alpha"].IsNull()) {
         qattr.SetAlpha(attr["alpha"].AsDouble());
     }
+    if (!attr["adaptivealpha"].IsNull()) {
+        qattr.SetAdaptiveAlpha(attr["adaptivealpha"].IsTrue());
+    }
     if (attr["name"].IsString()) {
         qattr.SetName(attr["name"].AsString());
     }
     if (!attr["maxwritethreshold"].IsNull()) {
-        qattr.SetMaxWriteThreshold(attr["maxwritethreshold"].AsUnsigned());
+        qattr.SetMaxWriteThreshold(attr["maxwritethreshold"].AsNumber<CPN::QueueSize_t>());
+    }
+    if (!attr["connections"].IsNull()) {
+        qattr.SetNumConnections(attr["connections"].AsUnsigned());
+    }
+    if (!attr["linkrate"].IsNull()) {
+        qattr.SetLinkRate(attr["linkrate"].AsDouble());
+    }
+    if (!attr["growpolicy"].IsNull()) {
+        qattr.SetGrowPolicy(LoadGrowPolicy(attr["growpolicy"]));
+    }
+    if (attr["memorynode"].IsNumber()) {
+        qattr.SetMemoryNode(attr["memorynode"].AsInt());
+    } else if (attr["memorynode"].IsString()) {
+        if (attr["memorynode"].AsString() == "reader") {
+            qattr.SetMemoryNode(CPN::QUEUEMEMORY_READER);
+        } else if (attr["memorynode"].AsString() == "writer") {
+            qattr.SetMemoryNode(CPN::QUEUEMEMORY_WRITER);
+        } else {
+            qattr.SetMemoryNode(CPN::QUEUEMEMORY_ANY);
+        }
+    }
+    if (attr["localaddresses"].IsArray()) {
+        for (Variant::ListIterator itr = attr["localaddresses"].ListBegin();
+                itr != attr["localaddresses"].ListEnd(); ++itr) {
+            qattr.AddLocalAddress(itr->AsString());
+        }
+    }
+    if (attr["readeraddresses"].IsArray()) {
+        for (Variant::ListIterator itr = attr["readeraddresses"].ListBegin();
+                itr != attr["readeraddresses"].ListEnd(); ++itr) {
+            qattr.AddReaderAddress(itr->AsString());
+        }
     }
-    kernel->CreateQueue(qattr);
+    return qattr;
 }
 
 std::pair<bool, std::string> VariantCPNLoader::Validate(Variant conf) {
@@ -45,8 +45,10 @@ public:
     void AddLib(const std::string &filename);
     void AddLibList(const std::string &filename);
     void UseD4R(bool value);
+    void UseFibers(bool value);
     void GrowQueueMaxThreshold(bool value);
     void SwallowBrokenQueueExceptions(bool value);
+    void PresizeQueues(bool value);
 
     // Context functions
     void LogLevel(int i);
@@ -63,15 +65,44 @@ public:
     void Setup(CPN::Kernel *kernel) { Setup(kernel, config); }
 
     static CPN::shared_ptr<CPN::Context> LoadContext(Variant v);
+    /**
+     * A grow policy from its name, "geometric", or an object with
+     * "type" geometric, budget or history and the parameters of that
+     * policy, see GrowPolicy.h. Budget and history take the policy they
+     * wrap under "policy".
+     * \return the policy or null if v is null
+     */
+    static CPN::shared_ptr<CPN::GrowPolicy> LoadGrowPolicy(Variant v);
     static CPN::KernelAttr GetKernelAttr(Variant args);
 
     static void Setup(CPN::Kernel *kernel, Variant args);
 
+    /**
+     * Create all the nodes with Kernel::CreateNodes so a remote
+     * context is asked for their keys in one message.
+     */
     static void LoadNodes(CPN::Kernel *kernel, Variant nodelist, Variant nodemap);
     static void LoadNode(CPN::Kernel *kernel, Variant attr, Variant nodemap);
+    static CPN::NodeAttr GetNodeAttr(Variant attr, Variant nodemap);
 
+    /**
+     * Presize the queues of a graph from the rate annotations of its
+     * nodes, see RateAnalysis. Setup only does this when the config
+     * has "presize-queues" true.
+     * \param logout where to report the parts that could not be
+     * analysed, may be null
+     * \return a copy of queuelist with the analysed queues resized,
+     * or queuelist if there are no rates
+     */
+    static Variant PresizeQueues(Variant nodelist, Variant queuelist, LoggerOutput *logout);
+
+    /**
+     * Create all the queues with Kernel::CreateQueues so a remote
+     * context looks up their endpoints in one message.
+     */
     static void LoadQueues(CPN::Kernel *kernel, Variant queuelist);
     static void LoadQueue(CPN::Kernel *kernel, Variant attr);
+    static CPN::QueueAttr GetQueueAttr(Variant attr);
 
     static std::pair<bool, std::string> Validate(Variant conf);
 private:
@@ -0,0 +1,63 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+#include "Clock.h"
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double ToSeconds(const timespec &ts) {
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+double MonotonicTime() {
+#ifdef CLOCK_MONOTONIC
+    timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return ToSeconds(ts);
+    }
+#endif
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+double ThreadCPUTime() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return ToSeconds(ts);
+    }
+#endif
+    return -1;
+}
+
+double ThreadCPUTime(pthread_t thread) {
+#if defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME >= 0
+    clockid_t clock;
+    timespec ts;
+    if (pthread_getcpuclockid(thread, &clock) == 0
+            && clock_gettime(clock, &ts) == 0) {
+        return ToSeconds(ts);
+    }
+#endif
+    return -1;
+}
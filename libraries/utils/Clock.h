@@ -0,0 +1,48 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Clocks for measuring elapsed and CPU time.
+ */
+#ifndef CLOCK_H
+#define CLOCK_H
+#pragma once
+
+#include <pthread.h>
+
+/**
+ * \return the time in seconds on a clock which only
+ * moves forward, the origin is unspecified
+ */
+double MonotonicTime();
+
+/**
+ * \return the CPU time in seconds used by the calling thread
+ * or -1 if the platform cannot tell
+ */
+double ThreadCPUTime();
+
+/**
+ * \param thread a running thread of this process
+ * \return the CPU time in seconds used by thread
+ * or -1 if the platform cannot tell
+ */
+double ThreadCPUTime(pthread_t thread);
+
+#endif
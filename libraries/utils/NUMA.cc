@@ -0,0 +1,98 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ */
+#include "NUMA.h"
+#include "ErrnoException.h"
+#include <stdio.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+bool GetNUMANodeCPUs(int node, std::vector<unsigned> &cpus) {
+    if (node < 0) { return false; }
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (!f) { return false; }
+    // sysfs files are at most a page
+    char list[4096];
+    if (fgets(list, sizeof(list), f)) {
+        ParseCPUList(list, cpus);
+    }
+    fclose(f);
+    return true;
+}
+
+void ParseCPUList(const char *list, std::vector<unsigned> &cpus) {
+    unsigned first, last;
+    int len;
+    while (sscanf(list, "%u%n", &first, &len) == 1) {
+        list += len;
+        last = first;
+        if (*list == '-') {
+            if (sscanf(list + 1, "%u%n", &last, &len) != 1) { break; }
+            list += 1 + len;
+        }
+        for (unsigned cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        if (*list != ',') { break; }
+        ++list;
+    }
+}
+
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+
+// From linux/mempolicy.h
+static const int NUMA_MPOL_DEFAULT = 0;
+static const int NUMA_MPOL_PREFERRED = 1;
+
+void SetPreferredNUMANode(int node) {
+    const unsigned bits = 8*sizeof(unsigned long);
+    unsigned long mask[1024/bits] = {0};
+    const unsigned long maxnode = 1024;
+    if (node >= int(maxnode)) {
+        throw ErrnoException(EINVAL);
+    }
+    long ret;
+    if (node < 0) {
+        ret = syscall(SYS_set_mempolicy, NUMA_MPOL_DEFAULT, 0, 0);
+    } else {
+        mask[node/bits] |= 1UL << (node%bits);
+        ret = syscall(SYS_set_mempolicy, NUMA_MPOL_PREFERRED, mask, maxnode);
+    }
+    if (ret != 0) {
+        throw ErrnoException();
+    }
+}
+
+#else
+
+void SetPreferredNUMANode(int node) {
+    if (node >= 0) {
+        throw ErrnoException(ENOSYS);
+    }
+}
+
+#endif
@@ -0,0 +1,53 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Minimal NUMA placement helpers which do not need libnuma.
+ */
+#ifndef NUMA_H
+#define NUMA_H
+#pragma once
+
+#include <vector>
+
+/**
+ * Get the processors which belong to a NUMA node.
+ * \param node the NUMA node
+ * \param cpus the processors are appended to this
+ * \return false if the node is not known on this system
+ */
+bool GetNUMANodeCPUs(int node, std::vector<unsigned> &cpus);
+
+/**
+ * Parse a processor list like 0-3,8-11 as the kernel writes it.
+ * Parsing stops at the first thing which is not part of the list.
+ * \param list the list
+ * \param cpus the processors are appended to this
+ */
+void ParseCPUList(const char *list, std::vector<unsigned> &cpus);
+
+/**
+ * Ask the kernel to prefer the given NUMA node for memory the
+ * calling thread allocates from now on.
+ * \param node the NUMA node or -1 for the default policy
+ * \throws ErrnoException on failure
+ */
+void SetPreferredNUMANode(int node);
+
+#endif
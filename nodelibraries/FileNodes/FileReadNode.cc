@@ -23,6 +23,7 @@
  */
 #include "NodeBase.h"
 #include "OQueue.h"
+#include "FiberScheduler.h"
 #include <string>
 #include <unistd.h>
 
@@ -48,7 +49,11 @@ void FileReadNode::Process() {
         while (true) {
             unsigned blocksize = out.MaxThreshold();
             void *ptr = out.GetEnqueuePtr(blocksize);
-            unsigned numread = read(fd, ptr, blocksize);
+            unsigned numread;
+            {
+                FiberBlockingCall blocking;
+                numread = read(fd, ptr, blocksize);
+            }
             if (numread < 1) {
                 // Do something if error??
                 break;
@@ -23,6 +23,7 @@
  */
 #include "NodeBase.h"
 #include "IQueue.h"
+#include "FiberScheduler.h"
 #include <string>
 #include <unistd.h>
 
@@ -62,7 +63,11 @@ void FileWriteNode::Process() {
                 in.Dequeue(0);
                 ptr = in.GetDequeuePtr(blksz);
             }
-            unsigned numwritten = write(fd, ptr, blksz);
+            unsigned numwritten;
+            {
+                FiberBlockingCall blocking;
+                numwritten = write(fd, ptr, blksz);
+            }
             if (numwritten < 0) {
                 break;
             }
@@ -21,6 +21,12 @@
  * \author John Bridgman
  * A node which reads from one or more queues and then duplicates the input
  * to one or more outputs.
+ *
+ * By default block i goes to output i mod num_outports. With the parameter
+ * dispatch set to freespace each block goes to the output with the most
+ * freespace instead, so that a slow reader gets fewer blocks, and the index
+ * of the output is written to the unsigned port seq. A JoinNode with order
+ * set to sequence reading that queue puts the blocks back in order.
  */
 #include "NodeBase.h"
 #include "IQueue.h"
@@ -37,6 +43,7 @@ using CPN::NodeAttr;
 using std::vector;
 using CPN::IQueue;
 using CPN::OQueue;
+using CPN::QueueSize_t;
 using std::for_each;
 using std::mem_fun_ref;
 
@@ -56,6 +63,7 @@ void ForkJoinNode::Process() {
     unsigned num_outports = GetParam<unsigned>("num_outports", 1);
     unsigned size = GetParam<unsigned>("size", 0);
     unsigned overlap = GetParam<unsigned>("overlap", 0);
+    bool byfreespace = GetParam<std::string>("dispatch", "roundrobin") == "freespace";
 
     vector<OQueue<void> > out;
     for (unsigned port = 0; port < num_outports; ++port) {
@@ -70,6 +78,10 @@ void ForkJoinNode::Process() {
         oss << "in" << port;
         in.push_back(GetIQueue(oss.str()));
     }
+    OQueue<unsigned> seq;
+    if (byfreespace) {
+        seq = GetOQueue("seq");
+    }
     vector<IQueue<void> >::iterator current_in = in.begin(), end_in = in.end();
     vector<OQueue<void> >::iterator current_out = out.begin(), end_out = out.end();
     while (true) {
@@ -79,6 +91,20 @@ void ForkJoinNode::Process() {
         if (current_out == end_out) {
             current_out = out.begin();
         }
+        if (byfreespace) {
+            // Ties go to the output round robin would have picked
+            vector<OQueue<void> >::iterator best = current_out;
+            QueueSize_t bestfree = best->Freespace();
+            for (vector<OQueue<void> >::iterator o = out.begin(); o != end_out; ++o) {
+                if (o == best) { continue; }
+                const QueueSize_t free = o->Freespace();
+                if (free > bestfree) {
+                    best = o;
+                    bestfree = free;
+                }
+            }
+            current_out = best;
+        }
         const void *inbuff = current_in->GetDequeuePtr(size);
         const unsigned chanstride = current_in->ChannelStride();
         const unsigned numchannels = current_in->NumChannels();
@@ -87,10 +113,17 @@ void ForkJoinNode::Process() {
         }
         current_out->Enqueue(inbuff, size, numchannels, chanstride);
         current_in->Dequeue(size - overlap);
+        if (byfreespace) {
+            unsigned port = current_out - out.begin();
+            seq.Enqueue(&port, 1);
+        }
         ++current_in;
         ++current_out;
     }
     for_each(out.begin(), out.end(), mem_fun_ref(&OQueue<void>::Release));
     for_each(in.begin(), in.end(), mem_fun_ref(&IQueue<void>::Release));
+    if (byfreespace) {
+        seq.Release();
+    }
 }
  
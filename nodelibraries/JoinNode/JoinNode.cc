@@ -21,10 +21,15 @@
  * \author John Bridgman
  * The JoinNode reads from the inputs in a round robbin fashion and
  * then writes to the output, optionally discarding some portion read.
+ *
+ * With the parameter order set to sequence the node instead reads the
+ * index of the next input from the unsigned port seq, as written by a
+ * ForkJoinNode which dispatches by freespace.
  */
 #include "NodeBase.h"
 #include "IQueue.h"
 #include "OQueue.h"
+#include "ThrowingAssert.h"
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -49,10 +54,27 @@ private:
 
 CPN_DECLARE_NODE_FACTORY(JoinNode, JoinNode);
 
+/**
+ * Move one block from in to out.
+ * \return false if in has no more data
+ */
+static bool MoveBlock(IQueue<void> &in, OQueue<void> &out, unsigned size, unsigned overlap) {
+    const void *inbuff = in.GetDequeuePtr(size);
+    const unsigned chanstride = in.ChannelStride();
+    const unsigned numchannels = in.NumChannels();
+    if (!inbuff) {
+        return false;
+    }
+    out.Enqueue(inbuff, size, numchannels, chanstride);
+    in.Dequeue(size - overlap);
+    return true;
+}
+
 void JoinNode::Process() {
     unsigned num_inputs = GetParam<unsigned>("num_inports", 1);
     unsigned size = GetParam<unsigned>("size", 0);
     unsigned overlap = GetParam<unsigned>("overlap", 0);
+    bool bysequence = GetParam<std::string>("order", "roundrobin") == "sequence";
 
     OQueue<void> out = GetOQueue("out");
     vector<IQueue<void> > in;
@@ -62,22 +84,30 @@ void JoinNode::Process() {
         in.push_back(GetIQueue(oss.str()));
     }
 
-    vector<IQueue<void> >::iterator current = in.begin();
-    const vector<IQueue<void> >::iterator end = in.end();
-    bool loop = true;
-    while (loop) {
-        current = in.begin();
-        while (current != end) {
-            const void *inbuff = current->GetDequeuePtr(size);
-            const unsigned chanstride = current->ChannelStride();
-            const unsigned numchannels = current->NumChannels();
-            if (!inbuff) {
-                loop = false;
+    IQueue<unsigned> seq;
+    if (bysequence) {
+        seq = GetIQueue("seq");
+        unsigned port;
+        while (seq.Dequeue(&port, 1)) {
+            ASSERT(port < num_inputs, "Sequence names input %u of %u", port, num_inputs);
+            if (!MoveBlock(in[port], out, size, overlap)) {
                 break;
             }
-            out.Enqueue(inbuff, size, numchannels, chanstride);
-            current->Dequeue(size - overlap);
-            ++current;
+        }
+        seq.Release();
+    } else {
+        vector<IQueue<void> >::iterator current = in.begin();
+        const vector<IQueue<void> >::iterator end = in.end();
+        bool loop = true;
+        while (loop) {
+            current = in.begin();
+            while (current != end) {
+                if (!MoveBlock(*current, out, size, overlap)) {
+                    loop = false;
+                    break;
+                }
+                ++current;
+            }
         }
     }
     out.Release();
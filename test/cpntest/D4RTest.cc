@@ -12,6 +12,9 @@
 #include "ToString.h"
 #include "JSONToVariant.h"
 #include "VariantToJSON.h"
+#include "D4RNode.h"
+#include "D4RQueue.h"
+#include "PthreadLib.h"
 
 #include <stdio.h>
 
@@ -121,7 +124,7 @@ void D4RTest::setUp() {
 void D4RTest::tearDown() {
 }
 
-void D4RTest::RunTest(int numkernels) {
+void D4RTest::RunTest(int numkernels, bool fibers) {
     std::string ext = ".test";
     Directory dir("D4R/Tests");
     unsigned runs = 0;
@@ -173,7 +176,9 @@ void D4RTest::RunTest(int numkernels) {
                         .SetRemoteEnabled(numkernels > 1)
                         .UseD4R(true)
                         .SwallowBrokenQueueExceptions(true)
-                        .GrowQueueMaxThreshold(false))
+                        .GrowQueueMaxThreshold(false)
+                        .UseFibers(fibers)
+                        .SetFiberWorkers(1))
                     );
         }
 
@@ -208,6 +213,103 @@ void D4RTest::RunTwoKernelTest() {
     RunTest(2);
 }
 
+void D4RTest::RunFiberTest() {
+    RunTest(1, true);
+}
+
+namespace {
+
+    /** Changes the public tag of a node over and over. */
+    class TagChanger : public Pthread {
+    public:
+        TagChanger(D4R::Node &n, unsigned num) : node(n), count(num) { Start(); }
+        ~TagChanger() { Join(); }
+        void *EntryPoint() {
+            for (uint64_t i = 1; i <= count; ++i) {
+                // Every field is derived from i so a torn read shows
+                D4R::Tag t(i);
+                t.Count(i);
+                t.QueueSize(i);
+                t.QueueKey(i);
+                node.SetPublicTag(t);
+            }
+            return 0;
+        }
+    private:
+        D4R::Node &node;
+        const unsigned count;
+    };
+
+    /** A queue that only counts the signals it gets. */
+    class CountingQueue : public D4R::QueueBase {
+    public:
+        CountingQueue() : numsignals(0) {}
+        unsigned NumSignals() const { return numsignals; }
+    protected:
+        bool ReadBlocked() { return false; }
+        bool WriteBlocked() { return false; }
+        void Detect() {}
+        void Lock() const { lock.Lock(); }
+        void Unlock() const { lock.Unlock(); }
+        void Wait() {}
+        void Signal() { ++numsignals; }
+    private:
+        mutable PthreadMutex lock;
+        unsigned numsignals;
+    };
+
+    /** A node whose queues can be signaled directly. */
+    class SignalingNode : public D4R::Node {
+    public:
+        SignalingNode(uint64_t key) : D4R::Node(key), numlocks(0) {}
+        void Signal() { SignalTagChanged(); }
+        unsigned NumLocks() const { return numlocks; }
+    protected:
+        void LockQueues() { D4R::Node::LockQueues(); ++numlocks; }
+    private:
+        unsigned numlocks;
+    };
+}
+
+void D4RTest::TagReadTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    D4R::Node node(1);
+    const unsigned num = 200000;
+    TagChanger changer(node, num);
+    uint64_t last = 0;
+    while (last < num) {
+        D4R::Tag t = node.GetPublicTag();
+        if (t.Count() == 0) { continue; }
+        CPPUNIT_ASSERT_EQUAL(t.Count(), t.Key());
+        CPPUNIT_ASSERT_EQUAL(t.Count(), t.QueueSize());
+        CPPUNIT_ASSERT_EQUAL(t.Count(), t.QueueKey());
+        CPPUNIT_ASSERT(t.Count() >= last);
+        last = t.Count();
+    }
+}
+
+void D4RTest::QueueListTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    SignalingNode node(1);
+    CountingQueue r1, r2, w1;
+    node.AddReader(&r1);
+    node.AddReader(&r2);
+    node.AddWriter(&w1);
+    node.Signal();
+    CPPUNIT_ASSERT_EQUAL(1u, r1.NumSignals());
+    CPPUNIT_ASSERT_EQUAL(1u, r2.NumSignals());
+    CPPUNIT_ASSERT_EQUAL(1u, w1.NumSignals());
+    node.RemoveReader(&r1);
+    node.RemoveWriter(&w1);
+    node.Signal();
+    CPPUNIT_ASSERT_EQUAL(1u, r1.NumSignals());
+    CPPUNIT_ASSERT_EQUAL(2u, r2.NumSignals());
+    CPPUNIT_ASSERT_EQUAL(1u, w1.NumSignals());
+    // Every change of the lists and every signaling goes through the hook
+    CPPUNIT_ASSERT_EQUAL(7u, node.NumLocks());
+    node.RemoveReader(&r2);
+}
+
 void D4RTest::Deadlock(TestNodeBase *tnb) {
     Info("%s detected deadlock correctly", tnb->GetName().c_str());
     {
@@ -28,11 +28,20 @@ public:
     CPPUNIT_TEST_SUITE( D4RTest );
     CPPUNIT_TEST( RunOneKernelTest );
     CPPUNIT_TEST( RunTwoKernelTest );
+    CPPUNIT_TEST( RunFiberTest );
+    CPPUNIT_TEST( TagReadTest );
+    CPPUNIT_TEST( QueueListTest );
     CPPUNIT_TEST_SUITE_END();
 
-    void RunTest(int numkernels);
+    void RunTest(int numkernels, bool fibers = false);
     void RunOneKernelTest();
     void RunTwoKernelTest();
+    /// The tests with every node a fiber on a single worker
+    void RunFiberTest();
+    /// Tags read without a lock are never torn by a concurrent change
+    void TagReadTest();
+    /// Only the queues added and not removed are signaled
+    void QueueListTest();
 
     void Deadlock(D4R::TestNodeBase *tnb);
     void Failure(D4R::TestNodeBase *tnb, const std::string &msg);
@@ -0,0 +1,184 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "FiberTest.h"
+#include <cppunit/TestAssert.h>
+#include "Kernel.h"
+#include "FunctionNode.h"
+#include <unistd.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( FiberTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+using CPN::Fiber;
+using CPN::FiberScheduler;
+using CPN::FiberMutex;
+using CPN::FiberBlockingCall;
+using CPN::AutoFiberLock;
+using CPN::Kernel;
+using CPN::KernelAttr;
+using CPN::NodeBase;
+
+static const unsigned STACKSIZE = 1<<16;
+
+void FiberTest::setUp() {
+    mutex = 0;
+    recursive = false;
+    go = false;
+    inside = 0;
+    maxinside = 0;
+    order = 0;
+    holderdone = 0;
+    contenderdone = 0;
+    pipefd[0] = pipefd[1] = -1;
+    readbyte = 0;
+}
+
+void FiberTest::tearDown() {
+    if (pipefd[0] >= 0) { close(pipefd[0]); }
+    if (pipefd[1] >= 0) { close(pipefd[1]); }
+}
+
+void FiberTest::SameLockTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    DoLockTest(false);
+}
+
+void FiberTest::RecursiveLockTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    DoLockTest(true);
+}
+
+void FiberTest::DoLockTest(bool recursive_) {
+    recursive = recursive_;
+    FiberMutex lock(recursive);
+    mutex = &lock;
+    {
+        // A single worker, so a lock owned by the worker thread would
+        // either let the contender in or deadlock it.
+        FiberScheduler scheduler(1, STACKSIZE);
+        std::auto_ptr<Fiber> holder(CPN::CreateFiberFunctional(scheduler, this, &FiberTest::HolderEntry));
+        std::auto_ptr<Fiber> contender(CPN::CreateFiberFunctional(scheduler, this, &FiberTest::ContenderEntry));
+        holder->Start();
+        contender->Start();
+        holder->Join();
+        contender->Join();
+    }
+    CPPUNIT_ASSERT_EQUAL(1u, maxinside);
+    CPPUNIT_ASSERT_EQUAL(1u, holderdone);
+    CPPUNIT_ASSERT_EQUAL(2u, contenderdone);
+    // The lock must be free again
+    lock.Lock();
+    lock.Unlock();
+}
+
+void *FiberTest::HolderEntry() {
+    AutoFiberLock al(*mutex);
+    if (recursive) { al.Lock(); }
+    ++inside;
+    maxinside = std::max(maxinside, inside);
+    {
+        // Suspend while holding mutex until the contender ran
+        AutoFiberLock wl(waitlock);
+        while (!go) {
+            waitcond.Wait(waitlock);
+        }
+    }
+    --inside;
+    holderdone = ++order;
+    return 0;
+}
+
+void *FiberTest::ContenderEntry() {
+    {
+        AutoFiberLock wl(waitlock);
+        go = true;
+        waitcond.Broadcast();
+    }
+    AutoFiberLock al(*mutex);
+    ++inside;
+    maxinside = std::max(maxinside, inside);
+    --inside;
+    contenderdone = ++order;
+    return 0;
+}
+
+void FiberTest::BlockingCallTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    CPPUNIT_ASSERT_EQUAL(0, pipe(pipefd));
+    FiberScheduler scheduler(1, STACKSIZE);
+    std::auto_ptr<Fiber> reader(CPN::CreateFiberFunctional(scheduler, this, &FiberTest::ReaderEntry));
+    std::auto_ptr<Fiber> writer(CPN::CreateFiberFunctional(scheduler, this, &FiberTest::WriterEntry));
+    reader->Start();
+    writer->Start();
+    reader->Join();
+    writer->Join();
+    CPPUNIT_ASSERT_EQUAL('x', readbyte);
+    CPPUNIT_ASSERT_EQUAL(1u, scheduler.NumWorkers());
+    CPPUNIT_ASSERT(scheduler.NumThreads() >= 2);
+}
+
+void *FiberTest::ReaderEntry() {
+    FiberBlockingCall blocking;
+    if (read(pipefd[0], &readbyte, 1) != 1) {
+        readbyte = 0;
+    }
+    return 0;
+}
+
+void *FiberTest::WriterEntry() {
+    const char c = 'x';
+    if (write(pipefd[1], &c, 1) != 1) {
+        close(pipefd[1]);
+        pipefd[1] = -1;
+    }
+    return 0;
+}
+
+static void PipeReaderNode(NodeBase *, int fd) {
+    char c = 0;
+    {
+        FiberBlockingCall blocking;
+        CPPUNIT_ASSERT_EQUAL(1, int(read(fd, &c, 1)));
+    }
+    CPPUNIT_ASSERT_EQUAL('y', c);
+}
+
+static void PipeWriterNode(NodeBase *node, int fd) {
+    // Only get here once the reader is blocked in read
+    node->GetKernel()->WaitForNodeStart("reader");
+    const char c = 'y';
+    CPPUNIT_ASSERT_EQUAL(1, int(write(fd, &c, 1)));
+}
+
+void FiberTest::BlockedIONodeTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    CPPUNIT_ASSERT_EQUAL(0, pipe(pipefd));
+    Kernel kernel(KernelAttr("test").UseD4R(false).UseFibers(true).SetFiberWorkers(1));
+    kernel.CreateFunctionNode("reader", &PipeReaderNode, pipefd[0]);
+    kernel.CreateFunctionNode("writer", &PipeWriterNode, pipefd[1]);
+    kernel.WaitForNode("reader");
+    kernel.WaitForNode("writer");
+}
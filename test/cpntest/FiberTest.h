@@ -0,0 +1,76 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+#ifndef FIBERTEST_H
+#define FIBERTEST_H
+#pragma once
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "FiberScheduler.h"
+
+class FiberTest : public CppUnit::TestFixture {
+public:
+    void setUp();
+
+    void tearDown();
+
+    CPPUNIT_TEST_SUITE( FiberTest );
+    CPPUNIT_TEST( SameLockTest );
+    CPPUNIT_TEST( RecursiveLockTest );
+    CPPUNIT_TEST( BlockingCallTest );
+    CPPUNIT_TEST( BlockedIONodeTest );
+    CPPUNIT_TEST_SUITE_END();
+
+    /**
+     * Two fibers on one worker take the same lock while the first
+     * holds it across a suspension.
+     */
+    void SameLockTest();
+    /** As SameLockTest with a recursive lock held twice. */
+    void RecursiveLockTest();
+    /**
+     * A fiber blocked reading a pipe must not keep the fiber which
+     * writes it from running.
+     */
+    void BlockingCallTest();
+    /** As BlockingCallTest with nodes of a kernel which uses fibers. */
+    void BlockedIONodeTest();
+
+    void DoLockTest(bool recursive);
+
+    void *HolderEntry();
+    void *ContenderEntry();
+    void *ReaderEntry();
+    void *WriterEntry();
+
+private:
+    CPN::FiberMutex *mutex;
+    CPN::FiberMutex waitlock;
+    CPN::FiberCondition<PthreadCondition> waitcond;
+    bool recursive;
+    bool go;
+    unsigned inside;
+    unsigned maxinside;
+    unsigned order;
+    unsigned holderdone;
+    unsigned contenderdone;
+    int pipefd[2];
+    char readbyte;
+};
+#endif
@@ -0,0 +1,135 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "ForkJoinTest.h"
+#include <cppunit/TestAssert.h>
+#include "Kernel.h"
+#include "NodeBase.h"
+#include "IQueue.h"
+#include "OQueue.h"
+#include <vector>
+#include <unistd.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ForkJoinTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+using CPN::shared_ptr;
+using CPN::Kernel;
+using CPN::KernelAttr;
+using CPN::NodeAttr;
+using CPN::QueueAttr;
+using CPN::NodeBase;
+using CPN::NodeFactory;
+using CPN::IQueue;
+using CPN::OQueue;
+
+// Linked in from nodelibraries
+extern "C" shared_ptr<NodeFactory> cpninitForkJoinNode(void);
+extern "C" shared_ptr<NodeFactory> cpninitJoinNode(void);
+
+const unsigned BLOCKSIZE = 64;
+const unsigned NUMBLOCKS = 300;
+
+static void Source(NodeBase *node, const std::vector<char> *data) {
+    OQueue<void> out = node->GetOQueue("out");
+    for (unsigned i = 0; i < data->size(); i += BLOCKSIZE) {
+        out.Enqueue(&(*data)[i], BLOCKSIZE);
+    }
+    out.Release();
+}
+
+/** Pass blocks through, sleeping delay microseconds for each. */
+static void Branch(NodeBase *node, unsigned delay, unsigned *numblocks) {
+    IQueue<void> in = node->GetIQueue("in");
+    OQueue<void> out = node->GetOQueue("out");
+    const void *buff;
+    while ((buff = in.GetDequeuePtr(BLOCKSIZE)) != 0) {
+        if (delay > 0) {
+            usleep(delay);
+        }
+        out.Enqueue(buff, BLOCKSIZE);
+        in.Dequeue(BLOCKSIZE);
+        ++*numblocks;
+    }
+    in.Release();
+    out.Release();
+}
+
+static void Sink(NodeBase *node, std::vector<char> *data) {
+    IQueue<void> in = node->GetIQueue("in");
+    const char *buff;
+    while ((buff = static_cast<const char*>(in.GetDequeuePtr(BLOCKSIZE))) != 0) {
+        data->insert(data->end(), buff, buff + BLOCKSIZE);
+        in.Dequeue(BLOCKSIZE);
+    }
+    in.Release();
+}
+
+void ForkJoinTest::setUp() {
+}
+
+void ForkJoinTest::tearDown() {
+}
+
+void ForkJoinTest::FreespaceDispatchTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    std::vector<char> input(BLOCKSIZE * NUMBLOCKS);
+    for (unsigned i = 0; i < input.size(); ++i) {
+        input[i] = char(i * 7 + i / BLOCKSIZE);
+    }
+    std::vector<char> output;
+    unsigned fastblocks = 0, slowblocks = 0;
+
+    Kernel kernel(KernelAttr("test"));
+    kernel.RegisterNodeFactory(cpninitForkJoinNode());
+    kernel.RegisterNodeFactory(cpninitJoinNode());
+
+    kernel.CreateFunctionNode("source", &Source, (const std::vector<char>*)&input);
+    NodeAttr fork("fork", "ForkJoinNode");
+    fork.SetParam("num_outports", 2).SetParam("size", BLOCKSIZE).SetParam("dispatch", "freespace");
+    kernel.CreateNode(fork);
+    kernel.CreateFunctionNode("fast", &Branch, 0u, &fastblocks);
+    kernel.CreateFunctionNode("slow", &Branch, 2000u, &slowblocks);
+    NodeAttr join("join", "JoinNode");
+    join.SetParam("num_inports", 2).SetParam("size", BLOCKSIZE).SetParam("order", "sequence");
+    kernel.CreateNode(join);
+    kernel.CreateFunctionNode("sink", &Sink, &output);
+
+    QueueAttr qattr(4 * BLOCKSIZE, BLOCKSIZE);
+    kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("fork", "in0", "source", "out"));
+    kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("fast", "in", "fork", "out0"));
+    kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("slow", "in", "fork", "out1"));
+    kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("join", "in0", "fast", "out"));
+    kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("join", "in1", "slow", "out"));
+    kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("sink", "in", "join", "out"));
+    kernel.CreateQueue(QueueAttr(NUMBLOCKS * sizeof(unsigned), sizeof(unsigned))
+            .SetDatatype<unsigned>().SetEndpoints("join", "seq", "fork", "seq"));
+    kernel.WaitForAllNodes();
+
+    DEBUG("fast %u slow %u\n", fastblocks, slowblocks);
+    CPPUNIT_ASSERT_EQUAL(NUMBLOCKS, fastblocks + slowblocks);
+    CPPUNIT_ASSERT(slowblocks < fastblocks);
+    CPPUNIT_ASSERT(output == input);
+}
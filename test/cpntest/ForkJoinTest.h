@@ -0,0 +1,42 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+#ifndef FORKJOINTEST_H
+#define FORKJOINTEST_H
+#pragma once
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class ForkJoinTest : public CppUnit::TestFixture {
+public:
+    void setUp();
+
+    void tearDown();
+
+    CPPUNIT_TEST_SUITE( ForkJoinTest );
+    CPPUNIT_TEST( FreespaceDispatchTest );
+    CPPUNIT_TEST_SUITE_END();
+
+    /**
+     * With dispatch by freespace a slow branch gets fewer blocks and the
+     * JoinNode reading the sequence puts the stream back together.
+     */
+    void FreespaceDispatchTest();
+};
+#endif
@@ -0,0 +1,138 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "GrowPolicyTest.h"
+#include <cppunit/TestAssert.h>
+#include "GrowPolicy.h"
+#include "ToString.h"
+#include <memory>
+#include <unistd.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( GrowPolicyTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+using CPN::QueueSize_t;
+using CPN::GrowRequest;
+using CPN::GrowPolicy;
+using CPN::GeometricGrowPolicy;
+using CPN::BudgetGrowPolicy;
+using CPN::HistoryGrowPolicy;
+
+static GrowRequest Request(const std::string &name, QueueSize_t count,
+        QueueSize_t length, QueueSize_t request, unsigned numchannels = 1)
+{
+    GrowRequest req;
+    req.name = name;
+    req.count = count;
+    req.length = length;
+    req.request = request;
+    req.numchannels = numchannels;
+    return req;
+}
+
+void GrowPolicyTest::setUp() {
+    filename = ToString("/tmp/cpntest-growpolicy-%d.json", int(getpid()));
+    unlink(filename.c_str());
+}
+
+void GrowPolicyTest::tearDown() {
+    unlink(filename.c_str());
+}
+
+void GrowPolicyTest::GeometricTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    GeometricGrowPolicy policy(2, 300);
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(200), policy.GrowSize(Request("q", 100, 100, 10)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(300), policy.GrowSize(Request("q", 200, 200, 10)));
+    // Past the cap only what is needed
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(310), policy.GrowSize(Request("q", 300, 300, 10)));
+    // A request larger than the doubling is still granted
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(150), policy.GrowSize(Request("q", 50, 50, 100)));
+    // The factor is at least one
+    GeometricGrowPolicy flat(0.5);
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(110), flat.GrowSize(Request("q", 100, 100, 10)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(100), flat.GrowSize(Request("q", 10, 100, 10)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(100), flat.InitialLength("q", 100));
+}
+
+void GrowPolicyTest::BudgetTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    BudgetGrowPolicy policy(500);
+    // Doubling two channels adds 2*100
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(200), policy.GrowSize(Request("q", 100, 100, 10, 2)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(200), policy.Used());
+    // Doubling again would add 2*200 and go over
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(210), policy.GrowSize(Request("q", 200, 200, 10, 2)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(220), policy.Used());
+    // Once over only what is needed, and it is still counted
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(410), policy.GrowSize(Request("q", 400, 210, 10, 2)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(620), policy.Used());
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(420), policy.GrowSize(Request("q", 410, 410, 10, 1)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(630), policy.Used());
+
+    // The inner policy decides the grows and the initial lengths
+    CPN::shared_ptr<GrowPolicy> inner(new GeometricGrowPolicy(4));
+    BudgetGrowPolicy wrapped(1000, inner);
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(400), wrapped.GrowSize(Request("q", 100, 100, 10)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(300), wrapped.Used());
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(100), wrapped.InitialLength("q", 100));
+}
+
+void GrowPolicyTest::HistoryTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    std::auto_ptr<HistoryGrowPolicy> policy(new HistoryGrowPolicy(filename));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(100), policy->InitialLength("a", 100));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(200), policy->GrowSize(Request("a", 100, 100, 10)));
+    // Unnamed queues are not remembered
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(100), policy->GrowSize(Request("", 50, 50, 10)));
+    // A grow only records, the file is written by Flush
+    CPPUNIT_ASSERT(access(filename.c_str(), R_OK) != 0);
+    policy->Flush();
+    CPPUNIT_ASSERT_EQUAL(0, access(filename.c_str(), R_OK));
+    // Through a temporary file that is renamed over the profile
+    CPPUNIT_ASSERT(access((filename + ".tmp").c_str(), R_OK) != 0);
+    {
+        HistoryGrowPolicy reader(filename);
+        CPPUNIT_ASSERT_EQUAL(QueueSize_t(200), reader.InitialLength("a", 100));
+        CPPUNIT_ASSERT_EQUAL(QueueSize_t(300), reader.InitialLength("a", 300));
+        CPPUNIT_ASSERT_EQUAL(QueueSize_t(100), reader.InitialLength("b", 100));
+        CPPUNIT_ASSERT_EQUAL(QueueSize_t(100), reader.InitialLength("", 100));
+    }
+    // A smaller grow does not lower what is remembered
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(60), policy->GrowSize(Request("a", 30, 30, 10)));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(200), policy->InitialLength("a", 10));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(500), policy->GrowSize(Request("b", 250, 250, 10)));
+    policy.reset();
+    HistoryGrowPolicy reader(filename);
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(200), reader.InitialLength("a", 100));
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(500), reader.InitialLength("b", 100));
+
+    // A profile that cannot be written is kept to try again
+    HistoryGrowPolicy unwritable("/nonexistent-cpntest-dir/profile.json");
+    CPPUNIT_ASSERT(unwritable.Save());
+    unwritable.GrowSize(Request("a", 100, 100, 10));
+    CPPUNIT_ASSERT(!unwritable.Save());
+    CPPUNIT_ASSERT(!unwritable.Save());
+}
@@ -0,0 +1,49 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+#ifndef GROWPOLICYTEST_H
+#define GROWPOLICYTEST_H
+#pragma once
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+
+class GrowPolicyTest : public CppUnit::TestFixture {
+public:
+    void setUp();
+
+    void tearDown();
+
+    CPPUNIT_TEST_SUITE( GrowPolicyTest );
+    CPPUNIT_TEST( GeometricTest );
+    CPPUNIT_TEST( BudgetTest );
+    CPPUNIT_TEST( HistoryTest );
+    CPPUNIT_TEST_SUITE_END();
+
+    /** Grows by the factor up to the cap but always grants the request. */
+    void GeometricTest();
+    /** Grows with the inner policy until the budget is spent, then only by what is needed. */
+    void BudgetTest();
+    /** The profile is written when a queue grows and read back by the next policy. */
+    void HistoryTest();
+
+private:
+    std::string filename;
+};
+#endif
@@ -7,9 +7,22 @@
 #include "MockNode.h"
 #include "MockSyncNode.h"
 #include "VariantCPNLoader.h"
+#include "NodeFactory.h"
+#include "IQueue.h"
+#include "OQueue.h"
+#include "PthreadMutex.h"
+#include "AutoLock.h"
+#include "ToString.h"
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 #include <string.h>
+#include <sstream>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
 
 CPPUNIT_TEST_SUITE_REGISTRATION( KernelTest );
 
@@ -25,6 +38,88 @@ using CPN::KernelAttr;
 using CPN::NodeAttr;
 using CPN::QueueAttr;
 using CPN::NodeBase;
+using CPN::IQueue;
+using CPN::OQueue;
+
+/**
+ * One end of a fused chain over the ports 0 and 1, one block after
+ * the other. The source writes blocks filled with their index to out0
+ * and then to out1, the sink checks them, reading in1 first when
+ * reverse is set. Each block moved is recorded as P or C.
+ */
+class FusedNode : public NodeBase {
+public:
+    FusedNode(Kernel &ker, const NodeAttr &attr) : NodeBase(ker, attr) {}
+
+    static const unsigned BLOCKSIZE = 32;
+
+    static std::string Events() {
+        AutoLock<PthreadMutex> al(lock);
+        return events;
+    }
+    static unsigned NumBad() {
+        AutoLock<PthreadMutex> al(lock);
+        return numbad;
+    }
+    static void Reset() {
+        AutoLock<PthreadMutex> al(lock);
+        events.clear();
+        numbad = 0;
+    }
+private:
+    void Process() {
+        const unsigned numblocks = GetParam<unsigned>("blocks");
+        if (GetParam<std::string>("mode") == "source") {
+            for (unsigned port = 0; port < 2; ++port) {
+                OQueue<char> out = GetOQueue(ToString("out%u", port));
+                for (unsigned i = 0; i < numblocks; ++i) {
+                    char *buff = out.GetEnqueuePtr(BLOCKSIZE);
+                    std::fill(buff, buff + BLOCKSIZE, char(i));
+                    out.Enqueue(BLOCKSIZE);
+                    Record('P', true);
+                }
+                // So the sink sees the end before waiting on the other port
+                out.Release();
+            }
+        } else {
+            const bool reverse = GetParam<bool>("reverse", false);
+            for (unsigned i = 0; i < 2; ++i) {
+                IQueue<char> in = GetIQueue(ToString("in%u", reverse ? 1 - i : i));
+                unsigned num = 0;
+                const char *buff;
+                while ((buff = in.GetDequeuePtr(BLOCKSIZE)) != 0) {
+                    Record('C', std::count(buff, buff + BLOCKSIZE, char(num)) == BLOCKSIZE);
+                    in.Dequeue(BLOCKSIZE);
+                    ++num;
+                }
+                Record('C', num == numblocks);
+                in.Release();
+            }
+        }
+    }
+
+    static void Record(char event, bool good) {
+        AutoLock<PthreadMutex> al(lock);
+        events.push_back(event);
+        if (!good) { ++numbad; }
+    }
+
+    static PthreadMutex lock;
+    static std::string events;
+    static unsigned numbad;
+};
+
+PthreadMutex FusedNode::lock;
+std::string FusedNode::events;
+unsigned FusedNode::numbad;
+
+class FusedNodeFactory : public CPN::NodeFactory {
+public:
+    FusedNodeFactory() : CPN::NodeFactory("FusedNode") {}
+    shared_ptr<NodeBase> Create(Kernel &ker, const NodeAttr &attr) {
+        return shared_ptr<NodeBase>(new FusedNode(ker, attr));
+    }
+};
 
 void KernelTest::setUp() {
 }
@@ -52,6 +147,34 @@ void KernelTest::TestCreateNodes() {
     AddNoOps(kernel);
 }
 
+void KernelTest::TestCreateNodesTaken() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    CPN::Kernel kernel(KernelAttr("test").UseD4R(false));
+    NodeAttr attr("taken", MOCKNODE_TYPENAME);
+    attr.SetParam("mode", MockNode::MODE_NOP);
+    kernel.CreateNode(attr);
+    std::vector<NodeAttr> attrs;
+    attrs.push_back(attr);
+    attrs.back().SetName("fresh");
+    attrs.push_back(attr);
+    try {
+        kernel.CreateNodes(attrs);
+        CPPUNIT_FAIL("A taken name must throw");
+    } catch (const std::invalid_argument &e) {
+        CPPUNIT_ASSERT_EQUAL(std::string("Node taken already exists."), std::string(e.what()));
+    }
+    CPPUNIT_ASSERT_THROW(kernel.GetContext()->GetNodeKey("fresh"), std::invalid_argument);
+    // A name given twice is caught before anything is created
+    attrs[1].SetName("fresh");
+    CPPUNIT_ASSERT_THROW(kernel.CreateNodes(attrs), std::invalid_argument);
+    CPPUNIT_ASSERT_THROW(kernel.GetContext()->GetNodeKey("fresh"), std::invalid_argument);
+    attrs.pop_back();
+    std::vector<CPN::Key_t> keys = kernel.CreateNodes(attrs);
+    CPPUNIT_ASSERT_EQUAL(keys[0], kernel.GetContext()->GetNodeKey("fresh"));
+    kernel.WaitForNode("fresh");
+    kernel.WaitForNode("taken");
+}
+
 void KernelTest::SimpleTwoNodeTest() {
     DEBUG("%s\n",__PRETTY_FUNCTION__);
     CPN::Kernel kernel(KernelAttr("test").UseD4R(false));
@@ -148,3 +271,116 @@ void KernelTest::TestSyncSourceSink() {
     DoSyncTest(&SyncSource::Run5, &SyncSink::Run3);
 }
 
+static unsigned long RunNodesInTurn(const KernelAttr &kattr) {
+    CPN::Kernel kernel(kattr);
+    NodeAttr attr("", MOCKNODE_TYPENAME);
+    attr.SetParam("mode", MockNode::MODE_NOP);
+    for (unsigned i = 0; i < 8; ++i) {
+        std::ostringstream oss;
+        oss << "nop" << i;
+        attr.SetName(oss.str());
+        kernel.CreateNode(attr);
+        kernel.WaitForNode(oss.str());
+        // Give the thread time to park
+        usleep(10000);
+    }
+    return kernel.NumNodeThreadsReused();
+}
+
+void KernelTest::NodeThreadPoolTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    CPPUNIT_ASSERT_EQUAL(0.0, KernelAttr("test").GetNodeThreadIdleTime());
+    CPPUNIT_ASSERT_EQUAL(0ul, RunNodesInTurn(KernelAttr("test")));
+    CPPUNIT_ASSERT(RunNodesInTurn(KernelAttr("test").SetNodeThreadIdleTime(10)) > 0);
+}
+
+void KernelTest::StatsSlowClientTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    std::ostringstream path;
+    path << "/tmp/cpntest-stats-" << getpid();
+    CPN::Kernel kernel(KernelAttr("test").SetStatsSocket(path.str()));
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CPPUNIT_ASSERT(fd >= 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.str().c_str(), sizeof(addr.sun_path) - 1);
+    CPPUNIT_ASSERT_EQUAL(0, connect(fd, (sockaddr*)&addr, sizeof(addr)));
+    // Fail rather than hang if the server stops reading
+    timeval timeout = { 10, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Ask for far more than the server keeps for a client
+    const std::string commands(std::string("snapshot\n") + "snapshot\n" + "snapshot\n" + "snapshot\n");
+    bool dropped = false;
+    for (unsigned i = 0; i < 1000000 && !dropped; ++i) {
+        if (send(fd, commands.data(), commands.size(), MSG_NOSIGNAL) < 0) {
+            CPPUNIT_ASSERT(errno == EPIPE || errno == ECONNRESET);
+            dropped = true;
+        }
+    }
+    CPPUNIT_ASSERT(dropped);
+    // What was sent before the drop, then the end
+    char buf[4096];
+    ssize_t num = 0;
+    while ((num = recv(fd, buf, sizeof(buf), 0)) > 0) {}
+    CPPUNIT_ASSERT(num == 0 || errno == ECONNRESET);
+    close(fd);
+}
+
+/**
+ * Run a fused source and sink with two queues of four blocks between
+ * them.
+ * \return the events recorded by the nodes
+ */
+static std::string RunFusedChain(unsigned numblocks, bool reverse) {
+    FusedNode::Reset();
+    {
+        Kernel kernel(KernelAttr("test"));
+        kernel.RegisterNodeFactory(shared_ptr<CPN::NodeFactory>(new FusedNodeFactory));
+        NodeAttr attr("source", "FusedNode");
+        attr.SetFusable(true).SetParam("mode", "source").SetParam("blocks", numblocks);
+        kernel.CreateNode(attr);
+        attr.SetName("sink").SetParam("mode", "sink").SetParam("reverse", reverse);
+        kernel.CreateNode(attr);
+        QueueAttr qattr(4 * FusedNode::BLOCKSIZE, FusedNode::BLOCKSIZE);
+        kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("sink", "in0", "source", "out0"));
+        kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("sink", "in1", "source", "out1"));
+        kernel.WaitForAllNodes();
+    }
+    CPPUNIT_ASSERT_EQUAL(0u, FusedNode::NumBad());
+    return FusedNode::Events();
+}
+
+void KernelTest::FusedChainTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const unsigned numblocks = 100;
+    std::string events = RunFusedChain(numblocks, false);
+    CPPUNIT_ASSERT_EQUAL(std::string::size_type(2 * numblocks),
+            (std::string::size_type)std::count(events.begin(), events.end(), 'P'));
+    // Every block plus the end of each queue
+    CPPUNIT_ASSERT_EQUAL(std::string::size_type(2 * numblocks + 2),
+            (std::string::size_type)std::count(events.begin(), events.end(), 'C'));
+    // Without the hand off the source fills the queue each time. It
+    // may still do so at the start and when the sink moves on to in1,
+    // before the sink waits for data.
+    unsigned numlong = 0;
+    std::string::size_type p = events.find('P');
+    while (p != std::string::npos) {
+        std::string::size_type end = events.find('C', p);
+        if (end == std::string::npos) { end = events.size(); }
+        if (end - p > 2) { ++numlong; }
+        p = events.find('P', end);
+    }
+    CPPUNIT_ASSERT(numlong <= 2);
+}
+
+void KernelTest::FusedDeadlockTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    // The source fills in0 while the sink waits on in1, only D4R
+    // growing in0 lets the chain finish
+    const unsigned numblocks = 20;
+    std::string events = RunFusedChain(numblocks, true);
+    CPPUNIT_ASSERT_EQUAL(std::string::size_type(4 * numblocks + 2), events.size());
+}
@@ -13,19 +13,43 @@ public:
     CPPUNIT_TEST( TestInvalidNodeCreationType );
     CPPUNIT_TEST( TestInvalidQueueCreationType );
     CPPUNIT_TEST( TestCreateNodes );
+    CPPUNIT_TEST( TestCreateNodesTaken );
     CPPUNIT_TEST( SimpleTwoNodeTest );
     CPPUNIT_TEST( SimpleTwoNodeTestFromVariant );
     CPPUNIT_TEST( TestSync );
     CPPUNIT_TEST( TestSyncSourceSink );
+    CPPUNIT_TEST( NodeThreadPoolTest );
+    CPPUNIT_TEST( StatsSlowClientTest );
+    CPPUNIT_TEST( FusedChainTest );
+    CPPUNIT_TEST( FusedDeadlockTest );
     CPPUNIT_TEST_SUITE_END();
 
     void TestInvalidNodeCreationType();
     void TestInvalidQueueCreationType();
     void TestCreateNodes();
+    /** CreateNodes creates nothing when one of the names is taken. */
+    void TestCreateNodesTaken();
     void SimpleTwoNodeTest();
     void SimpleTwoNodeTestFromVariant();
     void TestSync();
     void TestSyncSourceSink();
+    /**
+     * Node threads are only parked for reuse when the kernel is
+     * told to keep them.
+     */
+    void NodeThreadPoolTest();
+    /**
+     * A stats client which asks without reading is dropped instead
+     * of blocking the stats server and the kernel shutdown.
+     */
+    void StatsSlowClientTest();
+    /**
+     * A fused producer hands off to its consumer once half a queue is
+     * waiting, and the chain runs to the end.
+     */
+    void FusedChainTest();
+    /** D4R grows a queue between fused nodes which deadlocked. */
+    void FusedDeadlockTest();
 
 
     // Support functions
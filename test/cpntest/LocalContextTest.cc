@@ -0,0 +1,248 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "LocalContextTest.h"
+#include <cppunit/TestAssert.h>
+#include "LocalContext.h"
+#include "Exceptions.h"
+#include "PthreadLib.h"
+#include "PthreadMutex.h"
+#include "ToString.h"
+#include <vector>
+#include <unistd.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LocalContextTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+using CPN::shared_ptr;
+using CPN::Key_t;
+using CPN::LocalContext;
+
+namespace {
+    /** A thread blocked in one of the wait calls of the context. */
+    class ContextWaiter : public Pthread {
+    public:
+        enum Kind { NODE_START, NODE_END, ALL_NODE_END, KERNEL_START };
+
+        ContextWaiter(shared_ptr<LocalContext> ctx, Kind kind_, const std::string &name_)
+            : context(ctx), kind(kind_), name(name_), key(0), done(false), shutdown(false)
+        {
+            Start();
+        }
+
+        ~ContextWaiter() { Join(); }
+
+        void *EntryPoint() {
+            Key_t result = 0;
+            bool terminated = false;
+            try {
+                switch (kind) {
+                case NODE_START:
+                    result = context->WaitForNodeStart(name);
+                    break;
+                case NODE_END:
+                    context->WaitForNodeEnd(name);
+                    break;
+                case ALL_NODE_END:
+                    context->WaitForAllNodeEnd();
+                    break;
+                case KERNEL_START:
+                    result = context->WaitForKernelStart(name);
+                    break;
+                }
+            } catch (const CPN::ShutdownException &) {
+                terminated = true;
+            }
+            PthreadMutexProtected al(lock);
+            key = result;
+            shutdown = terminated;
+            done = true;
+            return 0;
+        }
+
+        bool Done() {
+            PthreadMutexProtected al(lock);
+            return done;
+        }
+
+        /** \return the key waited for, after Join */
+        Key_t GetKey() {
+            PthreadMutexProtected al(lock);
+            return key;
+        }
+
+        /** \return true if the wait threw ShutdownException */
+        bool Shutdown() {
+            PthreadMutexProtected al(lock);
+            return shutdown;
+        }
+    private:
+        shared_ptr<LocalContext> context;
+        const Kind kind;
+        const std::string name;
+        PthreadMutex lock;
+        Key_t key;
+        bool done;
+        bool shutdown;
+    };
+
+    typedef std::vector< shared_ptr<ContextWaiter> > WaiterList;
+
+    // Long enough for a wrongly woken waiter to have returned
+    void Settle() {
+        usleep(20000);
+    }
+}
+
+void LocalContextTest::setUp() {
+    context.reset(new LocalContext);
+}
+
+void LocalContextTest::tearDown() {
+    context.reset();
+}
+
+void LocalContextTest::WaitForNodeTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const unsigned NUM_NODES = 8;
+    std::vector<Key_t> keys;
+    WaiterList starts, ends, samename;
+    for (unsigned i = 0; i < NUM_NODES; ++i) {
+        const std::string name = ToString("node%u", i);
+        keys.push_back(context->CreateNodeKey(1, name));
+        starts.push_back(shared_ptr<ContextWaiter>(
+                    new ContextWaiter(context, ContextWaiter::NODE_START, name)));
+        ends.push_back(shared_ptr<ContextWaiter>(
+                    new ContextWaiter(context, ContextWaiter::NODE_END, name)));
+    }
+    for (unsigned i = 0; i < 4; ++i) {
+        samename.push_back(shared_ptr<ContextWaiter>(
+                    new ContextWaiter(context, ContextWaiter::NODE_START, "node0")));
+    }
+    Settle();
+    for (unsigned i = 0; i < NUM_NODES; ++i) {
+        CPPUNIT_ASSERT(!starts[i]->Done());
+        CPPUNIT_ASSERT(!ends[i]->Done());
+    }
+
+    for (unsigned i = 0; i < NUM_NODES; ++i) {
+        context->SignalNodeStart(keys[i]);
+        starts[i]->Join();
+        CPPUNIT_ASSERT_EQUAL(keys[i], starts[i]->GetKey());
+        if (i == 0) {
+            // Every waiter on the same name wakes
+            for (unsigned w = 0; w < samename.size(); ++w) {
+                samename[w]->Join();
+                CPPUNIT_ASSERT_EQUAL(keys[0], samename[w]->GetKey());
+            }
+        }
+        Settle();
+        for (unsigned j = i + 1; j < NUM_NODES; ++j) {
+            CPPUNIT_ASSERT(!starts[j]->Done());
+        }
+        for (unsigned j = 0; j < NUM_NODES; ++j) {
+            CPPUNIT_ASSERT(!ends[j]->Done());
+        }
+    }
+
+    // A node that has started does not block a new waiter
+    ContextWaiter late(context, ContextWaiter::NODE_START, "node3");
+    late.Join();
+    CPPUNIT_ASSERT_EQUAL(keys[3], late.GetKey());
+
+    for (unsigned i = NUM_NODES; i > 0; --i) {
+        context->SignalNodeEnd(keys[i - 1]);
+        ends[i - 1]->Join();
+        CPPUNIT_ASSERT(!ends[i - 1]->Shutdown());
+        Settle();
+        for (unsigned j = 0; j + 1 < i; ++j) {
+            CPPUNIT_ASSERT(!ends[j]->Done());
+        }
+    }
+    CPPUNIT_ASSERT(!context->IsTerminated());
+}
+
+void LocalContextTest::WaitForAllNodeEndTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    {
+        // Nothing live, nothing to wait for
+        ContextWaiter none(context, ContextWaiter::ALL_NODE_END, "");
+        none.Join();
+        CPPUNIT_ASSERT(!none.Shutdown());
+    }
+    const unsigned NUM_NODES = 4;
+    std::vector<Key_t> keys;
+    for (unsigned i = 0; i < NUM_NODES; ++i) {
+        keys.push_back(context->CreateNodeKey(1, ToString("node%u", i)));
+        context->SignalNodeStart(keys[i]);
+    }
+    WaiterList waiters;
+    for (unsigned i = 0; i < 3; ++i) {
+        waiters.push_back(shared_ptr<ContextWaiter>(
+                    new ContextWaiter(context, ContextWaiter::ALL_NODE_END, "")));
+    }
+    for (unsigned i = 0; i + 1 < NUM_NODES; ++i) {
+        context->SignalNodeEnd(keys[i]);
+        Settle();
+        for (unsigned w = 0; w < waiters.size(); ++w) {
+            CPPUNIT_ASSERT(!waiters[w]->Done());
+        }
+    }
+    context->SignalNodeEnd(keys[NUM_NODES - 1]);
+    for (unsigned w = 0; w < waiters.size(); ++w) {
+        waiters[w]->Join();
+        CPPUNIT_ASSERT(!waiters[w]->Shutdown());
+    }
+}
+
+void LocalContextTest::TerminateTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    Key_t key = context->CreateNodeKey(1, "running");
+    context->SignalNodeStart(key);
+    WaiterList waiters;
+    waiters.push_back(shared_ptr<ContextWaiter>(
+                new ContextWaiter(context, ContextWaiter::NODE_START, "missing")));
+    waiters.push_back(shared_ptr<ContextWaiter>(
+                new ContextWaiter(context, ContextWaiter::KERNEL_START, "missing")));
+    waiters.push_back(shared_ptr<ContextWaiter>(
+                new ContextWaiter(context, ContextWaiter::NODE_END, "running")));
+    waiters.push_back(shared_ptr<ContextWaiter>(
+                new ContextWaiter(context, ContextWaiter::ALL_NODE_END, "")));
+    Settle();
+    for (unsigned w = 0; w < waiters.size(); ++w) {
+        CPPUNIT_ASSERT(!waiters[w]->Done());
+    }
+    context->Terminate();
+    for (unsigned w = 0; w < waiters.size(); ++w) {
+        waiters[w]->Join();
+    }
+    // The start waits throw, the end waits just return
+    CPPUNIT_ASSERT(waiters[0]->Shutdown());
+    CPPUNIT_ASSERT(waiters[1]->Shutdown());
+    CPPUNIT_ASSERT(!waiters[2]->Shutdown());
+    CPPUNIT_ASSERT(!waiters[3]->Shutdown());
+    CPPUNIT_ASSERT(context->IsTerminated());
+    CPPUNIT_ASSERT_THROW(context->WaitForNodeStart("missing"), CPN::ShutdownException);
+}
@@ -0,0 +1,139 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "LoggerTest.h"
+#include <cppunit/TestAssert.h>
+#include "LoggerAsyncOutput.h"
+#include "PthreadFunctional.h"
+#include "AutoLock.h"
+#include "ToString.h"
+#include <fstream>
+#include <memory>
+#include <stdlib.h>
+#include <unistd.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LoggerTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+void LoggerTest::setUp() {
+    filename = ToString("/tmp/cpntest-log-%d", int(getpid()));
+    unlink(filename.c_str());
+    output = 0;
+    logged = false;
+    exit = false;
+}
+
+void LoggerTest::tearDown() {
+    delete output;
+    output = 0;
+    unlink(filename.c_str());
+}
+
+std::vector<std::string> LoggerTest::ReadLog() {
+    std::vector<std::string> lines;
+    std::ifstream is(filename.c_str());
+    std::string line;
+    while (std::getline(is, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void LoggerTest::WrapTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    // The smallest ring holds five of these, flushing every three
+    // makes it wrap without ever filling
+    output = new LoggerAsyncOutput(Logger::INFO, filename, 256, 10);
+    const unsigned num = 100;
+    for (unsigned i = 0; i < num; ++i) {
+        output->Log(Logger::INFO, ToString("message %03u of the wrap test.....", i));
+        if (i % 3 == 2) { output->Flush(); }
+    }
+    output->Flush();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), output->Dropped());
+    std::vector<std::string> lines = ReadLog();
+    CPPUNIT_ASSERT_EQUAL(size_t(num), lines.size());
+    for (unsigned i = 0; i < num; ++i) {
+        CPPUNIT_ASSERT_EQUAL(ToString("%d:message %03u of the wrap test.....", int(Logger::INFO), i), lines[i]);
+    }
+}
+
+void LoggerTest::DropTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    output = new LoggerAsyncOutput(Logger::INFO, filename, 256, 10);
+    // Once Flush returns the writer sleeps for the whole interval
+    output->Flush();
+    const unsigned num = 20;
+    for (unsigned i = 0; i < num; ++i) {
+        output->Log(Logger::INFO, ToString("message %03u of the drop test.....", i));
+    }
+    const uint64_t dropped = output->Dropped();
+    CPPUNIT_ASSERT(dropped > 0);
+    CPPUNIT_ASSERT(dropped < num);
+    output->Flush();
+    std::vector<std::string> lines = ReadLog();
+    // The messages which fit, in order, then the report of the others
+    CPPUNIT_ASSERT_EQUAL(size_t(num - dropped + 1), lines.size());
+    for (unsigned i = 0; i < num - dropped; ++i) {
+        CPPUNIT_ASSERT_EQUAL(ToString("%d:message %03u of the drop test.....", int(Logger::INFO), i), lines[i]);
+    }
+    CPPUNIT_ASSERT_EQUAL(ToString("%d:LoggerAsyncOutput:%llu messages dropped",
+                int(Logger::WARNING), (unsigned long long)dropped), lines.back());
+}
+
+void *LoggerTest::LoggingThread() {
+    output->Log(Logger::INFO, "from a thread which outlives the output");
+    AutoLock<PthreadMutex> al(lock);
+    logged = true;
+    cond.Broadcast();
+    while (!exit) {
+        cond.Wait(lock);
+    }
+    return 0;
+}
+
+void LoggerTest::OutliveTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    output = new LoggerAsyncOutput(Logger::INFO, filename, 256, 10);
+    std::auto_ptr<Pthread> thread(CreatePthreadFunctional(this, &LoggerTest::LoggingThread));
+    thread->Start();
+    {
+        AutoLock<PthreadMutex> al(lock);
+        while (!logged) {
+            cond.Wait(lock);
+        }
+    }
+    delete output;
+    output = 0;
+    {
+        AutoLock<PthreadMutex> al(lock);
+        exit = true;
+        cond.Broadcast();
+    }
+    // The thread exit releases its ring after the output has
+    thread->Join();
+    std::vector<std::string> lines = ReadLog();
+    CPPUNIT_ASSERT_EQUAL(size_t(1), lines.size());
+}
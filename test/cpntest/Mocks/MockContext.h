@@ -39,6 +39,8 @@ public:
     virtual CPN::Key_t WaitForNodeStart(const std::string &nodename) { return 0; }
     virtual void WaitForNodeEnd(const std::string &nodename) { }
     virtual void WaitForAllNodeEnd() { }
+    virtual bool SetReplicas(const CPN::NodeAttr &attr) { return true; }
+    virtual bool GetReplicas(const std::string &nodename, CPN::NodeAttr &attr) { return false; }
 
 
     virtual CPN::Key_t GetCreateReaderKey(CPN::Key_t nodekey, const std::string &portname) { return 0; }
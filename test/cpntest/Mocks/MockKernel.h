@@ -22,7 +22,7 @@ public:
     bool UseD4R() { return useD4R; }
     bool GrowQueueMaxThreshold() { return  true; }
     bool SwallowBrokenQueueExceptions() { return false; }
-    unsigned CalculateGrowSize(unsigned currentsize, unsigned request) { return currentsize + request; }
+    CPN::QueueSize_t CalculateGrowSize(CPN::QueueSize_t currentsize, CPN::QueueSize_t request) { return currentsize + request; }
     bool useD4R;
     CPN::shared_ptr<CPN::Context> context;
 };
@@ -201,6 +201,54 @@ void PacketEDTest::WriterIDTest() {
     DoTest(header);
 }
 
+void PacketEDTest::CompactTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const unsigned maxlen = 1000;
+    CircularQueue queue(maxlen, maxlen, 1);
+    BufferedPacketEncoder encoder;
+    MockDecoder decoder(queue, encoder);
+    for (unsigned i = 0; i < 64; ++i) {
+        // Mix both formats on the same stream
+        encoder.CompactHeaders(i % 2 == 0);
+        Packet header(i % 2 == 0 ? CPN::PACKET_DEQUEUE : CPN::PACKET_GROW);
+        header.Count(uint64_t(rand()) << (i % 33));
+        header.QueueSize(i % 3 == 0 ? 0 : rand());
+        header.ReadClock(rand()).WriteClock(i);
+        encoder.SendPacket(header);
+        if (encoder.CompactHeaders()) {
+            CPPUNIT_ASSERT(encoder.NumBytes() < CPN::PACKET_HEADERLENGTH);
+        }
+        Transfer(&encoder, &decoder);
+        CPPUNIT_ASSERT(decoder.NumEvents() == i + 1);
+        Packet rpacket = decoder.GetPacket();
+        CPPUNIT_ASSERT(memcmp(&rpacket, &header, sizeof(Packet)) == 0);
+    }
+}
+
+void PacketEDTest::FractionTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    uint8_t buf[CPN::PACKET_FRACTIONLENGTH];
+    // Network byte order, most significant byte first
+    CPN::EncodeFraction(0.5, buf);
+    CPPUNIT_ASSERT(buf[0] == 0x80 && buf[1] == 0 && buf[2] == 0 && buf[3] == 0);
+    CPN::EncodeFraction(1.0, buf);
+    CPPUNIT_ASSERT(buf[0] == 0xFF && buf[1] == 0xFF && buf[2] == 0xFF && buf[3] == 0xFF);
+    CPPUNIT_ASSERT(CPN::DecodeFraction(buf) == 1.0);
+    CPN::EncodeFraction(0.0, buf);
+    CPPUNIT_ASSERT(CPN::DecodeFraction(buf) == 0.0);
+    // Out of range values are clamped
+    CPN::EncodeFraction(2.5, buf);
+    CPPUNIT_ASSERT(CPN::DecodeFraction(buf) == 1.0);
+    CPN::EncodeFraction(-1.0, buf);
+    CPPUNIT_ASSERT(CPN::DecodeFraction(buf) == 0.0);
+    for (unsigned i = 0; i < 1000; ++i) {
+        const double frac = double(rand())/RAND_MAX;
+        CPN::EncodeFraction(frac, buf);
+        const double diff = CPN::DecodeFraction(buf) - frac;
+        CPPUNIT_ASSERT(diff < 1.0/4294967295.0 && diff > -1.0/4294967295.0);
+    }
+}
+
 void PacketEDTest::Transfer(BufferedPacketEncoder *encoder, PacketDecoder *decoder) {
     while (encoder->BytesReady()) {
         unsigned available = 0;
@@ -35,6 +35,8 @@ public:
     CPPUNIT_TEST( EndOfReadTest );
     CPPUNIT_TEST( ReaderIDTest );
     CPPUNIT_TEST( WriterIDTest );
+    CPPUNIT_TEST( CompactTest );
+    CPPUNIT_TEST( FractionTest );
     CPPUNIT_TEST_SUITE_END();
 
     void EnqueueTest();
@@ -49,6 +51,10 @@ public:
     void ReaderIDTest();
     void WriterIDTest();
 
+    void CompactTest();
+
+    void FractionTest();
+
     void Transfer(CPN::BufferedPacketEncoder *encoder, CPN::PacketDecoder *decoder);
     void DoTest(CPN::Packet &header);
 };
@@ -0,0 +1,250 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "PlacementTest.h"
+#include <cppunit/TestAssert.h>
+#include "Kernel.h"
+#include "NodeBase.h"
+#include "NodeFactory.h"
+#include "NUMA.h"
+#include "MirrorBufferSet.h"
+#include "PthreadMutex.h"
+#include "AutoLock.h"
+#include <vector>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( PlacementTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+using CPN::shared_ptr;
+using CPN::Kernel;
+using CPN::KernelAttr;
+using CPN::NodeAttr;
+using CPN::NodeBase;
+
+/** Records the processors and the scheduling policy of the node thread. */
+class ThreadProbe : public NodeBase {
+public:
+    ThreadProbe(Kernel &ker, const NodeAttr &attr) : NodeBase(ker, attr) {}
+
+    static cpu_set_t Affinity() {
+        AutoLock<PthreadMutex> al(lock);
+        return affinity;
+    }
+    /** \return the policy of the last node run, -1 before any */
+    static int Policy() {
+        AutoLock<PthreadMutex> al(lock);
+        return policy;
+    }
+    static void Reset() {
+        AutoLock<PthreadMutex> al(lock);
+        CPU_ZERO(&affinity);
+        policy = -1;
+    }
+private:
+    void Process() {
+        AutoLock<PthreadMutex> al(lock);
+        sched_getaffinity(0, sizeof(affinity), &affinity);
+        sched_param param;
+        pthread_getschedparam(pthread_self(), &policy, &param);
+    }
+
+    static PthreadMutex lock;
+    static cpu_set_t affinity;
+    static int policy;
+};
+
+PthreadMutex ThreadProbe::lock;
+cpu_set_t ThreadProbe::affinity;
+int ThreadProbe::policy = -1;
+
+class ThreadProbeFactory : public CPN::NodeFactory {
+public:
+    ThreadProbeFactory() : CPN::NodeFactory("ThreadProbe") {}
+    shared_ptr<NodeBase> Create(Kernel &ker, const NodeAttr &attr) {
+        return shared_ptr<NodeBase>(new ThreadProbe(ker, attr));
+    }
+};
+
+/** \return the processors the node ran on */
+static cpu_set_t RunProbe(const NodeAttr &attr) {
+    ThreadProbe::Reset();
+    Kernel kernel(KernelAttr("test"));
+    kernel.RegisterNodeFactory(shared_ptr<CPN::NodeFactory>(new ThreadProbeFactory));
+    kernel.CreateNode(attr);
+    kernel.WaitForNode(attr.GetName());
+    return ThreadProbe::Affinity();
+}
+
+/**
+ * Takes away the privilege to use real time scheduling while it
+ * exists. Root keeps its saved user id to get it back.
+ */
+class Unprivileged {
+public:
+    Unprivileged() : euid(geteuid()) {
+        CPPUNIT_ASSERT_EQUAL(0, getrlimit(RLIMIT_RTPRIO, &rtprio));
+        rlimit none = rtprio;
+        none.rlim_cur = 0;
+        CPPUNIT_ASSERT_EQUAL(0, setrlimit(RLIMIT_RTPRIO, &none));
+        if (euid == 0) {
+            CPPUNIT_ASSERT_EQUAL(0, seteuid(65534));
+        }
+    }
+    ~Unprivileged() {
+        if (euid == 0) {
+            seteuid(0);
+        }
+        setrlimit(RLIMIT_RTPRIO, &rtprio);
+    }
+private:
+    uid_t euid;
+    rlimit rtprio;
+};
+
+static cpu_set_t ProcessAffinity() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    CPPUNIT_ASSERT_EQUAL(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+    return allowed;
+}
+
+void PlacementTest::setUp() {
+}
+
+void PlacementTest::tearDown() {
+}
+
+void PlacementTest::CPUListTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    std::vector<unsigned> cpus;
+    ParseCPUList("0-3,8-11\n", cpus);
+    const unsigned expected[] = { 0, 1, 2, 3, 8, 9, 10, 11 };
+    CPPUNIT_ASSERT(cpus == std::vector<unsigned>(expected, expected + 8));
+
+    cpus.clear();
+    ParseCPUList("5", cpus);
+    CPPUNIT_ASSERT(cpus == std::vector<unsigned>(1, 5));
+
+    // Appends, and a single processor may follow a range
+    ParseCPUList("0-1,7\n", cpus);
+    const unsigned appended[] = { 5, 0, 1, 7 };
+    CPPUNIT_ASSERT(cpus == std::vector<unsigned>(appended, appended + 4));
+
+    // A node without processors has an empty list
+    cpus.clear();
+    ParseCPUList("\n", cpus);
+    CPPUNIT_ASSERT(cpus.empty());
+    ParseCPUList("", cpus);
+    CPPUNIT_ASSERT(cpus.empty());
+
+    // Stops at the first thing which is not a processor
+    ParseCPUList("2,x,4", cpus);
+    CPPUNIT_ASSERT(cpus == std::vector<unsigned>(1, 2));
+
+    // Unknown nodes leave the list alone
+    cpus.clear();
+    CPPUNIT_ASSERT(!GetNUMANodeCPUs(-1, cpus));
+    CPPUNIT_ASSERT(!GetNUMANodeCPUs(100000, cpus));
+    CPPUNIT_ASSERT(cpus.empty());
+}
+
+void PlacementTest::AvailableCPUTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const cpu_set_t allowed = ProcessAffinity();
+    unsigned cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) { ++cpu; }
+    NodeAttr attr("probe", "ThreadProbe");
+    attr.SetCPUs(std::vector<unsigned>(1, cpu));
+    cpu_set_t expected;
+    CPU_ZERO(&expected);
+    CPU_SET(cpu, &expected);
+    cpu_set_t affinity = RunProbe(attr);
+    CPPUNIT_ASSERT(CPU_EQUAL(&expected, &affinity));
+}
+
+void PlacementTest::UnavailableCPUTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    cpu_set_t allowed = ProcessAffinity();
+    std::vector<unsigned> cpus;
+    // One past the last processor this process may use and one which
+    // does not fit in a cpu_set_t
+    unsigned last = CPU_SETSIZE - 1;
+    while (!CPU_ISSET(last, &allowed)) { --last; }
+    if (last + 1 < CPU_SETSIZE) { cpus.push_back(last + 1); }
+    cpus.push_back(CPU_SETSIZE + 1);
+    NodeAttr attr("probe", "ThreadProbe");
+    attr.SetCPUs(cpus);
+    cpu_set_t affinity = RunProbe(attr);
+    CPPUNIT_ASSERT(CPU_EQUAL(&allowed, &affinity));
+}
+
+void PlacementTest::UnknownNUMANodeTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    cpu_set_t allowed = ProcessAffinity();
+    NodeAttr attr("probe", "ThreadProbe");
+    attr.SetNUMANode(100000);
+    cpu_set_t affinity = RunProbe(attr);
+    CPPUNIT_ASSERT(CPU_EQUAL(&allowed, &affinity));
+}
+
+void PlacementTest::BindMemoryNodeTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const unsigned long page = MirrorBufferSet::PageSize();
+    std::vector<char> buffer(4 * page);
+    MirrorBufferSet::BindMemoryNode(&buffer[0], buffer.size(), 100000);
+    MirrorBufferSet::BindMemoryNode(&buffer[0], buffer.size(), 1000);
+    memset(&buffer[0], 0x5a, buffer.size());
+    CPPUNIT_ASSERT_EQUAL(char(0x5a), buffer[buffer.size() - 1]);
+
+    MirrorBufferSet mbs(page, page, 1, 1000);
+    char *base = static_cast<char*>(static_cast<void*>(mbs));
+    memset(base, 0x3c, page);
+    // The mirror still shows the start of the buffer
+    CPPUNIT_ASSERT_EQUAL(char(0x3c), base[page]);
+}
+
+void PlacementTest::InvalidPolicyTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    NodeAttr attr("probe", "ThreadProbe");
+    attr.SetSchedulePolicy(12345).SetPriority(1);
+    RunProbe(attr);
+    CPPUNIT_ASSERT_EQUAL(int(SCHED_OTHER), ThreadProbe::Policy());
+}
+
+void PlacementTest::UnprivilegedFIFOTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    NodeAttr attr("probe", "ThreadProbe");
+    attr.SetSchedulePolicy(SCHED_FIFO).SetPriority(sched_get_priority_min(SCHED_FIFO));
+    {
+        Unprivileged unprivileged;
+        RunProbe(attr);
+    }
+    CPPUNIT_ASSERT_EQUAL(int(SCHED_OTHER), ThreadProbe::Policy());
+}
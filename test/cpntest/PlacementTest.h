@@ -0,0 +1,60 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+#ifndef PLACEMENTTEST_H
+#define PLACEMENTTEST_H
+#pragma once
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class PlacementTest : public CppUnit::TestFixture {
+public:
+    void setUp();
+
+    void tearDown();
+
+    CPPUNIT_TEST_SUITE( PlacementTest );
+    CPPUNIT_TEST( CPUListTest );
+    CPPUNIT_TEST( AvailableCPUTest );
+    CPPUNIT_TEST( UnavailableCPUTest );
+    CPPUNIT_TEST( UnknownNUMANodeTest );
+    CPPUNIT_TEST( BindMemoryNodeTest );
+    CPPUNIT_TEST( InvalidPolicyTest );
+    CPPUNIT_TEST( UnprivilegedFIFOTest );
+    CPPUNIT_TEST_SUITE_END();
+
+    /** The NUMA cpulist parser handles ranges, single processors and the end. */
+    void CPUListTest();
+    /** A node placed on an available processor runs only there. */
+    void AvailableCPUTest();
+    /** A node placed on processors which are not available runs without affinity. */
+    void UnavailableCPUTest();
+    /** A node on a NUMA node which does not exist runs without affinity. */
+    void UnknownNUMANodeTest();
+    /** Binding to a memory node which does not exist leaves the memory usable. */
+    void BindMemoryNodeTest();
+    /** A node asking for a scheduling policy which does not exist still runs. */
+    void InvalidPolicyTest();
+    /**
+     * A node asking for SCHED_FIFO without the privilege to use it runs
+     * with the inherited scheduling.
+     */
+    void UnprivilegedFIFOTest();
+};
+#endif
@@ -4,6 +4,8 @@
 #include "QueueBase.h"
 #include "QueueAttr.h"
 #include "ThresholdQueue.h"
+#include "ThresholdQueueBase.h"
+#include "NodeStats.h"
 
 #include "MockKernel.h"
 
@@ -28,6 +30,7 @@ using CPN::QueueBase;
 using CPN::ThresholdQueue;
 using CPN::SimpleQueueAttr;
 using CPN::Key_t;
+using CPN::QueueSize_t;
 
 const char data[] = { 'a', 'b', 'c', 'd', 'e' };
 const unsigned data_size = sizeof(data);
@@ -201,6 +204,94 @@ void QueueTest::ThresholdQueueTest() {
     GrowTest();
 }
 
+/**
+ * A queue written outside the library, it overrides the one QueueSize_t
+ * version of each virtual.
+ */
+class ExternalQueue : public QueueBase {
+public:
+    ExternalQueue(CPN::KernelBase *k, const SimpleQueueAttr &attr)
+        : QueueBase(k, attr),
+        queue(1, attr.GetLength(), attr.GetMaxThreshold(), attr.GetNumChannels())
+    {}
+    /// Enqueue and dequeue count with plain int arguments
+    void PassThrough(int count) {
+        AutoLock<QueueBase> al(*this);
+        InternalGetRawEnqueuePtr(count, 0);
+        InternalEnqueue(count);
+        InternalGetRawDequeuePtr(count, 0);
+        InternalDequeue(count);
+    }
+protected:
+    const void *InternalGetRawDequeuePtr(QueueSize_t thresh, unsigned chan) { return queue.GetRawDequeuePtr(thresh, chan); }
+    void InternalDequeue(QueueSize_t count) { queue.Dequeue(count); }
+    void *InternalGetRawEnqueuePtr(QueueSize_t thresh, unsigned chan) { return queue.GetRawEnqueuePtr(thresh, chan); }
+    void InternalEnqueue(QueueSize_t count) { queue.Enqueue(count); }
+    unsigned UnlockedNumChannels() const { return queue.NumChannels(); }
+    QueueSize_t UnlockedCount() const { return queue.Count(); }
+    bool UnlockedEmpty() const { return queue.Empty(); }
+    QueueSize_t UnlockedFreespace() const { return queue.Freespace(); }
+    bool UnlockedFull() const { return queue.Full(); }
+    QueueSize_t UnlockedMaxThreshold() const { return queue.MaxThreshold(); }
+    QueueSize_t UnlockedQueueLength() const { return queue.QueueLength(); }
+    QueueSize_t UnlockedEnqueueChannelStride() const { return queue.ChannelStride(); }
+    QueueSize_t UnlockedDequeueChannelStride() const { return queue.ChannelStride(); }
+    void UnlockedGrow(QueueSize_t queueLen, QueueSize_t maxThresh) { queue.Grow(queueLen, maxThresh); }
+    QueueSize_t UnlockedNumEnqueued() const { return queue.ElementsEnqueued(); }
+    QueueSize_t UnlockedNumDequeued() const { return queue.ElementsDequeued(); }
+
+    ThresholdQueueBase queue;
+};
+
+void QueueTest::ExternalQueueTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    MockKernel kernel;
+    SimpleQueueAttr attr;
+    attr.SetLength(309).SetMaxThreshold(10).SetNumChannels(1)
+        .SetReaderKey(RKEY).SetWriterKey(WKEY);
+    ExternalQueue *equeue = new ExternalQueue(&kernel, attr);
+    queue = equeue;
+    equeue->PassThrough(5);
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(5), queue->NumDequeued());
+    TestBulk();
+    CPPUNIT_ASSERT_EQUAL(queue->NumEnqueued(), queue->NumDequeued());
+    delete queue;
+    queue = 0;
+    attr.SetNumChannels(10);
+    queue = new ExternalQueue(&kernel, attr);
+    TestDirect();
+    delete queue;
+    queue = 0;
+    queue = new ExternalQueue(&kernel, attr);
+    CommunicationTest();
+}
+
+void QueueTest::EndpointStatsTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    MockKernel kernel;
+    SimpleQueueAttr attr;
+    attr.SetLength(30).SetMaxThreshold(10).SetNumChannels(4)
+        .SetReaderKey(RKEY).SetWriterKey(WKEY);
+    queue = new ThresholdQueue(&kernel, attr);
+    for (unsigned chan = 0; chan < 4; ++chan) {
+        memset(queue->GetRawEnqueuePtr(7, chan), 0, 7);
+    }
+    queue->Enqueue(7);
+    queue->GetRawDequeuePtr(3, 0);
+    queue->Dequeue(3);
+
+    CPN::EndpointStats stats;
+    queue->GetEndpointStats(stats, false);
+    CPPUNIT_ASSERT_EQUAL(4u, stats.channels);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4*7), stats.bytes);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4*4), stats.count);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4*queue->QueueLength()), stats.length);
+    queue->GetEndpointStats(stats, true);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4*3), stats.bytes);
+    delete queue;
+    queue = 0;
+}
+
 void QueueTest::TestBulk() {
     DEBUG("%s\n",__PRETTY_FUNCTION__);
     unsigned maxthresh = queue->MaxThreshold();
@@ -30,10 +30,15 @@ public:
     CPPUNIT_TEST_SUITE( QueueTest );
     CPPUNIT_TEST( SimpleQueueTest );
     CPPUNIT_TEST( ThresholdQueueTest );
+    CPPUNIT_TEST( ExternalQueueTest );
+    CPPUNIT_TEST( EndpointStatsTest );
     CPPUNIT_TEST_SUITE_END();
 
     void SimpleQueueTest();
     void ThresholdQueueTest();
+    void ExternalQueueTest();
+    /// The endpoint stats count the bytes of every channel
+    void EndpointStatsTest();
 
     void TestBulk();
     void TestDirect();
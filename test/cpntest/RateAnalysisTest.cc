@@ -0,0 +1,272 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "RateAnalysisTest.h"
+#include <cppunit/TestAssert.h>
+#include "RateAnalysis.h"
+#include "VariantCPNLoader.h"
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RateAnalysisTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+using CPN::QueueSize_t;
+
+static Variant Node(Variant &nodes, const std::string &name) {
+    Variant node(Variant::ObjectType);
+    node["name"] = name;
+    node["type"] = "NullNode";
+    node["inputrates"] = Variant(Variant::ObjectType);
+    node["outputrates"] = Variant(Variant::ObjectType);
+    nodes.Append(node);
+    return node;
+}
+
+static void Queue(Variant &queues, const std::string &writer, const std::string &reader) {
+    Variant queue(Variant::ObjectType);
+    queue["size"] = 1;
+    queue["threshold"] = 1;
+    queue["writernode"] = writer;
+    queue["writerport"] = "out_" + reader;
+    queue["readernode"] = reader;
+    queue["readerport"] = "in_" + writer;
+    queues.Append(queue);
+}
+
+/** Connect writer to reader, writing produce and reading consume each firing */
+static void Connect(Variant &nodes, Variant &queues, const std::string &writer,
+        Variant produce, const std::string &reader, Variant consume)
+{
+    for (unsigned i = 0; i < nodes.Size(); ++i) {
+        if (nodes[i]["name"].AsString() == writer) {
+            nodes[i]["outputrates"]["out_" + reader] = produce;
+        }
+        if (nodes[i]["name"].AsString() == reader) {
+            nodes[i]["inputrates"]["in_" + writer] = consume;
+        }
+    }
+    Queue(queues, writer, reader);
+}
+
+static bool HasProblem(const RateAnalysis &analysis, const std::string &what) {
+    for (unsigned i = 0; i < analysis.Problems().size(); ++i) {
+        if (analysis.Problems()[i].find(what) != std::string::npos) { return true; }
+    }
+    return false;
+}
+
+void RateAnalysisTest::setUp() {
+}
+
+void RateAnalysisTest::tearDown() {
+}
+
+void RateAnalysisTest::BalanceTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+    Node(nodes, "A");
+    Node(nodes, "B");
+    Node(nodes, "C");
+    Connect(nodes, queues, "A", 2, "B", 3);
+    Connect(nodes, queues, "B", 1, "C", 2);
+    RateAnalysis analysis(nodes, queues);
+    CPPUNIT_ASSERT(analysis.HasRates());
+    CPPUNIT_ASSERT(analysis.Run());
+    CPPUNIT_ASSERT(analysis.Problems().empty());
+    Variant reps = analysis.Repetitions();
+    CPPUNIT_ASSERT_EQUAL(3u, reps["A"].AsUnsigned());
+    CPPUNIT_ASSERT_EQUAL(2u, reps["B"].AsUnsigned());
+    CPPUNIT_ASSERT_EQUAL(1u, reps["C"].AsUnsigned());
+    // A fires twice before B can, then B and C keep the queues low
+    Variant sized = analysis.Apply(queues);
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(4), sized[0]["size"].AsNumber<QueueSize_t>());
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(3), sized[0]["threshold"].AsNumber<QueueSize_t>());
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(2), sized[1]["size"].AsNumber<QueueSize_t>());
+    CPPUNIT_ASSERT_EQUAL(QueueSize_t(2), sized[1]["threshold"].AsNumber<QueueSize_t>());
+    // The original is left alone
+    CPPUNIT_ASSERT_EQUAL(1u, queues[0]["size"].AsUnsigned());
+
+    // A queue already large enough is not shrunk
+    queues[0]["size"] = 100;
+    RateAnalysis again(nodes, queues);
+    again.Run();
+    sized = again.Apply(queues);
+    CPPUNIT_ASSERT_EQUAL(100u, sized[0]["size"].AsUnsigned());
+
+    // Without rates on both ends a queue is not analysed
+    Variant plain(Variant::ArrayType);
+    Node(plain, "X");
+    Node(plain, "Y");
+    Queue(queues, "X", "Y");
+    RateAnalysis none(plain, queues);
+    CPPUNIT_ASSERT(!none.HasRates());
+    CPPUNIT_ASSERT(none.Run());
+
+    // Bad rates are rejected
+    Variant bad = nodes.Copy();
+    bad[0]["outputrates"]["out_B"] = 0;
+    CPPUNIT_ASSERT_THROW(RateAnalysis(bad, queues), std::invalid_argument);
+    bad = nodes.Copy();
+    Variant peek(Variant::ObjectType);
+    peek["rate"] = 3;
+    peek["peek"] = 2;
+    bad[1]["inputrates"]["in_A"] = peek;
+    CPPUNIT_ASSERT_THROW(RateAnalysis(bad, queues), std::invalid_argument);
+}
+
+void RateAnalysisTest::InconsistentTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+    Node(nodes, "A");
+    Node(nodes, "B");
+    Node(nodes, "C");
+    Node(nodes, "D");
+    Node(nodes, "E");
+    // A to C directly wants C to fire half as often as through B
+    Connect(nodes, queues, "A", 1, "B", 1);
+    Connect(nodes, queues, "B", 1, "C", 1);
+    Connect(nodes, queues, "A", 1, "C", 2);
+    Connect(nodes, queues, "D", 8, "E", 8);
+    RateAnalysis analysis(nodes, queues);
+    CPPUNIT_ASSERT(!analysis.Run());
+    CPPUNIT_ASSERT_EQUAL(size_t(1), analysis.Problems().size());
+    CPPUNIT_ASSERT(HasProblem(analysis, "inconsistent"));
+    Variant reps = analysis.Repetitions();
+    CPPUNIT_ASSERT(reps["A"].IsNull());
+    CPPUNIT_ASSERT(reps["C"].IsNull());
+    CPPUNIT_ASSERT_EQUAL(1u, reps["D"].AsUnsigned());
+    Variant sized = analysis.Apply(queues);
+    for (unsigned i = 0; i < 3; ++i) {
+        CPPUNIT_ASSERT_EQUAL(1u, sized[i]["size"].AsUnsigned());
+        CPPUNIT_ASSERT_EQUAL(1u, sized[i]["threshold"].AsUnsigned());
+    }
+    CPPUNIT_ASSERT_EQUAL(8u, sized[3]["size"].AsUnsigned());
+    CPPUNIT_ASSERT_EQUAL(8u, sized[3]["threshold"].AsUnsigned());
+
+    // The loader logs the problem and still presizes the rest
+    sized = VariantCPNLoader::PresizeQueues(nodes, queues, 0);
+    CPPUNIT_ASSERT_EQUAL(1u, sized[0]["size"].AsUnsigned());
+    CPPUNIT_ASSERT_EQUAL(8u, sized[3]["size"].AsUnsigned());
+}
+
+void RateAnalysisTest::CycleTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+    Node(nodes, "A");
+    Node(nodes, "B");
+    Connect(nodes, queues, "A", 1, "B", 1);
+    Connect(nodes, queues, "B", 1, "A", 1);
+    {
+        RateAnalysis analysis(nodes, queues);
+        CPPUNIT_ASSERT(!analysis.Run());
+        CPPUNIT_ASSERT(HasProblem(analysis, "cannot complete a period"));
+        CPPUNIT_ASSERT_EQUAL(size_t(0), analysis.Repetitions().Size());
+        CPPUNIT_ASSERT_EQUAL(1u, analysis.Apply(queues)[1]["size"].AsUnsigned());
+    }
+    Variant initial(Variant::ObjectType);
+    initial["rate"] = 1;
+    initial["initial"] = 3;
+    nodes[1]["outputrates"]["out_A"] = initial;
+    {
+        RateAnalysis analysis(nodes, queues);
+        CPPUNIT_ASSERT(analysis.Run());
+        Variant reps = analysis.Repetitions();
+        CPPUNIT_ASSERT_EQUAL(1u, reps["A"].AsUnsigned());
+        CPPUNIT_ASSERT_EQUAL(1u, reps["B"].AsUnsigned());
+        Variant sized = analysis.Apply(queues);
+        CPPUNIT_ASSERT_EQUAL(1u, sized[0]["size"].AsUnsigned());
+        // Room for the initial tokens
+        CPPUNIT_ASSERT_EQUAL(3u, sized[1]["size"].AsUnsigned());
+    }
+}
+
+void RateAnalysisTest::PeekTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+    Node(nodes, "A");
+    Node(nodes, "B");
+    Variant peek(Variant::ObjectType);
+    peek["rate"] = 4;
+    peek["peek"] = 8;
+    Connect(nodes, queues, "A", 4, "B", peek);
+    RateAnalysis analysis(nodes, queues);
+    CPPUNIT_ASSERT(analysis.Run());
+    Variant sized = analysis.Apply(queues);
+    CPPUNIT_ASSERT_EQUAL(8u, sized[0]["size"].AsUnsigned());
+    CPPUNIT_ASSERT_EQUAL(8u, sized[0]["threshold"].AsUnsigned());
+}
+
+void RateAnalysisTest::OverflowTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const unsigned long long big = 10000000019ULL;
+    {
+        // B fires big times as often as A and C big times as often as B
+        Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+        Node(nodes, "A");
+        Node(nodes, "B");
+        Node(nodes, "C");
+        Connect(nodes, queues, "A", big, "B", 1);
+        Connect(nodes, queues, "B", big, "C", 1);
+        RateAnalysis analysis(nodes, queues);
+        CPPUNIT_ASSERT(!analysis.Run());
+        CPPUNIT_ASSERT_EQUAL(size_t(1), analysis.Problems().size());
+        CPPUNIT_ASSERT(HasProblem(analysis, "overflow"));
+        CPPUNIT_ASSERT_EQUAL(size_t(0), analysis.Repetitions().Size());
+    }
+    {
+        // The period is the product of two large coprime rates
+        Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+        Node(nodes, "A");
+        Node(nodes, "B");
+        Node(nodes, "C");
+        Connect(nodes, queues, "A", 1, "B", big);
+        Connect(nodes, queues, "A", 1, "C", big + 2);
+        RateAnalysis analysis(nodes, queues);
+        CPPUNIT_ASSERT(!analysis.Run());
+        CPPUNIT_ASSERT(HasProblem(analysis, "overflow"));
+    }
+    {
+        // Small enough to solve but too many firings to simulate
+        Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+        Node(nodes, "A");
+        Node(nodes, "B");
+        Connect(nodes, queues, "A", big, "B", 1);
+        RateAnalysis analysis(nodes, queues);
+        CPPUNIT_ASSERT(!analysis.Run());
+        CPPUNIT_ASSERT(HasProblem(analysis, "too many times"));
+    }
+    {
+        // One firing each but two periods of tokens do not fit
+        const unsigned long long huge = 1ULL << 63;
+        Variant nodes(Variant::ArrayType), queues(Variant::ArrayType);
+        Node(nodes, "A");
+        Node(nodes, "B");
+        Connect(nodes, queues, "A", huge, "B", huge);
+        RateAnalysis analysis(nodes, queues);
+        CPPUNIT_ASSERT(!analysis.Run());
+        CPPUNIT_ASSERT(HasProblem(analysis, "tokens"));
+        CPPUNIT_ASSERT_EQUAL(1u, analysis.Apply(queues)[0]["size"].AsUnsigned());
+    }
+}
@@ -0,0 +1,51 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+#ifndef RATEANALYSISTEST_H
+#define RATEANALYSISTEST_H
+#pragma once
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class RateAnalysisTest : public CppUnit::TestFixture {
+public:
+    void setUp();
+
+    void tearDown();
+
+    CPPUNIT_TEST_SUITE( RateAnalysisTest );
+    CPPUNIT_TEST( BalanceTest );
+    CPPUNIT_TEST( InconsistentTest );
+    CPPUNIT_TEST( CycleTest );
+    CPPUNIT_TEST( PeekTest );
+    CPPUNIT_TEST( OverflowTest );
+    CPPUNIT_TEST_SUITE_END();
+
+    /** A chain gets the repetitions and queue sizes of its schedule. */
+    void BalanceTest();
+    /** Inconsistent rates fail only their own component. */
+    void InconsistentTest();
+    /** A cycle needs initial tokens to complete a period. */
+    void CycleTest();
+    /** A reader that peeks makes its writer run ahead. */
+    void PeekTest();
+    /** Rates whose products or periods do not fit are reported. */
+    void OverflowTest();
+};
+#endif
@@ -4,6 +4,7 @@
 #include "RemoteContextClient.h"
 #include "RemoteContextServer.h"
 #include "AutoUnlock.h"
+#include "RCTXMT.h"
 
 #include "PthreadLib.h"
 #include "PthreadMutex.h"
@@ -12,6 +13,8 @@
 
 #include <deque>
 #include <map>
+#include <stdexcept>
+#include <vector>
 
 CPPUNIT_TEST_SUITE_REGISTRATION( RemoteContextTest);
 
@@ -88,7 +91,11 @@ public:
                 std::pair<std::string, Variant> entry = msgqueue.front();
                 msgqueue.pop_front();
                 DBPRINT("Processing %s -> %s\n", entry.first.c_str(), entry.second.AsJSON().c_str());
-                DispatchMessage(entry.first, entry.second.Copy());
+                try {
+                    DispatchMessage(entry.first, entry.second.Copy());
+                } catch (const std::exception &e) {
+                    DEBUG("dispatch: %s\n", e.what());
+                }
             }
         }
         return 0;
@@ -104,7 +111,7 @@ private:
 class LocalRContextClient : public CPN::RemoteContextClient {
 public:
     LocalRContextClient(LocalRContextServ *lrdbs_, const std::string &name_)
-        : lrdbs(lrdbs_), name(name_)
+        : lrdbs(lrdbs_), name(name_), numsent(0)
     {
         lrdbs->Register(name, this);
     }
@@ -123,14 +130,33 @@ public:
     void Log(int level, const std::string &msg) const {
     }
 
+    /** \brief Send msgs in one batch and wait for all the replies. */
+    std::vector<Variant> CallBatch(const std::vector<Variant> &msgs) {
+        CPN::AutoFiberLock al(lock);
+        std::vector<ReplyPtr> replies = RemoteCallBatch(msgs);
+        std::vector<Variant> results;
+        for (unsigned i = 0; i < replies.size(); ++i) {
+            results.push_back(WaitReply(replies[i]));
+        }
+        return results;
+    }
+
+    /** \return the number of messages sent to the server so far */
+    unsigned NumSent() {
+        CPN::AutoFiberLock al(lock);
+        return numsent;
+    }
+
 protected:
     void SendMessage(const Variant &msg) {
-        AutoUnlock<PthreadMutex> aul(lock);
+        ++numsent;
+        AutoUnlock<CPN::FiberMutex> aul(lock);
         lrdbs->EnqueueMessage(name, msg);
     }
 private:
     LocalRContextServ *lrdbs;
     std::string name;
+    unsigned numsent;
 };
 
 void RemoteContextTest::setUp() {
@@ -289,3 +315,96 @@ void RemoteContextTest::ConnectTest() {
     CPPUNIT_ASSERT_EQUAL(rkey, lrdbc.GetWritersReader(wkey));
 }
 
+void RemoteContextTest::CacheTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    LocalRContextClient lrdbc(serv, __PRETTY_FUNCTION__);
+    m_nodename = "bogus node";
+    m_nodekey = lrdbc.CreateNodeKey(4321, m_nodename);
+    Key_t wkey = lrdbc.GetCreateWriterKey(m_nodekey, "bogus writer");
+    Key_t rkey = lrdbc.GetCreateReaderKey(m_nodekey, "bogus reader");
+
+    // Everything asked so far is answered from the cache
+    unsigned sent = lrdbc.NumSent();
+    CPPUNIT_ASSERT_EQUAL(m_nodekey, lrdbc.GetNodeKey(m_nodename));
+    CPPUNIT_ASSERT_EQUAL(m_nodename, lrdbc.GetNodeName(m_nodekey));
+    CPPUNIT_ASSERT_EQUAL((Key_t)4321, lrdbc.GetNodeKernel(m_nodekey));
+    CPPUNIT_ASSERT_EQUAL(wkey, lrdbc.GetCreateWriterKey(m_nodekey, "bogus writer"));
+    CPPUNIT_ASSERT_EQUAL(rkey, lrdbc.GetCreateReaderKey(m_nodekey, "bogus reader"));
+    CPPUNIT_ASSERT_EQUAL(m_nodekey, lrdbc.GetWriterNode(wkey));
+    CPPUNIT_ASSERT_EQUAL(std::string("bogus reader"), lrdbc.GetReaderName(rkey));
+    CPPUNIT_ASSERT_EQUAL(sent, lrdbc.NumSent());
+
+    // An unconnected endpoint is asked again until the server knows
+    CPPUNIT_ASSERT_EQUAL((Key_t)0, lrdbc.GetWritersReader(wkey));
+    CPPUNIT_ASSERT_EQUAL(sent + 1, lrdbc.NumSent());
+    lrdbc.ConnectEndpoints(wkey, rkey, "name");
+    sent = lrdbc.NumSent();
+    CPPUNIT_ASSERT_EQUAL(rkey, lrdbc.GetWritersReader(wkey));
+    CPPUNIT_ASSERT_EQUAL(sent + 1, lrdbc.NumSent());
+    CPPUNIT_ASSERT_EQUAL(wkey, lrdbc.GetReadersWriter(rkey));
+    CPPUNIT_ASSERT_EQUAL(sent + 2, lrdbc.NumSent());
+    CPPUNIT_ASSERT_EQUAL(rkey, lrdbc.GetWritersReader(wkey));
+    CPPUNIT_ASSERT_EQUAL(wkey, lrdbc.GetReadersWriter(rkey));
+    CPPUNIT_ASSERT_EQUAL(sent + 2, lrdbc.NumSent());
+
+    // A node that ended is dropped along with its endpoints
+    lrdbc.SignalNodeStart(m_nodekey);
+    lrdbc.SignalNodeEnd(m_nodekey);
+    lrdbc.WaitForNodeEnd(m_nodename);
+    sent = lrdbc.NumSent();
+    CPPUNIT_ASSERT_EQUAL(m_nodename, lrdbc.GetNodeName(m_nodekey));
+    CPPUNIT_ASSERT_EQUAL(sent + 1, lrdbc.NumSent());
+    CPPUNIT_ASSERT_EQUAL(m_nodename, lrdbc.GetNodeName(m_nodekey));
+    CPPUNIT_ASSERT_EQUAL(sent + 2, lrdbc.NumSent());
+    CPPUNIT_ASSERT_EQUAL(wkey, lrdbc.GetCreateWriterKey(m_nodekey, "bogus writer"));
+    CPPUNIT_ASSERT_EQUAL(sent + 3, lrdbc.NumSent());
+}
+
+void RemoteContextTest::CreateNodeKeysTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    LocalRContextClient lrdbc(serv, __PRETTY_FUNCTION__);
+    LocalRContextClient other(serv, "other");
+    other.CreateNodeKey(1234, "taken");
+    std::vector<std::pair<Key_t, std::string> > nodes;
+    nodes.push_back(std::make_pair((Key_t)1234, std::string("fresh")));
+    nodes.push_back(std::make_pair((Key_t)1234, std::string("taken")));
+    try {
+        lrdbc.CreateNodeKeys(nodes);
+        CPPUNIT_FAIL("A taken name must throw");
+    } catch (const std::invalid_argument &e) {
+        CPPUNIT_ASSERT_EQUAL(std::string("Node taken already exists."), std::string(e.what()));
+    }
+    // Nothing was allocated for the name that was free
+    CPPUNIT_ASSERT_THROW(lrdbc.GetNodeKey("fresh"), std::invalid_argument);
+    nodes.pop_back();
+    std::vector<Key_t> keys = lrdbc.CreateNodeKeys(nodes);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, keys.size());
+    CPPUNIT_ASSERT_EQUAL(keys[0], lrdbc.GetNodeKey("fresh"));
+}
+
+void RemoteContextTest::BatchFailureTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    LocalRContextClient lrdbc(serv, __PRETTY_FUNCTION__);
+    Key_t nodekey = lrdbc.CreateNodeKey(1234, "bogus node");
+    std::vector<Variant> msgs;
+    Variant msg(Variant::ObjectType);
+    msg["type"] = CPN::RCTXMT_GET_NODE_INFO;
+    msg["name"] = "bogus node";
+    msgs.push_back(msg);
+    // The server cannot handle this one
+    msg = Variant(Variant::ObjectType);
+    msg["type"] = -1;
+    msgs.push_back(msg);
+    msg = Variant(Variant::ObjectType);
+    msg["type"] = CPN::RCTXMT_GET_NODE_INFO;
+    msg["name"] = "bogus node";
+    msgs.push_back(msg);
+    std::vector<Variant> replies = lrdbc.CallBatch(msgs);
+    CPPUNIT_ASSERT_EQUAL((size_t)3, replies.size());
+    CPPUNIT_ASSERT(replies[0]["success"].IsTrue());
+    CPPUNIT_ASSERT_EQUAL(nodekey, replies[0]["nodeinfo"]["key"].AsNumber<Key_t>());
+    CPPUNIT_ASSERT(replies[1]["success"].IsFalse());
+    CPPUNIT_ASSERT(replies[2]["success"].IsFalse());
+    // The server goes on with the next message
+    CPPUNIT_ASSERT_EQUAL(nodekey, lrdbc.GetNodeKey("bogus node"));
+}
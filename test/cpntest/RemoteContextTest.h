@@ -36,6 +36,9 @@ public:
     CPPUNIT_TEST( ReaderTest );
     CPPUNIT_TEST( WriterTest );
     CPPUNIT_TEST( ConnectTest );
+    CPPUNIT_TEST( CacheTest );
+    CPPUNIT_TEST( CreateNodeKeysTest );
+    CPPUNIT_TEST( BatchFailureTest );
     CPPUNIT_TEST_SUITE_END();
 
     void KernelSetupTest();
@@ -55,6 +58,12 @@ public:
     void WriterTest();
 
     void ConnectTest();
+    /// Count the round trips of cache hits, misses and evictions
+    void CacheTest();
+    /// A taken name throws its message and allocates no other key
+    void CreateNodeKeysTest();
+    /// A request in a batch that fails still answers every request
+    void BatchFailureTest();
 
     LocalRContextServ *serv;
 
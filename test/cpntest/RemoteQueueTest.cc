@@ -5,9 +5,12 @@
 #include "ConnectionServer.h"
 #include "Context.h"
 #include "RemoteQueue.h"
+#include "PacketHeader.h"
+#include "SocketHandle.h"
 #include "PthreadFunctional.h"
 #include "ErrnoException.h"
 #include <stdlib.h>
+#include <limits>
 CPPUNIT_TEST_SUITE_REGISTRATION( RemoteQueueTest );
 
 using CPN::shared_ptr;
@@ -44,7 +47,7 @@ void RemoteQueueTest::setUp() {
     context->LogLevel(Logger::WARNING);
 
 
-    SockAddrList addrs = SocketAddress::CreateIP("0.0.0.0", "");
+    SockAddrList addrs = SocketAddress::CreateIP("127.0.0.1", "");
     server = shared_ptr<ConnectionServer>(new ConnectionServer(addrs, context));
     server->Disable();
     servert = shared_ptr<Pthread>(CreatePthreadFunctional(this, &RemoteQueueTest::PollServer));
@@ -105,6 +108,7 @@ void RemoteQueueTest::tearDown() {
     wendp.reset();
     wqueue.reset();
     rqueue.reset();
+    stripedqueue.reset();
     server.reset();
     context.reset();
 }
@@ -468,6 +472,245 @@ void RemoteQueueTest::GrowTest() {
 }
 
 
+void RemoteQueueTest::LegacyWriterTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    HandshakeTest(CPN::PACKET_VERSION_LEGACY);
+}
+
+void RemoteQueueTest::CompactWriterTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    HandshakeTest(CPN::PACKET_VERSION);
+}
+
+static unsigned ReadFull(SocketHandle &sock, void *ptr, unsigned len) {
+    char *buf = static_cast<char*>(ptr);
+    unsigned num = 0;
+    while (num < len) {
+        unsigned n = sock.Read(buf + num, len - num);
+        if (n == 0) { break; }
+        num += n;
+    }
+    return num;
+}
+
+void RemoteQueueTest::HandshakeTest(unsigned version) {
+    // The server stays disabled so the writer endpoint never connects
+    // and the socket below takes its place.
+    SocketHandle sock;
+    sock.Connect(SocketAddress::CreateIP("localhost", server->GetAddress().GetServName()));
+    CPN::Packet id(CPN::PACKET_ID_WRITER);
+    id.SourceKey(writerkey).DestinationKey(readerkey).Version(version);
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(id.header)), sock.Write(&id.header, sizeof(id.header)));
+
+    CPN::Packet enqueue(CPN::PACKET_ENQUEUE);
+    enqueue.Count(sizeof(data)).DataLength(sizeof(data)).WriteClock(1);
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(enqueue.header)), sock.Write(&enqueue.header, sizeof(enqueue.header)));
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(data)), sock.Write(data, sizeof(data)));
+
+    const void *ptr = rqueue->GetRawDequeuePtr(sizeof(data), 0);
+    CPPUNIT_ASSERT(ptr);
+    CPPUNIT_ASSERT(memcmp(ptr, data, sizeof(data)) == 0);
+    rqueue->Dequeue(sizeof(data));
+
+    CPN::Packet reply;
+    if (version >= CPN::PACKET_VERSION_COMPACT) {
+        // The reader answers with its version and then goes compact
+        CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(reply.header)), ReadFull(sock, &reply.header, sizeof(reply.header)));
+        CPPUNIT_ASSERT(reply.Valid());
+        CPPUNIT_ASSERT_EQUAL(CPN::PACKET_ID_READER, reply.Type());
+        CPPUNIT_ASSERT_EQUAL(uint32_t(CPN::PACKET_VERSION), reply.Version());
+        uint8_t magic = 0;
+        CPPUNIT_ASSERT_EQUAL(1u, ReadFull(sock, &magic, 1));
+        CPPUNIT_ASSERT_EQUAL(uint8_t(CPN::PACKET_COMPACT_MAGIC), magic);
+    } else {
+        // A legacy writer must only ever see full length headers it knows
+        CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(reply.header)), ReadFull(sock, &reply.header, sizeof(reply.header)));
+        CPPUNIT_ASSERT(reply.Valid());
+        CPPUNIT_ASSERT_EQUAL(CPN::PACKET_DEQUEUE, reply.Type());
+    }
+
+    CPN::Packet end(CPN::PACKET_ENDOFWRITE);
+    end.WriteClock(2);
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(end.header)), sock.Write(&end.header, sizeof(end.header)));
+    while (!rqueue->IsWriterShutdown()) {
+        Pthread::Yield();
+    }
+    rqueue->ShutdownReader();
+}
+
+void RemoteQueueTest::SplitTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const unsigned total = 1<<16;
+    const unsigned maxthresh = 1<<12;
+    CPN::Key_t swriterkey = context->GetCreateWriterKey(nodekey, "writer3");
+    CPN::Key_t sreaderkey = context->GetCreateReaderKey(nodekey, "reader3");
+    context->ConnectEndpoints(swriterkey, sreaderkey, "q3");
+
+    SimpleQueueAttr attr;
+    attr.SetLength(total).SetMaxThreshold(maxthresh).SetNumChannels(1);
+    attr.SetReaderKey(sreaderkey).SetWriterKey(swriterkey);
+    attr.SetReaderNodeKey(nodekey).SetWriterNodeKey(nodekey);
+    attr.SetAlpha(0.5);
+    shared_ptr<RemoteQueue> sreader(new RemoteQueue(this, RemoteQueue::READ,
+                server.get(), &remotequeueholder, attr));
+    remotequeueholder.AddQueue(sreader);
+    sreader->Start();
+    CPPUNIT_ASSERT(sreader->LocalQueueLength() >= total/2);
+
+    // Stand in for the writer, as in HandshakeTest
+    SocketHandle sock;
+    sock.Connect(SocketAddress::CreateIP("localhost", server->GetAddress().GetServName()));
+    CPN::Packet id(CPN::PACKET_ID_WRITER);
+    id.SourceKey(swriterkey).DestinationKey(sreaderkey).Version(CPN::PACKET_VERSION);
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(id.header)), sock.Write(&id.header, sizeof(id.header)));
+
+    uint8_t frac[CPN::PACKET_FRACTIONLENGTH];
+    CPN::EncodeFraction(0.875, frac);
+    CPN::Packet grow(CPN::PACKET_GROW);
+    grow.QueueSize(total).MaxThreshold(maxthresh).DataLength(sizeof(frac)).WriteClock(1);
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(grow.header)), sock.Write(&grow.header, sizeof(grow.header)));
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(frac)), sock.Write(frac, sizeof(frac)));
+
+    // The reader keeps an eighth, rounded up to whole pages
+    while (sreader->LocalQueueLength() > total/4) {
+        Pthread::Yield();
+    }
+    const double alpha = sreader->GetAlpha();
+    CPPUNIT_ASSERT(alpha > 0.874 && alpha < 0.876);
+    CPPUNIT_ASSERT(sreader->LocalQueueLength() >= total/8);
+
+    // The smaller queue must still carry a full threshold of data
+    std::vector<char> buf(maxthresh);
+    for (unsigned i = 0; i < buf.size(); ++i) { buf[i] = (char)i; }
+    CPN::Packet enqueue(CPN::PACKET_ENQUEUE);
+    enqueue.Count(buf.size()).DataLength(buf.size()).WriteClock(2);
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(enqueue.header)), sock.Write(&enqueue.header, sizeof(enqueue.header)));
+    CPPUNIT_ASSERT_EQUAL(unsigned(buf.size()), sock.Write(&buf[0], buf.size()));
+    const void *ptr = sreader->GetRawDequeuePtr(buf.size(), 0);
+    CPPUNIT_ASSERT(ptr);
+    CPPUNIT_ASSERT(memcmp(ptr, &buf[0], buf.size()) == 0);
+    sreader->Dequeue(buf.size());
+
+    CPN::Packet end(CPN::PACKET_ENDOFWRITE);
+    end.WriteClock(3);
+    CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(end.header)), sock.Write(&end.header, sizeof(end.header)));
+    while (!sreader->IsWriterShutdown()) {
+        Pthread::Yield();
+    }
+    sreader->ShutdownReader();
+}
+
+void RemoteQueueTest::SocketBufferSizeTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const int header = CPN::PACKET_HEADERLENGTH;
+    // Nothing known about the link, the window is all that is needed
+    CPPUNIT_ASSERT_EQUAL(4096 + header, RemoteQueue::SocketBufferSize(4096, 0, 0, 1));
+    CPPUNIT_ASSERT_EQUAL(4096 + header, RemoteQueue::SocketBufferSize(4096, 0.01, 0, 1));
+    CPPUNIT_ASSERT_EQUAL(4096 + header, RemoteQueue::SocketBufferSize(4096, 0, 1e6, 1));
+    // 10 ms at 100 MB/s is 1 MB in flight
+    CPPUNIT_ASSERT_EQUAL(1000000 + 4096 + header, RemoteQueue::SocketBufferSize(4096, 0.01, 1e8, 1));
+    // Each connection carries its share
+    CPPUNIT_ASSERT_EQUAL(250000 + 1024 + header, RemoteQueue::SocketBufferSize(4096, 0.01, 1e8, 4));
+    // Never more than the socket calls take
+    const int maxsize = std::numeric_limits<int>::max()/2;
+    CPPUNIT_ASSERT_EQUAL(maxsize, RemoteQueue::SocketBufferSize(CPN::QueueSize_t(1) << 40, 0, 0, 1));
+    CPPUNIT_ASSERT_EQUAL(maxsize, RemoteQueue::SocketBufferSize(0, 10, 1e10, 1));
+}
+
+static const unsigned STRIPEDTOTAL = 1<<21;
+
+static char StripedByte(unsigned i) {
+    return (char)((i * 2654435761u) >> 24);
+}
+
+void RemoteQueueTest::StripedTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const std::string servname = server->GetAddress().GetServName();
+    server->Listen(SocketAddress::CreateIP("127.0.0.2", servname));
+
+    CPN::Key_t swriterkey = context->GetCreateWriterKey(nodekey, "writer2");
+    CPN::Key_t sreaderkey = context->GetCreateReaderKey(nodekey, "reader2");
+    context->ConnectEndpoints(swriterkey, sreaderkey, "q2");
+
+    std::vector<std::string> readeraddrs;
+    readeraddrs.push_back("127.0.0.1");
+    readeraddrs.push_back("127.0.0.2");
+    SimpleQueueAttr attr;
+    attr.SetLength(1<<15).SetMaxThreshold(1<<12).SetNumChannels(1);
+    attr.SetReaderKey(sreaderkey).SetWriterKey(swriterkey);
+    attr.SetReaderNodeKey(nodekey).SetWriterNodeKey(nodekey);
+    attr.SetAlpha(0.5);
+    attr.SetNumConnections(3);
+    attr.SetReaderAddresses(readeraddrs);
+
+    shared_ptr<RemoteQueue> sreader(new RemoteQueue(this, RemoteQueue::READ,
+                server.get(), &remotequeueholder, attr));
+    remotequeueholder.AddQueue(sreader);
+    sreader->Start();
+    shared_ptr<RemoteQueue> swriter(new RemoteQueue(this, RemoteQueue::WRITE,
+                server.get(), &remotequeueholder, attr));
+    remotequeueholder.AddQueue(swriter);
+    swriter->Start();
+    stripedqueue = swriter;
+
+    server->Enable();
+    auto_ptr<Pthread> enqueuer = auto_ptr<Pthread>(
+            CreatePthreadFunctional(this, &RemoteQueueTest::StripedEnqueueData));
+    CPPUNIT_ASSERT_EQUAL(0, enqueuer->Error());
+    enqueuer->Start();
+
+    // Read in different sized pieces than were written
+    unsigned numread = 0;
+    unsigned piece = 0;
+    while (true) {
+        unsigned count = 1 + (piece++ * 97) % sreader->MaxThreshold();
+        const char *ptr = (const char*)sreader->GetRawDequeuePtr(count, 0);
+        if (!ptr) {
+            count = sreader->Count();
+            if (count == 0) { break; }
+            ptr = (const char*)sreader->GetRawDequeuePtr(count, 0);
+            CPPUNIT_ASSERT(ptr);
+        }
+        for (unsigned i = 0; i < count; ++i) {
+            if (ptr[i] != StripedByte(numread + i)) {
+                CPPUNIT_FAIL("Striped data out of order");
+            }
+        }
+        sreader->Dequeue(count);
+        numread += count;
+    }
+    enqueuer->Join();
+    CPPUNIT_ASSERT_EQUAL(STRIPEDTOTAL, numread);
+    CPPUNIT_ASSERT(sreader->IsWriterShutdown());
+
+    CPN::EndpointStats stats;
+    sreader->GetEndpointStats(stats, true);
+    CPPUNIT_ASSERT(stats.linkbytes >= STRIPEDTOTAL);
+    swriter->GetEndpointStats(stats, false);
+    CPPUNIT_ASSERT(stats.linkbytes >= STRIPEDTOTAL);
+    sreader->ShutdownReader();
+}
+
+void *RemoteQueueTest::StripedEnqueueData() {
+    try {
+        unsigned numwritten = 0;
+        unsigned piece = 0;
+        while (numwritten < STRIPEDTOTAL) {
+            unsigned count = 1 + (piece++ * 37) % stripedqueue->MaxThreshold();
+            if (count > STRIPEDTOTAL - numwritten) { count = STRIPEDTOTAL - numwritten; }
+            char *ptr = (char*)stripedqueue->GetRawEnqueuePtr(count, 0);
+            for (unsigned i = 0; i < count; ++i) {
+                ptr[i] = StripedByte(numwritten + i);
+            }
+            stripedqueue->Enqueue(count);
+            numwritten += count;
+        }
+        stripedqueue->ShutdownWriter();
+    } catch (const std::exception &e) {
+        DEBUG("Exception on enqueue: %s\n", e.what());
+    }
+    return 0;
+}
 
 void RemoteQueueTest::NotifyTerminate() {
     wqueue->NotifyTerminate();
@@ -26,6 +26,11 @@ public:
     CPPUNIT_TEST( WriteEndWithNoFDTest );
     CPPUNIT_TEST( MaxThreshGrowTest );
     CPPUNIT_TEST( GrowTest );
+    CPPUNIT_TEST( LegacyWriterTest );
+    CPPUNIT_TEST( CompactWriterTest );
+    CPPUNIT_TEST( StripedTest );
+    CPPUNIT_TEST( SplitTest );
+    CPPUNIT_TEST( SocketBufferSizeTest );
     CPPUNIT_TEST_SUITE_END();
 
     void CommunicationTest();
@@ -36,9 +41,33 @@ public:
     void WriteEndWithNoFDTest();
     void MaxThreshGrowTest();
     void GrowTest();
+    void LegacyWriterTest();
+    void CompactWriterTest();
+    /**
+     * Stream data over a queue striped on three connections to two
+     * addresses of the reader and check it arrives intact and in order.
+     */
+    void StripedTest();
+    /**
+     * Move the split towards the writer with a grow packet and check
+     * the reader follows it and gives back the memory it lost.
+     */
+    void SplitTest();
+    /**
+     * Check the socket buffers hold the window plus the bandwidth-delay
+     * product, split over the connections and capped.
+     */
+    void SocketBufferSizeTest();
+
+    /**
+     * Connect to the reader as a writer of the given protocol version
+     * and check what the reader answers with.
+     */
+    void HandshakeTest(unsigned version);
 
     void *EnqueueData();
     void *DequeueData();
+    void *StripedEnqueueData();
 
     void NotifyTerminate();
 
@@ -50,6 +79,7 @@ public:
     CPN::shared_ptr<CPN::RemoteQueue> wendp;
     CPN::shared_ptr<CPN::QueueBase> wqueue;
     CPN::shared_ptr<CPN::QueueBase> rqueue;
+    CPN::shared_ptr<CPN::QueueBase> stripedqueue;
     CPN::shared_ptr<CPN::Context> context;
 
     CPN::Key_t kernelkey;
@@ -83,7 +113,7 @@ public:
     bool UseD4R() { return false; }
     bool GrowQueueMaxThreshold() { return  true; }
     bool SwallowBrokenQueueExceptions() { return false; }
-    unsigned CalculateGrowSize(unsigned currentsize, unsigned request) { return currentsize + request; }
+    CPN::QueueSize_t CalculateGrowSize(CPN::QueueSize_t currentsize, CPN::QueueSize_t request) { return currentsize + request; }
     bool useD4R;
 
 };
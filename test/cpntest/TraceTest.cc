@@ -0,0 +1,129 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+
+#include "TraceTest.h"
+#include <cppunit/TestAssert.h>
+#include "Kernel.h"
+#include "IQueue.h"
+#include "OQueue.h"
+#include "JSONToVariant.h"
+#include "Variant.h"
+#include "ToString.h"
+#include <fstream>
+#include <set>
+#include <unistd.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TraceTest );
+
+#if _DEBUG
+#define DEBUG(frmt, ...) printf(frmt, __VA_ARGS__)
+#else
+#define DEBUG(frmt, ...)
+#endif
+
+using CPN::Kernel;
+using CPN::KernelAttr;
+using CPN::QueueAttr;
+using CPN::NodeBase;
+using CPN::IQueue;
+using CPN::OQueue;
+
+const unsigned NUMBLOCKS = 16;
+
+/** Fills out0 before out1. */
+static void Source(NodeBase *node) {
+    for (unsigned port = 0; port < 2; ++port) {
+        OQueue<unsigned> out = node->GetOQueue(ToString("out%u", port));
+        for (unsigned i = 0; i < NUMBLOCKS; ++i) {
+            out.Enqueue(&i, 1);
+        }
+        out.Release();
+    }
+}
+
+/** Reads in1 before in0, so D4R has to grow in0. */
+static void Sink(NodeBase *node) {
+    for (unsigned port = 2; port > 0; --port) {
+        IQueue<unsigned> in = node->GetIQueue(ToString("in%u", port - 1));
+        unsigned value;
+        while (in.Dequeue(&value, 1)) {}
+        in.Release();
+    }
+}
+
+void TraceTest::setUp() {
+    filename = ToString("/tmp/cpntest-trace-%d.json", int(getpid()));
+    unlink(filename.c_str());
+}
+
+void TraceTest::tearDown() {
+    unlink(filename.c_str());
+}
+
+void TraceTest::TraceFileTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    {
+        Kernel kernel(KernelAttr("test").SetTraceFile(filename));
+        kernel.CreateFunctionNode("source", &Source);
+        kernel.CreateFunctionNode("sink", &Sink);
+        QueueAttr qattr(4 * sizeof(unsigned), sizeof(unsigned));
+        qattr.SetDatatype<unsigned>();
+        kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("sink", "in0", "source", "out0"));
+        kernel.CreateQueue(QueueAttr(qattr).SetEndpoints("sink", "in1", "source", "out1"));
+        kernel.WaitForNode("sink");
+    }
+    std::ifstream f(filename.c_str());
+#ifndef CPN_TRACE
+    CPPUNIT_ASSERT(!f.is_open());
+#else
+    CPPUNIT_ASSERT(f.is_open());
+    JSONToVariant parser;
+    f >> parser;
+    CPPUNIT_ASSERT(parser.Done());
+    Variant trace = parser.Get();
+    CPPUNIT_ASSERT(trace["traceEvents"].IsArray());
+    std::set<std::string> lanes, events;
+    unsigned numbegin = 0, numend = 0;
+    for (unsigned i = 0; i < trace["traceEvents"].Size(); ++i) {
+        const Variant &event = trace["traceEvents"][i];
+        const std::string name = event["name"].AsString();
+        const std::string phase = event["ph"].AsString();
+        CPPUNIT_ASSERT(event["pid"].IsNumber() && event["tid"].IsNumber());
+        if (phase == "M") {
+            CPPUNIT_ASSERT_EQUAL(std::string("thread_name"), name);
+            lanes.insert(event["args"]["name"].AsString());
+            continue;
+        }
+        CPPUNIT_ASSERT(event["ts"].IsNumber());
+        CPPUNIT_ASSERT(phase == "B" || phase == "E" || phase == "i");
+        events.insert(name);
+        if (name == "run") {
+            if (phase == "B") { ++numbegin; } else { ++numend; }
+        }
+    }
+    CPPUNIT_ASSERT(lanes.count("source") == 1 && lanes.count("sink") == 1);
+    CPPUNIT_ASSERT_EQUAL(2u, numbegin);
+    CPPUNIT_ASSERT_EQUAL(2u, numend);
+    CPPUNIT_ASSERT(events.count("enqueue") == 1);
+    CPPUNIT_ASSERT(events.count("dequeue") == 1);
+    CPPUNIT_ASSERT(events.count("d4r detect") == 1);
+    CPPUNIT_ASSERT(events.count("grow") == 1);
+#endif
+}
@@ -0,0 +1,45 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+#ifndef TRACETEST_H
+#define TRACETEST_H
+#pragma once
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+
+class TraceTest : public CppUnit::TestFixture {
+public:
+    void setUp();
+
+    void tearDown();
+
+    CPPUNIT_TEST_SUITE( TraceTest );
+    CPPUNIT_TEST( TraceFileTest );
+    CPPUNIT_TEST_SUITE_END();
+
+    /**
+     * With CPN_TRACE the trace file is Chrome trace JSON with the run,
+     * enqueue and D4R events of the nodes, without it there is no file.
+     */
+    void TraceFileTest();
+private:
+    std::string filename;
+};
+#endif
@@ -7,8 +7,13 @@
 #include "MockNodeFactory.h"
 #include "MockNode.h"
 #include "MockSyncNode.h"
+#include "NodeFactory.h"
+#include "QueueReader.h"
+#include "QueueWriter.h"
+#include "PthreadMutex.h"
 #include "ToString.h"
 #include <string.h>
+#include <map>
 
 using CPN::Context;
 using CPN::Kernel;
@@ -26,6 +31,54 @@ using CPN::QueueAttr;
 
 CPPUNIT_TEST_SUITE_REGISTRATION( TwoKernelTest );
 
+/**
+ * Opens num_inports ports in0... and num_outports ports out0...,
+ * records the threshold of each and ends. Stands in for the
+ * replicated node and for the ForkJoinNode scatter and gather
+ * nodes around it.
+ */
+class PortProbe : public CPN::NodeBase {
+public:
+    PortProbe(CPN::Kernel &ker, const NodeAttr &attr) : CPN::NodeBase(ker, attr) {}
+
+    static unsigned Threshold(const std::string &port) {
+        PthreadMutexProtected al(lock);
+        return thresholds[port];
+    }
+private:
+    void Process() {
+        unsigned numin = GetParam<unsigned>("num_inports", 0);
+        unsigned numout = GetParam<unsigned>("num_outports", 0);
+        for (unsigned i = 0; i < numin; ++i) {
+            std::string port = ToString("in%u", i);
+            Record(port, GetIQueue(port)->MaxThreshold());
+        }
+        for (unsigned i = 0; i < numout; ++i) {
+            std::string port = ToString("out%u", i);
+            Record(port, GetOQueue(port)->MaxThreshold());
+        }
+    }
+
+    void Record(const std::string &port, unsigned threshold) {
+        PthreadMutexProtected al(lock);
+        thresholds[GetName() + "." + port] = threshold;
+    }
+
+    static PthreadMutex lock;
+    static std::map<std::string, unsigned> thresholds;
+};
+
+PthreadMutex PortProbe::lock;
+std::map<std::string, unsigned> PortProbe::thresholds;
+
+class PortProbeFactory : public CPN::NodeFactory {
+public:
+    PortProbeFactory(const std::string &name) : CPN::NodeFactory(name) {}
+    shared_ptr<CPN::NodeBase> Create(Kernel &ker, const NodeAttr &attr) {
+        return shared_ptr<CPN::NodeBase>(new PortProbe(ker, attr));
+    }
+};
+
 void TwoKernelTest::setUp() {
     context = Context::Local();
 #ifdef _DEBUG
@@ -146,3 +199,44 @@ void TwoKernelTest::QueueShutdownTest() {
     kone->Wait();
 }
 
+
+void TwoKernelTest::ReplicatedNodeTest() {
+    DEBUG("%s\n",__PRETTY_FUNCTION__);
+    const unsigned scatter = 4096;
+    const unsigned gather = 1024;
+    Kernel *kernels[] = { kone, ktwo };
+    for (unsigned i = 0; i < 2; ++i) {
+        kernels[i]->RegisterNodeFactory(shared_ptr<CPN::NodeFactory>(new PortProbeFactory("PortProbe")));
+        kernels[i]->RegisterNodeFactory(shared_ptr<CPN::NodeFactory>(new PortProbeFactory("ForkJoinNode")));
+    }
+    NodeAttr attr("rep", "PortProbe");
+    attr.SetKernel("one").SetReplicas(3).SetScatterBlock(scatter).SetGatherBlock(gather);
+    attr.SetParam("num_inports", 1).SetParam("num_outports", 1);
+    CPN::Key_t group = kone->CreateNode(attr);
+    CPPUNIT_ASSERT_EQUAL(group, context->GetNodeKey("rep"));
+    CPPUNIT_ASSERT_THROW(ktwo->CreateNode(attr), std::invalid_argument);
+
+    // The other kernel learns of the group from the context.
+    NodeAttr found("", "");
+    CPPUNIT_ASSERT(context->GetReplicas("rep", found));
+    CPPUNIT_ASSERT_EQUAL(3u, found.GetReplicas());
+    CPPUNIT_ASSERT_EQUAL(gather, found.GetGatherSize());
+
+    ktwo->CreateNode(NodeAttr("src", "PortProbe").SetParam("num_outports", 1));
+    ktwo->CreateNode(NodeAttr("sink", "PortProbe").SetParam("num_inports", 1));
+    QueueAttr qattr(256, 64);
+    qattr.SetWriter("src", "out0").SetReader("rep", "in0");
+    ktwo->CreateQueue(qattr);
+    qattr.SetWriter("rep", "out0").SetReader("sink", "in0");
+    ktwo->CreateQueue(qattr);
+
+    kone->WaitForNode("rep");
+    ktwo->WaitForNode("sink");
+    ktwo->WaitForNode("src");
+    for (unsigned i = 0; i < 3; ++i) {
+        CPPUNIT_ASSERT(PortProbe::Threshold(ToString("rep.%u.in0", i)) >= scatter);
+        CPPUNIT_ASSERT(PortProbe::Threshold(ToString("rep.%u.out0", i)) >= gather);
+    }
+    CPPUNIT_ASSERT(PortProbe::Threshold("src.out0") >= scatter);
+    CPPUNIT_ASSERT(PortProbe::Threshold("sink.in0") >= gather);
+}
@@ -28,12 +28,18 @@ public:
     CPPUNIT_TEST( TestSync );
     CPPUNIT_TEST( TestSyncSourceSink );
     CPPUNIT_TEST( QueueShutdownTest );
+    CPPUNIT_TEST( ReplicatedNodeTest );
     CPPUNIT_TEST_SUITE_END();
 
     void SimpleTwoNodeTest();
     void TestSync();
     void TestSyncSourceSink();
     void QueueShutdownTest();
+    /**
+     * A replicated node is addressable by its name from every
+     * kernel and its branches hold a whole block.
+     */
+    void ReplicatedNodeTest();
 
 private:
     void DoSyncTest(void (*fun1)(CPN::NodeBase*, std::string),
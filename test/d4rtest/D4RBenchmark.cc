@@ -0,0 +1,185 @@
+
+#include "D4RBenchmark.h"
+#include "D4RTester.h"
+#include "D4RTestNodeBase.h"
+#include "VariantToJSON.h"
+#include "ToString.h"
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+namespace D4R {
+
+    namespace {
+        Variant NewNode(const std::string &name, unsigned key) {
+            Variant node(Variant::ObjectType);
+            node["name"] = name;
+            node["key"] = key;
+            node["instructions"] = Variant(Variant::ArrayType);
+            return node;
+        }
+
+        Variant NewQueue(const std::string &name, unsigned size,
+                const std::string &reader, const std::string &writer) {
+            Variant queue(Variant::ObjectType);
+            queue["name"] = name;
+            queue["size"] = size;
+            queue["reader"] = reader;
+            queue["writer"] = writer;
+            return queue;
+        }
+
+        Variant Op(const char *opcode, const std::string &qname, unsigned amount) {
+            return Variant().Append(opcode).Append(qname).Append(amount);
+        }
+
+        Variant Exit() {
+            return Variant().Append(TestNodeBase::OP_EXIT);
+        }
+
+        Variant NewGraph() {
+            Variant graph(Variant::ObjectType);
+            graph["nodes"] = Variant(Variant::ArrayType);
+            graph["queues"] = Variant(Variant::ArrayType);
+            return graph;
+        }
+    }
+
+    Benchmark::Benchmark(LoggerOutput *lo, unsigned seed_, unsigned scale_)
+        : logout(lo), seed(seed_), scale(std::max(scale_, 1u))
+    {
+    }
+
+    void Benchmark::RunAll(std::ostream &os, unsigned runs) {
+        for (unsigned run = 0; run < runs; ++run) {
+            for (unsigned length = 4; length <= 64; length *= 4) {
+                Run(os, ToString("forkjoin-%u", length*scale), ForkJoin(length*scale, 32), true);
+            }
+            for (unsigned length = 4; length <= 256; length *= 4) {
+                Run(os, ToString("ring-%u", length*scale), Ring(length*scale), true);
+            }
+            for (unsigned numnodes = 32; numnodes <= 128; numnodes *= 4) {
+                Run(os, ToString("random-%u", numnodes*scale), Random(numnodes*scale, 20, 4), true);
+            }
+        }
+    }
+
+    bool Benchmark::Run(std::ostream &os, const std::string &name, const Variant &graph, bool used4r) {
+        Variant result;
+        {
+            Tester tester(used4r);
+            tester.Output(logout);
+            tester.LogLevel(logout->LogLevel());
+            tester.Setup(graph);
+            tester.Run();
+            result = tester.Statistics();
+        }
+        result["benchmark"] = name;
+        VariantToJSON(os, result, false) << std::endl;
+        return result["success"].AsBool();
+    }
+
+    Variant Benchmark::ForkJoin(unsigned length, unsigned detections) {
+        Variant graph = NewGraph();
+        // The first branch holds a token in every queue and every node
+        const unsigned tokens = 2*length + 1 + detections;
+        unsigned key = 0;
+        Variant source = NewNode("source", ++key);
+        source["instructions"].Append(Op(TestNodeBase::OP_ENQUEUE, "a0", tokens));
+        source["instructions"].Append(Op(TestNodeBase::OP_ENQUEUE, "b0", tokens));
+        source["instructions"].Append(Exit());
+        graph["nodes"].Append(source);
+        const char *branches[] = { "a", "b" };
+        for (unsigned b = 0; b < 2; ++b) {
+            std::string prev = "source";
+            for (unsigned i = 0; i < length; ++i) {
+                const std::string name = ToString("%s%u", branches[b], i + 1);
+                const std::string in = ToString("%s%u", branches[b], i);
+                Variant node = NewNode(name, ++key);
+                for (unsigned t = 0; t < tokens; ++t) {
+                    node["instructions"].Append(Op(TestNodeBase::OP_DEQUEUE, in, 1));
+                    node["instructions"].Append(Op(TestNodeBase::OP_ENQUEUE, name, 1));
+                }
+                node["instructions"].Append(Exit());
+                graph["nodes"].Append(node);
+                graph["queues"].Append(NewQueue(in, 1, name, prev));
+                prev = name;
+            }
+            graph["queues"].Append(NewQueue(ToString("%s%u", branches[b], length), 1, "join", prev));
+        }
+        Variant join = NewNode("join", ++key);
+        join["instructions"].Append(Op(TestNodeBase::OP_DEQUEUE, ToString("b%u", length), tokens));
+        join["instructions"].Append(Op(TestNodeBase::OP_DEQUEUE, ToString("a%u", length), tokens));
+        join["instructions"].Append(Exit());
+        graph["nodes"].Append(join);
+        return graph;
+    }
+
+    Variant Benchmark::Ring(unsigned length) {
+        Variant graph = NewGraph();
+        for (unsigned i = 0; i < length; ++i) {
+            const std::string name = ToString("n%u", i);
+            const std::string in = ToString("q%u", i);
+            Variant node = NewNode(name, i + 1);
+            node["instructions"].Append(Op(TestNodeBase::OP_DEQUEUE, in, 1));
+            node["instructions"].Append(Variant().Append(TestNodeBase::OP_VERIFY_DEADLOCK));
+            graph["nodes"].Append(node);
+            graph["queues"].Append(NewQueue(in, 1, name, ToString("n%u", (i + length - 1) % length)));
+        }
+        return graph;
+    }
+
+    Variant Benchmark::Random(unsigned numnodes, unsigned rounds, unsigned maxburst) {
+        struct Edge {
+            std::string name;
+            unsigned burst;
+        };
+        std::vector<std::vector<Edge> > inputs(numnodes), outputs(numnodes);
+        Variant graph = NewGraph();
+        for (unsigned i = 1; i < numnodes; ++i) {
+            const unsigned numinputs = std::min(i, 1 + Rand(2));
+            std::vector<unsigned> preds;
+            while (preds.size() < numinputs) {
+                const unsigned pred = Rand(i);
+                if (std::find(preds.begin(), preds.end(), pred) == preds.end()) {
+                    preds.push_back(pred);
+                }
+            }
+            for (unsigned p = 0; p < preds.size(); ++p) {
+                Edge edge;
+                edge.name = ToString("q%u_%u", preds[p], i);
+                edge.burst = 1 + Rand(maxburst);
+                inputs[i].push_back(edge);
+                outputs[preds[p]].push_back(edge);
+                graph["queues"].Append(NewQueue(edge.name, 1 + Rand(maxburst),
+                            ToString("n%u", i), ToString("n%u", preds[p])));
+            }
+        }
+        for (unsigned i = 0; i < numnodes; ++i) {
+            Variant node = NewNode(ToString("n%u", i), i + 1);
+            std::vector<Variant> ops;
+            for (unsigned r = 0; r < rounds; ++r) {
+                ops.clear();
+                for (unsigned e = 0; e < inputs[i].size(); ++e) {
+                    ops.push_back(Op(TestNodeBase::OP_DEQUEUE, inputs[i][e].name, inputs[i][e].burst));
+                }
+                for (unsigned e = 0; e < outputs[i].size(); ++e) {
+                    ops.push_back(Op(TestNodeBase::OP_ENQUEUE, outputs[i][e].name, outputs[i][e].burst));
+                }
+                for (unsigned o = ops.size(); o > 1; --o) {
+                    std::swap(ops[o - 1], ops[Rand(o)]);
+                }
+                for (unsigned o = 0; o < ops.size(); ++o) {
+                    node["instructions"].Append(ops[o]);
+                }
+            }
+            node["instructions"].Append(Exit());
+            graph["nodes"].Append(node);
+        }
+        return graph;
+    }
+
+    unsigned Benchmark::Rand(unsigned max) {
+        return rand_r(&seed) % max;
+    }
+}
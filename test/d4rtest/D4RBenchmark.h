@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include "Variant.h"
+#include "Logger.h"
+#include <ostream>
+#include <string>
+
+namespace D4R {
+
+    /**
+     * Generates graphs in the same form as the .test files and runs
+     * each with a Tester, writing the statistics of every run as one
+     * line of JSON.
+     *
+     * These measure detection latency and tag signal counts. The cost
+     * of the D4R on a pipeline with no deadlocks is measured on the
+     * real applications instead, ThresholdSieve -D and cpnbf -d, with
+     * the d4r targets of their performance makefiles.
+     */
+    class Benchmark {
+    public:
+        /**
+         * \param lo where the testers log to
+         * \param seed for the random graphs
+         * \param scale multiplies the size of every graph
+         */
+        Benchmark(LoggerOutput *lo, unsigned seed, unsigned scale);
+
+        /** \brief Run the whole suite runs times. */
+        void RunAll(std::ostream &os, unsigned runs);
+
+        /**
+         * Run one graph and write its statistics.
+         * \return false if the tester failed
+         */
+        bool Run(std::ostream &os, const std::string &name, const Variant &graph, bool used4r);
+
+        /**
+         * A source feeding two branches of length nodes that join
+         * again, with queues of size one. The source fills one branch
+         * before the other so each extra token is an artificial
+         * deadlock the length of the cycle.
+         */
+        static Variant ForkJoin(unsigned length, unsigned detections);
+
+        /** A ring of nodes that all read first, a true deadlock. */
+        static Variant Ring(unsigned length);
+
+        /**
+         * A random directed acyclic graph, each node reads and writes a
+         * random amount on each of its queues every round in a random
+         * order. These only ever have artificial deadlocks.
+         */
+        Variant Random(unsigned numnodes, unsigned rounds, unsigned maxburst);
+    private:
+        unsigned Rand(unsigned max);
+
+        LoggerOutput *logout;
+        unsigned seed;
+        const unsigned scale;
+    };
+}
@@ -10,7 +10,8 @@ namespace D4R {
 
 
     TestNode::TestNode(const std::string &name_, uint64_t k, TesterBase *tb)
-        : TestNodeBase(tb), name(name_), node(new Node(k))
+        : TestNodeBase(tb), name(name_), node(new Node(k)),
+        blockedon(0), blockedsince(0)
     {
         Logger::Name(name);
     }
@@ -18,7 +19,9 @@ namespace D4R {
     TestNode::TestNode(const Variant &noded, TesterBase *tb)
         : TestNodeBase(tb),
         name(noded["name"].AsString()),
-        node(new Node(noded["key"].AsNumber<uint64_t>()))
+        node(new Node(noded["key"].AsNumber<uint64_t>())),
+        blockedon(0),
+        blockedsince(0)
     {
         Logger::Name(name);
         Variant::ConstListIterator itr = noded["instructions"].ListBegin();
@@ -30,19 +33,26 @@ namespace D4R {
 
     TestNode::~TestNode() {
         Join();
+        QueueMap::iterator itr;
+        for (itr = readermap.begin(); itr != readermap.end(); ++itr) {
+            node->RemoveReader(itr->second.get());
+        }
+        for (itr = writermap.begin(); itr != writermap.end(); ++itr) {
+            node->RemoveWriter(itr->second.get());
+        }
     }
 
     void TestNode::AddReadQueue(shared_ptr<TestQueue> q) {
         PthreadMutexProtected al(lock);
         q->SetReaderNode(node);
-        node->AddReader(q);
+        node->AddReader(q.get());
         readermap.insert(std::make_pair(q->GetName(), q));
     }
 
     void TestNode::AddWriteQueue(shared_ptr<TestQueue> q) {
         PthreadMutexProtected al(lock);
         q->SetWriterNode(node);
-        node->AddWriter(q);
+        node->AddWriter(q.get());
         writermap.insert(std::make_pair(q->GetName(), q));
     }
 
@@ -109,6 +119,18 @@ namespace D4R {
         }
     }
 
+    void TestNode::BlockedOn(TestQueue *q, double since) {
+        PthreadMutexProtected al(blocklock);
+        blockedon = q;
+        blockedsince = since;
+    }
+
+    TestQueue *TestNode::BlockedOn(double &since) {
+        PthreadMutexProtected al(blocklock);
+        since = blockedsince;
+        return blockedon;
+    }
+
     void TestNode::PrintNode() {
         Tag publicTag = GetPublicTag();
         Tag privateTag = GetPrivateTag();
@@ -31,6 +31,11 @@ namespace D4R {
         const std::string &GetName() const { return name; }
 
         void PrintNode();
+
+        /** Record that this node is blocked on q since the given time, or not blocked when q is 0. */
+        void BlockedOn(TestQueue *q, double since);
+        /** \return the queue this node is blocked on or 0 */
+        TestQueue *BlockedOn(double &since);
     private:
         void *EntryPoint();
 
@@ -45,5 +50,10 @@ namespace D4R {
         QueueMap readermap;
         QueueMap writermap;
         shared_ptr<Node> node;
+
+        // Only held to read or write the two below
+        PthreadMutex blocklock;
+        TestQueue *blockedon;
+        double blockedsince;
     };
 }
@@ -1,9 +1,30 @@
 
 #include "D4RTestQueue.h"
+#include "D4RTestNode.h"
+#include "D4RDeadlockException.h"
 #include "ThrowingAssert.h"
+#include "Clock.h"
+#include <set>
+#include <algorithm>
 #include <stdio.h>
 
 namespace D4R {
+
+    namespace {
+        /** Marks the node as blocked on the queue while in scope. */
+        class BlockRecord {
+        public:
+            BlockRecord(TestNode *n, TestQueue *q) : node(n) {
+                if (node) { node->BlockedOn(q, MonotonicTime()); }
+            }
+            ~BlockRecord() {
+                if (node) { node->BlockedOn(0, 0); }
+            }
+        private:
+            TestNode *node;
+        };
+    }
+
     TestQueue::TestQueue(unsigned initialsize, const std::string &name_)
         : detected(false), 
         aborted(false),
@@ -11,7 +32,10 @@ namespace D4R {
         count(0),
         enqueue_amount(0),
         dequeue_amount(0),
-        name(name_)
+        name(name_),
+        used4r(true),
+        readertestnode(0),
+        writertestnode(0)
     {
         Logger::Name(name);
     }
@@ -23,7 +47,10 @@ namespace D4R {
         count(0),
         enqueue_amount(0),
         dequeue_amount(0),
-        name(queued["name"].AsString())
+        name(queued["name"].AsString()),
+        used4r(true),
+        readertestnode(0),
+        writertestnode(0)
     {
         Logger::Name(name);
     }
@@ -32,9 +59,17 @@ namespace D4R {
         PthreadMutexProtected al(lock);
         Trace("Enqueue %u", amount);
         enqueue_amount = amount;
-        while (WriteBlocked()) {
-            Trace("Blocking");
-            WriteBlock(queuesize);
+        if (WriteBlocked()) {
+            ++stats.blocks;
+            BlockRecord record(writertestnode, this);
+            while (WriteBlocked()) {
+                Trace("Blocking");
+                if (used4r) {
+                    WriteBlock(queuesize);
+                } else {
+                    Wait();
+                }
+            }
         }
         count += amount;
         enqueue_amount = 0;
@@ -45,11 +80,26 @@ namespace D4R {
         PthreadMutexProtected al(lock);
         Trace("Dequeue %u", amount);
         dequeue_amount = amount;
-        while (ReadBlocked()) {
-            Trace("Blocking");
-            ReadBlock();
+        if (ReadBlocked()) {
+            ++stats.blocks;
+            BlockRecord record(readertestnode, this);
+            try {
+                while (ReadBlocked()) {
+                    Trace("Blocking");
+                    if (used4r) {
+                        ReadBlock();
+                    } else {
+                        Wait();
+                    }
+                }
+            } catch (const DeadlockException &e) {
+                ++stats.deadlocks;
+                stats.latencies.push_back(MonotonicTime() - DeadlockFormed(readertestnode));
+                throw;
+            }
         }
         count -= amount;
+        stats.tokens += amount;
         dequeue_amount = 0;
         Signal();
     }
@@ -78,8 +128,50 @@ namespace D4R {
         return d;
     }
 
+    void TestQueue::SetTestNodes(TestNode *reader, TestNode *writer) {
+        PthreadMutexProtected al(lock);
+        readertestnode = reader;
+        writertestnode = writer;
+    }
+
+    TestQueue::Stats TestQueue::GetStats() const {
+        PthreadMutexProtected al(lock);
+        return stats;
+    }
+
+    void TestQueue::UnlockedSignalReaderTagChanged() {
+        ++stats.tagsignals;
+        QueueBase::UnlockedSignalReaderTagChanged();
+    }
+
+    void TestQueue::UnlockedSignalWriterTagChanged() {
+        ++stats.tagsignals;
+        QueueBase::UnlockedSignalWriterTagChanged();
+    }
+
+    /**
+     * Follow the chain of blocked nodes starting at blocked, only
+     * taking the lock of each node and never of another queue.
+     * \return the time the last node in the chain blocked
+     */
+    double TestQueue::DeadlockFormed(TestNode *blocked) {
+        std::set<TestNode*> visited;
+        double formed = 0;
+        TestNode *current = blocked;
+        while (current && visited.insert(current).second) {
+            double since = 0;
+            TestQueue *q = current->BlockedOn(since);
+            if (!q) { break; }
+            formed = std::max(formed, since);
+            current = (q->writertestnode == current ? q->readertestnode : q->writertestnode);
+        }
+        return formed;
+    }
+
     void TestQueue::Detect() {
         detected = true;
+        ++stats.detections;
+        stats.latencies.push_back(MonotonicTime() - DeadlockFormed(writertestnode));
         queuesize = count + enqueue_amount;
         Debug("increased queue size", name.c_str());
         Signal();
@@ -7,8 +7,12 @@
 #include "Logger.h"
 #include <exception>
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 namespace D4R {
+    class TestNode;
+
     class TestQueue : public D4R::QueueBase, public Logger {
     public:
         TestQueue(unsigned initialsize, const std::string &name_);
@@ -54,9 +58,37 @@ namespace D4R {
         void Unlock() const { lock.Unlock(); }
 
         bool Detected();
+
+        /**
+         * When not using the D4R a blocked reader or writer just
+         * waits, only for graphs that never deadlock.
+         */
+        void UseD4R(bool enable) { used4r = enable; }
+
+        /** The test nodes on each end, used to follow a chain of blocked nodes. */
+        void SetTestNodes(TestNode *reader, TestNode *writer);
+
+        struct Stats {
+            Stats() : tokens(0), blocks(0), tagsignals(0), detections(0), deadlocks(0) {}
+            uint64_t tokens;
+            uint64_t blocks;
+            /// tag changes signaled to this queue
+            uint64_t tagsignals;
+            /// artificial deadlocks resolved on this queue
+            uint64_t detections;
+            /// true deadlocks detected on this queue
+            uint64_t deadlocks;
+            /// seconds from when a deadlock formed to when it was detected
+            std::vector<double> latencies;
+        };
+        Stats GetStats() const;
+    protected:
+        void UnlockedSignalReaderTagChanged();
+        void UnlockedSignalWriterTagChanged();
     private:
 
         void Detect();
+        double DeadlockFormed(TestNode *blocked);
 
         void Signal() { cond.Broadcast(); }
         void Wait() { cond.Wait(lock); }
@@ -70,6 +102,10 @@ namespace D4R {
         unsigned enqueue_amount;
         unsigned dequeue_amount;
         const std::string name;
+        bool used4r;
+        TestNode *readertestnode;
+        TestNode *writertestnode;
+        Stats stats;
     };
 
     class TestQueueAbortException : public std::exception {
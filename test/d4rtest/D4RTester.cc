@@ -2,13 +2,16 @@
 
 #include "D4RTester.h"
 #include "D4RTestNode.h"
+#include "Clock.h"
 #include <vector>
 #include <iostream>
 #include <algorithm>
 
 namespace D4R {
 
-    Tester::Tester() {
+    Tester::Tester(bool used4r_)
+        : used4r(used4r_), elapsed(0)
+    {
     }
 
     Tester::~Tester() {
@@ -35,6 +38,7 @@ namespace D4R {
 
     void Tester::Run() {
         std::vector<TestNode*> joiners;
+        const double start = MonotonicTime();
         {
             PthreadMutexProtected al(lock);
             NodeMap::iterator nodeitr = nodemap.begin();
@@ -49,6 +53,47 @@ namespace D4R {
             (*itr)->Join();
             ++itr;
         }
+        elapsed = MonotonicTime() - start;
+    }
+
+    Variant Tester::Statistics() {
+        PthreadMutexProtected al(lock);
+        uint64_t tokens = 0, blocks = 0, tagsignals = 0, detections = 0, deadlocks = 0;
+        std::vector<double> latencies;
+        for (QueueMap::iterator qitr = queuemap.begin(); qitr != queuemap.end(); ++qitr) {
+            TestQueue::Stats stats = qitr->second.queue->GetStats();
+            tokens += stats.tokens;
+            blocks += stats.blocks;
+            tagsignals += stats.tagsignals;
+            detections += stats.detections;
+            deadlocks += stats.deadlocks;
+            latencies.insert(latencies.end(), stats.latencies.begin(), stats.latencies.end());
+        }
+        Variant ret(Variant::ObjectType);
+        ret["d4r"] = used4r;
+        ret["success"] = Success();
+        ret["nodes"] = nodemap.size();
+        ret["queues"] = queuemap.size();
+        ret["seconds"] = elapsed;
+        ret["tokens"] = tokens;
+        ret["throughput"] = (elapsed > 0 ? tokens/elapsed : 0);
+        ret["blocks"] = blocks;
+        ret["tagsignals"] = tagsignals;
+        ret["detections"] = detections;
+        ret["deadlocks"] = deadlocks;
+        Variant latency(Variant::ObjectType);
+        latency["count"] = latencies.size();
+        if (!latencies.empty()) {
+            std::sort(latencies.begin(), latencies.end());
+            double sum = 0;
+            for (unsigned i = 0; i < latencies.size(); ++i) { sum += latencies[i]; }
+            latency["min"] = latencies.front();
+            latency["median"] = latencies[latencies.size()/2];
+            latency["mean"] = sum/latencies.size();
+            latency["max"] = latencies.back();
+        }
+        ret["latency"] = latency;
+        return ret;
     }
 
     struct node_t;
@@ -197,6 +242,8 @@ namespace D4R {
         qinfo.writer = nodemap[queued["writer"].AsString()];
         qinfo.reader->AddReadQueue(tq);
         qinfo.writer->AddWriteQueue(tq);
+        tq->SetTestNodes(qinfo.reader, qinfo.writer);
+        tq->UseD4R(used4r);
         PthreadMutexProtected al(lock);
         queuemap.insert(std::make_pair(tq->GetName(), qinfo));
     }
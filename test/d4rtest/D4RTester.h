@@ -12,7 +12,11 @@
 namespace D4R {
     class Tester : public TesterBase {
     public:
-        Tester();
+        /**
+         * \param used4r false to have blocked nodes just wait, only
+         * for graphs that never deadlock
+         */
+        Tester(bool used4r = true);
         ~Tester();
 
         void Deadlock(TestNodeBase *tnb) { Abort(); }
@@ -25,6 +29,12 @@ namespace D4R {
         void Run();
 
         void Report();
+
+        /**
+         * Totals of the queue counters after Run, with the detection
+         * latencies in seconds summarized.
+         */
+        Variant Statistics();
     protected:
         virtual void CreateNode(const Variant &noded);
         virtual void CreateQueue(const Variant &queued);
@@ -40,6 +50,8 @@ namespace D4R {
         };
     private:
         PthreadMutex lock;
+        const bool used4r;
+        double elapsed;
         typedef std::map<std::string, QueueInfo> QueueMap;
         NodeMap nodemap;
         QueueMap queuemap;
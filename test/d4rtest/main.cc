@@ -1,30 +1,57 @@
 
 
 #include "D4RTester.h"
+#include "D4RBenchmark.h"
 #include "Variant.h"
 #include "JSONToVariant.h"
 #include "Directory.h"
 #include "Logger.h"
 #include <vector>
+#include <iostream>
 #include <stdlib.h>
 #include <stdio.h>
 
-const char VALID_OPS[] = "l:r";
+const char VALID_OPS[] = "l:rbs:x:n:h";
 
 
 int main(int argc, char **argv) {
     bool procOpts = true;
     int loglevel = Logger::DEBUG;
     bool repeat = false;
+    bool benchmark = false;
+    bool loglevelset = false;
+    unsigned seed = 1;
+    unsigned scale = 1;
+    unsigned runs = 1;
     while (procOpts) {
         int opt = getopt(argc, argv, VALID_OPS);
         switch (opt) {
         case 'l':
             loglevel = atoi(optarg);
+            loglevelset = true;
             break;
         case 'r':
             repeat = true;
             break;
+        case 'b':
+            benchmark = true;
+            break;
+        case 's':
+            seed = strtoul(optarg, 0, 0);
+            break;
+        case 'x':
+            scale = strtoul(optarg, 0, 0);
+            break;
+        case 'n':
+            runs = strtoul(optarg, 0, 0);
+            break;
+        case 'h':
+            printf("Usage: %s [-l level] [-r] [test dir]\n"
+                    "       %s -b [-l level] [-s seed] [-x scale] [-n runs]\n"
+                    "Runs the tests in test dir, or with -b runs the benchmarks and\n"
+                    "prints the statistics of each run as a line of JSON.\n",
+                    argv[0], argv[0]);
+            return 0;
         case -1:
             procOpts = false;
             break;
@@ -41,6 +68,19 @@ int main(int argc, char **argv) {
         dirname = argv[optind];
     }
 
+    if (benchmark) {
+        // Keep the output to the JSON lines unless asked
+        LoggerStdOutput loggerout(loglevelset ? loglevel : int(Logger::WARNING));
+        try {
+            D4R::Benchmark bench(&loggerout, seed, scale);
+            bench.RunAll(std::cout, runs);
+        } catch (const std::exception &e) {
+            printf("Error: %s\n", e.what());
+            return 1;
+        }
+        return 0;
+    }
+
     std::string ext = ".test";
     LoggerStdOutput loggerout(loglevel);
 
@@ -0,0 +1,529 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Find what limits the throughput of a process network.
+ *
+ * Reads the stats a kernel writes (KernelAttr::SetStatsFile), a
+ * snapshot saved from its stats server (KernelAttr::SetStatsAddress) or
+ * the trace it records (KernelAttr::SetTraceFile), several files from the
+ * kernels of one context may be given. Every node is busy for the part
+ * of its life it was not blocked on a queue. A node blocked reading is
+ * waiting on the writer of that queue and a node blocked writing on the
+ * reader, so the blocking a node causes is the time its neighbours
+ * spent waiting on it. Following the longest wait from node to node
+ * ends at the node holding the network back, the critical path.
+ *
+ * The network cannot run faster than its busiest node, so the
+ * throughput limit is the measured throughput divided by the busy
+ * fraction of that node. A queue on which the writer and the reader
+ * both block is too short to smooth out their bursts, a bigger one is
+ * suggested. Blocking on only one side means the other node is slower
+ * and a bigger queue would not help.
+ */
+
+#include "VariantToJSON.h"
+#include "JSONToVariant.h"
+#include "Variant.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <stdexcept>
+
+typedef uint64_t Key_t;
+
+struct Node {
+    Node() : key(0), walltime(0), cputime(-1), readblocked(0), writeblocked(0),
+        upstream(0), downstream(0) {}
+    std::string name;
+    Key_t key;
+    double walltime;
+    double cputime;
+    double readblocked;
+    double writeblocked;
+    /// Time the writers of our inputs spent blocked on us
+    double upstream;
+    /// Time the readers of our outputs spent blocked on us
+    double downstream;
+    double Busy() const { return std::max(0.0, walltime - readblocked - writeblocked); }
+    double Utilization() const { return walltime > 0 ? Busy()/walltime : 0; }
+};
+
+struct Queue {
+    Queue() : key(0), writer(0), reader(0), writeblocked(0), readblocked(0),
+        writestalls(0), readstalls(0), enqueued(0), dequeued(0), length(0), grows(0) {}
+    Key_t key;
+    Key_t writer;
+    Key_t reader;
+    std::string writerport;
+    std::string readerport;
+    double writeblocked;
+    double readblocked;
+    unsigned long writestalls;
+    unsigned long readstalls;
+    uint64_t enqueued;
+    uint64_t dequeued;
+    /// The length of one channel, as set by QueueAttr::SetLength
+    uint64_t length;
+    unsigned grows;
+    uint64_t Bytes() const { return std::max(enqueued, dequeued); }
+};
+
+typedef std::map<Key_t, Node> NodeMap;
+typedef std::map<Key_t, Queue> QueueMap;
+
+struct Network {
+    Network() : duration(0), stalls(false) {}
+    NodeMap nodes;
+    QueueMap queues;
+    double duration;
+    /// Whether the number of times each side blocked is known
+    bool stalls;
+};
+
+static Node &GetNode(Network &net, Key_t key) {
+    Node &node = net.nodes[key];
+    node.key = key;
+    return node;
+}
+
+static Queue &GetQueue(Network &net, Key_t key) {
+    Queue &queue = net.queues[key];
+    queue.key = key;
+    return queue;
+}
+
+static void LoadNodeStats(Network &net, const Variant &nodes) {
+    for (Variant::ConstListIterator n = nodes.ListBegin(); n != nodes.ListEnd(); ++n) {
+        Node &node = GetNode(net, (*n)["key"].AsNumber<Key_t>());
+        node.name = (*n)["name"].AsString();
+        node.walltime = (*n)["walltime"].AsDouble();
+        node.cputime = (*n)["cputime"].AsDouble();
+        node.readblocked = (*n)["readblocked"].AsDouble();
+        node.writeblocked = (*n)["writeblocked"].AsDouble();
+        net.duration = std::max(net.duration, node.walltime);
+        const Variant &endpoints = (*n)["endpoints"];
+        for (Variant::ConstListIterator e = endpoints.ListBegin(); e != endpoints.ListEnd(); ++e) {
+            Queue &queue = GetQueue(net, (*e)["queue"].AsNumber<Key_t>());
+            // The stats sum the channels, the trace and QueueAttr count one
+            const uint64_t channels = std::max((*e)["channels"].AsNumber<uint64_t>(), uint64_t(1));
+            queue.length = std::max(queue.length, (*e)["length"].AsNumber<uint64_t>()/channels);
+            if ((*e)["reader"].IsTrue()) {
+                queue.reader = node.key;
+                queue.readerport = (*e)["port"].AsString();
+                queue.readblocked = (*e)["blocked"].AsDouble();
+                queue.dequeued = (*e)["bytes"].AsNumber<uint64_t>();
+            } else {
+                queue.writer = node.key;
+                queue.writerport = (*e)["port"].AsString();
+                queue.writeblocked = (*e)["blocked"].AsDouble();
+                queue.enqueued = (*e)["bytes"].AsNumber<uint64_t>();
+            }
+        }
+    }
+}
+
+/**
+ * A stats file or a snapshot from the stats server (see StatsServer),
+ * which has the nodes which have ended apart.
+ */
+static void LoadStats(Network &net, const Variant &doc) {
+    LoadNodeStats(net, doc["nodes"]);
+    if (doc.Contains("ended") == Variant::ArrayType) {
+        LoadNodeStats(net, doc["ended"]);
+    }
+}
+
+static void LoadTrace(Network &net, const Variant &doc) {
+    typedef std::pair<Key_t, Key_t> LaneQueue;
+    std::map<Key_t, double> running;
+    std::map<LaneQueue, double> reading;
+    std::map<LaneQueue, double> writing;
+    double first = -1, last = 0;
+    const Variant &events = doc["traceEvents"];
+    for (Variant::ConstListIterator e = events.ListBegin(); e != events.ListEnd(); ++e) {
+        const std::string &name = (*e)["name"].AsString();
+        const std::string &phase = (*e)["ph"].AsString();
+        const Key_t lane = (*e)["tid"].AsNumber<Key_t>();
+        if (phase == "M") {
+            if (name == "thread_name") {
+                GetNode(net, lane).name = (*e)["args"]["name"].AsString();
+            }
+            continue;
+        }
+        // Times in the trace are in microseconds
+        const double ts = (*e)["ts"].AsDouble()*1e-6;
+        if (first < 0) { first = ts; }
+        last = std::max(last, ts);
+        const Key_t qkey = (*e)["args"]["queue"].AsNumber<Key_t>();
+        const uint64_t value = (*e)["args"]["value"].AsNumber<uint64_t>();
+        Node &node = GetNode(net, lane);
+        if (name == "run") {
+            if (phase == "B") {
+                running[lane] = ts;
+            } else if (phase == "E") {
+                // The begin may have fallen out of the ring
+                const double begin = running.count(lane) ? running[lane] : first;
+                node.walltime += ts - begin;
+                running.erase(lane);
+            }
+        } else if (name == "read blocked" || name == "write blocked") {
+            const bool reader = (name == "read blocked");
+            std::map<LaneQueue, double> &open = (reader ? reading : writing);
+            const LaneQueue lq(lane, qkey);
+            if (phase == "B") {
+                open[lq] = ts;
+            } else if (phase == "E" && open.count(lq)) {
+                const double blocked = ts - open[lq];
+                open.erase(lq);
+                Queue &queue = GetQueue(net, qkey);
+                if (reader) {
+                    queue.reader = lane;
+                    queue.readblocked += blocked;
+                    ++queue.readstalls;
+                    node.readblocked += blocked;
+                } else {
+                    queue.writer = lane;
+                    queue.writeblocked += blocked;
+                    ++queue.writestalls;
+                    node.writeblocked += blocked;
+                }
+            }
+        } else if (name == "enqueue") {
+            Queue &queue = GetQueue(net, qkey);
+            queue.writer = lane;
+            queue.enqueued += value;
+        } else if (name == "dequeue") {
+            Queue &queue = GetQueue(net, qkey);
+            queue.reader = lane;
+            queue.dequeued += value;
+        } else if (name == "queue") {
+            Queue &queue = GetQueue(net, qkey);
+            queue.length = std::max(queue.length, value);
+        } else if (name == "grow") {
+            Queue &queue = GetQueue(net, qkey);
+            queue.length = std::max(queue.length, value);
+            ++queue.grows;
+        }
+    }
+    // Nodes still running when the trace was written
+    for (std::map<Key_t, double>::iterator r = running.begin(); r != running.end(); ++r) {
+        net.nodes[r->first].walltime += last - r->second;
+    }
+    net.duration = std::max(net.duration, last - first);
+    net.stalls = true;
+}
+
+static bool Load(Network &net, const std::string &filename) {
+    std::ifstream is(filename.c_str());
+    if (!is) {
+        fprintf(stderr, "Unable to open %s\n", filename.c_str());
+        return false;
+    }
+    Variant doc;
+    try {
+        doc = VariantFromJSON(is);
+    } catch (const std::exception &) {
+        fprintf(stderr, "Unable to parse %s\n", filename.c_str());
+        return false;
+    }
+    if (doc.IsObject() && doc.Contains("traceEvents") == Variant::ArrayType) {
+        LoadTrace(net, doc);
+    } else if (doc.IsObject() && doc.Contains("nodes") == Variant::ArrayType) {
+        LoadStats(net, doc);
+    } else {
+        fprintf(stderr, "%s is neither a CPN stats file nor a trace\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void Blame(Network &net) {
+    for (QueueMap::iterator q = net.queues.begin(); q != net.queues.end(); ++q) {
+        if (q->second.writer && net.nodes.count(q->second.writer)) {
+            net.nodes[q->second.writer].downstream += q->second.readblocked;
+        }
+        if (q->second.reader && net.nodes.count(q->second.reader)) {
+            net.nodes[q->second.reader].upstream += q->second.writeblocked;
+        }
+    }
+}
+
+static std::string NodeName(const Network &net, Key_t key) {
+    NodeMap::const_iterator entry = net.nodes.find(key);
+    if (entry == net.nodes.end() || entry->second.name.empty()) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "#%llu", (unsigned long long)key);
+        return key ? buf : "?";
+    }
+    return entry->second.name;
+}
+
+/** \return node.port, only the node when the port is not known (traces) */
+static std::string EndName(const Network &net, Key_t key, const std::string &port) {
+    return port.empty() ? NodeName(net, key) : NodeName(net, key) + "." + port;
+}
+
+/**
+ * \return the node the given node waits on longest, 0 if it is not
+ * mostly waiting.
+ */
+static Key_t WaitsOn(const Network &net, const Node &node) {
+    Key_t peer = 0;
+    double longest = node.Busy();
+    for (QueueMap::const_iterator q = net.queues.begin(); q != net.queues.end(); ++q) {
+        if (q->second.reader == node.key && q->second.readblocked > longest && q->second.writer) {
+            longest = q->second.readblocked;
+            peer = q->second.writer;
+        }
+        if (q->second.writer == node.key && q->second.writeblocked > longest && q->second.reader) {
+            longest = q->second.writeblocked;
+            peer = q->second.reader;
+        }
+    }
+    return net.nodes.count(peer) ? peer : 0;
+}
+
+/**
+ * Start at the node blocked the longest and follow what each node
+ * waits on until reaching one which is mostly busy.
+ */
+static std::vector<Key_t> CriticalPath(const Network &net) {
+    std::vector<Key_t> path;
+    Key_t start = 0;
+    double longest = -1;
+    for (NodeMap::const_iterator n = net.nodes.begin(); n != net.nodes.end(); ++n) {
+        const double blocked = n->second.readblocked + n->second.writeblocked;
+        if (blocked > longest) {
+            longest = blocked;
+            start = n->first;
+        }
+    }
+    std::set<Key_t> seen;
+    for (Key_t key = start; key && !seen.count(key); key = WaitsOn(net, net.nodes.find(key)->second)) {
+        seen.insert(key);
+        path.push_back(key);
+    }
+    return path;
+}
+
+static bool ByCaused(const Node *a, const Node *b) {
+    return a->upstream + a->downstream > b->upstream + b->downstream;
+}
+
+static uint64_t NextPow2(uint64_t v) {
+    uint64_t p = 1;
+    while (p < v) { p <<= 1; }
+    return p;
+}
+
+/**
+ * \return the suggested length of the queue, 0 for no change
+ * \param threshold the fraction of the run both sides must block
+ */
+static uint64_t SuggestLength(const Network &net, const Queue &queue, double threshold) {
+    if (queue.length == 0 || net.duration <= 0) { return 0; }
+    const double limit = threshold*net.duration;
+    if (queue.writeblocked > limit && queue.readblocked > limit) {
+        if (!net.stalls) { return 2*queue.length; }
+        // Enough room for what the writer produces during an average
+        // stall of the reader, so neither has to wait on the other
+        const double rate = queue.Bytes()/net.duration;
+        const double stall = queue.readblocked/std::max(queue.readstalls, 1ul);
+        return NextPow2(std::max(queue.length + uint64_t(rate*stall), 2*queue.length));
+    }
+    if (queue.grows > 0) {
+        // Start at the size it grew to
+        return queue.length;
+    }
+    return 0;
+}
+
+static void Report(const Network &net, const std::vector<Key_t> &path, double threshold) {
+    const double T = net.duration;
+    printf("Run time %.6f s, %lu nodes, %lu queues\n\n", T,
+            (unsigned long)net.nodes.size(), (unsigned long)net.queues.size());
+
+    printf("%-24s %10s %10s %10s %10s %6s\n", "node", "wall s", "cpu s",
+            "read blk s", "write blk s", "busy");
+    const Node *busiest = 0;
+    for (NodeMap::const_iterator n = net.nodes.begin(); n != net.nodes.end(); ++n) {
+        const Node &node = n->second;
+        printf("%-24s %10.4f %10.4f %10.4f %10.4f %5.1f%%\n", NodeName(net, node.key).c_str(),
+                node.walltime, node.cputime, node.readblocked, node.writeblocked,
+                100*node.Utilization());
+        if (!busiest || node.Utilization() > busiest->Utilization()) { busiest = &node; }
+    }
+
+    // The busiest node saturates first, every rate can only grow as much
+    const double headroom = (busiest && busiest->Utilization() > 0 ? 1/busiest->Utilization() : 1);
+    printf("\n%-32s %-32s %10s %10s %10s %10s %10s\n", "queue writer", "queue reader",
+            "MB/s", "limit MB/s", "length", "w blk s", "r blk s");
+    for (QueueMap::const_iterator q = net.queues.begin(); q != net.queues.end(); ++q) {
+        const Queue &queue = q->second;
+        const double rate = (T > 0 ? queue.Bytes()/T : 0);
+        printf("%-32s %-32s %10.3f %10.3f %10llu %10.4f %10.4f\n",
+                EndName(net, queue.writer, queue.writerport).c_str(),
+                EndName(net, queue.reader, queue.readerport).c_str(),
+                rate*1e-6, headroom*rate*1e-6, (unsigned long long)queue.length,
+                queue.writeblocked, queue.readblocked);
+    }
+
+    if (busiest) {
+        printf("\nBusiest node %s is busy %.1f%% of the time, the steady state\n"
+                "throughput limit is %.2fx the measured throughput.\n",
+                NodeName(net, busiest->key).c_str(), 100*busiest->Utilization(), headroom);
+    }
+
+    if (!path.empty()) {
+        printf("\nCritical path:");
+        for (unsigned i = 0; i < path.size(); ++i) {
+            printf("%s%s", (i ? " -> " : " "), NodeName(net, path[i]).c_str());
+        }
+        printf("\n");
+    }
+
+    std::vector<const Node*> ranked;
+    for (NodeMap::const_iterator n = net.nodes.begin(); n != net.nodes.end(); ++n) {
+        if (n->second.upstream + n->second.downstream > 0) { ranked.push_back(&n->second); }
+    }
+    std::sort(ranked.begin(), ranked.end(), ByCaused);
+    if (!ranked.empty()) {
+        printf("\nBlocking caused (time neighbours waited on the node):\n");
+        printf("%-24s %12s %12s\n", "node", "upstream s", "downstream s");
+        for (unsigned i = 0; i < ranked.size(); ++i) {
+            printf("%-24s %12.4f %12.4f\n", NodeName(net, ranked[i]->key).c_str(),
+                    ranked[i]->upstream, ranked[i]->downstream);
+        }
+    }
+
+    bool header = false;
+    for (QueueMap::const_iterator q = net.queues.begin(); q != net.queues.end(); ++q) {
+        const uint64_t suggested = SuggestLength(net, q->second, threshold);
+        if (suggested == 0) { continue; }
+        if (!header) {
+            printf("\nSuggested queue lengths:\n");
+            header = true;
+        }
+        printf("%s -> %s: %llu bytes per channel (now %llu%s)\n",
+                EndName(net, q->second.writer, q->second.writerport).c_str(),
+                EndName(net, q->second.reader, q->second.readerport).c_str(),
+                (unsigned long long)suggested, (unsigned long long)q->second.length,
+                (q->second.grows ? ", grew" : ""));
+    }
+}
+
+static std::string DotId(const Network &net, Key_t key, Key_t queue, const char *end) {
+    if (net.nodes.count(key)) {
+        return "\"" + NodeName(net, key) + "\"";
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s_%llu", end, (unsigned long long)queue);
+    return buf;
+}
+
+/**
+ * Write the network in the graphviz dot format, the width of an edge
+ * is proportional to the throughput of the queue and the critical path
+ * is drawn in red.
+ */
+static bool WriteDot(const Network &net, const std::vector<Key_t> &path, const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "w");
+    if (!f) { return false; }
+    std::set<std::pair<Key_t, Key_t> > critical;
+    for (unsigned i = 1; i < path.size(); ++i) {
+        critical.insert(std::make_pair(path[i - 1], path[i]));
+        critical.insert(std::make_pair(path[i], path[i - 1]));
+    }
+    const double T = net.duration;
+    double maxrate = 0;
+    for (QueueMap::const_iterator q = net.queues.begin(); q != net.queues.end(); ++q) {
+        maxrate = std::max(maxrate, T > 0 ? q->second.Bytes()/T : 0);
+    }
+    fprintf(f, "digraph {\n");
+    for (NodeMap::const_iterator n = net.nodes.begin(); n != net.nodes.end(); ++n) {
+        const bool bottleneck = !path.empty() && path.back() == n->first;
+        fprintf(f, "    \"%s\" [label=\"%s\\nbusy %.0f%%\"%s]\n", NodeName(net, n->first).c_str(),
+                NodeName(net, n->first).c_str(), 100*n->second.Utilization(),
+                (bottleneck ? ",color=red,style=bold" : ""));
+    }
+    for (QueueMap::const_iterator q = net.queues.begin(); q != net.queues.end(); ++q) {
+        const Queue &queue = q->second;
+        const std::string from = DotId(net, queue.writer, queue.key, "in");
+        const std::string to = DotId(net, queue.reader, queue.key, "out");
+        if (!net.nodes.count(queue.writer)) { fprintf(f, "    %s [label=\"\",shape=plaintext]\n", from.c_str()); }
+        if (!net.nodes.count(queue.reader)) { fprintf(f, "    %s [label=\"\",shape=plaintext]\n", to.c_str()); }
+        const double rate = (T > 0 ? queue.Bytes()/T : 0);
+        const double width = 1 + (maxrate > 0 ? 7*rate/maxrate : 0);
+        fprintf(f, "    %s -> %s [taillabel=\"%s\",headlabel=\"%s\",label=\"%.3g MB/s\",penwidth=%.2f%s]\n",
+                from.c_str(), to.c_str(), queue.writerport.c_str(), queue.readerport.c_str(),
+                rate*1e-6, width,
+                (critical.count(std::make_pair(queue.writer, queue.reader)) ? ",color=red" : ""));
+    }
+    fprintf(f, "}\n");
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv) {
+    std::string dotfile;
+    double threshold = 0.05;
+    while (true) {
+        int c = getopt(argc, argv, "d:t:h");
+        if (c == -1) break;
+        switch (c) {
+        case 'd':
+            dotfile = optarg;
+            break;
+        case 't':
+            threshold = strtod(optarg, 0);
+            break;
+        case 'h':
+        default:
+            fprintf(stderr, "Usage: %s [options] <stats or trace file>...\n"
+                    "\t-d file\t Write the network annotated with throughput as graphviz dot\n"
+                    "\t-t n\t Fraction of the run both ends of a queue must block\n"
+                    "\t    \t before a bigger queue is suggested (current: %g)\n",
+                    *argv, threshold);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "No stats or trace file given, -h for help\n");
+        return 1;
+    }
+    Network net;
+    for (int i = optind; i < argc; ++i) {
+        if (!Load(net, argv[i])) { return 1; }
+    }
+    Blame(net);
+    std::vector<Key_t> path = CriticalPath(net);
+    Report(net, path, threshold);
+    if (!dotfile.empty() && !WriteDot(net, path, dotfile)) {
+        fprintf(stderr, "Unable to write %s\n", dotfile.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Measure what the fiber aware locks cost a kernel that does not
+ * use fibers, next to the plain pthread calls and a queue moving small
+ * blocks between two nodes.
+ *
+ * Run with -f to create a FiberScheduler first, which puts the locks
+ * of the whole process on their fiber aware path.
+ */
+#include "Kernel.h"
+#include "NodeBase.h"
+#include "FunctionNode.h"
+#include "IQueue.h"
+#include "OQueue.h"
+#include "FiberScheduler.h"
+#include "PthreadMutex.h"
+#include "PthreadCondition.h"
+#include "AutoLock.h"
+#include "Clock.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+
+using std::cout;
+using std::endl;
+using std::setw;
+using namespace CPN;
+
+// Keeps the compiler from removing the loops
+static volatile unsigned long sink;
+
+static void Report(const char *name, double elapsed, double base, unsigned long iterations) {
+    cout << setw(40) << std::left << name << std::right << std::fixed << std::setprecision(2)
+        << setw(10) << std::max(0.0, elapsed - base)/iterations*1e9 << " ns/call" << endl;
+}
+
+static double Empty(unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) { sink = i; }
+    return MonotonicTime() - start;
+}
+
+template<class Mutex>
+static double LockUnlock(Mutex &mutex, unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        AutoLock<Mutex> al(mutex);
+        sink = i;
+    }
+    return MonotonicTime() - start;
+}
+
+template<class Condition>
+static double Broadcast(Condition &cond, unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        cond.Broadcast();
+        sink = i;
+    }
+    return MonotonicTime() - start;
+}
+
+static void Source(NodeBase *node, unsigned long blocks, unsigned blocksize) {
+    OQueue<char> out = node->GetOQueue("out");
+    for (unsigned long i = 0; i < blocks; ++i) {
+        char *ptr = out.GetEnqueuePtr(blocksize);
+        ptr[0] = char(i);
+        out.Enqueue(blocksize);
+    }
+}
+
+static void Sink(NodeBase *node, unsigned blocksize) {
+    IQueue<char> in = node->GetIQueue("in");
+    while (const char *ptr = in.GetDequeuePtr(blocksize)) {
+        sink = ptr[0];
+        in.Dequeue(blocksize);
+    }
+}
+
+static double Pipeline(Kernel &kernel, unsigned long blocks, unsigned blocksize) {
+    const double start = MonotonicTime();
+    kernel.CreateFunctionNode("source", &Source, blocks, blocksize);
+    kernel.CreateFunctionNode("sink", &Sink, blocksize);
+    QueueAttr qattr(64*blocksize, blocksize);
+    qattr.SetWriter("source", "out").SetReader("sink", "in");
+    kernel.CreateQueue(qattr);
+    kernel.WaitForAllNodes();
+    return MonotonicTime() - start;
+}
+
+int main(int argc, char **argv) {
+    unsigned long iterations = 10000000;
+    unsigned long blocks = 2000000;
+    unsigned blocksize = 16;
+    bool fibers = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:s:fh")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoul(optarg, 0, 0);
+            break;
+        case 'b':
+            blocks = strtoul(optarg, 0, 0);
+            break;
+        case 's':
+            blocksize = strtoul(optarg, 0, 0);
+            break;
+        case 'f':
+            fibers = true;
+            break;
+        case 'h':
+        default:
+            cout << "Usage: " << argv[0] << " [-n iterations] [-b blocks] [-s blocksize] [-f]\n"
+                "Times the locks a kernel without fibers uses and a queue between two nodes.\n"
+                "\t-f\t create a FiberScheduler first, as a kernel using fibers or fusion does" << endl;
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (iterations == 0) { iterations = 1; }
+    if (blocks == 0) { blocks = 1; }
+    if (blocksize == 0) { blocksize = 1; }
+    if (fibers) {
+        // Never destroyed, the process stays on the fiber aware path anyway
+        new FiberScheduler(1, 1<<16);
+    }
+    cout << (FiberScheduler::Started() ? "Fiber scheduler started" : "No fiber scheduler") << endl;
+    // Its threads take the C library off its single threaded path
+    Kernel kernel(KernelAttr("lockbench").UseD4R(false));
+    const double base = Empty(iterations);
+
+    PthreadMutex pmutex;
+    FiberMutex fmutex;
+    FiberMutex rmutex(true);
+    Report("PthreadMutex lock and unlock", LockUnlock(pmutex, iterations), base, iterations);
+    Report("FiberMutex lock and unlock", LockUnlock(fmutex, iterations), base, iterations);
+    Report("recursive FiberMutex lock and unlock", LockUnlock(rmutex, iterations), base, iterations);
+
+    PthreadCondition pcond;
+    FiberCondition<PthreadCondition> fcond;
+    Report("PthreadCondition broadcast", Broadcast(pcond, iterations), base, iterations);
+    Report("FiberCondition broadcast", Broadcast(fcond, iterations), base, iterations);
+
+    Report("queue block of two thread nodes", Pipeline(kernel, blocks, blocksize), 0, blocks);
+    return 0;
+}
@@ -0,0 +1,151 @@
+//=============================================================================
+//	Computational Process Networks class library
+//	Copyright (C) 1997-2006  Gregory E. Allen and The University of Texas
+//
+//	This library is free software; you can redistribute it and/or modify it
+//	under the terms of the GNU Library General Public License as published
+//	by the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	This library is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//	Library General Public License for more details.
+//
+//	The GNU Public License is available in the file LICENSE, or you
+//	can write to the Free Software Foundation, Inc., 59 Temple Place -
+//	Suite 330, Boston, MA 02111-1307, USA, or you can find it on the
+//	World Wide Web at http://www.fsf.org.
+//=============================================================================
+/** \file
+ * \brief Measure what a trace message costs per call when the trace
+ * level is off and when it is on.
+ *
+ * Build with make TRACE=1 to compile the LOG_TRACE and SCOPE_TRACE
+ * macros in, without it they are compiled out and cost nothing.
+ */
+#include "Logger.h"
+#include "Clock.h"
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+
+using std::cout;
+using std::endl;
+using std::setw;
+
+/** Throws the messages away so only the logging itself is measured. */
+class NullOutput : public LoggerOutput {
+public:
+    NullOutput(int level) : count(0), loglevel(level) {}
+    int LogLevel() const { return loglevel; }
+    int LogLevel(int level) { return loglevel = level; }
+    void Log(int level, const std::string &msg) { count += msg.size(); }
+    unsigned long count;
+private:
+    int loglevel;
+};
+
+// Keeps the compiler from removing the loops
+static volatile unsigned long sink;
+
+static std::string State(unsigned long i) {
+    return std::string(i & 1 ? "odd" : "even");
+}
+
+static void Report(const char *name, double elapsed, double base, unsigned long iterations) {
+    cout << setw(40) << std::left << name << std::right << std::fixed << std::setprecision(2)
+        << setw(10) << std::max(0.0, elapsed - base)/iterations*1e9 << " ns/call" << endl;
+}
+
+static double Empty(unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) { sink = i; }
+    return MonotonicTime() - start;
+}
+
+static double TraceMacro(Logger &logger, unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        sink = i;
+        LOG_TRACE(logger, "Enqueue(%lu) %s", i, State(i).c_str());
+    }
+    return MonotonicTime() - start;
+}
+
+static double TraceCall(Logger &logger, unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        sink = i;
+        logger.Trace("Enqueue(%lu) %s", i, State(i).c_str());
+    }
+    return MonotonicTime() - start;
+}
+
+static double TraceLocked(Logger &logger, unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        sink = i;
+        // What every Trace call used to do before looking at the level
+        if (logger.LogLevel() <= Logger::TRACE) {
+            logger.Trace("Enqueue(%lu) %s", i, State(i).c_str());
+        }
+    }
+    return MonotonicTime() - start;
+}
+
+static double ScopeTracer(Logger &logger, unsigned long iterations) {
+    const double start = MonotonicTime();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        SCOPE_TRACE(logger);
+        sink = i;
+    }
+    return MonotonicTime() - start;
+}
+
+int main(int argc, char **argv) {
+    unsigned long iterations = 10000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoul(optarg, 0, 0);
+            break;
+        case 'h':
+        default:
+            cout << "Usage: " << argv[0] << " [-n iterations]\n"
+                "Times a trace message with the trace level off and on.\n"
+                "Build with make TRACE=1 to compile the trace macros in." << endl;
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (iterations == 0) { iterations = 1; }
+#ifdef _DEBUG
+    cout << "Trace macros compiled in" << endl;
+#else
+    cout << "Trace macros compiled out" << endl;
+#endif
+    NullOutput output(Logger::WARNING);
+    Logger logger(&output, Logger::INFO);
+    logger.Name("bench");
+    const double base = Empty(iterations);
+
+    cout << "Trace level off" << endl;
+    Report("LOG_TRACE", TraceMacro(logger, iterations), base, iterations);
+    Report("SCOPE_TRACE", ScopeTracer(logger, iterations), base, iterations);
+    Report("Logger::Trace", TraceCall(logger, iterations), base, iterations);
+    Report("Logger::Trace after a locked level read", TraceLocked(logger, iterations), base, iterations);
+
+    output.LogLevel(Logger::TRACE);
+    logger.LogLevel(Logger::TRACE);
+    const unsigned long oniterations = iterations/10 + 1;
+    const double onbase = Empty(oniterations);
+    cout << "Trace level on" << endl;
+    Report("LOG_TRACE", TraceMacro(logger, oniterations), onbase, oniterations);
+    Report("SCOPE_TRACE", ScopeTracer(logger, oniterations), onbase, oniterations);
+    Report("Logger::Trace", TraceCall(logger, oniterations), onbase, oniterations);
+    return 0;
+}